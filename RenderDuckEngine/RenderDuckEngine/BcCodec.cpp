@@ -0,0 +1,1163 @@
+#include "BcCodec.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+#include "JobSystem.h"
+
+namespace
+{
+	// Rows of blocks encoded by one job.
+	const u32 c_EncodeBlockRowsPerJob = 8;
+
+	// Decoding is far cheaper per block, so decode jobs take whole rows adding up to about this many.
+	const u32 c_DecodeBlocksPerJob = 4096;
+
+	const float c_Bc1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	const float c_Bc4Weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+	const u32 c_Bc7Weights2[4] = { 0, 21, 43, 64 };
+	const u32 c_Bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const u32 c_Bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Layout of each BC7 mode. Endpoints are stored channel by channel, subset by subset, P bits add
+	// one low bit to every channel of an endpoint, or of both endpoints of a subset when shared.
+	struct Bc7Mode
+	{
+		u32 m_Subsets;
+		u32 m_PartitionBits;
+		u32 m_RotationBits;
+		u32 m_IndexSelectionBits;
+		u32 m_ColourBits;
+		u32 m_AlphaBits;
+		u32 m_EndpointPBits;
+		u32 m_SharedPBits;
+		u32 m_IndexBits;
+
+		// Modes 4 and 5 give alpha indices of their own.
+		u32 m_SecondaryIndexBits;
+	};
+
+	const Bc7Mode c_Bc7Modes[8] =
+	{
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+	};
+
+	// Texel i of two subset partition p belongs to subset (c_Bc7Partitions2[p] >> i) & 1.
+	const u16 c_Bc7Partitions2[64] =
+	{
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+	};
+
+	// Two bits per texel, texel i of three subset partition p belongs to subset
+	// (c_Bc7Partitions3[p] >> (i * 2)) & 3.
+	const u32 c_Bc7Partitions3[64] =
+	{
+		0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+		0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+		0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+		0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+		0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+		0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+		0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+		0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+	};
+
+	// Anchor texels, whose index drops its top bit, of the subsets after the first. Subset 0 is
+	// always anchored at texel 0.
+	const u8 c_Bc7Anchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+		15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+		15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+		6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15,
+	};
+
+	const u8 c_Bc7Anchors3[2][64] =
+	{
+		{
+			3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+			3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+			8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+			3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3,
+		},
+		{
+			15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+			15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+			15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+			15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8,
+		},
+	};
+
+	// One block split into channels, so the kernels work on four texels at a time.
+	struct BlockTexels
+	{
+		alignas(16) float m_Channels[4][16];
+	};
+
+	void LoadBlock(const u8* texels, BlockTexels& block)
+	{
+		for (u32 i = 0; i < 16; ++i)
+		{
+			for (u32 c = 0; c < 4; ++c)
+			{
+				block.m_Channels[c][i] = texels[i * 4 + c];
+			}
+		}
+	}
+
+	// Mean and direction of greatest variance of the channels, by power iteration on the covariance.
+	void GetPrincipalAxis(const float* const* channels, u32 channelCount, float* mean, float* axis)
+	{
+		for (u32 c = 0; c < channelCount; ++c)
+		{
+			float sum = 0.0f;
+			for (u32 i = 0; i < 16; ++i)
+			{
+				sum += channels[c][i];
+			}
+			mean[c] = sum / 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (u32 a = 0; a < channelCount; ++a)
+		{
+			for (u32 b = a; b < channelCount; ++b)
+			{
+				float sum = 0.0f;
+				for (u32 i = 0; i < 16; ++i)
+				{
+					sum += (channels[a][i] - mean[a]) * (channels[b][i] - mean[b]);
+				}
+				covariance[a][b] = sum;
+				covariance[b][a] = sum;
+			}
+		}
+
+		for (u32 c = 0; c < channelCount; ++c)
+		{
+			axis[c] = 1.0f;
+		}
+		for (u32 iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for (u32 a = 0; a < channelCount; ++a)
+			{
+				for (u32 b = 0; b < channelCount; ++b)
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				length = std::max(length, fabsf(next[a]));
+			}
+
+			// Flat block, any direction will do.
+			if (length < 1e-6f)
+			{
+				break;
+			}
+			for (u32 c = 0; c < channelCount; ++c)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float lengthSquared = 0.0f;
+		for (u32 c = 0; c < channelCount; ++c)
+		{
+			lengthSquared += axis[c] * axis[c];
+		}
+		const float scale = 1.0f / sqrtf(lengthSquared);
+		for (u32 c = 0; c < channelCount; ++c)
+		{
+			axis[c] *= scale;
+		}
+	}
+
+	// Ends of the line through mean along axis that cover every texel.
+	void GetAxisExtent(const float* const* channels, u32 channelCount, const float* mean, const float* axis, float* start, float* end)
+	{
+		__m128 low = _mm_set1_ps(FLT_MAX);
+		__m128 high = _mm_set1_ps(-FLT_MAX);
+		for (u32 i = 0; i < 16; i += 4)
+		{
+			__m128 t = _mm_setzero_ps();
+			for (u32 c = 0; c < channelCount; ++c)
+			{
+				const __m128 offset = _mm_sub_ps(_mm_load_ps(channels[c] + i), _mm_set1_ps(mean[c]));
+				t = _mm_add_ps(t, _mm_mul_ps(offset, _mm_set1_ps(axis[c])));
+			}
+			low = _mm_min_ps(low, t);
+			high = _mm_max_ps(high, t);
+		}
+
+		alignas(16) float lows[4];
+		alignas(16) float highs[4];
+		_mm_store_ps(lows, low);
+		_mm_store_ps(highs, high);
+		const float tMin = std::min(std::min(lows[0], lows[1]), std::min(lows[2], lows[3]));
+		const float tMax = std::max(std::max(highs[0], highs[1]), std::max(highs[2], highs[3]));
+		for (u32 c = 0; c < channelCount; ++c)
+		{
+			start[c] = std::min(std::max(mean[c] + axis[c] * tMin, 0.0f), 255.0f);
+			end[c] = std::min(std::max(mean[c] + axis[c] * tMax, 0.0f), 255.0f);
+		}
+	}
+
+	// Nearest palette entry for every texel by squared distance. Returns the total squared error.
+	float ChooseIndices(const float* const* channels, u32 channelCount, const float (*palette)[4], u32 paletteSize, u8* indices)
+	{
+		__m128 total = _mm_setzero_ps();
+		for (u32 i = 0; i < 16; i += 4)
+		{
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (u32 entry = 0; entry < paletteSize; ++entry)
+			{
+				__m128 distance = _mm_setzero_ps();
+				for (u32 c = 0; c < channelCount; ++c)
+				{
+					const __m128 delta = _mm_sub_ps(_mm_load_ps(channels[c] + i), _mm_set1_ps(palette[entry][c]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(delta, delta));
+				}
+
+				const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((int)entry)), _mm_andnot_si128(closer, bestIndex));
+				best = _mm_min_ps(best, distance);
+			}
+
+			alignas(16) s32 chosen[4];
+			_mm_store_si128((__m128i*)chosen, bestIndex);
+			for (u32 k = 0; k < 4; ++k)
+			{
+				indices[i + k] = (u8)chosen[k];
+			}
+			total = _mm_add_ps(total, best);
+		}
+
+		alignas(16) float sums[4];
+		_mm_store_ps(sums, total);
+		return sums[0] + sums[1] + sums[2] + sums[3];
+	}
+
+	// Least squares endpoints for fixed indices, where weights[index] is how much of end the palette
+	// entry holds. False when the indices do not pin both endpoints down.
+	bool FitEndpoints(const float* const* channels, u32 channelCount, const u8* indices, const float* weights, float* start, float* end)
+	{
+		float aa = 0.0f;
+		float ab = 0.0f;
+		float bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for (u32 i = 0; i < 16; ++i)
+		{
+			const float b = weights[indices[i]];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (u32 c = 0; c < channelCount; ++c)
+			{
+				ax[c] += a * channels[c][i];
+				bx[c] += b * channels[c][i];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (fabsf(determinant) < 1e-6f)
+		{
+			return false;
+		}
+
+		const float scale = 1.0f / determinant;
+		for (u32 c = 0; c < channelCount; ++c)
+		{
+			start[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) * scale, 0.0f), 255.0f);
+			end[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) * scale, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	u16 PackRgb565(const float* rgb)
+	{
+		const u32 r = (u32)std::min(std::max(rgb[0] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+		const u32 g = (u32)std::min(std::max(rgb[1] * 63.0f / 255.0f + 0.5f, 0.0f), 63.0f);
+		const u32 b = (u32)std::min(std::max(rgb[2] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+		return (u16)((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRgb565(u16 colour, u32* rgb)
+	{
+		const u32 r = (colour >> 11) & 31;
+		const u32 g = (colour >> 5) & 63;
+		const u32 b = colour & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// Colours as the decoder rebuilds them. The 3 colour mode is only used by BC1 blocks whose
+	// first endpoint is not the larger one, the encoder never writes those.
+	void GetBc1Palette(u16 colour0, u16 colour1, bool allowThreeColour, u32 (*palette)[4])
+	{
+		UnpackRgb565(colour0, palette[0]);
+		UnpackRgb565(colour1, palette[1]);
+		palette[0][3] = 255;
+		palette[1][3] = 255;
+		const bool threeColour = allowThreeColour && colour0 <= colour1;
+		for (u32 c = 0; c < 3; ++c)
+		{
+			if (threeColour)
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+			else
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = threeColour ? 0 : 255;
+	}
+
+	float ChooseBc1Indices(const float* const* channels, u16 colour0, u16 colour1, u8* indices)
+	{
+		u32 palette[4][4];
+		GetBc1Palette(colour0, colour1, false, palette);
+		float entries[4][4];
+		for (u32 entry = 0; entry < 4; ++entry)
+		{
+			for (u32 c = 0; c < 3; ++c)
+			{
+				entries[entry][c] = (float)palette[entry][c];
+			}
+		}
+		return ChooseIndices(channels, 3, entries, 4, indices);
+	}
+
+	void WriteBc1Block(u16 colour0, u16 colour1, const u8* indices, u8* block)
+	{
+		// Equal endpoints would select the 3 colour mode, index 0 means the same there.
+		u32 bits = 0;
+		if (colour0 != colour1)
+		{
+			for (u32 i = 0; i < 16; ++i)
+			{
+				bits |= (u32)indices[i] << (i * 2);
+			}
+		}
+
+		// The 4 colour mode needs the larger endpoint first, swapping them swaps indices 0 and 1,
+		// and 2 and 3.
+		if (colour0 < colour1)
+		{
+			std::swap(colour0, colour1);
+			bits ^= 0x55555555;
+		}
+		memcpy(block, &colour0, 2);
+		memcpy(block + 2, &colour1, 2);
+		memcpy(block + 4, &bits, 4);
+	}
+
+	void EncodeBc1Colour(const BlockTexels& texels, u8* block)
+	{
+		const float* channels[3] = { texels.m_Channels[0], texels.m_Channels[1], texels.m_Channels[2] };
+		float mean[3];
+		float axis[3];
+		float start[3];
+		float end[3];
+		GetPrincipalAxis(channels, 3, mean, axis);
+		GetAxisExtent(channels, 3, mean, axis, start, end);
+
+		u16 colour0 = PackRgb565(start);
+		u16 colour1 = PackRgb565(end);
+		u8 indices[16];
+		float error = ChooseBc1Indices(channels, colour0, colour1, indices);
+
+		// One least squares pass moves the endpoints to fit the chosen indices.
+		if (error > 0.0f && FitEndpoints(channels, 3, indices, c_Bc1Weights, start, end))
+		{
+			const u16 fitted0 = PackRgb565(start);
+			const u16 fitted1 = PackRgb565(end);
+			u8 fittedIndices[16];
+			const float fittedError = ChooseBc1Indices(channels, fitted0, fitted1, fittedIndices);
+			if (fittedError < error)
+			{
+				colour0 = fitted0;
+				colour1 = fitted1;
+				memcpy(indices, fittedIndices, sizeof(indices));
+			}
+		}
+
+		WriteBc1Block(colour0, colour1, indices, block);
+	}
+
+	void GetBc4Palette(u32 value0, u32 value1, u32* palette)
+	{
+		palette[0] = value0;
+		palette[1] = value1;
+		if (value0 > value1)
+		{
+			for (u32 i = 2; i < 8; ++i)
+			{
+				palette[i] = ((8 - i) * value0 + (i - 1) * value1) / 7;
+			}
+		}
+		else
+		{
+			for (u32 i = 2; i < 6; ++i)
+			{
+				palette[i] = ((6 - i) * value0 + (i - 1) * value1) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	float ChooseBc4Indices(const float* values, u32 value0, u32 value1, u8* indices)
+	{
+		u32 palette[8];
+		GetBc4Palette(value0, value1, palette);
+		float entries[8][4];
+		for (u32 entry = 0; entry < 8; ++entry)
+		{
+			entries[entry][0] = (float)palette[entry];
+		}
+		return ChooseIndices(&values, 1, entries, 8, indices);
+	}
+
+	// One channel as an 8 level block, always in the mode with the larger value first.
+	void EncodeBc4Channel(const float* values, u8* block)
+	{
+		float low = values[0];
+		float high = values[0];
+		for (u32 i = 1; i < 16; ++i)
+		{
+			low = std::min(low, values[i]);
+			high = std::max(high, values[i]);
+		}
+
+		u32 value0 = (u32)high;
+		u32 value1 = (u32)low;
+		u8 indices[16] = {};
+		if (value0 != value1)
+		{
+			float error = ChooseBc4Indices(values, value0, value1, indices);
+
+			float start = 0.0f;
+			float end = 0.0f;
+			if (error > 0.0f && FitEndpoints(&values, 1, indices, c_Bc4Weights, &start, &end))
+			{
+				const u32 fitted0 = (u32)(start + 0.5f);
+				const u32 fitted1 = (u32)(end + 0.5f);
+				u8 fittedIndices[16];
+				if (fitted0 > fitted1 && ChooseBc4Indices(values, fitted0, fitted1, fittedIndices) < error)
+				{
+					value0 = fitted0;
+					value1 = fitted1;
+					memcpy(indices, fittedIndices, sizeof(indices));
+				}
+			}
+		}
+
+		block[0] = (u8)value0;
+		block[1] = (u8)value1;
+		u64 bits = 0;
+		for (u32 i = 0; i < 16; ++i)
+		{
+			bits |= (u64)indices[i] << (i * 3);
+		}
+		for (u32 i = 0; i < 6; ++i)
+		{
+			block[2 + i] = (u8)(bits >> (i * 8));
+		}
+	}
+
+	// Palette entries are packed into whole RGBA8 texels, so each texel is a single 32 bit copy.
+	void DecodeBc1Colour(const u8* block, bool allowThreeColour, u8* texels)
+	{
+		u16 colour0;
+		u16 colour1;
+		u32 bits;
+		memcpy(&colour0, block, 2);
+		memcpy(&colour1, block + 2, 2);
+		memcpy(&bits, block + 4, 4);
+
+		u32 palette[4][4];
+		GetBc1Palette(colour0, colour1, allowThreeColour, palette);
+		u32 packed[4];
+		for (u32 entry = 0; entry < 4; ++entry)
+		{
+			packed[entry] = palette[entry][0] | (palette[entry][1] << 8) | (palette[entry][2] << 16) | (palette[entry][3] << 24);
+		}
+		for (u32 i = 0; i < 16; ++i)
+		{
+			memcpy(texels + i * 4, &packed[(bits >> (i * 2)) & 3], 4);
+		}
+	}
+
+	void DecodeBc2Alpha(const u8* block, u8* texels)
+	{
+		u64 bits;
+		memcpy(&bits, block, 8);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			texels[i * 4 + 3] = (u8)(((bits >> (i * 4)) & 15) * 17);
+		}
+	}
+
+	void DecodeBc4Channel(const u8* block, u32 channel, u8* texels)
+	{
+		u32 palette[8];
+		GetBc4Palette(block[0], block[1], palette);
+		u64 bits = 0;
+		memcpy(&bits, block + 2, 6);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			texels[i * 4 + channel] = (u8)palette[(bits >> (i * 3)) & 7];
+		}
+	}
+
+	u32 Bc7Interpolate(u32 endpoint0, u32 endpoint1, u32 weight)
+	{
+		return ((64 - weight) * endpoint0 + weight * endpoint1 + 32) >> 6;
+	}
+
+	float ChooseBc7Indices(const float* const* channels, u32 channelCount, const u32* endpoint0, const u32* endpoint1,
+		const u32* weights, u32 levelCount, u8* indices)
+	{
+		float entries[16][4];
+		for (u32 entry = 0; entry < levelCount; ++entry)
+		{
+			for (u32 c = 0; c < channelCount; ++c)
+			{
+				entries[entry][c] = (float)Bc7Interpolate(endpoint0[c], endpoint1[c], weights[entry]);
+			}
+		}
+		return ChooseIndices(channels, channelCount, entries, levelCount, indices);
+	}
+
+	// Mode 6 endpoints are 7 bits per channel plus one low bit shared by the endpoint's channels.
+	void QuantizeBc7Mode6Endpoint(const float* endpoint, u32* expanded)
+	{
+		float bestError = FLT_MAX;
+		for (u32 p = 0; p < 2; ++p)
+		{
+			u32 values[4];
+			float error = 0.0f;
+			for (u32 c = 0; c < 4; ++c)
+			{
+				const u32 quantized = (u32)std::min(std::max((endpoint[c] - p) * 0.5f + 0.5f, 0.0f), 127.0f);
+				values[c] = (quantized << 1) | p;
+				const float delta = (float)values[c] - endpoint[c];
+				error += delta * delta;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(expanded, values, sizeof(values));
+			}
+		}
+	}
+
+	// Mode 5 colour endpoints are 7 bits, expanded by repeating the top bit.
+	void QuantizeBc7Mode5Colour(const float* endpoint, u32* expanded)
+	{
+		for (u32 c = 0; c < 3; ++c)
+		{
+			const u32 quantized = (u32)std::min(std::max(endpoint[c] * 127.0f / 255.0f + 0.5f, 0.0f), 127.0f);
+			expanded[c] = (quantized << 1) | (quantized >> 6);
+		}
+	}
+
+	void GetBc7Weights(const u32* weights, u32 levelCount, float* fractions)
+	{
+		for (u32 i = 0; i < levelCount; ++i)
+		{
+			fractions[i] = weights[i] / 64.0f;
+		}
+	}
+
+	// The first index of each set is stored without its top bit, swapping the endpoints clears it.
+	void FixBc7Anchor(u32 (*endpoints)[4], u32 levelCount, u8* indices)
+	{
+		if (indices[0] >= levelCount / 2)
+		{
+			std::swap(endpoints[0], endpoints[1]);
+			for (u32 i = 0; i < 16; ++i)
+			{
+				indices[i] = (u8)(levelCount - 1 - indices[i]);
+			}
+		}
+	}
+
+	// Appends count bits of value to a 128 bit block, least significant first.
+	void WriteBits(u8* block, u32& position, u32 value, u32 count)
+	{
+		for (u32 i = 0; i < count; ++i, ++position)
+		{
+			block[position >> 3] |= (u8)(((value >> i) & 1) << (position & 7));
+		}
+	}
+
+	// Reads a 128 bit block least significant bit first, a field at a time.
+	class Bc7BitReader
+	{
+	public:
+		explicit Bc7BitReader(const u8* block)
+		{
+			memcpy(&m_Low, block, 8);
+			memcpy(&m_High, block + 8, 8);
+		}
+
+		u32 Read(u32 count)
+		{
+			if (count == 0)
+			{
+				return 0;
+			}
+			const u32 value = (u32)m_Low & ((1u << count) - 1);
+			m_Low = (m_Low >> count) | (m_High << (64 - count));
+			m_High >>= count;
+			return value;
+		}
+
+	private:
+		u64 m_Low;
+		u64 m_High;
+	};
+
+	// One RGBA line with 16 levels.
+	void EncodeBc7Mode6(const float* const* channels, u8* block)
+	{
+		float mean[4];
+		float axis[4];
+		float start[4];
+		float end[4];
+		GetPrincipalAxis(channels, 4, mean, axis);
+		GetAxisExtent(channels, 4, mean, axis, start, end);
+
+		u32 endpoints[2][4];
+		u8 indices[16];
+		QuantizeBc7Mode6Endpoint(start, endpoints[0]);
+		QuantizeBc7Mode6Endpoint(end, endpoints[1]);
+		const float error = ChooseBc7Indices(channels, 4, endpoints[0], endpoints[1], c_Bc7Weights4, 16, indices);
+
+		float weights[16];
+		GetBc7Weights(c_Bc7Weights4, 16, weights);
+		if (error > 0.0f && FitEndpoints(channels, 4, indices, weights, start, end))
+		{
+			u32 fitted[2][4];
+			u8 fittedIndices[16];
+			QuantizeBc7Mode6Endpoint(start, fitted[0]);
+			QuantizeBc7Mode6Endpoint(end, fitted[1]);
+			if (ChooseBc7Indices(channels, 4, fitted[0], fitted[1], c_Bc7Weights4, 16, fittedIndices) < error)
+			{
+				memcpy(endpoints, fitted, sizeof(endpoints));
+				memcpy(indices, fittedIndices, sizeof(indices));
+			}
+		}
+		FixBc7Anchor(endpoints, 16, indices);
+
+		memset(block, 0, 16);
+		u32 position = 0;
+		WriteBits(block, position, 1 << 6, 7);
+		for (u32 c = 0; c < 4; ++c)
+		{
+			WriteBits(block, position, endpoints[0][c] >> 1, 7);
+			WriteBits(block, position, endpoints[1][c] >> 1, 7);
+		}
+		WriteBits(block, position, endpoints[0][0] & 1, 1);
+		WriteBits(block, position, endpoints[1][0] & 1, 1);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			WriteBits(block, position, indices[i], i == 0 ? 3 : 4);
+		}
+	}
+
+	// An RGB line and a separate alpha line, 4 levels each. Better than mode 6 when alpha does not
+	// follow the colour, such as gloss stored next to a normal.
+	void EncodeBc7Mode5(const float* const* channels, u8* block)
+	{
+		float mean[3];
+		float axis[3];
+		float start[3];
+		float end[3];
+		GetPrincipalAxis(channels, 3, mean, axis);
+		GetAxisExtent(channels, 3, mean, axis, start, end);
+
+		float weights[4];
+		GetBc7Weights(c_Bc7Weights2, 4, weights);
+
+		u32 colour[2][4] = {};
+		u8 colourIndices[16];
+		QuantizeBc7Mode5Colour(start, colour[0]);
+		QuantizeBc7Mode5Colour(end, colour[1]);
+		const float colourError = ChooseBc7Indices(channels, 3, colour[0], colour[1], c_Bc7Weights2, 4, colourIndices);
+		if (colourError > 0.0f && FitEndpoints(channels, 3, colourIndices, weights, start, end))
+		{
+			u32 fitted[2][4] = {};
+			u8 fittedIndices[16];
+			QuantizeBc7Mode5Colour(start, fitted[0]);
+			QuantizeBc7Mode5Colour(end, fitted[1]);
+			if (ChooseBc7Indices(channels, 3, fitted[0], fitted[1], c_Bc7Weights2, 4, fittedIndices) < colourError)
+			{
+				memcpy(colour, fitted, sizeof(colour));
+				memcpy(colourIndices, fittedIndices, sizeof(colourIndices));
+			}
+		}
+		FixBc7Anchor(colour, 4, colourIndices);
+
+		const float* alphaChannel = channels[3];
+		float low = alphaChannel[0];
+		float high = alphaChannel[0];
+		for (u32 i = 1; i < 16; ++i)
+		{
+			low = std::min(low, alphaChannel[i]);
+			high = std::max(high, alphaChannel[i]);
+		}
+
+		u32 alpha[2][4] = { { (u32)low }, { (u32)high } };
+		u8 alphaIndices[16];
+		const float alphaError = ChooseBc7Indices(&alphaChannel, 1, alpha[0], alpha[1], c_Bc7Weights2, 4, alphaIndices);
+		if (alphaError > 0.0f && FitEndpoints(&alphaChannel, 1, alphaIndices, weights, &low, &high))
+		{
+			u32 fitted[2][4] = { { (u32)(low + 0.5f) }, { (u32)(high + 0.5f) } };
+			u8 fittedIndices[16];
+			if (ChooseBc7Indices(&alphaChannel, 1, fitted[0], fitted[1], c_Bc7Weights2, 4, fittedIndices) < alphaError)
+			{
+				memcpy(alpha, fitted, sizeof(alpha));
+				memcpy(alphaIndices, fittedIndices, sizeof(alphaIndices));
+			}
+		}
+		FixBc7Anchor(alpha, 4, alphaIndices);
+
+		// No channel rotation, alpha stays alpha.
+		memset(block, 0, 16);
+		u32 position = 0;
+		WriteBits(block, position, 1 << 5, 6);
+		WriteBits(block, position, 0, 2);
+		for (u32 c = 0; c < 3; ++c)
+		{
+			WriteBits(block, position, colour[0][c] >> 1, 7);
+			WriteBits(block, position, colour[1][c] >> 1, 7);
+		}
+		WriteBits(block, position, alpha[0][0], 8);
+		WriteBits(block, position, alpha[1][0], 8);
+		for (u32 i = 0; i < 16; ++i)
+		{
+			WriteBits(block, position, colourIndices[i], i == 0 ? 1 : 2);
+		}
+		for (u32 i = 0; i < 16; ++i)
+		{
+			WriteBits(block, position, alphaIndices[i], i == 0 ? 1 : 2);
+		}
+	}
+
+	const u32* GetBc7WeightTable(u32 indexBits)
+	{
+		return indexBits == 2 ? c_Bc7Weights2 : indexBits == 3 ? c_Bc7Weights3 : c_Bc7Weights4;
+	}
+
+	// Every level of one line as packed RGBA8, four levels at a time with a channel in each 16 bit
+	// lane. Neither product nor their sum leaves 16 bits. levelCount is 4, 8 or 16.
+	void InterpolateBc7Palette(const u32* endpoint0, const u32* endpoint1, const u32* weights, u32 levelCount, u32* palette)
+	{
+		const __m128i start = _mm_setr_epi16((short)endpoint0[0], (short)endpoint0[1], (short)endpoint0[2], (short)endpoint0[3],
+			(short)endpoint0[0], (short)endpoint0[1], (short)endpoint0[2], (short)endpoint0[3]);
+		const __m128i end = _mm_setr_epi16((short)endpoint1[0], (short)endpoint1[1], (short)endpoint1[2], (short)endpoint1[3],
+			(short)endpoint1[0], (short)endpoint1[1], (short)endpoint1[2], (short)endpoint1[3]);
+		const __m128i full = _mm_set1_epi16(64);
+		const __m128i round = _mm_set1_epi16(32);
+
+		for (u32 level = 0; level < levelCount; level += 4)
+		{
+			__m128i pairs[2];
+			for (u32 pair = 0; pair < 2; ++pair)
+			{
+				const short weight0 = (short)weights[level + pair * 2];
+				const short weight1 = (short)weights[level + pair * 2 + 1];
+				const __m128i weight = _mm_setr_epi16(weight0, weight0, weight0, weight0, weight1, weight1, weight1, weight1);
+				const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(start, _mm_sub_epi16(full, weight)), _mm_mullo_epi16(end, weight));
+				pairs[pair] = _mm_srli_epi16(_mm_add_epi16(sum, round), 6);
+			}
+			_mm_storeu_si128((__m128i*)(palette + level), _mm_packus_epi16(pairs[0], pairs[1]));
+		}
+	}
+
+	// Widens an endpoint channel of count bits to 8 by repeating its top bits.
+	u32 ExpandBc7Channel(u32 value, u32 count)
+	{
+		return count == 8 ? value : (value << (8 - count)) | (value >> (2 * count - 8));
+	}
+
+	// All eight modes. The reserved mode, a first byte of zero, decodes to zero and returns false.
+	bool DecodeBc7Block(const u8* block, u8* texels)
+	{
+		u32 mode = 0;
+		while (mode < 8 && ((block[0] >> mode) & 1) == 0)
+		{
+			++mode;
+		}
+		if (mode == 8)
+		{
+			memset(texels, 0, 64);
+			return false;
+		}
+
+		const Bc7Mode& layout = c_Bc7Modes[mode];
+		Bc7BitReader reader(block);
+		reader.Read(mode + 1);
+		const u32 partition = reader.Read(layout.m_PartitionBits);
+		const u32 rotation = reader.Read(layout.m_RotationBits);
+		const u32 indexSelection = reader.Read(layout.m_IndexSelectionBits);
+
+		u32 endpoints[3][2][4];
+		for (u32 c = 0; c < 4; ++c)
+		{
+			const u32 bits = c < 3 ? layout.m_ColourBits : layout.m_AlphaBits;
+			for (u32 subset = 0; subset < layout.m_Subsets; ++subset)
+			{
+				endpoints[subset][0][c] = reader.Read(bits);
+				endpoints[subset][1][c] = reader.Read(bits);
+			}
+		}
+
+		u32 colourBits = layout.m_ColourBits;
+		u32 alphaBits = layout.m_AlphaBits;
+		if (layout.m_EndpointPBits != 0 || layout.m_SharedPBits != 0)
+		{
+			for (u32 subset = 0; subset < layout.m_Subsets; ++subset)
+			{
+				u32 pBits[2];
+				pBits[0] = reader.Read(1);
+				pBits[1] = layout.m_SharedPBits != 0 ? pBits[0] : reader.Read(1);
+				for (u32 e = 0; e < 2; ++e)
+				{
+					for (u32 c = 0; c < 4; ++c)
+					{
+						endpoints[subset][e][c] = (endpoints[subset][e][c] << 1) | pBits[e];
+					}
+				}
+			}
+			++colourBits;
+			alphaBits += alphaBits != 0 ? 1 : 0;
+		}
+
+		for (u32 subset = 0; subset < layout.m_Subsets; ++subset)
+		{
+			for (u32 e = 0; e < 2; ++e)
+			{
+				for (u32 c = 0; c < 3; ++c)
+				{
+					endpoints[subset][e][c] = ExpandBc7Channel(endpoints[subset][e][c], colourBits);
+				}
+				endpoints[subset][e][3] = alphaBits != 0 ? ExpandBc7Channel(endpoints[subset][e][3], alphaBits) : 255;
+			}
+		}
+
+		// Subset of every texel, two bits each.
+		u32 subsets = 0;
+		u32 anchors[3] = { 0, 0, 0 };
+		if (layout.m_Subsets == 2)
+		{
+			const u32 mask = c_Bc7Partitions2[partition];
+			for (u32 i = 0; i < 16; ++i)
+			{
+				subsets |= ((mask >> i) & 1) << (i * 2);
+			}
+			anchors[1] = c_Bc7Anchors2[partition];
+		}
+		else if (layout.m_Subsets == 3)
+		{
+			subsets = c_Bc7Partitions3[partition];
+			anchors[1] = c_Bc7Anchors3[0][partition];
+			anchors[2] = c_Bc7Anchors3[1][partition];
+		}
+
+		u8 indices[16];
+		for (u32 i = 0; i < 16; ++i)
+		{
+			const u32 subset = (subsets >> (i * 2)) & 3;
+			indices[i] = (u8)reader.Read(layout.m_IndexBits - (anchors[subset] == i ? 1 : 0));
+		}
+
+		u32 packed[16];
+		if (layout.m_SecondaryIndexBits == 0)
+		{
+			u32 palettes[3][16];
+			for (u32 subset = 0; subset < layout.m_Subsets; ++subset)
+			{
+				InterpolateBc7Palette(endpoints[subset][0], endpoints[subset][1], GetBc7WeightTable(layout.m_IndexBits),
+					1 << layout.m_IndexBits, palettes[subset]);
+			}
+			for (u32 i = 0; i < 16; ++i)
+			{
+				packed[i] = palettes[(subsets >> (i * 2)) & 3][indices[i]];
+			}
+		}
+		else
+		{
+			u8 secondaryIndices[16];
+			for (u32 i = 0; i < 16; ++i)
+			{
+				secondaryIndices[i] = (u8)reader.Read(layout.m_SecondaryIndexBits - (i == 0 ? 1 : 0));
+			}
+
+			// Colour and alpha are separate lines, mode 4 can swap which index set goes to which.
+			const u8* colourIndices = indexSelection == 0 ? indices : secondaryIndices;
+			const u8* alphaIndices = indexSelection == 0 ? secondaryIndices : indices;
+			const u32 colourIndexBits = indexSelection == 0 ? layout.m_IndexBits : layout.m_SecondaryIndexBits;
+			const u32 alphaIndexBits = indexSelection == 0 ? layout.m_SecondaryIndexBits : layout.m_IndexBits;
+
+			u32 colourPalette[16];
+			u32 alphaPalette[16];
+			InterpolateBc7Palette(endpoints[0][0], endpoints[0][1], GetBc7WeightTable(colourIndexBits), 1 << colourIndexBits, colourPalette);
+			InterpolateBc7Palette(endpoints[0][0], endpoints[0][1], GetBc7WeightTable(alphaIndexBits), 1 << alphaIndexBits, alphaPalette);
+			for (u32 i = 0; i < 16; ++i)
+			{
+				packed[i] = (colourPalette[colourIndices[i]] & 0x00FFFFFF) | (alphaPalette[alphaIndices[i]] & 0xFF000000);
+			}
+		}
+		memcpy(texels, packed, sizeof(packed));
+
+		// Rotation swaps alpha with one of the colour channels.
+		if (rotation != 0)
+		{
+			for (u32 i = 0; i < 16; ++i)
+			{
+				std::swap(texels[i * 4 + 3], texels[i * 4 + rotation - 1]);
+			}
+		}
+		return true;
+	}
+
+	// Gathers the 4x4 block at block coordinates x, y, clamping at the image edges.
+	void GatherBlock(const u8* pixels, u32 width, u32 height, u32 rowPitch, u32 x, u32 y, u8* texels)
+	{
+		for (u32 row = 0; row < 4; ++row)
+		{
+			const u8* source = pixels + (u64)std::min(y * 4 + row, height - 1) * rowPitch;
+			for (u32 column = 0; column < 4; ++column)
+			{
+				memcpy(texels + (row * 4 + column) * 4, source + std::min(x * 4 + column, width - 1) * 4, 4);
+			}
+		}
+	}
+
+	void RunBlockRows(u32 blockRows, u32 rowsPerJob, JobSystem* jobSystem, const std::function<void(u32 firstRow, u32 rowCount)>& job)
+	{
+		const u32 jobCount = (blockRows + rowsPerJob - 1) / rowsPerJob;
+		auto runJob = [&](u32 index)
+		{
+			const u32 firstRow = index * rowsPerJob;
+			job(firstRow, std::min(rowsPerJob, blockRows - firstRow));
+		};
+
+		if (jobSystem != nullptr && jobCount > 1)
+		{
+			JobCounter counter;
+			jobSystem->DispatchRange(counter, jobCount, [&](u32 index, u32) { runJob(index); });
+			jobSystem->Wait(counter);
+		}
+		else
+		{
+			for (u32 index = 0; index < jobCount; ++index)
+			{
+				runJob(index);
+			}
+		}
+	}
+}
+
+u32 GetBcBlockSize(BcFormat format)
+{
+	return format == BcFormat::BC1 || format == BcFormat::BC4 ? 8 : 16;
+}
+
+void EncodeBc1Block(const u8* texels, u8* block)
+{
+	BlockTexels channels;
+	LoadBlock(texels, channels);
+	EncodeBc1Colour(channels, block);
+}
+
+void EncodeBc2Block(const u8* texels, u8* block)
+{
+	u64 alpha = 0;
+	for (u32 i = 0; i < 16; ++i)
+	{
+		alpha |= (u64)((texels[i * 4 + 3] * 15 + 127) / 255) << (i * 4);
+	}
+	memcpy(block, &alpha, 8);
+
+	BlockTexels channels;
+	LoadBlock(texels, channels);
+	EncodeBc1Colour(channels, block + 8);
+}
+
+void EncodeBc3Block(const u8* texels, u8* block)
+{
+	BlockTexels channels;
+	LoadBlock(texels, channels);
+	EncodeBc4Channel(channels.m_Channels[3], block);
+	EncodeBc1Colour(channels, block + 8);
+}
+
+void EncodeBc4Block(const u8* texels, u8* block)
+{
+	BlockTexels channels;
+	LoadBlock(texels, channels);
+	EncodeBc4Channel(channels.m_Channels[0], block);
+}
+
+void EncodeBc5Block(const u8* texels, u8* block)
+{
+	BlockTexels channels;
+	LoadBlock(texels, channels);
+	EncodeBc4Channel(channels.m_Channels[0], block);
+	EncodeBc4Channel(channels.m_Channels[1], block + 8);
+}
+
+void EncodeBc7Block(const u8* texels, u8* block)
+{
+	BlockTexels channels;
+	LoadBlock(texels, channels);
+	const float* channelData[4] = { channels.m_Channels[0], channels.m_Channels[1], channels.m_Channels[2], channels.m_Channels[3] };
+
+	// Both modes are cheap, whichever decodes closer wins.
+	u8 candidates[2][16];
+	EncodeBc7Mode6(channelData, candidates[0]);
+	EncodeBc7Mode5(channelData, candidates[1]);
+
+	u32 errors[2] = {};
+	for (u32 candidate = 0; candidate < 2; ++candidate)
+	{
+		u8 decoded[64];
+		DecodeBc7Block(candidates[candidate], decoded);
+		for (u32 i = 0; i < 64; ++i)
+		{
+			const s32 delta = (s32)decoded[i] - (s32)texels[i];
+			errors[candidate] += (u32)(delta * delta);
+		}
+	}
+	memcpy(block, candidates[errors[1] < errors[0] ? 1 : 0], 16);
+}
+
+void EncodeBcBlock(BcFormat format, const u8* texels, u8* block)
+{
+	switch (format)
+	{
+	case BcFormat::BC1: EncodeBc1Block(texels, block); break;
+	case BcFormat::BC2: EncodeBc2Block(texels, block); break;
+	case BcFormat::BC3: EncodeBc3Block(texels, block); break;
+	case BcFormat::BC4: EncodeBc4Block(texels, block); break;
+	case BcFormat::BC5: EncodeBc5Block(texels, block); break;
+	case BcFormat::BC7: EncodeBc7Block(texels, block); break;
+	}
+}
+
+bool DecodeBcBlock(BcFormat format, const u8* block, u8* texels)
+{
+	switch (format)
+	{
+	case BcFormat::BC1:
+		DecodeBc1Colour(block, true, texels);
+		return true;
+
+	case BcFormat::BC2:
+		DecodeBc1Colour(block + 8, false, texels);
+		DecodeBc2Alpha(block, texels);
+		return true;
+
+	case BcFormat::BC3:
+		DecodeBc1Colour(block + 8, false, texels);
+		DecodeBc4Channel(block, 3, texels);
+		return true;
+
+	case BcFormat::BC4:
+		for (u32 i = 0; i < 16; ++i)
+		{
+			texels[i * 4 + 1] = 0;
+			texels[i * 4 + 2] = 0;
+			texels[i * 4 + 3] = 255;
+		}
+		DecodeBc4Channel(block, 0, texels);
+		return true;
+
+	case BcFormat::BC5:
+		for (u32 i = 0; i < 16; ++i)
+		{
+			texels[i * 4 + 2] = 0;
+			texels[i * 4 + 3] = 255;
+		}
+		DecodeBc4Channel(block, 0, texels);
+		DecodeBc4Channel(block + 8, 1, texels);
+		return true;
+
+	case BcFormat::BC7:
+		return DecodeBc7Block(block, texels);
+	}
+	return false;
+}
+
+void EncodeBcImage(BcFormat format, const u8* pixels, u32 width, u32 height, u32 rowPitch,
+	u8* dest, u32 destRowPitch, JobSystem* jobSystem)
+{
+	const u32 blockSize = GetBcBlockSize(format);
+	const u32 blocksWide = (width + 3) / 4;
+	const u32 blocksHigh = (height + 3) / 4;
+	RunBlockRows(blocksHigh, c_EncodeBlockRowsPerJob, jobSystem, [&](u32 firstRow, u32 rowCount)
+	{
+		u8 texels[64];
+		for (u32 y = firstRow; y < firstRow + rowCount; ++y)
+		{
+			u8* row = dest + (u64)y * destRowPitch;
+			for (u32 x = 0; x < blocksWide; ++x)
+			{
+				GatherBlock(pixels, width, height, rowPitch, x, y, texels);
+				EncodeBcBlock(format, texels, row + x * blockSize);
+			}
+		}
+	});
+}
+
+void DecodeBcImage(BcFormat format, const u8* blocks, u32 blockRowPitch, u32 width, u32 height,
+	u8* pixels, u32 rowPitch, JobSystem* jobSystem)
+{
+	const u32 blockSize = GetBcBlockSize(format);
+	const u32 blocksWide = (width + 3) / 4;
+	const u32 blocksHigh = (height + 3) / 4;
+	const u32 rowsPerJob = std::max(1u, c_DecodeBlocksPerJob / blocksWide);
+	RunBlockRows(blocksHigh, rowsPerJob, jobSystem, [&](u32 firstRow, u32 rowCount)
+	{
+		alignas(16) u8 texels[64];
+		for (u32 y = firstRow; y < firstRow + rowCount; ++y)
+		{
+			const u8* row = blocks + (u64)y * blockRowPitch;
+			for (u32 x = 0; x < blocksWide; ++x)
+			{
+				DecodeBcBlock(format, row + x * blockSize, texels);
+				const u32 columns = std::min(4u, width - x * 4);
+				for (u32 texelRow = 0; texelRow < 4 && y * 4 + texelRow < height; ++texelRow)
+				{
+					memcpy(pixels + (u64)(y * 4 + texelRow) * rowPitch + x * 16, texels + texelRow * 16, columns * 4);
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "EngineCore.h"
+
+class JobSystem;
+
+// Block compressed formats the encoder can write.
+enum class BcFormat : u32
+{
+	// RGB with 1 bit alpha, 4 bits per texel. Always written in its opaque 4 colour mode.
+	BC1 = 0,
+
+	// BC1 colour plus explicit 4 bit alpha, 8 bits per texel.
+	BC2,
+
+	// BC1 colour plus a separate 8 level alpha block, 8 bits per texel.
+	BC3,
+
+	// One 8 level channel, red, 4 bits per texel.
+	BC4,
+
+	// Two independent 8 level channels, red and green, 8 bits per texel.
+	BC5,
+
+	// RGBA, 8 bits per texel. Only the single subset modes are tried, mode 6 with one RGBA line of
+	// 16 levels and mode 5 with separate colour and alpha lines, which keeps encoding fast.
+	BC7,
+};
+
+// Bytes per 4x4 block.
+u32 GetBcBlockSize(BcFormat format);
+
+// Every encoder and decoder takes or returns the 16 RGBA8 texels of one block, row by row.
+void EncodeBc1Block(const u8* texels, u8* block);
+void EncodeBc2Block(const u8* texels, u8* block);
+void EncodeBc3Block(const u8* texels, u8* block);
+void EncodeBc4Block(const u8* texels, u8* block);
+void EncodeBc5Block(const u8* texels, u8* block);
+void EncodeBc7Block(const u8* texels, u8* block);
+void EncodeBcBlock(BcFormat format, const u8* texels, u8* block);
+
+// Channels the format does not store come back as 0, and alpha as 255. Every BC7 mode decodes,
+// blocks in the reserved mode decode to zero and return false.
+bool DecodeBcBlock(BcFormat format, const u8* block, u8* texels);
+
+// Encodes an RGBA8 image of any size. Blocks past the right and bottom edges repeat the last
+// column and row. With a job system, rows of blocks are split across jobs.
+void EncodeBcImage(BcFormat format, const u8* pixels, u32 width, u32 height, u32 rowPitch,
+	u8* dest, u32 destRowPitch, JobSystem* jobSystem = nullptr);
+
+// Decodes into an RGBA8 image, dropping texels of edge blocks that fall outside it. With a job
+// system, bands of block rows are decoded in parallel.
+void DecodeBcImage(BcFormat format, const u8* blocks, u32 blockRowPitch, u32 width, u32 height,
+	u8* pixels, u32 rowPitch, JobSystem* jobSystem = nullptr);
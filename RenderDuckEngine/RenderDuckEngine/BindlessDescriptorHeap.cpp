@@ -0,0 +1,63 @@
+#include "BindlessDescriptorHeap.h"
+
+BindlessDescriptorHeap::BindlessDescriptorHeap(ID3D12Device* device, u32 persistentCount, u32 shardCount, u32 transientCountPerFrame, u32 frameCount, IGpuTimeline* timeline)
+	: m_Capacity(persistentCount + transientCountPerFrame * frameCount)
+	, m_Allocator(persistentCount, shardCount, timeline)
+	, m_TransientRing(persistentCount, transientCountPerFrame, frameCount, timeline)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = m_Capacity;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_Heap)));
+
+	m_CpuStart = m_Heap->GetCPUDescriptorHandleForHeapStart();
+	m_GpuStart = m_Heap->GetGPUDescriptorHandleForHeapStart();
+	m_DescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+DescriptorHandle BindlessDescriptorHeap::Allocate(u32 count)
+{
+	ASSERTMSG(count <= m_Allocator.GetShardSize(), "Descriptor range is larger than a heap shard");
+
+	const DescriptorHandle handle = m_Allocator.Allocate(count);
+	ASSERTMSG(handle.IsValid(), "Out of shader visible descriptors");
+	return handle;
+}
+
+DescriptorHandle BindlessDescriptorHeap::AllocateTransient(u32 count)
+{
+	DescriptorHandle handle;
+	handle.m_Index = m_TransientRing.Allocate(count);
+	ASSERTMSG(handle.IsValid(), "Out of transient descriptors for this frame");
+	handle.m_Count = handle.IsValid() ? count : 0;
+	return handle;
+}
+
+void BindlessDescriptorHeap::Commit(u64 fenceValue)
+{
+	m_Allocator.Commit(fenceValue);
+	m_TransientRing.EndFrame(fenceValue);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE BindlessDescriptorHeap::GetCpuHandle(const DescriptorHandle& handle, u32 offset) const
+{
+	ASSERTMSG((m_TransientRing.Contains(handle.m_Index) || m_Allocator.IsLive(handle)) && offset < handle.m_Count, "Stale descriptor handle or offset out of range");
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_CpuStart, handle.m_Index + offset, m_DescriptorSize);
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE BindlessDescriptorHeap::GetGpuHandle(const DescriptorHandle& handle, u32 offset) const
+{
+	ASSERTMSG((m_TransientRing.Contains(handle.m_Index) || m_Allocator.IsLive(handle)) && offset < handle.m_Count, "Stale descriptor handle or offset out of range");
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_GpuStart, handle.m_Index + offset, m_DescriptorSize);
+}
+
+DescriptorHandle BindlessDescriptorHeap::FindHandle(D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle) const
+{
+	if (cpuHandle.ptr < m_CpuStart.ptr)
+	{
+		return DescriptorHandle();
+	}
+
+	return m_Allocator.FindHandle((u32)((cpuHandle.ptr - m_CpuStart.ptr) / m_DescriptorSize));
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "EngineCore.h"
+
+#include "d3dUtil.h"
+#include "DescriptorAllocator.h"
+#include "TransientDescriptorRing.h"
+
+// The shader visible CBV/SRV/UAV heap. Shaders index textures by their position in the heap, so
+// a descriptor's index is all a material needs to reference it.
+// The start of the heap holds persistent descriptors, see DescriptorAllocator, and the end one
+// transient partition per frame resource, see TransientDescriptorRing.
+class BindlessDescriptorHeap
+{
+public:
+	BindlessDescriptorHeap(ID3D12Device* device, u32 persistentCount, u32 shardCount, u32 transientCountPerFrame, u32 frameCount, IGpuTimeline* timeline);
+	BindlessDescriptorHeap(const BindlessDescriptorHeap& rhs) = delete;
+	BindlessDescriptorHeap& operator=(const BindlessDescriptorHeap& rhs) = delete;
+
+	DescriptorHandle Allocate(u32 count = 1);
+
+	// Recycled once the GPU passes the fence given to the next Commit.
+	void Free(const DescriptorHandle& handle) { m_Allocator.Free(handle); }
+
+	// Valid until the end of the frame, never freed. Lock free, so recording workers can use it.
+	DescriptorHandle AllocateTransient(u32 count);
+
+	// Render thread, once the GPU has finished the frame resource at frameIndex.
+	void BeginFrame(u32 frameIndex) { m_TransientRing.BeginFrame(frameIndex); }
+
+	// Persistent descriptors freed since the last commit, and this frame's transient partition,
+	// are reused once the GPU reaches fenceValue.
+	void Commit(u64 fenceValue);
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(const DescriptorHandle& handle, u32 offset = 0) const;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(const DescriptorHandle& handle, u32 offset = 0) const;
+
+	// The live range starting at cpuHandle, for code such as Dear ImGui that only keeps raw handles.
+	DescriptorHandle FindHandle(D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle) const;
+
+	ID3D12DescriptorHeap* GetHeap() const { return m_Heap.Get(); }
+	u32 GetCapacity() const { return m_Capacity; }
+	const DescriptorAllocator& GetAllocator() const { return m_Allocator; }
+	const TransientDescriptorRing& GetTransientRing() const { return m_TransientRing; }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_Heap;
+	D3D12_CPU_DESCRIPTOR_HANDLE m_CpuStart;
+	D3D12_GPU_DESCRIPTOR_HANDLE m_GpuStart;
+	UINT m_DescriptorSize;
+	u32 m_Capacity;
+
+	DescriptorAllocator m_Allocator;
+	TransientDescriptorRing m_TransientRing;
+};
@@ -0,0 +1,91 @@
+#include "CommandRecorder.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+ParallelCommandRecorder::ParallelCommandRecorder(JobSystem* jobSystem)
+	: m_JobSystem(jobSystem)
+{
+	assert(m_JobSystem != nullptr);
+}
+
+void ParallelCommandRecorder::BeginFrame()
+{
+	m_Passes.clear();
+	m_Tasks.clear();
+}
+
+u32 ParallelCommandRecorder::AddPass(const std::string& name, u32 itemCount, u32 minItemsPerTask)
+{
+	assert(minItemsPerTask > 0);
+
+	RecordPass pass;
+	pass.m_Name = name;
+	pass.m_ItemCount = itemCount;
+	pass.m_MinItemsPerTask = minItemsPerTask;
+	m_Passes.push_back(pass);
+
+	return (u32)m_Passes.size() - 1;
+}
+
+u32 ParallelCommandRecorder::GetMaxTasksPerPass() const
+{
+	return m_JobSystem->GetThreadCount();
+}
+
+const std::vector<RecordTask>& ParallelCommandRecorder::BuildTasks()
+{
+	m_Tasks.clear();
+
+	const u32 maxTasks = GetMaxTasksPerPass();
+	for (u32 passIndex = 0; passIndex < (u32)m_Passes.size(); ++passIndex)
+	{
+		const RecordPass& pass = m_Passes[passIndex];
+
+		// Never split below the minimum, and never into more tasks than there are workers to record them.
+		u32 taskCount = 1;
+		if (pass.m_MinItemsPerTask != UINT32_MAX && pass.m_ItemCount > pass.m_MinItemsPerTask)
+		{
+			taskCount = (pass.m_ItemCount + pass.m_MinItemsPerTask - 1) / pass.m_MinItemsPerTask;
+			taskCount = std::min(taskCount, maxTasks);
+		}
+
+		// Spread the remainder over the first tasks so sizes differ by at most one item.
+		const u32 baseCount = pass.m_ItemCount / taskCount;
+		const u32 remainder = pass.m_ItemCount % taskCount;
+
+		u32 firstItem = 0;
+		for (u32 t = 0; t < taskCount; ++t)
+		{
+			RecordTask task;
+			task.m_PassIndex = passIndex;
+			task.m_FirstItem = firstItem;
+			task.m_ItemCount = baseCount + (t < remainder ? 1 : 0);
+			task.m_FirstInPass = t == 0;
+			task.m_LastInPass = t == taskCount - 1;
+			m_Tasks.push_back(task);
+
+			firstItem += task.m_ItemCount;
+		}
+		assert(firstItem == pass.m_ItemCount);
+	}
+
+	return m_Tasks;
+}
+
+void ParallelCommandRecorder::Record(ICommandListRecorder& recorder)
+{
+	BuildTasks();
+
+	// The task index doubles as the command list index, which keeps submission order
+	// independent of the order workers finish in.
+	JobCounter counter;
+	m_JobSystem->DispatchRange(counter, (u32)m_Tasks.size(), [this, &recorder](u32 index, u32 workerIndex)
+	{
+		recorder.RecordCommandList(workerIndex, index, m_Tasks[index]);
+	});
+	m_JobSystem->Wait(counter);
+
+	recorder.SubmitRecordedLists((u32)m_Tasks.size());
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <cstdint>
+#include <string>
+
+class JobSystem;
+
+// A pass that will be recorded this frame. Passes are submitted in the order they are added.
+struct RecordPass
+{
+	std::string m_Name;
+	u32 m_ItemCount = 0;
+
+	// Passes with more items than this are split into several tasks, each recorded into
+	// its own command list. UINT32_MAX keeps the pass in a single list.
+	u32 m_MinItemsPerTask = UINT32_MAX;
+};
+
+// One command list worth of work: a whole pass, or a contiguous item range of one.
+struct RecordTask
+{
+	u32 m_PassIndex = 0;
+	u32 m_FirstItem = 0;
+	u32 m_ItemCount = 0;
+
+	// Only the first task of a pass should record the pass's entry barriers and clears,
+	// and only the last task its exit barriers.
+	bool m_FirstInPass = true;
+	bool m_LastInPass = true;
+};
+
+// Backend the parallel recorder drives. The D3D12 implementation lives in the Renderer;
+// anything else (e.g. a CPU-only mock) can implement it to exercise the task splitting.
+class ICommandListRecorder
+{
+public:
+	virtual ~ICommandListRecorder() = default;
+
+	// Record task into command list listIndex using the allocator owned by workerIndex.
+	// Called concurrently from worker threads, so it must only touch per-list and per-worker state.
+	virtual void RecordCommandList(u32 workerIndex, u32 listIndex, const RecordTask& task) = 0;
+
+	// Called on the recording thread once every task is recorded. Lists [0, listCount)
+	// are in submission order.
+	virtual void SubmitRecordedLists(u32 listCount) = 0;
+};
+
+// Splits the frame's passes into tasks, records them on the job system and submits the
+// resulting command lists in pass order with a single submission.
+class ParallelCommandRecorder
+{
+public:
+	ParallelCommandRecorder(JobSystem* jobSystem);
+
+	void BeginFrame();
+	u32 AddPass(const std::string& name, u32 itemCount, u32 minItemsPerTask = UINT32_MAX);
+
+	// Splits the passes added since BeginFrame into tasks. Called by Record, exposed so the
+	// split can be inspected without recording.
+	const std::vector<RecordTask>& BuildTasks();
+
+	void Record(ICommandListRecorder& recorder);
+
+	const std::vector<RecordPass>& GetPasses() const { return m_Passes; }
+	const std::vector<RecordTask>& GetTasks() const { return m_Tasks; }
+
+	// Upper bound on the number of lists a single frame can produce, used to size list pools.
+	u32 GetMaxTasksPerPass() const;
+
+private:
+	JobSystem* m_JobSystem;
+
+	std::vector<RecordPass> m_Passes;
+	std::vector<RecordTask> m_Tasks;
+};
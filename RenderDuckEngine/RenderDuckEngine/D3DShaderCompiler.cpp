@@ -0,0 +1,47 @@
+#include "D3DShaderCompiler.h"
+
+D3DShaderCompiler::D3DShaderCompiler()
+	: m_CompileFlags(0)
+{
+#if defined(DEBUG) || defined(_DEBUG)
+	m_CompileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+}
+
+std::string D3DShaderCompiler::GetVersion() const
+{
+	// Debug and release builds produce different code, so the flags are part of the version.
+	return "D3DCompiler_" + std::to_string(D3D_COMPILER_VERSION) + " flags " + std::to_string(m_CompileFlags);
+}
+
+bool D3DShaderCompiler::Compile(const ShaderDesc& desc, std::vector<u8>& byteCode, std::string& errors)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	macros.reserve(desc.m_Defines.size() + 1);
+	for (const ShaderDefine& define : desc.m_Defines)
+	{
+		macros.push_back({ define.m_Name.c_str(), define.m_Value.c_str() });
+	}
+	macros.push_back({ nullptr, nullptr });
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
+	HRESULT hr = D3DCompileFromFile(desc.m_Path.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		desc.m_EntryPoint.c_str(), desc.m_Target.c_str(), m_CompileFlags, 0, &blob, &errorBlob);
+
+	// Warnings come through here too, even when compilation succeeds.
+	if (errorBlob != nullptr)
+	{
+		errors.assign((const char*)errorBlob->GetBufferPointer(), errorBlob->GetBufferSize());
+		OutputDebugStringA(errors.c_str());
+	}
+
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	const u8* data = (const u8*)blob->GetBufferPointer();
+	byteCode.assign(data, data + blob->GetBufferSize());
+	return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "EngineCore.h"
+
+#include "d3dUtil.h"
+#include "ShaderCache.h"
+
+// IShaderCompiler over D3DCompileFromFile, with includes resolved next to the including file.
+class D3DShaderCompiler : public IShaderCompiler
+{
+public:
+	D3DShaderCompiler();
+
+	virtual std::string GetVersion() const override;
+	virtual bool Compile(const ShaderDesc& desc, std::vector<u8>& byteCode, std::string& errors) override;
+
+private:
+	UINT m_CompileFlags;
+};
@@ -0,0 +1,646 @@
+#include "DdsFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// File layout, see DDS.h in DirectXTex.
+	const u32 c_DdsMagic = 0x20534444; // "DDS "
+
+	const u32 c_PixelFormatFourCC = 0x00000004;
+	const u32 c_PixelFormatRgb = 0x00000040;
+	const u32 c_PixelFormatLuminance = 0x00020000;
+	const u32 c_PixelFormatAlpha = 0x00000002;
+
+	const u32 c_HeaderFlagsCaps = 0x00000001;
+	const u32 c_HeaderFlagsHeight = 0x00000002;
+	const u32 c_HeaderFlagsWidth = 0x00000004;
+	const u32 c_HeaderFlagsPixelFormat = 0x00001000;
+	const u32 c_HeaderFlagsMipCount = 0x00020000;
+	const u32 c_HeaderFlagsLinearSize = 0x00080000;
+	const u32 c_HeaderFlagsVolume = 0x00800000;
+
+	const u32 c_CapsComplex = 0x00000008;
+	const u32 c_CapsTexture = 0x00001000;
+	const u32 c_CapsMipMap = 0x00400000;
+
+	const u32 c_Caps2CubeMap = 0x00000200;
+	const u32 c_Caps2CubeMapAllFaces = 0x0000fc00;
+
+	// D3D11_RESOURCE_DIMENSION and D3D11_RESOURCE_MISC_TEXTURECUBE, as written in the DX10 extension.
+	const u32 c_Dx10Texture1D = 2;
+	const u32 c_Dx10Texture2D = 3;
+	const u32 c_Dx10Texture3D = 4;
+	const u32 c_Dx10MiscTextureCube = 0x4;
+	const u32 c_Dx10AlphaModeMask = 0x7;
+
+	// D3D12 hardware limits. Metadata past these is rejected rather than trusted.
+	const u32 c_MaxMipLevels = 15;
+	const u32 c_MaxTexture1DSize = 16384;
+	const u32 c_MaxTexture2DSize = 16384;
+	const u32 c_MaxTexture3DSize = 2048;
+	const u32 c_MaxTextureCubeSize = 16384;
+	const u32 c_MaxArraySize = 2048;
+
+	constexpr u32 MakeFourCC(char a, char b, char c, char d)
+	{
+		return (u32)(u8)a | ((u32)(u8)b << 8) | ((u32)(u8)c << 16) | ((u32)(u8)d << 24);
+	}
+
+	struct DdsPixelFormat
+	{
+		u32 m_Size;
+		u32 m_Flags;
+		u32 m_FourCC;
+		u32 m_RgbBitCount;
+		u32 m_RBitMask;
+		u32 m_GBitMask;
+		u32 m_BBitMask;
+		u32 m_ABitMask;
+	};
+
+	struct DdsHeader
+	{
+		u32 m_Size;
+		u32 m_Flags;
+		u32 m_Height;
+		u32 m_Width;
+		u32 m_PitchOrLinearSize;
+		u32 m_Depth;
+		u32 m_MipMapCount;
+		u32 m_Reserved1[11];
+		DdsPixelFormat m_PixelFormat;
+		u32 m_Caps;
+		u32 m_Caps2;
+		u32 m_Caps3;
+		u32 m_Caps4;
+		u32 m_Reserved2;
+	};
+
+	struct DdsHeaderDx10
+	{
+		u32 m_Format;
+		u32 m_ResourceDimension;
+		u32 m_MiscFlag;
+		u32 m_ArraySize;
+		u32 m_MiscFlags2;
+	};
+
+	static_assert(sizeof(DdsPixelFormat) == 32, "DDS pixel format is 32 bytes");
+	static_assert(sizeof(DdsHeader) == 124, "DDS header is 124 bytes");
+	static_assert(sizeof(DdsHeaderDx10) == 20, "DDS DX10 header is 20 bytes");
+
+	bool HasMasks(const DdsPixelFormat& format, u32 r, u32 g, u32 b, u32 a)
+	{
+		return format.m_RBitMask == r && format.m_GBitMask == g && format.m_BBitMask == b && format.m_ABitMask == a;
+	}
+
+	// Formats of files without the DX10 extension, from the pixel format masks or FourCC.
+	DdsFormat GetLegacyFormat(const DdsPixelFormat& format)
+	{
+		if (format.m_Flags & c_PixelFormatRgb)
+		{
+			switch (format.m_RgbBitCount)
+			{
+			case 32:
+				if (HasMasks(format, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DdsFormat::R8G8B8A8_UNorm;
+				if (HasMasks(format, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) return DdsFormat::B8G8R8A8_UNorm;
+				if (HasMasks(format, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000)) return DdsFormat::B8G8R8X8_UNorm;
+
+				// D3DX writes 10:10:10:2 with red and blue swapped, so the swapped masks are the common ones.
+				if (HasMasks(format, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000)) return DdsFormat::R10G10B10A2_UNorm;
+				if (HasMasks(format, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) return DdsFormat::R16G16_UNorm;
+				if (HasMasks(format, 0xffffffff, 0x00000000, 0x00000000, 0x00000000)) return DdsFormat::R32_Float;
+				break;
+
+			case 16:
+				if (HasMasks(format, 0x7c00, 0x03e0, 0x001f, 0x8000)) return DdsFormat::B5G5R5A1_UNorm;
+				if (HasMasks(format, 0xf800, 0x07e0, 0x001f, 0x0000)) return DdsFormat::B5G6R5_UNorm;
+				if (HasMasks(format, 0x0f00, 0x00f0, 0x000f, 0xf000)) return DdsFormat::B4G4R4A4_UNorm;
+				break;
+			}
+		}
+		else if (format.m_Flags & c_PixelFormatLuminance)
+		{
+			if (format.m_RgbBitCount == 8 && HasMasks(format, 0x000000ff, 0x00000000, 0x00000000, 0x00000000)) return DdsFormat::R8_UNorm;
+			if (format.m_RgbBitCount == 16 && HasMasks(format, 0x0000ffff, 0x00000000, 0x00000000, 0x00000000)) return DdsFormat::R16_UNorm;
+			if (format.m_RgbBitCount == 16 && HasMasks(format, 0x000000ff, 0x00000000, 0x00000000, 0x0000ff00)) return DdsFormat::R8G8_UNorm;
+		}
+		else if (format.m_Flags & c_PixelFormatAlpha)
+		{
+			if (format.m_RgbBitCount == 8) return DdsFormat::A8_UNorm;
+		}
+		else if (format.m_Flags & c_PixelFormatFourCC)
+		{
+			switch (format.m_FourCC)
+			{
+			case MakeFourCC('D', 'X', 'T', '1'): return DdsFormat::BC1_UNorm;
+			case MakeFourCC('D', 'X', 'T', '3'): return DdsFormat::BC2_UNorm;
+			case MakeFourCC('D', 'X', 'T', '5'): return DdsFormat::BC3_UNorm;
+
+			// Premultiplied alpha has no format of its own, the alpha mode records it instead.
+			case MakeFourCC('D', 'X', 'T', '2'): return DdsFormat::BC2_UNorm;
+			case MakeFourCC('D', 'X', 'T', '4'): return DdsFormat::BC3_UNorm;
+
+			case MakeFourCC('A', 'T', 'I', '1'): return DdsFormat::BC4_UNorm;
+			case MakeFourCC('B', 'C', '4', 'U'): return DdsFormat::BC4_UNorm;
+			case MakeFourCC('B', 'C', '4', 'S'): return DdsFormat::BC4_SNorm;
+			case MakeFourCC('A', 'T', 'I', '2'): return DdsFormat::BC5_UNorm;
+			case MakeFourCC('B', 'C', '5', 'U'): return DdsFormat::BC5_UNorm;
+			case MakeFourCC('B', 'C', '5', 'S'): return DdsFormat::BC5_SNorm;
+
+			case MakeFourCC('R', 'G', 'B', 'G'): return DdsFormat::R8G8_B8G8_UNorm;
+			case MakeFourCC('G', 'R', 'G', 'B'): return DdsFormat::G8R8_G8B8_UNorm;
+			case MakeFourCC('Y', 'U', 'Y', '2'): return DdsFormat::YUY2;
+
+			// D3DFORMAT values written as the FourCC.
+			case 36: return DdsFormat::R16G16B16A16_UNorm;
+			case 110: return DdsFormat::R16G16B16A16_SNorm;
+			case 111: return DdsFormat::R16_Float;
+			case 112: return DdsFormat::R16G16_Float;
+			case 113: return DdsFormat::R16G16B16A16_Float;
+			case 114: return DdsFormat::R32_Float;
+			case 115: return DdsFormat::R32G32_Float;
+			case 116: return DdsFormat::R32G32B32A32_Float;
+			}
+		}
+
+		return DdsFormat::Unknown;
+	}
+
+	DdsAlphaMode GetAlphaMode(const DdsHeader& header, const DdsHeaderDx10* dx10)
+	{
+		if (dx10 != nullptr)
+		{
+			const u32 mode = dx10->m_MiscFlags2 & c_Dx10AlphaModeMask;
+			return mode <= (u32)DdsAlphaMode::Custom ? (DdsAlphaMode)mode : DdsAlphaMode::Unknown;
+		}
+
+		const u32 fourCC = header.m_PixelFormat.m_FourCC;
+		if ((header.m_PixelFormat.m_Flags & c_PixelFormatFourCC) &&
+			(fourCC == MakeFourCC('D', 'X', 'T', '2') || fourCC == MakeFourCC('D', 'X', 'T', '4')))
+		{
+			return DdsAlphaMode::Premultiplied;
+		}
+		return DdsAlphaMode::Unknown;
+	}
+
+	u32 GetFullMipCount(u32 width, u32 height, u32 depth)
+	{
+		u32 size = std::max(width, std::max(height, depth));
+		u32 mipCount = 1;
+		while (size > 1)
+		{
+			size >>= 1;
+			++mipCount;
+		}
+		return mipCount;
+	}
+}
+
+const char* GetDdsErrorString(DdsError error)
+{
+	switch (error)
+	{
+	case DdsError::None: return "no error";
+	case DdsError::CannotOpen: return "file cannot be opened";
+	case DdsError::NotDds: return "not a DDS file";
+	case DdsError::BadHeader: return "invalid DDS header";
+	case DdsError::UnsupportedFormat: return "unsupported pixel format";
+	case DdsError::UnsupportedDimension: return "unsupported texture dimension";
+	case DdsError::TooLarge: return "texture exceeds hardware limits";
+	case DdsError::Truncated: return "file is shorter than its header describes";
+	}
+	return "unknown error";
+}
+
+bool GetDdsSurfaceInfo(DdsFormat format, u32 width, u32 height, u32& rowPitch, u32& rowCount, u64& slicePitch)
+{
+	u32 blockBytes = 0;
+	u32 packedBytes = 0;
+	u32 bitsPerPixel = 0;
+	switch (format)
+	{
+	case DdsFormat::BC1_UNorm:
+	case DdsFormat::BC1_UNorm_SRGB:
+	case DdsFormat::BC4_UNorm:
+	case DdsFormat::BC4_SNorm:
+		blockBytes = 8;
+		break;
+
+	case DdsFormat::BC2_UNorm:
+	case DdsFormat::BC2_UNorm_SRGB:
+	case DdsFormat::BC3_UNorm:
+	case DdsFormat::BC3_UNorm_SRGB:
+	case DdsFormat::BC5_UNorm:
+	case DdsFormat::BC5_SNorm:
+	case DdsFormat::BC6H_UF16:
+	case DdsFormat::BC6H_SF16:
+	case DdsFormat::BC7_UNorm:
+	case DdsFormat::BC7_UNorm_SRGB:
+		blockBytes = 16;
+		break;
+
+	// Two pixels share four bytes.
+	case DdsFormat::R8G8_B8G8_UNorm:
+	case DdsFormat::G8R8_G8B8_UNorm:
+	case DdsFormat::YUY2:
+		packedBytes = 4;
+		break;
+
+	case DdsFormat::R32G32B32A32_Float:
+		bitsPerPixel = 128;
+		break;
+
+	case DdsFormat::R32G32B32_Float:
+		bitsPerPixel = 96;
+		break;
+
+	case DdsFormat::R16G16B16A16_Float:
+	case DdsFormat::R16G16B16A16_UNorm:
+	case DdsFormat::R16G16B16A16_SNorm:
+	case DdsFormat::R32G32_Float:
+		bitsPerPixel = 64;
+		break;
+
+	case DdsFormat::R10G10B10A2_UNorm:
+	case DdsFormat::R11G11B10_Float:
+	case DdsFormat::R8G8B8A8_UNorm:
+	case DdsFormat::R8G8B8A8_UNorm_SRGB:
+	case DdsFormat::R16G16_Float:
+	case DdsFormat::R16G16_UNorm:
+	case DdsFormat::R32_Float:
+	case DdsFormat::B8G8R8A8_UNorm:
+	case DdsFormat::B8G8R8X8_UNorm:
+	case DdsFormat::B8G8R8A8_UNorm_SRGB:
+	case DdsFormat::B8G8R8X8_UNorm_SRGB:
+		bitsPerPixel = 32;
+		break;
+
+	case DdsFormat::R8G8_UNorm:
+	case DdsFormat::R16_Float:
+	case DdsFormat::R16_UNorm:
+	case DdsFormat::B5G6R5_UNorm:
+	case DdsFormat::B5G5R5A1_UNorm:
+	case DdsFormat::B4G4R4A4_UNorm:
+		bitsPerPixel = 16;
+		break;
+
+	case DdsFormat::R8_UNorm:
+	case DdsFormat::A8_UNorm:
+		bitsPerPixel = 8;
+		break;
+
+	default:
+		return false;
+	}
+
+	if (blockBytes != 0)
+	{
+		rowPitch = std::max(1u, (width + 3) / 4) * blockBytes;
+		rowCount = std::max(1u, (height + 3) / 4);
+	}
+	else if (packedBytes != 0)
+	{
+		rowPitch = ((width + 1) >> 1) * packedBytes;
+		rowCount = height;
+	}
+	else
+	{
+		rowPitch = (width * bitsPerPixel + 7) / 8;
+		rowCount = height;
+	}
+	slicePitch = (u64)rowPitch * rowCount;
+	return true;
+}
+
+DdsFormat MakeDdsFormatSRGB(DdsFormat format)
+{
+	switch (format)
+	{
+	case DdsFormat::R8G8B8A8_UNorm: return DdsFormat::R8G8B8A8_UNorm_SRGB;
+	case DdsFormat::BC1_UNorm: return DdsFormat::BC1_UNorm_SRGB;
+	case DdsFormat::BC2_UNorm: return DdsFormat::BC2_UNorm_SRGB;
+	case DdsFormat::BC3_UNorm: return DdsFormat::BC3_UNorm_SRGB;
+	case DdsFormat::B8G8R8A8_UNorm: return DdsFormat::B8G8R8A8_UNorm_SRGB;
+	case DdsFormat::B8G8R8X8_UNorm: return DdsFormat::B8G8R8X8_UNorm_SRGB;
+	case DdsFormat::BC7_UNorm: return DdsFormat::BC7_UNorm_SRGB;
+	default: return format;
+	}
+}
+
+bool IsDdsFormatSRGB(DdsFormat format)
+{
+	switch (format)
+	{
+	case DdsFormat::R8G8B8A8_UNorm_SRGB:
+	case DdsFormat::BC1_UNorm_SRGB:
+	case DdsFormat::BC2_UNorm_SRGB:
+	case DdsFormat::BC3_UNorm_SRGB:
+	case DdsFormat::B8G8R8A8_UNorm_SRGB:
+	case DdsFormat::B8G8R8X8_UNorm_SRGB:
+	case DdsFormat::BC7_UNorm_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool IsDdsFormatBlockCompressed(DdsFormat format)
+{
+	return (format >= DdsFormat::BC1_UNorm && format <= DdsFormat::BC5_SNorm) ||
+		(format >= DdsFormat::BC6H_UF16 && format <= DdsFormat::BC7_UNorm_SRGB);
+}
+
+void WriteDdsHeaders(const DdsTextureDesc& desc, std::vector<u8>& file)
+{
+	ASSERTMSG(desc.m_Dimension == DdsDimension::Texture2D, "Only 2D textures are written");
+
+	DdsHeader header = {};
+	header.m_Size = sizeof(DdsHeader);
+	header.m_Flags = c_HeaderFlagsCaps | c_HeaderFlagsHeight | c_HeaderFlagsWidth | c_HeaderFlagsPixelFormat |
+		c_HeaderFlagsMipCount | c_HeaderFlagsLinearSize;
+	header.m_Height = desc.m_Height;
+	header.m_Width = desc.m_Width;
+	header.m_PitchOrLinearSize = (u32)GetDdsMipSize(desc, 0) / desc.m_ArraySize;
+	header.m_MipMapCount = desc.m_MipCount;
+	header.m_PixelFormat.m_Size = sizeof(DdsPixelFormat);
+	header.m_PixelFormat.m_Flags = c_PixelFormatFourCC;
+	header.m_PixelFormat.m_FourCC = MakeFourCC('D', 'X', '1', '0');
+	header.m_Caps = c_CapsTexture | (desc.m_MipCount > 1 ? c_CapsComplex | c_CapsMipMap : 0);
+	header.m_Caps2 = desc.m_IsCubeMap ? c_Caps2CubeMap | c_Caps2CubeMapAllFaces : 0;
+
+	// The extension counts whole cubes.
+	DdsHeaderDx10 dx10 = {};
+	dx10.m_Format = (u32)desc.m_Format;
+	dx10.m_ResourceDimension = c_Dx10Texture2D;
+	dx10.m_MiscFlag = desc.m_IsCubeMap ? c_Dx10MiscTextureCube : 0;
+	dx10.m_ArraySize = desc.m_IsCubeMap ? desc.m_ArraySize / 6 : desc.m_ArraySize;
+	dx10.m_MiscFlags2 = (u32)desc.m_AlphaMode;
+
+	const size_t start = file.size();
+	file.resize(start + sizeof(c_DdsMagic) + sizeof(header) + sizeof(dx10));
+	memcpy(file.data() + start, &c_DdsMagic, sizeof(c_DdsMagic));
+	memcpy(file.data() + start + sizeof(c_DdsMagic), &header, sizeof(header));
+	memcpy(file.data() + start + sizeof(c_DdsMagic) + sizeof(header), &dx10, sizeof(dx10));
+}
+
+u64 GetDdsMipSize(const DdsTextureDesc& desc, u32 mip)
+{
+	assert(mip < desc.m_MipCount);
+	const u32 width = std::max(1u, desc.m_Width >> mip);
+	const u32 height = std::max(1u, desc.m_Height >> mip);
+	const u32 depth = std::max(1u, desc.m_Depth >> mip);
+
+	u32 rowPitch = 0;
+	u32 rowCount = 0;
+	u64 slicePitch = 0;
+	if (!GetDdsSurfaceInfo(desc.m_Format, width, height, rowPitch, rowCount, slicePitch))
+	{
+		return 0;
+	}
+	return slicePitch * depth * desc.m_ArraySize;
+}
+
+DdsError DdsFile::Open(const std::filesystem::path& path)
+{
+	Close();
+	if (!m_File.Open(path))
+	{
+		return DdsError::CannotOpen;
+	}
+
+	const DdsError error = Parse(m_File.GetData(), m_File.GetSize());
+	if (error != DdsError::None)
+	{
+		m_File.Close();
+	}
+	return error;
+}
+
+void DdsFile::Close()
+{
+	m_File.Close();
+	m_Desc = DdsTextureDesc();
+	m_Subresources.clear();
+	m_DataSize = 0;
+}
+
+DdsError DdsFile::Parse(const u8* data, u64 size)
+{
+	m_Desc = DdsTextureDesc();
+	m_Subresources.clear();
+	m_DataSize = 0;
+
+	u64 dataOffset = 0;
+	DdsError error = ParseHeader(data, size, dataOffset);
+	if (error == DdsError::None)
+	{
+		m_DataSize = size - dataOffset;
+		error = BuildSubresources(data, dataOffset);
+	}
+
+	if (error != DdsError::None)
+	{
+		m_Desc = DdsTextureDesc();
+		m_Subresources.clear();
+		m_DataSize = 0;
+	}
+	return error;
+}
+
+DdsError DdsFile::ParseHeader(const u8* data, u64 size, u64& dataOffset)
+{
+	u32 magic = 0;
+	if (data == nullptr || size < sizeof(magic) + sizeof(DdsHeader))
+	{
+		return DdsError::NotDds;
+	}
+
+	// Copied out, a mapping or caller buffer gives no alignment guarantee.
+	DdsHeader header;
+	memcpy(&magic, data, sizeof(magic));
+	memcpy(&header, data + sizeof(magic), sizeof(header));
+	if (magic != c_DdsMagic)
+	{
+		return DdsError::NotDds;
+	}
+	if (header.m_Size != sizeof(DdsHeader) || header.m_PixelFormat.m_Size != sizeof(DdsPixelFormat))
+	{
+		return DdsError::BadHeader;
+	}
+
+	dataOffset = sizeof(magic) + sizeof(DdsHeader);
+
+	DdsTextureDesc& desc = m_Desc;
+	desc.m_Width = header.m_Width;
+	desc.m_Height = header.m_Height;
+	desc.m_Depth = header.m_Depth;
+	desc.m_MipCount = header.m_MipMapCount != 0 ? header.m_MipMapCount : 1;
+
+	const bool hasDx10Header = (header.m_PixelFormat.m_Flags & c_PixelFormatFourCC) &&
+		header.m_PixelFormat.m_FourCC == MakeFourCC('D', 'X', '1', '0');
+	DdsHeaderDx10 dx10 = {};
+	if (hasDx10Header)
+	{
+		if (size < dataOffset + sizeof(DdsHeaderDx10))
+		{
+			return DdsError::Truncated;
+		}
+		memcpy(&dx10, data + dataOffset, sizeof(dx10));
+		dataOffset += sizeof(DdsHeaderDx10);
+
+		if (dx10.m_ArraySize == 0)
+		{
+			return DdsError::BadHeader;
+		}
+
+		u32 rowPitch = 0;
+		u32 rowCount = 0;
+		u64 slicePitch = 0;
+		desc.m_Format = (DdsFormat)dx10.m_Format;
+		if (!GetDdsSurfaceInfo(desc.m_Format, 1, 1, rowPitch, rowCount, slicePitch))
+		{
+			return DdsError::UnsupportedFormat;
+		}
+
+		desc.m_ArraySize = dx10.m_ArraySize;
+		switch (dx10.m_ResourceDimension)
+		{
+		case c_Dx10Texture1D:
+			if ((header.m_Flags & c_HeaderFlagsHeight) && desc.m_Height != 1)
+			{
+				return DdsError::BadHeader;
+			}
+			desc.m_Dimension = DdsDimension::Texture1D;
+			desc.m_Height = 1;
+			desc.m_Depth = 1;
+			break;
+
+		case c_Dx10Texture2D:
+			if (dx10.m_MiscFlag & c_Dx10MiscTextureCube)
+			{
+				desc.m_ArraySize *= 6;
+				desc.m_IsCubeMap = true;
+			}
+			desc.m_Dimension = DdsDimension::Texture2D;
+			desc.m_Depth = 1;
+			break;
+
+		case c_Dx10Texture3D:
+			if (!(header.m_Flags & c_HeaderFlagsVolume) || desc.m_ArraySize > 1)
+			{
+				return DdsError::UnsupportedDimension;
+			}
+			desc.m_Dimension = DdsDimension::Texture3D;
+			break;
+
+		default:
+			return DdsError::UnsupportedDimension;
+		}
+	}
+	else
+	{
+		desc.m_Format = GetLegacyFormat(header.m_PixelFormat);
+		if (desc.m_Format == DdsFormat::Unknown)
+		{
+			return DdsError::UnsupportedFormat;
+		}
+
+		if (header.m_Flags & c_HeaderFlagsVolume)
+		{
+			desc.m_Dimension = DdsDimension::Texture3D;
+		}
+		else
+		{
+			if (header.m_Caps2 & c_Caps2CubeMap)
+			{
+				// Partial cube maps were a D3D9 feature, they have no D3D12 equivalent.
+				if ((header.m_Caps2 & c_Caps2CubeMapAllFaces) != c_Caps2CubeMapAllFaces)
+				{
+					return DdsError::UnsupportedDimension;
+				}
+				desc.m_ArraySize = 6;
+				desc.m_IsCubeMap = true;
+			}
+			desc.m_Dimension = DdsDimension::Texture2D;
+			desc.m_Depth = 1;
+		}
+	}
+
+	desc.m_AlphaMode = GetAlphaMode(header, hasDx10Header ? &dx10 : nullptr);
+
+	if (desc.m_Width == 0 || desc.m_Height == 0 || desc.m_Depth == 0)
+	{
+		return DdsError::BadHeader;
+	}
+	if (desc.m_MipCount > c_MaxMipLevels || desc.m_ArraySize > c_MaxArraySize)
+	{
+		return DdsError::TooLarge;
+	}
+	if (desc.m_MipCount > GetFullMipCount(desc.m_Width, desc.m_Height, desc.m_Depth))
+	{
+		return DdsError::BadHeader;
+	}
+
+	u32 maxSize = c_MaxTexture2DSize;
+	switch (desc.m_Dimension)
+	{
+	case DdsDimension::Texture1D: maxSize = c_MaxTexture1DSize; break;
+	case DdsDimension::Texture2D: maxSize = desc.m_IsCubeMap ? c_MaxTextureCubeSize : c_MaxTexture2DSize; break;
+	case DdsDimension::Texture3D: maxSize = c_MaxTexture3DSize; break;
+	}
+	if (desc.m_Width > maxSize || desc.m_Height > maxSize || desc.m_Depth > maxSize)
+	{
+		return DdsError::TooLarge;
+	}
+
+	return DdsError::None;
+}
+
+DdsError DdsFile::BuildSubresources(const u8* data, u64 dataOffset)
+{
+	const DdsTextureDesc& desc = m_Desc;
+	m_Subresources.reserve((size_t)desc.m_ArraySize * desc.m_MipCount);
+
+	u64 offset = 0;
+	for (u32 slice = 0; slice < desc.m_ArraySize; ++slice)
+	{
+		u32 width = desc.m_Width;
+		u32 height = desc.m_Height;
+		u32 depth = desc.m_Depth;
+		for (u32 mip = 0; mip < desc.m_MipCount; ++mip)
+		{
+			DdsSubresource subresource;
+			subresource.m_Width = width;
+			subresource.m_Height = height;
+			subresource.m_Depth = depth;
+			GetDdsSurfaceInfo(desc.m_Format, width, height, subresource.m_RowPitch, subresource.m_RowCount, subresource.m_SlicePitch);
+
+			// Sizes are bounded by the limits checked in ParseHeader, so none of this can overflow.
+			const u64 mipSize = subresource.m_SlicePitch * depth;
+			if (mipSize > m_DataSize - offset)
+			{
+				return DdsError::Truncated;
+			}
+
+			subresource.m_Offset = dataOffset + offset;
+			subresource.m_Data = data + subresource.m_Offset;
+			m_Subresources.push_back(subresource);
+			offset += mipSize;
+
+			width = std::max(1u, width >> 1);
+			height = std::max(1u, height >> 1);
+			depth = std::max(1u, depth >> 1);
+		}
+	}
+
+	return DdsError::None;
+}
+
+const DdsSubresource& DdsFile::GetSubresource(u32 mip, u32 arraySlice) const
+{
+	ASSERTMSG(mip < m_Desc.m_MipCount && arraySlice < m_Desc.m_ArraySize, "DDS subresource out of range");
+	return m_Subresources[(size_t)arraySlice * m_Desc.m_MipCount + mip];
+}
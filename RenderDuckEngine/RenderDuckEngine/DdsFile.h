@@ -0,0 +1,169 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <filesystem>
+
+#include "MappedFile.h"
+
+// Pixel formats a DDS file can hold that the engine understands. Values match DXGI_FORMAT, so the
+// D3D side can cast them straight across.
+enum class DdsFormat : u32
+{
+	Unknown = 0,
+	R32G32B32A32_Float = 2,
+	R32G32B32_Float = 6,
+	R16G16B16A16_Float = 10,
+	R16G16B16A16_UNorm = 11,
+	R16G16B16A16_SNorm = 13,
+	R32G32_Float = 16,
+	R10G10B10A2_UNorm = 24,
+	R11G11B10_Float = 26,
+	R8G8B8A8_UNorm = 28,
+	R8G8B8A8_UNorm_SRGB = 29,
+	R16G16_Float = 34,
+	R16G16_UNorm = 35,
+	R32_Float = 41,
+	R8G8_UNorm = 49,
+	R16_Float = 54,
+	R16_UNorm = 56,
+	R8_UNorm = 61,
+	A8_UNorm = 65,
+	R8G8_B8G8_UNorm = 68,
+	G8R8_G8B8_UNorm = 69,
+	BC1_UNorm = 71,
+	BC1_UNorm_SRGB = 72,
+	BC2_UNorm = 74,
+	BC2_UNorm_SRGB = 75,
+	BC3_UNorm = 77,
+	BC3_UNorm_SRGB = 78,
+	BC4_UNorm = 80,
+	BC4_SNorm = 81,
+	BC5_UNorm = 83,
+	BC5_SNorm = 84,
+	B5G6R5_UNorm = 85,
+	B5G5R5A1_UNorm = 86,
+	B8G8R8A8_UNorm = 87,
+	B8G8R8X8_UNorm = 88,
+	B8G8R8A8_UNorm_SRGB = 91,
+	B8G8R8X8_UNorm_SRGB = 93,
+	BC6H_UF16 = 95,
+	BC6H_SF16 = 96,
+	BC7_UNorm = 98,
+	BC7_UNorm_SRGB = 99,
+	YUY2 = 107,
+	B4G4R4A4_UNorm = 115,
+};
+
+enum class DdsDimension : u32
+{
+	Texture1D = 0,
+	Texture2D,
+	Texture3D,
+};
+
+// Values match DDS_ALPHA_MODE.
+enum class DdsAlphaMode : u32
+{
+	Unknown = 0,
+	Straight,
+	Premultiplied,
+	Opaque,
+	Custom,
+};
+
+enum class DdsError : u32
+{
+	None = 0,
+	CannotOpen,
+	NotDds,
+	BadHeader,
+	UnsupportedFormat,
+	UnsupportedDimension,
+	TooLarge,
+	Truncated,
+};
+
+const char* GetDdsErrorString(DdsError error);
+
+struct DdsTextureDesc
+{
+	DdsDimension m_Dimension = DdsDimension::Texture2D;
+	DdsFormat m_Format = DdsFormat::Unknown;
+	u32 m_Width = 0;
+	u32 m_Height = 0;
+	u32 m_Depth = 1;
+
+	// Includes the six faces of every cube.
+	u32 m_ArraySize = 1;
+	u32 m_MipCount = 1;
+	bool m_IsCubeMap = false;
+	DdsAlphaMode m_AlphaMode = DdsAlphaMode::Unknown;
+};
+
+// One mip of one array slice. Rows are tightly packed, for block compressed formats a row is one
+// row of 4x4 blocks. Volume mips hold m_Depth slices of m_SlicePitch bytes each.
+struct DdsSubresource
+{
+	const u8* m_Data = nullptr;
+	u64 m_Offset = 0;
+	u32 m_Width = 0;
+	u32 m_Height = 0;
+	u32 m_Depth = 0;
+	u32 m_RowPitch = 0;
+	u32 m_RowCount = 0;
+	u64 m_SlicePitch = 0;
+};
+
+// Device independent DDS reader. Open memory maps the file, validates the header and the DX10
+// extension and builds the subresource table, which points straight into the mapping so no
+// texel data is copied. Subresources are ordered like D3D12 subresource indices, every mip of
+// slice 0 first, then every mip of slice 1 and so on.
+class DdsFile
+{
+public:
+	DdsFile() = default;
+	DdsFile(const DdsFile& rhs) = delete;
+	DdsFile& operator=(const DdsFile& rhs) = delete;
+
+	DdsError Open(const std::filesystem::path& path);
+
+	// Parses a file already in memory. The data is not copied and has to outlive this object.
+	DdsError Parse(const u8* data, u64 size);
+
+	void Close();
+
+	const DdsTextureDesc& GetDesc() const { return m_Desc; }
+
+	u32 GetSubresourceCount() const { return (u32)m_Subresources.size(); }
+	const DdsSubresource& GetSubresource(u32 mip, u32 arraySlice) const;
+	const std::vector<DdsSubresource>& GetSubresources() const { return m_Subresources; }
+
+	// Bytes of texel data after the headers, including anything past the last subresource.
+	u64 GetDataSize() const { return m_DataSize; }
+
+private:
+	DdsError ParseHeader(const u8* data, u64 size, u64& dataOffset);
+	DdsError BuildSubresources(const u8* data, u64 dataOffset);
+
+	MappedFile m_File;
+
+	DdsTextureDesc m_Desc;
+	std::vector<DdsSubresource> m_Subresources;
+	u64 m_DataSize = 0;
+};
+
+// Bytes and rows of one 2D surface of the format, false for formats DdsFile does not know.
+bool GetDdsSurfaceInfo(DdsFormat format, u32 width, u32 height, u32& rowPitch, u32& rowCount, u64& slicePitch);
+
+DdsFormat MakeDdsFormatSRGB(DdsFormat format);
+bool IsDdsFormatSRGB(DdsFormat format);
+
+// BC formats, stored as 4x4 blocks. D3D12 wants the top mip of these to be a whole number of blocks.
+bool IsDdsFormatBlockCompressed(DdsFormat format);
+
+// Bytes of one mip level across every array slice and, for volumes, every depth slice.
+u64 GetDdsMipSize(const DdsTextureDesc& desc, u32 mip);
+
+// Appends the magic, header and DX10 extension of a 2D texture. The texel data follows in the
+// order DdsFile reads it, tightly packed.
+void WriteDdsHeaders(const DdsTextureDesc& desc, std::vector<u8>& file);
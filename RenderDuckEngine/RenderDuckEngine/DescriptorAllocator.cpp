@@ -0,0 +1,199 @@
+#include "DescriptorAllocator.h"
+
+#include <thread>
+
+DescriptorAllocator::DescriptorAllocator(u32 capacity, u32 shardCount, const IGpuTimeline* timeline)
+	: m_Timeline(timeline)
+	, m_Capacity(capacity)
+	, m_ShardCount(shardCount)
+{
+	ASSERTMSG(capacity > 0 && shardCount > 0 && shardCount <= capacity, "Descriptor allocator needs at least one index per shard");
+	assert(timeline != nullptr);
+
+	// The last shard takes the remainder.
+	m_ShardSize = capacity / shardCount;
+	m_Shards = std::make_unique<Shard[]>(shardCount);
+	for (u32 i = 0; i < shardCount; ++i)
+	{
+		const u32 start = i * m_ShardSize;
+		const u32 end = i + 1 == shardCount ? capacity : start + m_ShardSize;
+		m_Shards[i].m_FreeRanges.push_back({ start, end - start });
+	}
+
+	m_RangeCounts.resize(capacity, 0);
+	m_Generations = std::make_unique<std::atomic<u32>[]>(capacity);
+	for (u32 i = 0; i < capacity; ++i)
+	{
+		m_Generations[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+DescriptorHandle DescriptorAllocator::Allocate(u32 count)
+{
+	ASSERTMSG(count > 0, "Descriptor ranges need at least one descriptor");
+
+	// Threads start at different shards so they do not contend for the same lock.
+	const u32 homeShard = (u32)(std::hash<std::thread::id>()(std::this_thread::get_id()) % m_ShardCount);
+	for (u32 i = 0; i < m_ShardCount; ++i)
+	{
+		Shard& shard = m_Shards[(homeShard + i) % m_ShardCount];
+		std::lock_guard<std::mutex> lock(shard.m_Mutex);
+
+		u32 start = TryAllocate(shard, count);
+		if (start == c_InvalidDescriptorIndex && !shard.m_PendingFrees.empty())
+		{
+			Recycle(shard);
+			start = TryAllocate(shard, count);
+		}
+
+		if (start != c_InvalidDescriptorIndex)
+		{
+			m_RangeCounts[start] = count;
+			m_AllocatedCount.fetch_add(count, std::memory_order_relaxed);
+
+			DescriptorHandle handle;
+			handle.m_Index = start;
+			handle.m_Count = count;
+			handle.m_Generation = m_Generations[start].load(std::memory_order_relaxed);
+			return handle;
+		}
+	}
+
+	return DescriptorHandle();
+}
+
+u32 DescriptorAllocator::TryAllocate(Shard& shard, u32 count)
+{
+	// First fit keeps the low indices packed, leaving the large ranges at the end of the shard.
+	for (size_t i = 0; i < shard.m_FreeRanges.size(); ++i)
+	{
+		Range& range = shard.m_FreeRanges[i];
+		if (range.m_Count < count)
+		{
+			continue;
+		}
+
+		const u32 start = range.m_Start;
+		range.m_Start += count;
+		range.m_Count -= count;
+		if (range.m_Count == 0)
+		{
+			shard.m_FreeRanges.erase(shard.m_FreeRanges.begin() + i);
+		}
+		return start;
+	}
+
+	return c_InvalidDescriptorIndex;
+}
+
+void DescriptorAllocator::Free(const DescriptorHandle& handle)
+{
+	if (!handle.IsValid())
+	{
+		return;
+	}
+
+	Shard& shard = GetShard(handle.m_Index);
+	std::lock_guard<std::mutex> lock(shard.m_Mutex);
+
+	ASSERTMSG(IsLive(handle) && m_RangeCounts[handle.m_Index] == handle.m_Count, "Descriptor range freed twice or with a stale handle");
+	if (!IsLive(handle) || m_RangeCounts[handle.m_Index] != handle.m_Count)
+	{
+		return;
+	}
+
+	m_RangeCounts[handle.m_Index] = 0;
+	m_Generations[handle.m_Index].fetch_add(1, std::memory_order_release);
+	m_AllocatedCount.fetch_sub(handle.m_Count, std::memory_order_relaxed);
+	shard.m_PendingFrees.push_back({ { handle.m_Index, handle.m_Count }, c_UncommittedFence });
+}
+
+void DescriptorAllocator::Commit(u64 fenceValue)
+{
+	for (u32 i = 0; i < m_ShardCount; ++i)
+	{
+		Shard& shard = m_Shards[i];
+		std::lock_guard<std::mutex> lock(shard.m_Mutex);
+		for (PendingFree& pending : shard.m_PendingFrees)
+		{
+			if (pending.m_FenceValue == c_UncommittedFence)
+			{
+				pending.m_FenceValue = fenceValue;
+			}
+		}
+	}
+}
+
+void DescriptorAllocator::Recycle(Shard& shard)
+{
+	const u64 completedValue = m_Timeline->GetCompletedValue();
+
+	std::vector<PendingFree>& pending = shard.m_PendingFrees;
+	for (size_t i = 0; i < pending.size();)
+	{
+		if (pending[i].m_FenceValue != c_UncommittedFence && pending[i].m_FenceValue <= completedValue)
+		{
+			Release(shard, pending[i].m_Range);
+			pending[i] = pending.back();
+			pending.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void DescriptorAllocator::Release(Shard& shard, const Range& range)
+{
+	std::vector<Range>& ranges = shard.m_FreeRanges;
+	auto next = std::lower_bound(ranges.begin(), ranges.end(), range.m_Start, [](const Range& lhs, u32 start) { return lhs.m_Start < start; });
+
+	const bool mergePrevious = next != ranges.begin() && (next - 1)->m_Start + (next - 1)->m_Count == range.m_Start;
+	const bool mergeNext = next != ranges.end() && range.m_Start + range.m_Count == next->m_Start;
+
+	if (mergePrevious && mergeNext)
+	{
+		(next - 1)->m_Count += range.m_Count + next->m_Count;
+		ranges.erase(next);
+	}
+	else if (mergePrevious)
+	{
+		(next - 1)->m_Count += range.m_Count;
+	}
+	else if (mergeNext)
+	{
+		next->m_Start = range.m_Start;
+		next->m_Count += range.m_Count;
+	}
+	else
+	{
+		ranges.insert(next, range);
+	}
+}
+
+bool DescriptorAllocator::IsLive(const DescriptorHandle& handle) const
+{
+	return handle.IsValid() && handle.m_Index < m_Capacity &&
+		m_Generations[handle.m_Index].load(std::memory_order_acquire) == handle.m_Generation;
+}
+
+DescriptorHandle DescriptorAllocator::FindHandle(u32 index) const
+{
+	if (index >= m_Capacity)
+	{
+		return DescriptorHandle();
+	}
+
+	std::lock_guard<std::mutex> lock(GetShard(index).m_Mutex);
+	if (m_RangeCounts[index] == 0)
+	{
+		return DescriptorHandle();
+	}
+
+	DescriptorHandle handle;
+	handle.m_Index = index;
+	handle.m_Count = m_RangeCounts[index];
+	handle.m_Generation = m_Generations[index].load(std::memory_order_relaxed);
+	return handle;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "GpuTimeline.h"
+
+const u32 c_InvalidDescriptorIndex = ~0u;
+
+// A contiguous range of descriptors. The generation of a range's first index changes every time a
+// range starting there is freed, so a handle kept after Free is caught instead of silently
+// pointing at whatever reuses the slots.
+struct DescriptorHandle
+{
+	u32 m_Index = c_InvalidDescriptorIndex;
+	u32 m_Count = 0;
+	u32 m_Generation = 0;
+
+	bool IsValid() const { return m_Index != c_InvalidDescriptorIndex; }
+};
+
+// Hands out contiguous ranges of indices into a descriptor heap. Only indices are managed, so it
+// runs without a device.
+// The indices are split into shards, each with its own lock and sorted list of free ranges. Threads
+// allocate from a shard picked by their id and move on to the others when it is full, so threads
+// rarely wait for each other. A range never spans shards.
+// Freed ranges are recycled once the timeline reaches the fence value given to the next Commit.
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator(u32 capacity, u32 shardCount, const IGpuTimeline* timeline);
+	DescriptorAllocator(const DescriptorAllocator& rhs) = delete;
+	DescriptorAllocator& operator=(const DescriptorAllocator& rhs) = delete;
+
+	// Returns an invalid handle when no shard has count contiguous free indices, even after
+	// recycling the ranges the GPU has finished with.
+	DescriptorHandle Allocate(u32 count);
+
+	// The handle is stale as soon as this returns, the indices are reused after a later Commit.
+	void Free(const DescriptorHandle& handle);
+
+	// Everything freed since the last commit is recycled once the timeline reaches fenceValue.
+	void Commit(u64 fenceValue);
+
+	// False once the handle's range has been freed.
+	bool IsLive(const DescriptorHandle& handle) const;
+
+	// The live range starting at index, or an invalid handle, for callers that only kept the index.
+	DescriptorHandle FindHandle(u32 index) const;
+
+	u32 GetCapacity() const { return m_Capacity; }
+	u32 GetShardSize() const { return m_ShardSize; }
+	u32 GetAllocatedCount() const { return m_AllocatedCount.load(std::memory_order_relaxed); }
+
+private:
+	// Fence value of frees that have not been committed yet.
+	static const u64 c_UncommittedFence = ~0ull;
+
+	struct Range
+	{
+		u32 m_Start;
+		u32 m_Count;
+	};
+
+	struct PendingFree
+	{
+		Range m_Range;
+		u64 m_FenceValue;
+	};
+
+	struct Shard
+	{
+		// Sorted by start, neighbouring ranges are always merged.
+		std::vector<Range> m_FreeRanges;
+		std::vector<PendingFree> m_PendingFrees;
+
+		mutable std::mutex m_Mutex;
+	};
+
+	u32 TryAllocate(Shard& shard, u32 count);
+	void Recycle(Shard& shard);
+	void Release(Shard& shard, const Range& range);
+	Shard& GetShard(u32 index) const { return m_Shards[std::min(index / m_ShardSize, m_ShardCount - 1)]; }
+
+	const IGpuTimeline* m_Timeline;
+	u32 m_Capacity;
+	u32 m_ShardCount;
+	u32 m_ShardSize;
+
+	std::unique_ptr<Shard[]> m_Shards;
+
+	// Per index, only meaningful where a range starts. Counts are zero for indices that do not start
+	// a live range and are guarded by the owning shard's lock. Generations are atomic so IsLive can
+	// check a handle without locking.
+	std::vector<u32> m_RangeCounts;
+	std::unique_ptr<std::atomic<u32>[]> m_Generations;
+
+	std::atomic<u32> m_AllocatedCount = 0;
+};
@@ -0,0 +1,140 @@
+#include "Archetype.h"
+
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace
+{
+	// Fixed size so ids already handed out can be looked up without the lock while another
+	// thread registers a type.
+	ComponentTypeInfo s_ComponentTypes[c_MaxComponentTypes];
+	u32 s_ComponentTypeCount = 0;
+	std::mutex s_ComponentTypeMutex;
+
+	u64 AlignUp(u64 value, u64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	u8* AllocateChunk()
+	{
+		return (u8*)::operator new(c_ArchetypeChunkSize, std::align_val_t(c_ArchetypeChunkAlignment));
+	}
+
+	void FreeChunk(u8* chunk)
+	{
+		::operator delete(chunk, std::align_val_t(c_ArchetypeChunkAlignment));
+	}
+}
+
+ComponentTypeId RegisterComponentType(const ComponentTypeInfo& info)
+{
+	std::lock_guard<std::mutex> lock(s_ComponentTypeMutex);
+	ASSERTMSG(s_ComponentTypeCount < c_MaxComponentTypes, "Too many component types for ComponentMask");
+	ASSERTMSG(info.m_Alignment <= c_ArchetypeChunkAlignment, "Component is aligned beyond a chunk");
+	s_ComponentTypes[s_ComponentTypeCount] = info;
+	return s_ComponentTypeCount++;
+}
+
+const ComponentTypeInfo& GetComponentTypeInfo(ComponentTypeId type)
+{
+	assert(type < c_MaxComponentTypes);
+	return s_ComponentTypes[type];
+}
+
+Archetype::Archetype(ComponentMask mask)
+	: m_Mask(mask)
+{
+	// Handles first, then each component's array aligned for it. Every row costs the handle plus
+	// one of each component, alignment padding is what is left over.
+	u64 rowSize = sizeof(EntityHandle);
+	u64 padding = 0;
+	for (ComponentTypeId type = 0; type < c_MaxComponentTypes; ++type)
+	{
+		if (HasComponent(type))
+		{
+			rowSize += GetComponentTypeInfo(type).m_Size;
+			padding += GetComponentTypeInfo(type).m_Alignment;
+		}
+	}
+	m_ChunkCapacity = (u32)((c_ArchetypeChunkSize - padding) / rowSize);
+	ASSERTMSG(m_ChunkCapacity > 0, "Archetype row does not fit in a chunk");
+
+	u64 offset = (u64)m_ChunkCapacity * sizeof(EntityHandle);
+	for (ComponentTypeId type = 0; type < c_MaxComponentTypes; ++type)
+	{
+		if (HasComponent(type))
+		{
+			const ComponentTypeInfo& info = GetComponentTypeInfo(type);
+			offset = AlignUp(offset, info.m_Alignment);
+			m_ColumnOffsets[type] = (u32)offset;
+			offset += (u64)m_ChunkCapacity * info.m_Size;
+		}
+	}
+	assert(offset <= c_ArchetypeChunkSize);
+}
+
+Archetype::~Archetype()
+{
+	for (u8* chunk : m_Chunks)
+	{
+		FreeChunk(chunk);
+	}
+	if (m_SpareChunk != nullptr)
+	{
+		FreeChunk(m_SpareChunk);
+	}
+}
+
+u32 Archetype::AddRow(EntityHandle entity)
+{
+	const u32 row = m_EntityCount;
+	const u32 chunk = row / m_ChunkCapacity;
+	if (chunk == m_Chunks.size())
+	{
+		m_Chunks.push_back(m_SpareChunk != nullptr ? m_SpareChunk : AllocateChunk());
+		m_SpareChunk = nullptr;
+	}
+
+	((EntityHandle*)m_Chunks[chunk])[row % m_ChunkCapacity] = entity;
+	++m_EntityCount;
+	return row;
+}
+
+void Archetype::CopyRow(u32 row, Archetype& dst, u32 dstRow) const
+{
+	const ComponentMask shared = m_Mask & dst.m_Mask;
+	for (ComponentTypeId type = 0; type < c_MaxComponentTypes; ++type)
+	{
+		if ((shared >> type) & 1)
+		{
+			memcpy(dst.GetComponent(dstRow, type), GetComponent(row, type), GetComponentTypeInfo(type).m_Size);
+		}
+	}
+}
+
+EntityHandle Archetype::RemoveRow(u32 row)
+{
+	assert(row < m_EntityCount);
+	const u32 last = m_EntityCount - 1;
+	EntityHandle moved;
+	if (row != last)
+	{
+		moved = GetEntity(last);
+		((EntityHandle*)m_Chunks[row / m_ChunkCapacity])[row % m_ChunkCapacity] = moved;
+		CopyRow(last, *this, row);
+	}
+	--m_EntityCount;
+
+	if (m_EntityCount <= (m_Chunks.size() - 1) * m_ChunkCapacity)
+	{
+		if (m_SpareChunk != nullptr)
+		{
+			FreeChunk(m_SpareChunk);
+		}
+		m_SpareChunk = m_Chunks.back();
+		m_Chunks.pop_back();
+	}
+	return moved;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "../EngineCore.h"
+
+#include <algorithm>
+
+#include "Entity.h"
+#include "Components/Component.h"
+
+// Chunks are sized to sit comfortably in L1/L2 while iterating and are cache line aligned.
+const u32 c_ArchetypeChunkSize = 16 * 1024;
+const u32 c_ArchetypeChunkAlignment = 64;
+
+// Every entity with exactly the same set of components. Their components are stored in fixed
+// size chunks, each holding one dense array per component plus the entities' handles, so a query
+// walks each array front to back. Rows are numbered across chunks, chunk * capacity + index,
+// and are kept packed: removing a row moves the last row into its place, so only the last chunk
+// is ever partly filled.
+class Archetype
+{
+public:
+	explicit Archetype(ComponentMask mask);
+	Archetype(const Archetype& rhs) = delete;
+	Archetype& operator=(const Archetype& rhs) = delete;
+	~Archetype();
+
+	ComponentMask GetMask() const { return m_Mask; }
+	bool HasComponent(ComponentTypeId type) const { return (m_Mask >> type) & 1; }
+
+	u32 GetEntityCount() const { return m_EntityCount; }
+	u32 GetChunkCapacity() const { return m_ChunkCapacity; }
+	u32 GetChunkCount() const { return (u32)m_Chunks.size(); }
+	u32 GetChunkEntityCount(u32 chunk) const { return std::min(m_EntityCount - chunk * m_ChunkCapacity, m_ChunkCapacity); }
+
+	const EntityHandle* GetEntities(u32 chunk) const { return (const EntityHandle*)m_Chunks[chunk]; }
+
+	// The dense array of one component within a chunk, the archetype must have the component.
+	void* GetColumn(u32 chunk, ComponentTypeId type) const
+	{
+		assert(HasComponent(type));
+		return m_Chunks[chunk] + m_ColumnOffsets[type];
+	}
+
+	template<typename T>
+	T* GetColumn(u32 chunk) const { return (T*)GetColumn(chunk, GetComponentTypeId<T>()); }
+
+	void* GetComponent(u32 row, ComponentTypeId type) const
+	{
+		return (u8*)GetColumn(row / m_ChunkCapacity, type) + (u64)(row % m_ChunkCapacity) * GetComponentTypeInfo(type).m_Size;
+	}
+
+	EntityHandle GetEntity(u32 row) const { return GetEntities(row / m_ChunkCapacity)[row % m_ChunkCapacity]; }
+
+	// Appends a row for the entity, its components are left uninitialised for the caller.
+	u32 AddRow(EntityHandle entity);
+
+	// Copies the components both archetypes have from a row of this one to a row of dst.
+	void CopyRow(u32 row, Archetype& dst, u32 dstRow) const;
+
+	// Fills the row with the last one, returns the entity that moved into it or an invalid handle
+	// when the row was the last.
+	EntityHandle RemoveRow(u32 row);
+
+	// Where an entity goes when a component is added or removed, filled in by EntityAdmin the
+	// first time the transition is made.
+	Archetype* m_AddEdges[c_MaxComponentTypes] = {};
+	Archetype* m_RemoveEdges[c_MaxComponentTypes] = {};
+
+private:
+	ComponentMask m_Mask;
+	u32 m_ChunkCapacity = 0;
+	u32 m_EntityCount = 0;
+
+	// Byte offset of each component's array within a chunk, indexed by component type.
+	u32 m_ColumnOffsets[c_MaxComponentTypes] = {};
+
+	std::vector<u8*> m_Chunks;
+
+	// A chunk emptied by RemoveRow is kept for the next AddRow, so an entity moving back and
+	// forth across a chunk boundary does not allocate each time.
+	u8* m_SpareChunk = nullptr;
+};
@@ -1,25 +1,38 @@
 #pragma once
+#include "../../EngineCore.h"
 
-#include "../Entity.h"
+#include <type_traits>
 
+typedef u32 ComponentTypeId;
 
-class Component
-{
-public:
-	Component() {}
-	~Component() {}
-		
-	virtual void OnAdded() {};
-	virtual void OnRemoved() {};
-
-	virtual void OnEnabled() {};
-	virtual void OnDisabled() {};
+// One bit per component type, an archetype is the set of components its entities have.
+typedef u64 ComponentMask;
+const u32 c_MaxComponentTypes = 64;
 
+struct ComponentTypeInfo
+{
+	u32 m_Size = 0;
+	u32 m_Alignment = 0;
 };
 
-#define COMPONENT_CLASS(name) class name;\
-typedef std::shared_ptr<name> name##Ref;\
-typedef std::weak_ptr<name> name##WeakRef;\
-class name
+// Ids are handed out in the order types are first used, so they are only stable within a run.
+ComponentTypeId RegisterComponentType(const ComponentTypeInfo& info);
+const ComponentTypeInfo& GetComponentTypeInfo(ComponentTypeId type);
 
+// Components are plain data stored in archetype chunks, which move them around with memcpy
+// and never run their destructors.
+template<typename T>
+ComponentTypeId GetComponentTypeId()
+{
+	static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+		"Components must be trivially copyable and destructible");
+
+	static const ComponentTypeId id = RegisterComponentType({ (u32)sizeof(T), (u32)alignof(T) });
+	return id;
+}
 
+template<typename T>
+ComponentMask GetComponentMask()
+{
+	return ComponentMask(1) << GetComponentTypeId<T>();
+}
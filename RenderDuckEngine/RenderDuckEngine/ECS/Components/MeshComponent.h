@@ -1,10 +1,17 @@
 #pragma once
 #include "Component.h"
 
-COMPONENT_CLASS(MeshComponent) : public Component
+struct MeshGeometry;
+struct Material;
+
+// What to draw for an entity, its world matrix comes from its TransformComponent.
+struct MeshComponent
 {
-public:
+	MeshGeometry* m_Geo = nullptr;
+	Material* m_Mat = nullptr;
 
-private:
+	// DrawIndexedInstanced parameters.
+	u32 m_IndexCount = 0;
+	u32 m_StartIndexLocation = 0;
+	s32 m_BaseVertexLocation = 0;
 };
-
@@ -3,16 +3,15 @@
 #include "Component.h"
 
 
-COMPONENT_CLASS(TransformComponent) : public Component
+class TransformComponent
 {
 public:
     TransformComponent() 
     {    
         m_Position = DirectX::XMVectorZero();
-        m_Scale = DirectX::XMVectorZero();
-        m_Rotation = DirectX::XMVectorZero();
+        m_Scale = DirectX::XMVectorSplatOne();
+        m_Rotation = DirectX::XMQuaternionIdentity();
     }
-    ~TransformComponent() {}
 
     void SetPosition(const vec3& pos) 
     {
@@ -29,6 +28,10 @@ public:
         m_Scale = scl;
     }
 
+    const vec3& GetPosition() const { return m_Position; }
+    const quat& GetRotation() const { return m_Rotation; }
+    const vec3& GetScale() const { return m_Scale; }
+
     mtx44 GetTransformMatrix() const {
         using namespace DirectX;
 
@@ -41,4 +44,3 @@ private:
     quat m_Rotation;
     vec3 m_Scale;
 };
-
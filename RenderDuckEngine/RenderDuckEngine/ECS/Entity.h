@@ -1,29 +1,22 @@
 #pragma once
-#include <memory>
-#include "../../Handle.h"
-#include "Components/Component.h"
+#include "../EngineCore.h"
+#include "../Handle.h"
 
+// The low 32 bits index the entity table, the high 32 bits are the generation of that slot, so
+// handles to destroyed entities stay invalid after the slot is reused.
 typedef Handle64 EntityHandle;
 
-class EntityAdmin;
-class Entity
+inline EntityHandle MakeEntityHandle(u32 index, u32 generation)
 {
-public:
-	Entity(EntityHandle handle, EntityAdmin* admin) : m_Handle(handle), m_EntityAdmin(admin) {}
-	const EntityHandle GetHandle() { return m_Handle; };
+	return EntityHandle(((u64)generation << 32) | index);
+}
 
-	template<typename T>
-	std::shared_ptr<T> GetComponent()
-	{
-		T* component = static_cast<Component*>();
-		return m_EntityAdmin->GetComponent(m_Handle);
-	}
-
-private:
-
-	EntityHandle m_Handle;
-	EntityAdmin* m_EntityAdmin;
-};
+inline u32 GetEntityIndex(EntityHandle handle)
+{
+	return (u32)handle.GetValue();
+}
 
-typedef std::shared_ptr<Entity> EntityRef; 
-typedef std::weak_ptr<Entity> EntityWeakRef;
\ No newline at end of file
+inline u32 GetEntityGeneration(EntityHandle handle)
+{
+	return (u32)(handle.GetValue() >> 32);
+}
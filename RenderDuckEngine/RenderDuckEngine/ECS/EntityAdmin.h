@@ -3,44 +3,134 @@
 #include "../Handle.h"
 #include "Entity.h"
 
-#include <queue>
+#include <string>
 #include <unordered_map>
 
+#include "Archetype.h"
 #include "Components/TransformComponent.h"
 #include "Components/MeshComponent.h"
 
-/// Macro for declaring the required map and getter function for each component type
-/// Declares a private map of (EntityHandle, ComponentRef), and a public getter function GetComponent<ComponentType>(Entityhandle) 
-#define COMPONENT_MAP_NAME(name) m_##name##s
-#define COMPONENT_REF(name) name##WeakRef
-#define REGISTER_COMPONENT(ComponentName) private: \
-	std::unordered_map<EntityHandle, COMPONENT_REF(ComponentName)> COMPONENT_MAP_NAME(ComponentName);\
-public: \
-template<class ComponentName>\
-COMPONENT_REF(ComponentName) GetComponent(const EntityHandle& handle)\
-{\
-	ASSERTMSG(handle.IsValid(), "Get" #ComponentName " called on invalid entity handle");\
-	if (auto& it = COMPONENT_MAP_NAME(ComponentName).find(handle); it != COMPONENT_MAP_NAME(ComponentName).end()) { return it->second; }\
-	else { ASSERTFAILMSG("Entity does not have requested " #ComponentName); }\
-};
-
-
+// Owns every entity and its components, grouped into archetypes by the set of components each
+// entity has. An entity's handle indexes a table holding its archetype and row, so component
+// lookups are two indirections rather than a hash lookup per component type. Adding or removing
+// a component moves the entity to the archetype for its new set, which invalidates component
+// pointers into both archetypes. Queries visit every archetype that has the components asked for
+// and walk their chunks' arrays.
 class EntityAdmin
 {
 public:
 
 	EntityAdmin();
+	EntityAdmin(const EntityAdmin& rhs) = delete;
+	EntityAdmin& operator=(const EntityAdmin& rhs) = delete;
 
 	EntityHandle CreateEntity();
-	void DestroyEntity(EntityHandle& handle);
+	void DestroyEntity(EntityHandle handle);
+	bool IsAlive(EntityHandle handle) const;
+
+	// Replaces the component when the entity already has one.
+	template<typename T>
+	T& AddComponent(EntityHandle handle, const T& component = T())
+	{
+		T* added = (T*)AddComponentById(handle, GetComponentTypeId<T>());
+		*added = component;
+		return *added;
+	}
+
+	template<typename T>
+	void RemoveComponent(EntityHandle handle)
+	{
+		RemoveComponentById(handle, GetComponentTypeId<T>());
+	}
+
+	template<typename T>
+	bool HasComponent(EntityHandle handle) const
+	{
+		return GetRecord(handle).m_Archetype->HasComponent(GetComponentTypeId<T>());
+	}
+
+	// Null when the entity does not have the component. Valid until the next structural change.
+	template<typename T>
+	T* GetComponent(EntityHandle handle) const
+	{
+		return (T*)GetComponentById(handle, GetComponentTypeId<T>());
+	}
+
+	// Calls func(count, entities, components...) for every chunk of every archetype with all of
+	// the components, each pointing at count dense elements.
+	template<typename... Components, typename Func>
+	void ForEachChunk(Func func)
+	{
+		const ComponentMask query = (GetComponentMask<Components>() | ... | ComponentMask(0));
+		for (const std::unique_ptr<Archetype>& archetype : m_Archetypes)
+		{
+			if ((archetype->GetMask() & query) != query)
+			{
+				continue;
+			}
+			for (u32 chunk = 0; chunk < archetype->GetChunkCount(); ++chunk)
+			{
+				func(archetype->GetChunkEntityCount(chunk), archetype->GetEntities(chunk), archetype->GetColumn<Components>(chunk)...);
+			}
+		}
+	}
+
+	// Calls func(entity, components&...) for every entity with all of the components. Entities
+	// must not be created or destroyed, or components added or removed, from inside func.
+	template<typename... Components, typename Func>
+	void ForEach(Func func)
+	{
+		ForEachChunk<Components...>([&func](u32 count, const EntityHandle* entities, Components*... components)
+		{
+			for (u32 i = 0; i < count; ++i)
+			{
+				func(entities[i], components[i]...);
+			}
+		});
+	}
 
-	REGISTER_COMPONENT(TransformComponent)
-	REGISTER_COMPONENT(MeshComponent)
+	u32 GetEntityCount() const { return m_EntityCount; }
+	u32 GetArchetypeCount() const { return (u32)m_Archetypes.size(); }
 
 private:
 
-	EntityHandle AllocateEntiyHandle();
+	struct EntityRecord
+	{
+		Archetype* m_Archetype = nullptr;
+		u32 m_Row = 0;
 
-	std::unordered_map<EntityHandle, Entity> m_Entities;
-	std::queue<EntityHandle> m_FreeHandles;
+		// Bumped when the entity is destroyed, so old handles stop matching.
+		u32 m_Generation = 0;
+	};
+
+	const EntityRecord& GetRecord(EntityHandle handle) const
+	{
+		ASSERTMSG(IsAlive(handle), "Entity handle is invalid or was destroyed");
+		return m_Records[GetEntityIndex(handle)];
+	}
+
+	void* AddComponentById(EntityHandle handle, ComponentTypeId type);
+	void RemoveComponentById(EntityHandle handle, ComponentTypeId type);
+	void* GetComponentById(EntityHandle handle, ComponentTypeId type) const;
+
+	Archetype* GetArchetype(ComponentMask mask);
+
+	// Moves the entity's row to dst, copying the components both archetypes have.
+	void MoveEntity(EntityRecord& record, Archetype* dst);
+
+	// Removes the entity's row and points the record of the entity moved into it at it.
+	void RemoveRow(const EntityRecord& record);
+
+	// Archetypes are never freed, an emptied one keeps its spare chunk for the next entity.
+	std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+	std::unordered_map<ComponentMask, Archetype*> m_ArchetypesByMask;
+	Archetype* m_EmptyArchetype;
+
+	std::vector<EntityRecord> m_Records;
+	std::vector<u32> m_FreeIndices;
+	u32 m_EntityCount = 0;
 };
+
+// Iterates one million entities through archetype queries, and through component maps keyed
+// by entity handle like the ones this replaced, and reports the time of each.
+void RunEcsBenchmark(std::string& report);
@@ -0,0 +1,25 @@
+#include "FenceTimeline.h"
+
+FenceTimeline::FenceTimeline(ID3D12Fence* fence)
+	: m_Fence(fence)
+{
+	m_WaitEvent = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+	ASSERTMSG(m_WaitEvent != nullptr, "Failed to create fence wait event");
+}
+
+FenceTimeline::~FenceTimeline()
+{
+	CloseHandle(m_WaitEvent);
+}
+
+void FenceTimeline::Wait(u64 value)
+{
+	if (m_Fence->GetCompletedValue() >= value)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_WaitMutex);
+	ThrowIfFailed(m_Fence->SetEventOnCompletion(value, m_WaitEvent));
+	WaitForSingleObject(m_WaitEvent, INFINITE);
+}
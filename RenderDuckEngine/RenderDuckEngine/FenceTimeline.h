@@ -0,0 +1,28 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <mutex>
+
+#include "d3dUtil.h"
+#include "GpuTimeline.h"
+
+// IGpuTimeline backed by a D3D12 fence. Waits share one event for the life of the timeline
+// instead of creating one per wait.
+class FenceTimeline : public IGpuTimeline
+{
+public:
+	FenceTimeline(ID3D12Fence* fence);
+	FenceTimeline(const FenceTimeline& rhs) = delete;
+	FenceTimeline& operator=(const FenceTimeline& rhs) = delete;
+	~FenceTimeline();
+
+	virtual u64 GetCompletedValue() const override { return m_Fence->GetCompletedValue(); }
+	virtual void Wait(u64 value) override;
+
+private:
+	ID3D12Fence* m_Fence;
+	HANDLE m_WaitEvent;
+
+	// The event can only track one fence value at a time.
+	std::mutex m_WaitMutex;
+};
@@ -0,0 +1,105 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <chrono>
+
+FramePacer::FramePacer(IGpuTimeline* timeline, u32 frameResourceCount)
+	: m_Timeline(timeline)
+	, m_FrameResourceCount(frameResourceCount)
+	, m_MaxFramesInFlight(frameResourceCount)
+{
+	assert(timeline != nullptr);
+	ASSERTMSG(frameResourceCount > 0, "Frame pacing needs at least one frame resource");
+
+	m_SlotFences.resize(frameResourceCount, 0);
+	m_WaitHistoryMs.resize(c_WaitHistoryLength, 0.0f);
+}
+
+void FramePacer::SetMaxFramesInFlight(u32 maxFramesInFlight)
+{
+	// A slot can only be reused once its last frame is done, so there can never be more frames
+	// in flight than slots.
+	m_MaxFramesInFlight = std::min(std::max(maxFramesInFlight, 1u), m_FrameResourceCount);
+}
+
+void FramePacer::BeginFrame()
+{
+	m_WaitedThisFrame = false;
+	m_CurrentWaitMs = 0.0f;
+
+	if (m_LowLatency)
+	{
+		WaitForFrame();
+	}
+}
+
+void FramePacer::WaitForFrameResources()
+{
+	if (!m_WaitedThisFrame)
+	{
+		WaitForFrame();
+	}
+}
+
+void FramePacer::WaitForFrame()
+{
+	m_WaitedThisFrame = true;
+
+	// The frame m_MaxFramesInFlight back has to be finished. That also frees this frame's slot,
+	// which was last used at least that many frames ago.
+	if (m_FrameNumber < m_MaxFramesInFlight)
+	{
+		return;
+	}
+
+	const u64 frameToRetire = m_FrameNumber - m_MaxFramesInFlight;
+	const u64 fenceValue = m_SlotFences[frameToRetire % m_FrameResourceCount];
+	if (fenceValue == 0 || m_Timeline->GetCompletedValue() >= fenceValue)
+	{
+		return;
+	}
+
+	const auto waitStart = std::chrono::steady_clock::now();
+	m_Timeline->Wait(fenceValue);
+	const auto waitEnd = std::chrono::steady_clock::now();
+
+	m_CurrentWaitMs += std::chrono::duration<float, std::milli>(waitEnd - waitStart).count();
+}
+
+void FramePacer::EndFrame(u64 fenceValue)
+{
+	ASSERTMSG(m_WaitedThisFrame, "WaitForFrameResources must be called before EndFrame");
+
+	m_SlotFences[GetFrameResourceIndex()] = fenceValue;
+	RecordWait(m_CurrentWaitMs);
+
+	++m_FrameNumber;
+}
+
+void FramePacer::RecordWait(float waitMs)
+{
+	m_WaitHistoryMs[m_FrameNumber % c_WaitHistoryLength] = waitMs;
+
+	const u32 historyCount = (u32)std::min<u64>(m_FrameNumber + 1, c_WaitHistoryLength);
+
+	m_Stats.m_LastWaitMs = waitMs;
+	m_Stats.m_AverageWaitMs = 0.0f;
+	m_Stats.m_MaxWaitMs = 0.0f;
+	m_Stats.m_FramesWaited = 0;
+	for (u32 i = 0; i < historyCount; ++i)
+	{
+		const float historyWaitMs = m_WaitHistoryMs[i];
+		m_Stats.m_AverageWaitMs += historyWaitMs;
+		m_Stats.m_MaxWaitMs = std::max(m_Stats.m_MaxWaitMs, historyWaitMs);
+		m_Stats.m_FramesWaited += historyWaitMs > 0.0f ? 1 : 0;
+	}
+	m_Stats.m_AverageWaitMs /= (float)historyCount;
+}
+
+void FramePacer::FillReport(FramePacingReport& report) const
+{
+	report.m_Stats = m_Stats;
+	std::copy(m_WaitHistoryMs.begin(), m_WaitHistoryMs.end(), report.m_WaitHistoryMs);
+	report.m_WaitHistoryOffset = GetWaitHistoryOffset();
+	report.m_FrameResourceCount = m_FrameResourceCount;
+}
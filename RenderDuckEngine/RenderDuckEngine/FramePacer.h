@@ -0,0 +1,87 @@
+#pragma once
+#include "EngineCore.h"
+
+#include "GpuTimeline.h"
+#include "LodSelector.h"
+
+struct FramePacingStats
+{
+	// CPU time spent blocked on the GPU, in milliseconds.
+	float m_LastWaitMs = 0.0f;
+	float m_AverageWaitMs = 0.0f;
+	float m_MaxWaitMs = 0.0f;
+
+	// Frames in the history that had to wait at all.
+	u32 m_FramesWaited = 0;
+};
+
+struct FramePacingReport;
+
+// Decides when the CPU has to wait for the GPU so that at most a set number of frames are in
+// flight. Each frame: BeginFrame before input is sampled, WaitForFrameResources before the CPU
+// writes into the frame's resources, then EndFrame with the fence value signalled after submit.
+// Normally the wait happens in WaitForFrameResources, so input is sampled as early as possible and
+// the CPU can run ahead. In low latency mode it happens in BeginFrame instead, so input is read
+// after the wait and is as fresh as possible when the frame reaches the GPU.
+class FramePacer
+{
+public:
+	static const u32 c_WaitHistoryLength = 120;
+
+	// frameResourceCount is the number of frame resource slots, the most frames that can be in flight.
+	FramePacer(IGpuTimeline* timeline, u32 frameResourceCount);
+
+	void SetMaxFramesInFlight(u32 maxFramesInFlight);
+	void SetLowLatencyMode(bool lowLatency) { m_LowLatency = lowLatency; }
+
+	void BeginFrame();
+	void WaitForFrameResources();
+	void EndFrame(u64 fenceValue);
+
+	// Frame resource slot for the current frame.
+	u32 GetFrameResourceIndex() const { return (u32)(m_FrameNumber % m_FrameResourceCount); }
+
+	u64 GetFrameNumber() const { return m_FrameNumber; }
+	u32 GetFrameResourceCount() const { return m_FrameResourceCount; }
+	u32 GetMaxFramesInFlight() const { return m_MaxFramesInFlight; }
+	bool IsLowLatencyMode() const { return m_LowLatency; }
+
+	const FramePacingStats& GetStats() const { return m_Stats; }
+
+	// Wait durations of the last c_WaitHistoryLength frames, oldest at GetWaitHistoryOffset.
+	const float* GetWaitHistory() const { return m_WaitHistoryMs.data(); }
+	u32 GetWaitHistoryOffset() const { return (u32)(m_FrameNumber % c_WaitHistoryLength); }
+
+	void FillReport(FramePacingReport& report) const;
+
+private:
+	void WaitForFrame();
+	void RecordWait(float waitMs);
+
+	IGpuTimeline* m_Timeline;
+	u32 m_FrameResourceCount;
+	u32 m_MaxFramesInFlight;
+	bool m_LowLatency = false;
+
+	u64 m_FrameNumber = 0;
+	bool m_WaitedThisFrame = false;
+	float m_CurrentWaitMs = 0.0f;
+
+	// Fence value of each slot's last frame, 0 when the slot has never been submitted.
+	std::vector<u64> m_SlotFences;
+
+	std::vector<float> m_WaitHistoryMs;
+	FramePacingStats m_Stats;
+};
+
+// Copy of the pacer's state, for showing it on a thread other than the one driving the pacer.
+struct FramePacingReport
+{
+	FramePacingStats m_Stats;
+	float m_WaitHistoryMs[FramePacer::c_WaitHistoryLength] = {};
+	u32 m_WaitHistoryOffset = 0;
+	u32 m_FrameResourceCount = 0;
+
+	// Filled in by the renderer after the pacer, the frame's LOD selection per view.
+	LodStats m_LodStats[(u32)LodView::Count];
+};
@@ -1,15 +1,14 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT workerCount)
 {
-    ThrowIfFailed(device->CreateCommandAllocator(
-        D3D12_COMMAND_LIST_TYPE_DIRECT,
-		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
-
-    PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    SsaoCB = std::make_unique<UploadBuffer<SsaoConstants>>(device, 1, true);
-	MaterialBuffer = std::make_unique<UploadBuffer<MaterialData>>(device, materialCount, false);
-    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
+    WorkerCmdListAllocs.resize(workerCount);
+    for (auto& cmdListAlloc : WorkerCmdListAllocs)
+    {
+        ThrowIfFailed(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_DIRECT,
+            IID_PPV_ARGS(cmdListAlloc.GetAddressOf())));
+    }
 }
 
 FrameResource::~FrameResource()
@@ -2,7 +2,7 @@
 
 #include "d3dUtil.h"
 #include "MathHelper.h"
-#include "UploadBuffer.h"
+#include "FrameUploadHeap.h"
 
 struct ObjectConstants
 {
@@ -90,27 +90,22 @@ struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, UINT workerCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
 
     // We cannot reset the allocator until the GPU is done processing the commands.
-    // So each frame needs their own allocator.
-    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
+    // So each frame needs their own allocators, and each recording worker needs its own
+    // because an allocator cannot be recorded into from two threads at once.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> WorkerCmdListAllocs;
 
     // We cannot update a cbuffer until the GPU is done processing the commands
-    // that reference it.  So each frame needs their own cbuffers.
-    std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
-    std::unique_ptr<UploadBuffer<SsaoConstants>> SsaoCB = nullptr;
+    // that reference it.  So each frame suballocates its own from the frame upload heap.
+    // PassCB element 0 is the main pass and element 1 the shadow pass.
+    UploadAllocation PassCB;
+    UploadAllocation ObjectCB;
+    UploadAllocation SsaoCB;
 
-	std::unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
-
-    
-
-
-    // Fence value to mark commands up to this fence point.  This lets us
-    // check if these frame resources are still in use by the GPU.
-    UINT64 Fence = 0;
+	UploadAllocation MaterialBuffer;
 };
\ No newline at end of file
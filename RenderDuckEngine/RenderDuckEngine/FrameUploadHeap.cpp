@@ -0,0 +1,56 @@
+#include "FrameUploadHeap.h"
+
+FrameUploadHeap::FrameUploadHeap(ID3D12Device* device, ID3D12Fence* fence, u64 capacity)
+	: m_Timeline(fence)
+	, m_Ring(capacity, &m_Timeline)
+{
+	ThrowIfFailed(device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(capacity),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_UploadBuffer)));
+
+	// The buffer stays mapped for its whole life, the ring makes sure nothing in use by the GPU is written.
+	ThrowIfFailed(m_UploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_MappedData)));
+	m_GpuAddress = m_UploadBuffer->GetGPUVirtualAddress();
+}
+
+FrameUploadHeap::~FrameUploadHeap()
+{
+	if (m_UploadBuffer != nullptr)
+		m_UploadBuffer->Unmap(0, nullptr);
+
+	m_MappedData = nullptr;
+}
+
+UploadAllocation FrameUploadHeap::Allocate(u64 size, u64 alignment)
+{
+	u64 offset = m_Ring.Allocate(size, alignment);
+
+	// Out of room, wait for the oldest frame in flight to free its memory.
+	while (offset == c_InvalidRingOffset && m_Ring.HasPendingBlocks())
+	{
+		m_Timeline.Wait(m_Ring.GetOldestPendingFence());
+		offset = m_Ring.Allocate(size, alignment);
+	}
+
+	ASSERTMSG(offset != c_InvalidRingOffset, "Frame upload heap is too small for one frame of data");
+
+	UploadAllocation allocation;
+	allocation.m_CpuAddress = m_MappedData + offset;
+	allocation.m_GpuAddress = m_GpuAddress + offset;
+	allocation.m_Offset = offset;
+	allocation.m_Size = size;
+	allocation.m_ElementStride = (u32)size;
+	return allocation;
+}
+
+UploadAllocation FrameUploadHeap::AllocateElements(u32 elementStride, u32 count, u64 alignment)
+{
+	// Always hand out at least one element so empty scenes still get a valid address to bind.
+	UploadAllocation allocation = Allocate((u64)elementStride * std::max(count, 1u), alignment);
+	allocation.m_ElementStride = elementStride;
+	return allocation;
+}
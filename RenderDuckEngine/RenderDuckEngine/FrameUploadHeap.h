@@ -0,0 +1,82 @@
+#pragma once
+#include "EngineCore.h"
+
+#include "d3dUtil.h"
+#include "FenceTimeline.h"
+#include "RingAllocator.h"
+
+// A piece of the frame upload heap. Valid for the frame it was allocated in, the memory is
+// reused once the GPU has finished that frame.
+struct UploadAllocation
+{
+	u8* m_CpuAddress = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS m_GpuAddress = 0;
+	u64 m_Offset = 0;
+	u64 m_Size = 0;
+
+	// Distance between elements, constant buffer elements are padded to 256 bytes.
+	u32 m_ElementStride = 0;
+
+	template<typename T>
+	void CopyData(u32 elementIndex, const T& data)
+	{
+		assert((u64)(elementIndex + 1) * m_ElementStride <= m_Size);
+		memcpy(m_CpuAddress + (u64)elementIndex * m_ElementStride, &data, sizeof(T));
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress(u32 elementIndex = 0) const
+	{
+		return m_GpuAddress + (u64)elementIndex * m_ElementStride;
+	}
+};
+
+// One persistently mapped upload buffer that every frame suballocates its constants and other
+// transient data from. Memory is handed out by a RingAllocator and released when the fence value
+// given to EndFrame completes, so the amount used per frame can change freely.
+class FrameUploadHeap
+{
+public:
+	FrameUploadHeap(ID3D12Device* device, ID3D12Fence* fence, u64 capacity);
+	FrameUploadHeap(const FrameUploadHeap& rhs) = delete;
+	FrameUploadHeap& operator=(const FrameUploadHeap& rhs) = delete;
+	~FrameUploadHeap();
+
+	// Blocks on the GPU if the ring is full of frames still in flight.
+	UploadAllocation Allocate(u64 size, u64 alignment);
+
+	// count elements of T, each padded to constant buffer alignment.
+	template<typename T>
+	UploadAllocation AllocateConstants(u32 count)
+	{
+		return AllocateElements(d3dUtil::CalcConstantBufferByteSize(sizeof(T)), count, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	}
+
+	// count tightly packed elements of T, for structured buffers bound as root SRVs.
+	template<typename T>
+	UploadAllocation AllocateStructured(u32 count)
+	{
+		return AllocateElements(sizeof(T), count, 16);
+	}
+
+	// Frees the memory of every frame the GPU has finished.
+	void Retire() { m_Ring.Retire(); }
+
+	// Everything allocated since the last call is released once the fence reaches fenceValue.
+	void EndFrame(u64 fenceValue) { m_Ring.Commit(fenceValue); }
+
+	ID3D12Resource* Resource() const { return m_UploadBuffer.Get(); }
+
+	u64 GetCapacity() const { return m_Ring.GetCapacity(); }
+	u64 GetUsedBytes() const { return m_Ring.GetUsedBytes(); }
+	u64 GetPeakUsedBytes() const { return m_Ring.GetPeakUsedBytes(); }
+
+private:
+	UploadAllocation AllocateElements(u32 elementStride, u32 count, u64 alignment);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_UploadBuffer;
+	u8* m_MappedData = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS m_GpuAddress = 0;
+
+	FenceTimeline m_Timeline;
+	RingAllocator m_Ring;
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include "EngineCore.h"
+
+// A GPU fence as seen from the CPU. Allocators and frame pacing only need to know how far the GPU
+// has got and to block until it gets further, so they take this instead of a fence and can be
+// driven by a fake timeline without a device.
+class IGpuTimeline
+{
+public:
+	virtual ~IGpuTimeline() = default;
+
+	virtual u64 GetCompletedValue() const = 0;
+
+	// Blocks the calling thread until the timeline reaches value.
+	virtual void Wait(u64 value) = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <cstring>
+#include <string>
+
+// 64 bit FNV-1a, for building content keys. Fast and stable across runs, not cryptographic.
+const u64 c_HashSeed = 14695981039346656037ull;
+
+inline u64 HashBytes(const void* data, u64 size, u64 hash = c_HashSeed)
+{
+	const u8* bytes = (const u8*)data;
+	for (u64 i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Only for types without padding, padding bytes are not stable.
+template<typename T>
+inline u64 HashValue(const T& value, u64 hash = c_HashSeed)
+{
+	return HashBytes(&value, sizeof(T), hash);
+}
+
+// The length goes in first so consecutive strings cannot run into each other.
+inline u64 HashString(const std::string& value, u64 hash = c_HashSeed)
+{
+	hash = HashValue((u64)value.size(), hash);
+	return HashBytes(value.data(), value.size(), hash);
+}
+
+// Accumulates one hash over a sequence of fields.
+class Hasher
+{
+public:
+	template<typename T>
+	void Add(const T& value) { m_Hash = HashValue(value, m_Hash); }
+
+	void AddBytes(const void* data, u64 size)
+	{
+		m_Hash = HashValue(size, m_Hash);
+		m_Hash = HashBytes(data, size, m_Hash);
+	}
+
+	// Null and empty strings hash differently.
+	void AddString(const char* value)
+	{
+		Add(value != nullptr);
+		if (value != nullptr)
+		{
+			AddBytes(value, strlen(value));
+		}
+	}
+
+	u64 GetHash() const { return m_Hash; }
+
+private:
+	u64 m_Hash = c_HashSeed;
+};
@@ -0,0 +1,289 @@
+#include "ImageDecodePool.h"
+
+#include <algorithm>
+
+#include "MappedFile.h"
+#include "MipGenerator.h"
+
+using Microsoft::WRL::ComPtr;
+
+ImageDecodePool::ImageDecodePool(ID3D12Device* device, JobSystem* jobSystem, UploadQueue* uploadQueue, const IGpuTimeline* frameTimeline, ImageDecodeFunc decode)
+	: m_Device(device)
+	, m_UploadQueue(uploadQueue)
+	, m_FrameTimeline(frameTimeline)
+	, m_Decode(decode)
+	, m_Requests(jobSystem, uploadQueue)
+	, m_MaxBuffers(jobSystem->GetThreadCount() * 2)
+{
+}
+
+ImageDecodePool::~ImageDecodePool()
+{
+	m_Requests.WaitForJobs();
+}
+
+std::vector<u8> ImageDecodePool::AcquireBuffer(u64 size)
+{
+	std::vector<u8> buffer;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_Stats.m_BufferAcquires;
+		if (!m_Buffers.empty())
+		{
+			// The smallest buffer that fits, or the largest when none does.
+			auto best = m_Buffers.end() - 1;
+			for (auto it = m_Buffers.begin(); it != m_Buffers.end(); ++it)
+			{
+				const bool fits = it->capacity() >= size;
+				const bool bestFits = best->capacity() >= size;
+				if (fits ? !bestFits || it->capacity() < best->capacity() : !bestFits && it->capacity() > best->capacity())
+				{
+					best = it;
+				}
+			}
+			buffer = std::move(*best);
+			m_Buffers.erase(best);
+			m_Stats.m_PooledBytes -= buffer.capacity();
+		}
+		if (buffer.capacity() < size || buffer.capacity() == 0)
+		{
+			++m_Stats.m_BufferAllocations;
+		}
+	}
+
+	buffer.clear();
+	buffer.reserve((size_t)size);
+	return buffer;
+}
+
+void ImageDecodePool::ReleaseBuffer(std::vector<u8>&& buffer)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.m_PooledBytes += buffer.capacity();
+	m_Buffers.push_back(std::move(buffer));
+
+	// Past the limit the smallest buffer goes, large images are the ones worth keeping memory for.
+	if (m_Buffers.size() > m_MaxBuffers)
+	{
+		auto smallest = std::min_element(m_Buffers.begin(), m_Buffers.end(),
+			[](const std::vector<u8>& a, const std::vector<u8>& b) { return a.capacity() < b.capacity(); });
+		m_Stats.m_PooledBytes -= smallest->capacity();
+		m_Buffers.erase(smallest);
+	}
+}
+
+bool ImageDecodePool::Stage(Request& request)
+{
+	// Files are only mapped, the decoder reads straight from the OS file cache.
+	MappedFile file;
+	const u8* data = request.m_Data.data();
+	u64 size = request.m_Data.size();
+	if (!request.m_Path.empty())
+	{
+		if (!file.Open(request.m_Path))
+		{
+			return false;
+		}
+		data = file.GetData();
+		size = file.GetSize();
+	}
+
+	std::vector<u8> pixels = AcquireBuffer(0);
+	u32 width = 0;
+	u32 height = 0;
+	if (!m_Decode(data, size, width, height, pixels) || width == 0 || height == 0 || pixels.size() < (size_t)width * height * 4)
+	{
+		ReleaseBuffer(std::move(pixels));
+		return false;
+	}
+	file.Close();
+	request.m_Data = std::vector<u8>();
+
+	// The upload queue copies mips larger than its staging ring a band of rows at a time, but one
+	// row of the top mip still has to fit.
+	const u64 rowPitch = ((u64)width * 4 + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(u64)(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+	if (rowPitch > m_UploadQueue->GetStagingSize())
+	{
+		ReleaseBuffer(std::move(pixels));
+		return false;
+	}
+
+	// Tightly packed, the upload queue lays the mips out for the copy. This already runs as a job
+	// per image, so the generator keeps to this thread.
+	const u32 mipCount = GetFullMipCount(width, height);
+	std::vector<MipLevelLayout> levels;
+	const u64 chainSize = GetMipChainLayout(MipFormat::RGBA8_UNorm, width, height, mipCount, 4, 1, levels);
+	std::vector<u8> chain = AcquireBuffer(chainSize);
+	chain.resize((size_t)chainSize);
+
+	MipGenerator generator;
+	generator.Generate(MipFormat::RGBA8_UNorm, MipFilter::Box, pixels.data(), width * 4, chain.data(), levels);
+	ReleaseBuffer(std::move(pixels));
+
+	// Created in COMMON, copy queue writes decay back to it and the first read promotes it.
+	ComPtr<ID3D12Resource> resource;
+	if (FAILED(m_Device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, (UINT16)mipCount),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(resource.GetAddressOf()))))
+	{
+		ReleaseBuffer(std::move(chain));
+		return false;
+	}
+
+	std::vector<D3D12_SUBRESOURCE_DATA> subresources(mipCount);
+	for (u32 mip = 0; mip < mipCount; ++mip)
+	{
+		subresources[mip].pData = chain.data() + levels[mip].m_Offset;
+		subresources[mip].RowPitch = levels[mip].m_RowPitch;
+		subresources[mip].SlicePitch = (LONG_PTR)levels[mip].m_RowPitch * levels[mip].m_Height;
+	}
+
+	// The texels are copied into the staging ring here, so the chain can go straight back.
+	m_UploadQueue->UploadTexture(resource.Get(), 0, mipCount, subresources.data());
+	ReleaseBuffer(std::move(chain));
+
+	request.m_Resource = resource;
+	request.m_Width = width;
+	request.m_Height = height;
+	request.m_MipCount = mipCount;
+	return true;
+}
+
+ImageHandle ImageDecodePool::Dispatch(std::unique_ptr<Request> request)
+{
+	return m_Requests.Dispatch(std::move(request), [this](Request& job)
+	{
+		bool staged = false;
+		try
+		{
+			staged = Stage(job);
+		}
+		catch (...)
+		{
+		}
+
+		if (!staged)
+		{
+			job.m_Data = std::vector<u8>();
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (staged)
+		{
+			++m_Stats.m_Decoded;
+		}
+		else
+		{
+			++m_Stats.m_Failed;
+		}
+		return staged;
+	});
+}
+
+ImageHandle ImageDecodePool::Load(const std::filesystem::path& path, D3D12_CPU_DESCRIPTOR_HANDLE srv)
+{
+	std::unique_ptr<Request> request = std::make_unique<Request>();
+	request->m_Path = path;
+	request->m_Srv = srv;
+	return Dispatch(std::move(request));
+}
+
+ImageHandle ImageDecodePool::Load(std::vector<u8>&& data, D3D12_CPU_DESCRIPTOR_HANDLE srv)
+{
+	std::unique_ptr<Request> request = std::make_unique<Request>();
+	request->m_Data = std::move(data);
+	request->m_Srv = srv;
+	return Dispatch(std::move(request));
+}
+
+void ImageDecodePool::Update()
+{
+	{
+		const u64 completedValue = m_FrameTimeline->GetCompletedValue();
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_RetiredTextures.erase(std::remove_if(m_RetiredTextures.begin(), m_RetiredTextures.end(),
+			[completedValue](const RetiredTexture& retired) { return retired.m_CommitsLeft == 0 && retired.m_FenceValue <= completedValue; }),
+			m_RetiredTextures.end());
+	}
+
+	const bool submitted = m_Requests.Update(
+		[this](ImageHandle, Request& request)
+		{
+			D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+			srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+			srvDesc.Texture2D.MipLevels = request.m_MipCount;
+			srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+			m_Device->CreateShaderResourceView(request.m_Resource.Get(), &srvDesc, request.m_Srv);
+		},
+		[](ImageHandle, Request&) {});
+
+	if (submitted)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_Stats.m_Batches;
+	}
+}
+
+ImageState ImageDecodePool::GetState(ImageHandle handle) const
+{
+	switch (m_Requests.GetState(handle))
+	{
+	case UploadRequestState::Landed:
+		return ImageState::Ready;
+	case UploadRequestState::Failed:
+	case UploadRequestState::FailureReported:
+		return ImageState::Failed;
+	default:
+		return ImageState::Pending;
+	}
+}
+
+ID3D12Resource* ImageDecodePool::GetResource(ImageHandle handle) const
+{
+	return m_Requests.GetState(handle) == UploadRequestState::Landed ? m_Requests[handle].m_Resource.Get() : nullptr;
+}
+
+u32 ImageDecodePool::GetWidth(ImageHandle handle) const
+{
+	assert(GetState(handle) == ImageState::Ready);
+	return m_Requests[handle].m_Width;
+}
+
+u32 ImageDecodePool::GetHeight(ImageHandle handle) const
+{
+	assert(GetState(handle) == ImageState::Ready);
+	return m_Requests[handle].m_Height;
+}
+
+void ImageDecodePool::Release(ImageHandle handle)
+{
+	if (m_Requests.GetState(handle) == UploadRequestState::Landed)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_RetiredTextures.push_back({ std::move(m_Requests[handle].m_Resource), 2, 0 });
+	}
+	m_Requests.Release(handle);
+}
+
+void ImageDecodePool::Commit(u64 fenceValue)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (RetiredTexture& retired : m_RetiredTextures)
+	{
+		if (retired.m_CommitsLeft > 0 && --retired.m_CommitsLeft == 0)
+		{
+			retired.m_FenceValue = fenceValue;
+		}
+	}
+}
+
+ImageDecodePoolStats ImageDecodePool::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <filesystem>
+#include <mutex>
+
+#include "d3dUtil.h"
+#include "GpuTimeline.h"
+#include "JobSystem.h"
+#include "UploadQueue.h"
+#include "UploadRequestList.h"
+
+typedef u32 ImageHandle;
+
+enum class ImageState : u32
+{
+	// Decoding, or waiting for its copy to land.
+	Pending = 0,
+	Ready,
+	Failed,
+};
+
+// Decodes an encoded image such as a PNG or JPEG into tightly packed RGBA8. pixels comes from the
+// pool's buffers, so resizing it within its capacity costs nothing. Called from worker threads.
+typedef bool (*ImageDecodeFunc)(const u8* data, u64 size, u32& width, u32& height, std::vector<u8>& pixels);
+
+struct ImageDecodePoolStats
+{
+	u32 m_Decoded = 0;
+	u32 m_Failed = 0;
+
+	// Decode and mip buffers taken from the pool, and how many of those were new or too small for
+	// the size asked for.
+	u32 m_BufferAcquires = 0;
+	u32 m_BufferAllocations = 0;
+	u64 m_PooledBytes = 0;
+
+	// Upload batches submitted, each carrying every image staged since the one before.
+	u32 m_Batches = 0;
+};
+
+// Loads UI and editor images in the background. Each image is read, decoded and given a box
+// filtered mip chain by a job, in buffers reused from one image to the next, and staged into the
+// upload queue. Update sends everything staged since the last call as one batch and marks images
+// whose batch has landed as ready, writing their shader resource view then, so the UI can poll a
+// handle every frame and draw the image as soon as it is ready without ever waiting on it.
+// Load, Update and Release must not be called from more than one thread at a time, Commit can be
+// called from another.
+class ImageDecodePool
+{
+public:
+	// frameTimeline is the fence the render thread signals once per frame.
+	ImageDecodePool(ID3D12Device* device, JobSystem* jobSystem, UploadQueue* uploadQueue, const IGpuTimeline* frameTimeline, ImageDecodeFunc decode);
+	ImageDecodePool(const ImageDecodePool& rhs) = delete;
+	ImageDecodePool& operator=(const ImageDecodePool& rhs) = delete;
+
+	// Waits for jobs still decoding. The GPU must be done with every texture.
+	~ImageDecodePool();
+
+	// srv must stay valid, and unused by the GPU, until the image is ready or has failed.
+	ImageHandle Load(const std::filesystem::path& path, D3D12_CPU_DESCRIPTOR_HANDLE srv);
+
+	// Takes ownership of an encoded image already in memory.
+	ImageHandle Load(std::vector<u8>&& data, D3D12_CPU_DESCRIPTOR_HANDLE srv);
+
+	// Call once per frame.
+	void Update();
+
+	ImageState GetState(ImageHandle handle) const;
+
+	// Valid once ready.
+	ID3D12Resource* GetResource(ImageHandle handle) const;
+	u32 GetWidth(ImageHandle handle) const;
+	u32 GetHeight(ImageHandle handle) const;
+
+	// Lets the pool reuse the handle. A ready image's texture is kept until the frames that may
+	// still draw it are done, see Commit. Pending images are released once their job and copy
+	// have finished with them.
+	void Release(ImageHandle handle);
+
+	// Call after signalling fenceValue at the end of each frame. An image released while the UI of
+	// one frame is built can still be drawn by the frame rendering at the time and by that one, so
+	// textures wait for two commits.
+	void Commit(u64 fenceValue);
+
+	bool IsIdle() const { return m_Requests.IsIdle(); }
+
+	ImageDecodePoolStats GetStats() const;
+
+private:
+	struct Request : UploadRequest
+	{
+		std::filesystem::path m_Path;
+		std::vector<u8> m_Data;
+		D3D12_CPU_DESCRIPTOR_HANDLE m_Srv = {};
+
+		u32 m_Width = 0;
+		u32 m_Height = 0;
+		u32 m_MipCount = 0;
+	};
+
+	// The texture of a released image, freed once m_CommitsLeft reaches 0 and the timeline passes
+	// m_FenceValue.
+	struct RetiredTexture
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_Resource;
+		u32 m_CommitsLeft;
+		u64 m_FenceValue;
+	};
+
+	ImageHandle Dispatch(std::unique_ptr<Request> request);
+
+	// Returns false when the image could not be decoded or created.
+	bool Stage(Request& request);
+
+	std::vector<u8> AcquireBuffer(u64 size);
+	void ReleaseBuffer(std::vector<u8>&& buffer);
+
+	ID3D12Device* m_Device;
+	UploadQueue* m_UploadQueue;
+	const IGpuTimeline* m_FrameTimeline;
+	ImageDecodeFunc m_Decode;
+
+	UploadRequestList<Request> m_Requests;
+
+	// Buffers free for the next job, at most m_MaxBuffers. m_Mutex guards m_Stats and
+	// m_RetiredTextures too.
+	std::vector<std::vector<u8>> m_Buffers;
+	u32 m_MaxBuffers;
+	mutable std::mutex m_Mutex;
+
+	ImageDecodePoolStats m_Stats;
+	std::vector<RetiredTexture> m_RetiredTextures;
+};
@@ -0,0 +1,175 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Set while this thread executes a job, to catch waits from inside one.
+	thread_local bool t_RunningJob = false;
+}
+
+JobSystem::JobSystem(u32 workerThreadCount)
+	: m_OwnerThread(std::this_thread::get_id())
+{
+	if (workerThreadCount == 0)
+	{
+		u32 cores = std::thread::hardware_concurrency();
+		workerThreadCount = cores > 1 ? cores - 1 : 1;
+	}
+
+	m_Threads.reserve(workerThreadCount);
+	for (u32 i = 0; i < workerThreadCount; ++i)
+	{
+		m_Threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		m_Exit = true;
+	}
+	m_QueueCondition.notify_all();
+
+	for (std::thread& thread : m_Threads)
+	{
+		thread.join();
+	}
+}
+
+void JobSystem::Dispatch(JobCounter& counter, JobFunc job)
+{
+	counter.m_Pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		m_Queue.push_back({ std::move(job), &counter });
+	}
+	m_QueueCondition.notify_one();
+	m_CompleteCondition.notify_all();
+}
+
+void JobSystem::DispatchRange(JobCounter& counter, u32 count, std::function<void(u32 index, u32 workerIndex)> job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	counter.m_Pending.fetch_add(count, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		for (u32 i = 0; i < count; ++i)
+		{
+			m_Queue.push_back({ [job, i](u32 workerIndex) { job(i, workerIndex); }, &counter });
+		}
+	}
+	m_QueueCondition.notify_all();
+	m_CompleteCondition.notify_all();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	ASSERTMSG(!t_RunningJob, "Jobs must not wait on other jobs");
+	if (IsFinished(counter))
+	{
+		return;
+	}
+
+	const bool isOwner = std::this_thread::get_id() == m_OwnerThread;
+	const u32 workerIndex = isOwner ? (u32)m_Threads.size() : AcquireScratchIndex();
+	if (workerIndex == c_NoWorkerIndex)
+	{
+		// The worker threads never wait, so they still drain the queue.
+		std::unique_lock<std::mutex> lock(m_QueueMutex);
+		m_CompleteCondition.wait(lock, [&]() { return IsFinished(counter); });
+		return;
+	}
+
+	while (!IsFinished(counter))
+	{
+		if (!TryRunOne(workerIndex))
+		{
+			std::unique_lock<std::mutex> lock(m_QueueMutex);
+			m_CompleteCondition.wait(lock, [&]() { return IsFinished(counter) || !m_Queue.empty(); });
+		}
+	}
+
+	if (!isOwner)
+	{
+		ReleaseScratchIndex(workerIndex);
+	}
+}
+
+u32 JobSystem::AcquireScratchIndex()
+{
+	u32 free = m_FreeScratch.load(std::memory_order_relaxed);
+	while (free != 0)
+	{
+		u32 slot = 0;
+		while ((free & (1u << slot)) == 0)
+		{
+			++slot;
+		}
+
+		if (m_FreeScratch.compare_exchange_weak(free, free & ~(1u << slot), std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			return GetThreadCount() + slot;
+		}
+	}
+	return c_NoWorkerIndex;
+}
+
+void JobSystem::ReleaseScratchIndex(u32 workerIndex)
+{
+	m_FreeScratch.fetch_or(1u << (workerIndex - GetThreadCount()), std::memory_order_release);
+}
+
+void JobSystem::WorkerLoop(u32 workerIndex)
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_QueueMutex);
+			m_QueueCondition.wait(lock, [this]() { return m_Exit || !m_Queue.empty(); });
+			if (m_Queue.empty())
+			{
+				return;
+			}
+			job = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+		Execute(job, workerIndex);
+	}
+}
+
+bool JobSystem::TryRunOne(u32 workerIndex)
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		if (m_Queue.empty())
+		{
+			return false;
+		}
+		job = std::move(m_Queue.front());
+		m_Queue.pop_front();
+	}
+	Execute(job, workerIndex);
+	return true;
+}
+
+void JobSystem::Execute(Job& job, u32 workerIndex)
+{
+	t_RunningJob = true;
+	job.m_Func(workerIndex);
+	t_RunningJob = false;
+
+	if (job.m_Counter->m_Pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		// Take the lock so a waiter cannot miss the wake-up between its check and its wait.
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		m_CompleteCondition.notify_all();
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Job entry point. workerIndex is in [0, JobSystem::GetWorkerCount()) and is stable for
+// the duration of the job, so it can be used to index per-worker resources.
+typedef std::function<void(u32 workerIndex)> JobFunc;
+
+// Tracks a group of dispatched jobs so the caller can wait for all of them.
+struct JobCounter
+{
+	std::atomic<u32> m_Pending = 0;
+};
+
+// Fixed size pool of worker threads pulling jobs from a shared queue.
+// Any thread waiting on a counter executes queued jobs meanwhile. The thread that creates the
+// JobSystem does so under its own worker index, right after the worker threads'. Other threads
+// borrow one of a few scratch indices after that, or sleep when every one is taken. Jobs must
+// not wait: with every worker waiting inside a job nothing would be left to run the queue.
+class JobSystem
+{
+public:
+	// workerThreadCount == 0 picks one thread per hardware core, minus the owning thread.
+	JobSystem(u32 workerThreadCount = 0);
+	JobSystem(const JobSystem& rhs) = delete;
+	JobSystem& operator=(const JobSystem& rhs) = delete;
+	~JobSystem();
+
+	// Number of distinct worker indices, including the owning thread's and the scratch ones.
+	u32 GetWorkerCount() const { return GetThreadCount() + c_ScratchWorkerCount; }
+
+	// Threads that run jobs when only the owning thread waits: the workers and itself.
+	u32 GetThreadCount() const { return (u32)m_Threads.size() + 1; }
+
+	void Dispatch(JobCounter& counter, JobFunc job);
+
+	// Runs count jobs, job(index, workerIndex) for index in [0, count).
+	void DispatchRange(JobCounter& counter, u32 count, std::function<void(u32 index, u32 workerIndex)> job);
+
+	// Blocks until every job dispatched against counter has finished, executing queued jobs
+	// meanwhile. Can be called from any thread but not from inside a job.
+	void Wait(JobCounter& counter);
+
+	bool IsFinished(const JobCounter& counter) const { return counter.m_Pending.load(std::memory_order_acquire) == 0; }
+
+private:
+
+	struct Job
+	{
+		JobFunc m_Func;
+		JobCounter* m_Counter;
+	};
+
+	static constexpr u32 c_NoWorkerIndex = ~0u;
+	static constexpr u32 c_ScratchWorkerCount = 4;
+
+	void WorkerLoop(u32 workerIndex);
+	bool TryRunOne(u32 workerIndex);
+	void Execute(Job& job, u32 workerIndex);
+
+	u32 AcquireScratchIndex();
+	void ReleaseScratchIndex(u32 workerIndex);
+
+	std::vector<std::thread> m_Threads;
+	std::thread::id m_OwnerThread;
+
+	// One bit per scratch index not lent out.
+	std::atomic<u32> m_FreeScratch = (1u << c_ScratchWorkerCount) - 1;
+
+	std::mutex m_QueueMutex;
+	std::condition_variable m_QueueCondition;
+	std::condition_variable m_CompleteCondition;
+	std::deque<Job> m_Queue;
+	bool m_Exit = false;
+};
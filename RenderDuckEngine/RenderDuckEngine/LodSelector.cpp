@@ -0,0 +1,129 @@
+#include "LodSelector.h"
+
+#include <cfloat>
+#include <emmintrin.h>
+
+namespace
+{
+	// Items closer than this, or with the eye inside their bounds, always project a huge error.
+	const float c_MinLodDistance = 1e-3f;
+}
+
+u32 LodSelector::AddItem(const LodSet* lodSet)
+{
+	assert(lodSet != nullptr);
+	ASSERTMSG(!lodSet->m_Levels.empty() && lodSet->m_Levels.size() <= c_MaxLodLevels, "LOD set needs between 1 and c_MaxLodLevels levels");
+
+	const u32 item = (u32)m_Sets.size();
+	m_Sets.push_back(lodSet);
+	Pad();
+
+	m_LevelCount[item] = (float)lodSet->m_Levels.size();
+	for (u32 level = 0; level < (u32)lodSet->m_Levels.size(); ++level)
+	{
+		// Selection counts the levels under the threshold, which only works if errors increase.
+		ASSERTMSG(level == 0 || lodSet->m_Levels[level].m_GeometricError >= lodSet->m_Levels[level - 1].m_GeometricError,
+			"LOD levels must be ordered from finest to coarsest");
+		m_LevelError[level][item] = lodSet->m_Levels[level].m_GeometricError;
+	}
+
+	return item;
+}
+
+void LodSelector::Pad()
+{
+	const size_t paddedCount = (m_Sets.size() + 3) & ~(size_t)3;
+	if (m_CenterX.size() >= paddedCount)
+	{
+		return;
+	}
+
+	// Padding items have a single level, so they always select level 0.
+	m_CenterX.resize(paddedCount, 0.0f);
+	m_CenterY.resize(paddedCount, 0.0f);
+	m_CenterZ.resize(paddedCount, 0.0f);
+	m_Radius.resize(paddedCount, 0.0f);
+	m_Scale.resize(paddedCount, 1.0f);
+	m_LevelCount.resize(paddedCount, 1.0f);
+	for (std::vector<float>& errors : m_LevelError)
+	{
+		errors.resize(paddedCount, FLT_MAX);
+	}
+	for (u32 view = 0; view < (u32)LodView::Count; ++view)
+	{
+		m_State[view].resize(paddedCount, 0);
+		m_Selected[view].resize(paddedCount, 0);
+	}
+}
+
+void LodSelector::SetItemBounds(u32 item, const DirectX::XMFLOAT3& centerW, float radius, float scale)
+{
+	assert(item < m_Sets.size());
+
+	m_CenterX[item] = centerW.x;
+	m_CenterY[item] = centerW.y;
+	m_CenterZ[item] = centerW.z;
+	m_Radius[item] = radius;
+	m_Scale[item] = scale;
+}
+
+const LodDrawArgs& LodSelector::GetSelectedDrawArgs(LodView view, u32 item) const
+{
+	return m_Sets[item]->m_Levels[m_Selected[(u32)view][item]].m_DrawArgs;
+}
+
+void LodSelector::Select(LodView view, const LodViewParams& params)
+{
+	std::vector<s32>& state = m_State[(u32)view];
+	std::vector<s32>& selected = m_Selected[(u32)view];
+
+	const __m128 eyeX = _mm_set1_ps(params.m_EyePosW.x);
+	const __m128 eyeY = _mm_set1_ps(params.m_EyePosW.y);
+	const __m128 eyeZ = _mm_set1_ps(params.m_EyePosW.z);
+	const __m128 minDistance = _mm_set1_ps(c_MinLodDistance);
+	const __m128 projectionScale = _mm_set1_ps(params.m_ProjectionScale);
+	const __m128 threshold = _mm_set1_ps(params.m_ErrorThreshold);
+	const __m128 coarserThreshold = _mm_set1_ps(params.m_ErrorThreshold * (1.0f - params.m_Hysteresis));
+	const __m128 bias = _mm_set1_ps((float)params.m_LodBias);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (size_t i = 0; i < m_CenterX.size(); i += 4)
+	{
+		const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&m_CenterX[i]), eyeX);
+		const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&m_CenterY[i]), eyeY);
+		const __m128 dz = _mm_sub_ps(_mm_loadu_ps(&m_CenterZ[i]), eyeZ);
+		const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+		// Distance to the nearest point of the bounds, so large items refine as soon as any part is close.
+		const __m128 distance = _mm_max_ps(_mm_sub_ps(_mm_sqrt_ps(distSq), _mm_loadu_ps(&m_Radius[i])), minDistance);
+		const __m128 errorScale = _mm_mul_ps(projectionScale, _mm_loadu_ps(&m_Scale[i]));
+		const __m128 current = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)&state[i]));
+
+		// Errors increase with the level, so the selected level is the number of coarser levels
+		// whose projected error is under the threshold. Levels coarser than the current one have
+		// to beat the lower threshold, which gives the hysteresis.
+		__m128 level = _mm_setzero_ps();
+		for (u32 l = 1; l < c_MaxLodLevels; ++l)
+		{
+			const __m128 projectedError = _mm_mul_ps(_mm_loadu_ps(&m_LevelError[l][i]), errorScale);
+			const __m128 coarser = _mm_cmpgt_ps(_mm_set1_ps((float)l), current);
+			const __m128 levelThreshold = _mm_or_ps(_mm_and_ps(coarser, coarserThreshold), _mm_andnot_ps(coarser, threshold));
+			const __m128 accept = _mm_cmple_ps(projectedError, _mm_mul_ps(levelThreshold, distance));
+			level = _mm_add_ps(level, _mm_and_ps(accept, one));
+		}
+		_mm_storeu_si128((__m128i*)&state[i], _mm_cvttps_epi32(level));
+
+		const __m128 lastLevel = _mm_sub_ps(_mm_loadu_ps(&m_LevelCount[i]), one);
+		const __m128 biased = _mm_min_ps(_mm_add_ps(level, bias), lastLevel);
+		_mm_storeu_si128((__m128i*)&selected[i], _mm_cvttps_epi32(biased));
+	}
+
+	LodStats& stats = m_Stats[(u32)view];
+	stats = LodStats();
+	for (u32 item = 0; item < (u32)m_Sets.size(); ++item)
+	{
+		const std::vector<LodLevel>& levels = m_Sets[item]->m_Levels;
+		stats.m_FullDetailTriangles += levels[0].m_DrawArgs.m_IndexCount / 3;
+		stats.m_SelectedTriangles += levels[selected[item]].m_DrawArgs.m_IndexCount / 3;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "EngineCore.h"
+
+const u32 c_MaxLodLevels = 4;
+
+// Views that select their own LOD each frame.
+enum class LodView : u32
+{
+	Main = 0,
+	Shadow,
+	Count
+};
+
+// DrawIndexedInstanced parameters for one level of detail.
+struct LodDrawArgs
+{
+	u32 m_IndexCount = 0;
+	u32 m_StartIndexLocation = 0;
+	s32 m_BaseVertexLocation = 0;
+};
+
+struct LodLevel
+{
+	LodDrawArgs m_DrawArgs;
+
+	// Largest distance, in object space units, between this level and the full detail surface.
+	float m_GeometricError = 0.0f;
+};
+
+// Levels of one mesh, level 0 is full detail and each following level is coarser.
+struct LodSet
+{
+	std::vector<LodLevel> m_Levels;
+};
+
+struct LodViewParams
+{
+	DirectX::XMFLOAT3 m_EyePosW;
+
+	// Pixels per world unit at a distance of one: viewportHeight / (2 * tan(fovY / 2)).
+	float m_ProjectionScale = 1.0f;
+
+	// A level is used once its projected error is at most this many pixels.
+	float m_ErrorThreshold = 1.0f;
+
+	// Fraction the error has to drop below the threshold before switching to a coarser level,
+	// stops items near a threshold flickering between two levels.
+	float m_Hysteresis = 0.2f;
+
+	// Extra levels added after selection, for views that can get away with less detail.
+	u32 m_LodBias = 0;
+};
+
+struct LodStats
+{
+	u32 m_FullDetailTriangles = 0;
+	u32 m_SelectedTriangles = 0;
+
+	u32 GetTrianglesSaved() const { return m_FullDetailTriangles - m_SelectedTriangles; }
+};
+
+// Picks a level of detail per item and view from the projected screen space error of each level.
+// Item data is stored as structure of arrays and selection runs four items at a time with SSE.
+class LodSelector
+{
+public:
+	u32 AddItem(const LodSet* lodSet);
+
+	// World space bounding sphere, and the world scale applied to the object space errors.
+	void SetItemBounds(u32 item, const DirectX::XMFLOAT3& centerW, float radius, float scale);
+
+	void Select(LodView view, const LodViewParams& params);
+
+	u32 GetSelectedLevel(LodView view, u32 item) const { return (u32)m_Selected[(u32)view][item]; }
+	const LodDrawArgs& GetSelectedDrawArgs(LodView view, u32 item) const;
+	const LodStats& GetStats(LodView view) const { return m_Stats[(u32)view]; }
+
+	u32 GetItemCount() const { return (u32)m_Sets.size(); }
+
+private:
+	void Pad();
+
+	std::vector<const LodSet*> m_Sets;
+
+	// Padded to a multiple of four items so selection never needs a scalar tail.
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_Radius;
+	std::vector<float> m_Scale;
+	std::vector<float> m_LevelCount;
+	std::vector<float> m_LevelError[c_MaxLodLevels];
+
+	// Selection before the view's bias is applied, fed back in for hysteresis.
+	std::vector<s32> m_State[(u32)LodView::Count];
+	std::vector<s32> m_Selected[(u32)LodView::Count];
+
+	LodStats m_Stats[(u32)LodView::Count];
+};
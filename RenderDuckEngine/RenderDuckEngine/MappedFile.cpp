@@ -0,0 +1,148 @@
+#include "MappedFile.h"
+
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_File = file;
+	m_Mapping = mapping;
+	m_Data = (const u8*)data;
+	m_Size = (u64)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data != nullptr)
+	{
+		UnmapViewOfFile(m_Data);
+		CloseHandle(m_Mapping);
+		CloseHandle(m_File);
+	}
+
+	m_File = nullptr;
+	m_Mapping = nullptr;
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (data == MAP_FAILED)
+	{
+		close(file);
+		return false;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	close(file);
+
+	m_Data = (const u8*)data;
+	m_Size = (u64)info.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data != nullptr)
+	{
+		munmap((void*)m_Data, m_Size);
+	}
+
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+#endif
+
+bool WriteFileAtomic(const std::filesystem::path& path, const void* header, u64 headerSize, const void* data, u64 dataSize)
+{
+	// The temporary name is per thread, so two threads writing the same path do not share it.
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	bool written = false;
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write((const char*)header, headerSize);
+		file.write((const char*)data, dataSize);
+		written = (bool)file;
+	}
+
+	std::error_code error;
+	if (written)
+	{
+		std::filesystem::rename(tempPath, path, error);
+	}
+	if (!written || error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <filesystem>
+
+// Read only view of a whole file mapped into memory. Pages are read in on first access and
+// shared with the OS file cache, so nothing is copied.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	// Returns false if the file does not exist or cannot be mapped. Empty files cannot be mapped.
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	bool IsOpen() const { return m_Data != nullptr; }
+	const u8* GetData() const { return m_Data; }
+	u64 GetSize() const { return m_Size; }
+
+private:
+	// File and mapping handles, only kept open on Windows.
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+
+	const u8* m_Data = nullptr;
+	u64 m_Size = 0;
+};
+
+// Writes header followed by data to a temporary file and renames it over path, so a crash or a
+// concurrent writer never leaves a partial file behind. Either part can be empty. Returns false if
+// the file could not be written, in which case path is left as it was.
+bool WriteFileAtomic(const std::filesystem::path& path, const void* header, u64 headerSize, const void* data, u64 dataSize);
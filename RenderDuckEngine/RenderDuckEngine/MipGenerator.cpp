@@ -0,0 +1,557 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+#include <intrin.h>
+
+#include "JobSystem.h"
+
+namespace
+{
+	// Destination rows filtered by one job.
+	const u32 c_RowsPerBand = 32;
+
+	// The Kaiser filter reads source texels 2x - 2 to 2x + 3 for destination texel x. Its window
+	// is measured in destination texels.
+	const u32 c_KaiserTaps = 6;
+	const float c_KaiserAlpha = 4.0f;
+	const float c_KaiserRadius = 1.5f;
+
+	const u32 c_MaxTaps = c_KaiserTaps;
+
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (u32 k = 1; k < 20; ++k)
+		{
+			const float half = x / (2.0f * k);
+			term *= half * half;
+			sum += term;
+		}
+		return sum;
+	}
+
+	float Sinc(float x)
+	{
+		const float pi = 3.14159265358979f;
+		return x == 0.0f ? 1.0f : sinf(pi * x) / (pi * x);
+	}
+
+	float FromSrgb(float srgb)
+	{
+		return srgb <= 0.04045f ? srgb / 12.92f : powf((srgb + 0.055f) / 1.055f, 2.4f);
+	}
+
+	struct Tables
+	{
+		float m_SrgbToLinear[256];
+
+		// Linear values half way between two sRGB steps, a value encodes to the number it reaches.
+		float m_SrgbThresholds[255];
+
+		float m_KaiserWeights[c_KaiserTaps];
+		float m_BoxWeights[2];
+
+		Tables()
+		{
+			for (u32 i = 0; i < 256; ++i)
+			{
+				m_SrgbToLinear[i] = FromSrgb(i / 255.0f);
+			}
+			for (u32 i = 0; i < 255; ++i)
+			{
+				m_SrgbThresholds[i] = FromSrgb((i + 0.5f) / 255.0f);
+			}
+
+			float sum = 0.0f;
+			for (u32 k = 0; k < c_KaiserTaps; ++k)
+			{
+				// Source texel centres relative to the destination texel centre, in destination texels.
+				const float t = ((float)k - 2.5f) * 0.5f;
+				const float window = t / c_KaiserRadius;
+				m_KaiserWeights[k] = Sinc(t) * BesselI0(c_KaiserAlpha * sqrtf(std::max(0.0f, 1.0f - window * window))) / BesselI0(c_KaiserAlpha);
+				sum += m_KaiserWeights[k];
+			}
+			for (float& weight : m_KaiserWeights)
+			{
+				weight /= sum;
+			}
+
+			m_BoxWeights[0] = 0.5f;
+			m_BoxWeights[1] = 0.5f;
+		}
+	};
+
+	const Tables& GetTables()
+	{
+		static const Tables tables;
+		return tables;
+	}
+
+	bool IsAvxSupported()
+	{
+		int info[4];
+		__cpuid(info, 1);
+		const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+		return osSavesYmm && (info[2] & (1 << 28)) != 0;
+	}
+
+	u32 GetChannelCount(MipFormat format)
+	{
+		return format == MipFormat::R16_UNorm ? 1 : 4;
+	}
+
+	float HalfToFloat(u16 half)
+	{
+		const u32 sign = (u32)(half & 0x8000) << 16;
+		const u32 exponent = (half >> 10) & 0x1f;
+		const u32 mantissa = half & 0x3ff;
+
+		if (exponent == 0)
+		{
+			const float value = ldexpf((float)mantissa, -24);
+			return sign != 0 ? -value : value;
+		}
+
+		const u32 bits = exponent == 31 ?
+			sign | 0x7f800000 | (mantissa << 13) :
+			sign | ((exponent + 112) << 23) | (mantissa << 13);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// Rounds to nearest even, like the hardware conversion.
+	u16 FloatToHalf(float value)
+	{
+		u32 bits;
+		memcpy(&bits, &value, sizeof(bits));
+		const u32 sign = (bits >> 16) & 0x8000;
+		bits &= 0x7fffffff;
+
+		if (bits >= 0x7f800000)
+		{
+			return (u16)(sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0));
+		}
+		if (bits >= 0x477ff000)
+		{
+			return (u16)(sign | 0x7c00);
+		}
+
+		u32 half;
+		u32 remainder;
+		u32 halfway;
+		if (bits < 0x38800000)
+		{
+			// Subnormal, anything up to 2^-25 rounds to zero.
+			if (bits <= 0x33000000)
+			{
+				return (u16)sign;
+			}
+			const u32 shift = 126 - (bits >> 23);
+			const u32 mantissa = (bits & 0x7fffff) | 0x800000;
+			half = mantissa >> shift;
+			remainder = mantissa & ((1u << shift) - 1);
+			halfway = 1u << (shift - 1);
+		}
+		else
+		{
+			half = (bits - 0x38000000) >> 13;
+			remainder = bits & 0x1fff;
+			halfway = 0x1000;
+		}
+
+		if (remainder > halfway || (remainder == halfway && (half & 1) != 0))
+		{
+			++half;
+		}
+		return (u16)(sign | half);
+	}
+
+	void DecodeRow(MipFormat format, const u8* src, u32 width, float* dst)
+	{
+		const Tables& tables = GetTables();
+		switch (format)
+		{
+		case MipFormat::RGBA8_UNorm:
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+			for (u32 x = 0; x < width; ++x)
+			{
+				s32 pixel;
+				memcpy(&pixel, src + x * 4, sizeof(pixel));
+				const __m128i bytes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero), zero);
+				_mm_storeu_ps(dst + x * 4, _mm_mul_ps(_mm_cvtepi32_ps(bytes), scale));
+			}
+			break;
+		}
+
+		case MipFormat::RGBA8_UNorm_SRGB:
+			for (u32 x = 0; x < width; ++x)
+			{
+				const u8* pixel = src + x * 4;
+				_mm_storeu_ps(dst + x * 4, _mm_setr_ps(tables.m_SrgbToLinear[pixel[0]], tables.m_SrgbToLinear[pixel[1]],
+					tables.m_SrgbToLinear[pixel[2]], pixel[3] / 255.0f));
+			}
+			break;
+
+		case MipFormat::RGBA16_Float:
+			for (u32 i = 0; i < width * 4; ++i)
+			{
+				u16 half;
+				memcpy(&half, src + i * 2, sizeof(half));
+				dst[i] = HalfToFloat(half);
+			}
+			break;
+
+		case MipFormat::R16_UNorm:
+			for (u32 x = 0; x < width; ++x)
+			{
+				u16 value;
+				memcpy(&value, src + x * 2, sizeof(value));
+				dst[x] = value / 65535.0f;
+			}
+			break;
+		}
+	}
+
+	void EncodeRow(MipFormat format, const float* src, u32 width, u8* dst)
+	{
+		const Tables& tables = GetTables();
+		switch (format)
+		{
+		case MipFormat::RGBA8_UNorm:
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 scale = _mm_set1_ps(255.0f);
+			const __m128 round = _mm_set1_ps(0.5f);
+			for (u32 x = 0; x < width; ++x)
+			{
+				const __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + x * 4), zero), one);
+				const __m128i ints = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), round));
+				const __m128i words = _mm_packs_epi32(ints, ints);
+				const s32 pixel = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+				memcpy(dst + x * 4, &pixel, sizeof(pixel));
+			}
+			break;
+		}
+
+		case MipFormat::RGBA8_UNorm_SRGB:
+			for (u32 x = 0; x < width; ++x)
+			{
+				const float* pixel = src + x * 4;
+				for (u32 c = 0; c < 3; ++c)
+				{
+					dst[x * 4 + c] = (u8)(std::upper_bound(tables.m_SrgbThresholds, tables.m_SrgbThresholds + 255, pixel[c]) - tables.m_SrgbThresholds);
+				}
+				dst[x * 4 + 3] = (u8)(std::min(std::max(pixel[3], 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+			break;
+
+		case MipFormat::RGBA16_Float:
+			for (u32 i = 0; i < width * 4; ++i)
+			{
+				const u16 half = FloatToHalf(src[i]);
+				memcpy(dst + i * 2, &half, sizeof(half));
+			}
+			break;
+
+		case MipFormat::R16_UNorm:
+			for (u32 x = 0; x < width; ++x)
+			{
+				const u16 value = (u16)(std::min(std::max(src[x], 0.0f), 1.0f) * 65535.0f + 0.5f);
+				memcpy(dst + x * 2, &value, sizeof(value));
+			}
+			break;
+		}
+	}
+
+	// dst[i] = sum of weights[k] * rows[k][i].
+	void WeightedSumAvx(const float* const* rows, const float* weights, u32 taps, u32 count, float* dst, u32& i)
+	{
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 sum = _mm256_mul_ps(_mm256_loadu_ps(rows[0] + i), _mm256_set1_ps(weights[0]));
+			for (u32 k = 1; k < taps; ++k)
+			{
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(weights[k])));
+			}
+			_mm256_storeu_ps(dst + i, sum);
+		}
+	}
+
+	void WeightedSum(const float* const* rows, const float* weights, u32 taps, u32 count, float* dst, bool useAvx)
+	{
+		u32 i = 0;
+		if (useAvx)
+		{
+			WeightedSumAvx(rows, weights, taps, count, dst, i);
+		}
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 sum = _mm_mul_ps(_mm_loadu_ps(rows[0] + i), _mm_set1_ps(weights[0]));
+			for (u32 k = 1; k < taps; ++k)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+			}
+			_mm_storeu_ps(dst + i, sum);
+		}
+
+		for (; i < count; ++i)
+		{
+			float sum = 0.0f;
+			for (u32 k = 0; k < taps; ++k)
+			{
+				sum += rows[k][i] * weights[k];
+			}
+			dst[i] = sum;
+		}
+	}
+
+	void HalveRgbaAvx(const float* src, u32 dstWidth, float* dst, u32& x)
+	{
+		// Two destination texels from four source texels per iteration.
+		const __m256 half = _mm256_set1_ps(0.5f);
+		for (; x + 2 <= dstWidth; x += 2)
+		{
+			const __m256 a = _mm256_loadu_ps(src + x * 8);
+			const __m256 b = _mm256_loadu_ps(src + x * 8 + 8);
+			const __m256 even = _mm256_permute2f128_ps(a, b, 0x20);
+			const __m256 odd = _mm256_permute2f128_ps(a, b, 0x31);
+			_mm256_storeu_ps(dst + x * 4, _mm256_mul_ps(_mm256_add_ps(even, odd), half));
+		}
+	}
+
+	// Box filter along the row. Only called with srcWidth > 1, so texel 2x + 1 always exists.
+	void HalveRow(const float* src, u32 channels, u32 dstWidth, float* dst, bool useAvx)
+	{
+		const __m128 half = _mm_set1_ps(0.5f);
+		u32 x = 0;
+		if (channels == 4)
+		{
+			if (useAvx)
+			{
+				HalveRgbaAvx(src, dstWidth, dst, x);
+			}
+			for (; x < dstWidth; ++x)
+			{
+				_mm_storeu_ps(dst + x * 4, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(src + x * 8), _mm_loadu_ps(src + x * 8 + 4)), half));
+			}
+			return;
+		}
+
+		for (; x + 4 <= dstWidth; x += 4)
+		{
+			const __m128 a = _mm_loadu_ps(src + x * 2);
+			const __m128 b = _mm_loadu_ps(src + x * 2 + 4);
+			const __m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_ps(dst + x, _mm_mul_ps(_mm_add_ps(even, odd), half));
+		}
+		for (; x < dstWidth; ++x)
+		{
+			dst[x] = (src[x * 2] + src[x * 2 + 1]) * 0.5f;
+		}
+	}
+
+	// Kaiser filter along the row, clamping at the edges.
+	void KaiserRow(const float* src, u32 srcWidth, u32 channels, u32 dstWidth, float* dst)
+	{
+		const float* weights = GetTables().m_KaiserWeights;
+		for (u32 x = 0; x < dstWidth; ++x)
+		{
+			const s32 first = (s32)x * 2 - 2;
+			const bool interior = first >= 0 && first + (s32)c_KaiserTaps <= (s32)srcWidth;
+			if (channels == 4)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (u32 k = 0; k < c_KaiserTaps; ++k)
+				{
+					const u32 texel = interior ? first + k : (u32)std::min(std::max(first + (s32)k, 0), (s32)srcWidth - 1);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + texel * 4), _mm_set1_ps(weights[k])));
+				}
+				_mm_storeu_ps(dst + x * 4, sum);
+			}
+			else
+			{
+				float sum = 0.0f;
+				for (u32 k = 0; k < c_KaiserTaps; ++k)
+				{
+					const u32 texel = interior ? first + k : (u32)std::min(std::max(first + (s32)k, 0), (s32)srcWidth - 1);
+					sum += src[texel] * weights[k];
+				}
+				dst[x] = sum;
+			}
+		}
+	}
+}
+
+u32 GetMipFormatPixelSize(MipFormat format)
+{
+	switch (format)
+	{
+	case MipFormat::RGBA16_Float: return 8;
+	case MipFormat::R16_UNorm: return 2;
+	default: return 4;
+	}
+}
+
+u32 GetFullMipCount(u32 width, u32 height)
+{
+	u32 count = 1;
+	for (u32 size = std::max(width, height); size > 1; size >>= 1)
+	{
+		++count;
+	}
+	return count;
+}
+
+u64 GetMipChainLayout(MipFormat format, u32 width, u32 height, u32 mipCount, u32 rowAlignment, u32 offsetAlignment,
+	std::vector<MipLevelLayout>& levels)
+{
+	ASSERTMSG(rowAlignment != 0 && (rowAlignment & (rowAlignment - 1)) == 0, "Row alignment must be a power of two");
+	ASSERTMSG(offsetAlignment != 0 && (offsetAlignment & (offsetAlignment - 1)) == 0, "Offset alignment must be a power of two");
+
+	levels.resize(mipCount);
+	u64 offset = 0;
+	for (u32 mip = 0; mip < mipCount; ++mip)
+	{
+		MipLevelLayout& level = levels[mip];
+		level.m_Width = std::max(1u, width >> mip);
+		level.m_Height = std::max(1u, height >> mip);
+		level.m_RowPitch = (level.m_Width * GetMipFormatPixelSize(format) + rowAlignment - 1) & ~(rowAlignment - 1);
+
+		offset = (offset + offsetAlignment - 1) & ~(u64)(offsetAlignment - 1);
+		level.m_Offset = offset;
+		offset += (u64)level.m_RowPitch * level.m_Height;
+	}
+	return offset;
+}
+
+MipGenerator::MipGenerator(JobSystem* jobSystem)
+	: m_JobSystem(jobSystem)
+	, m_UseAvx(IsAvxSupported())
+{
+}
+
+void MipGenerator::Generate(MipFormat format, MipFilter filter, const u8* source, u32 sourceRowPitch,
+	u8* dest, const std::vector<MipLevelLayout>& levels)
+{
+	ASSERTMSG(!levels.empty(), "Mip chain has no levels");
+	const u32 pixelSize = GetMipFormatPixelSize(format);
+
+	const MipLevelLayout& top = levels[0];
+	for (u32 y = 0; y < top.m_Height; ++y)
+	{
+		memcpy(dest + top.m_Offset + (u64)y * top.m_RowPitch, source + (u64)y * sourceRowPitch, (size_t)top.m_Width * pixelSize);
+	}
+
+	const u8* levelSource = source;
+	u32 levelSourcePitch = sourceRowPitch;
+	for (u32 mip = 1; mip < (u32)levels.size(); ++mip)
+	{
+		const MipLevelLayout& parent = levels[mip - 1];
+		const MipLevelLayout& level = levels[mip];
+		ASSERTMSG(level.m_Width == std::max(1u, parent.m_Width >> 1) && level.m_Height == std::max(1u, parent.m_Height >> 1),
+			"Each mip must be half the size of the one before");
+
+		// The last mip is never read back, so it only goes to dest.
+		const bool keep = mip + 1 < (u32)levels.size();
+		std::vector<u8>& scratch = m_Scratch[mip & 1];
+		if (keep)
+		{
+			scratch.resize((size_t)level.m_Width * level.m_Height * pixelSize);
+		}
+		u8* scratchData = keep ? scratch.data() : nullptr;
+
+		const u32 bandCount = (level.m_Height + c_RowsPerBand - 1) / c_RowsPerBand;
+		auto filterBand = [&](u32 band)
+		{
+			const u32 firstRow = band * c_RowsPerBand;
+			FilterBand(format, filter, levelSource, levelSourcePitch, parent.m_Width, parent.m_Height, dest, level,
+				scratchData, firstRow, std::min(c_RowsPerBand, level.m_Height - firstRow));
+		};
+
+		if (m_JobSystem != nullptr && bandCount > 1)
+		{
+			JobCounter counter;
+			m_JobSystem->DispatchRange(counter, bandCount, [&](u32 band, u32) { filterBand(band); });
+			m_JobSystem->Wait(counter);
+		}
+		else
+		{
+			for (u32 band = 0; band < bandCount; ++band)
+			{
+				filterBand(band);
+			}
+		}
+
+		levelSource = scratchData;
+		levelSourcePitch = level.m_Width * pixelSize;
+	}
+}
+
+void MipGenerator::FilterBand(MipFormat format, MipFilter filter, const u8* source, u32 sourceRowPitch, u32 sourceWidth, u32 sourceHeight,
+	u8* dest, const MipLevelLayout& level, u8* scratch, u32 firstRow, u32 rowCount) const
+{
+	const Tables& tables = GetTables();
+	const u32 channels = GetChannelCount(format);
+	const u32 pixelSize = GetMipFormatPixelSize(format);
+	const u32 taps = filter == MipFilter::Kaiser ? c_KaiserTaps : 2;
+	const float* weights = filter == MipFilter::Kaiser ? tables.m_KaiserWeights : tables.m_BoxWeights;
+	const u32 sourceFloats = sourceWidth * channels;
+
+	// Decoded source rows, slot r % taps holds row r. Neighbouring destination rows share most
+	// of their source rows, so each is only decoded once per band.
+	std::vector<float> decoded((size_t)taps * sourceFloats);
+	s32 decodedRow[c_MaxTaps];
+	std::fill(decodedRow, decodedRow + c_MaxTaps, -1);
+
+	std::vector<float> vertical(sourceFloats);
+	std::vector<float> filtered((size_t)level.m_Width * channels);
+	std::vector<u8> encoded((size_t)level.m_Width * pixelSize);
+
+	for (u32 y = firstRow; y < firstRow + rowCount; ++y)
+	{
+		const s32 first = filter == MipFilter::Kaiser ? (s32)y * 2 - 2 : (s32)y * 2;
+		const float* rows[c_MaxTaps];
+		for (u32 k = 0; k < taps; ++k)
+		{
+			const s32 row = std::min(std::max(first + (s32)k, 0), (s32)sourceHeight - 1);
+			const u32 slot = (u32)row % taps;
+			float* slotData = decoded.data() + (size_t)slot * sourceFloats;
+			if (decodedRow[slot] != row)
+			{
+				DecodeRow(format, source + (u64)row * sourceRowPitch, sourceWidth, slotData);
+				decodedRow[slot] = row;
+			}
+			rows[k] = slotData;
+		}
+
+		WeightedSum(rows, weights, taps, sourceFloats, vertical.data(), m_UseAvx);
+
+		if (sourceWidth == 1)
+		{
+			std::copy(vertical.begin(), vertical.end(), filtered.begin());
+		}
+		else if (filter == MipFilter::Kaiser)
+		{
+			KaiserRow(vertical.data(), sourceWidth, channels, level.m_Width, filtered.data());
+		}
+		else
+		{
+			HalveRow(vertical.data(), channels, level.m_Width, filtered.data(), m_UseAvx);
+		}
+
+		// Encoded into cached memory first, dest gets one sequential copy of the finished row.
+		u8* row = scratch != nullptr ? scratch + (size_t)y * level.m_Width * pixelSize : encoded.data();
+		EncodeRow(format, filtered.data(), level.m_Width, row);
+		memcpy(dest + level.m_Offset + (u64)y * level.m_RowPitch, row, (size_t)level.m_Width * pixelSize);
+	}
+}
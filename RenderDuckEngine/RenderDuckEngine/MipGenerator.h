@@ -0,0 +1,74 @@
+#pragma once
+#include "EngineCore.h"
+
+class JobSystem;
+
+// Pixel layouts the generator can filter. Channel order does not matter, so BGRA8 images use the
+// RGBA8 formats.
+enum class MipFormat : u32
+{
+	RGBA8_UNorm = 0,
+	RGBA8_UNorm_SRGB,
+	RGBA16_Float,
+	R16_UNorm,
+};
+
+enum class MipFilter : u32
+{
+	// 2x2 average. Odd sizes drop their last row or column.
+	Box = 0,
+
+	// 6x6 Kaiser windowed sinc, sharper than the box but can ring on hard edges.
+	Kaiser,
+};
+
+// Where one mip lives in a chain buffer.
+struct MipLevelLayout
+{
+	u64 m_Offset = 0;
+	u32 m_Width = 0;
+	u32 m_Height = 0;
+	u32 m_RowPitch = 0;
+};
+
+u32 GetMipFormatPixelSize(MipFormat format);
+
+// Mips down to 1x1.
+u32 GetFullMipCount(u32 width, u32 height);
+
+// Lays out mipCount mips one after the other, rows aligned to rowAlignment and mips to
+// offsetAlignment. D3D12_TEXTURE_DATA_PITCH_ALIGNMENT and D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT give
+// the layout CopyTextureRegion reads from an upload buffer. Returns the size of the whole chain.
+u64 GetMipChainLayout(MipFormat format, u32 width, u32 height, u32 mipCount, u32 rowAlignment, u32 offsetAlignment,
+	std::vector<MipLevelLayout>& levels);
+
+// Builds mip chains on the CPU. Filtering happens in linear float, sRGB colour is converted on the
+// way in and out and alpha is always linear. Each mip is filtered from the one above it, split
+// into bands of rows that run as jobs, with SSE kernels and AVX ones where the CPU has it.
+// The destination is only ever written, a whole row at a time, so it can be write combined memory
+// such as a mapped upload buffer. The previous mip is read from scratch memory owned by the
+// generator instead.
+class MipGenerator
+{
+public:
+	// Without a job system every band runs on the calling thread.
+	explicit MipGenerator(JobSystem* jobSystem = nullptr);
+	MipGenerator(const MipGenerator& rhs) = delete;
+	MipGenerator& operator=(const MipGenerator& rhs) = delete;
+
+	// Copies the source image into mip 0 of dest and fills every following mip in levels.
+	void Generate(MipFormat format, MipFilter filter, const u8* source, u32 sourceRowPitch,
+		u8* dest, const std::vector<MipLevelLayout>& levels);
+
+	bool IsUsingAvx() const { return m_UseAvx; }
+
+private:
+	void FilterBand(MipFormat format, MipFilter filter, const u8* source, u32 sourceRowPitch, u32 sourceWidth, u32 sourceHeight,
+		u8* dest, const MipLevelLayout& level, u8* scratch, u32 firstRow, u32 rowCount) const;
+
+	JobSystem* m_JobSystem;
+	bool m_UseAvx;
+
+	// The last two mips, tightly packed, so each mip is filtered from cached memory.
+	std::vector<u8> m_Scratch[2];
+};
@@ -0,0 +1,681 @@
+#include "OcclusionCuller.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <emmintrin.h>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Anything this close to the eye, or behind it, is treated as visible and never used as an occluder.
+	const float c_MinClipW = 1e-4f;
+
+	// Occludees are tested in batches of this many per job.
+	const u32 c_OccludeesPerJob = 64;
+
+	XMFLOAT4X4 Multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+	{
+		XMFLOAT4X4 result;
+		for (u32 r = 0; r < 4; ++r)
+		{
+			for (u32 c = 0; c < 4; ++c)
+			{
+				result.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+			}
+		}
+		return result;
+	}
+
+	void LoadRows(const XMFLOAT4X4& m, __m128 rows[4])
+	{
+		for (u32 r = 0; r < 4; ++r)
+		{
+			rows[r] = _mm_loadu_ps(m.m[r]);
+		}
+	}
+
+	// Row vector transform, p * M.
+	__m128 TransformPoint(const __m128 rows[4], float x, float y, float z)
+	{
+		__m128 result = _mm_mul_ps(_mm_set1_ps(x), rows[0]);
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(y), rows[1]));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(z), rows[2]));
+		return _mm_add_ps(result, rows[3]);
+	}
+
+	// Projects the corners of a world space box to screen space. Returns false if any corner is
+	// behind the near plane, in which case the screen rect is meaningless.
+	bool ProjectBox(const __m128 rows[4], const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax,
+		float& minX, float& minY, float& maxX, float& maxY, float& minZ)
+	{
+		minX = minY = minZ = FLT_MAX;
+		maxX = maxY = -FLT_MAX;
+
+		for (u32 corner = 0; corner < 8; ++corner)
+		{
+			const float x = (corner & 1) ? boundsMax.x : boundsMin.x;
+			const float y = (corner & 2) ? boundsMax.y : boundsMin.y;
+			const float z = (corner & 4) ? boundsMax.z : boundsMin.z;
+
+			alignas(16) float clip[4];
+			_mm_store_ps(clip, TransformPoint(rows, x, y, z));
+			if (clip[3] <= c_MinClipW)
+			{
+				return false;
+			}
+
+			const float invW = 1.0f / clip[3];
+			const float screenX = (clip[0] * invW * 0.5f + 0.5f) * (float)OcclusionCuller::c_Width;
+			const float screenY = (0.5f - clip[1] * invW * 0.5f) * (float)OcclusionCuller::c_Height;
+
+			minX = std::min(minX, screenX);
+			maxX = std::max(maxX, screenX);
+			minY = std::min(minY, screenY);
+			maxY = std::max(maxY, screenY);
+			minZ = std::min(minZ, clip[2] * invW);
+		}
+
+		return true;
+	}
+}
+
+OcclusionCuller::OcclusionCuller(JobSystem* jobSystem)
+	: m_JobSystem(jobSystem)
+	, m_Depth(c_Width * c_Height, 1.0f)
+{
+	assert(m_JobSystem != nullptr);
+	static_assert(c_Width % c_TileSize == 0 && c_Height % c_TileSize == 0, "Occlusion buffer must be a whole number of tiles");
+	static_assert(c_TileSize % 4 == 0, "Tiles are rasterized four pixels at a time");
+
+	std::fill(std::begin(m_TileMaxDepth), std::end(m_TileMaxDepth), 1.0f);
+	m_WorkerBins.resize(m_JobSystem->GetWorkerCount());
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& viewProj)
+{
+	m_ViewProj = viewProj;
+
+	std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+	std::fill(std::begin(m_TileMaxDepth), std::end(m_TileMaxDepth), 1.0f);
+
+	m_Occluders.clear();
+	for (WorkerBins& bins : m_WorkerBins)
+	{
+		bins.m_Triangles.clear();
+		for (std::vector<u32>& tile : bins.m_Tiles)
+		{
+			tile.clear();
+		}
+	}
+
+	m_Stats = OcclusionStats();
+}
+
+void OcclusionCuller::AddOccluder(const OccluderDesc& desc)
+{
+	assert(desc.m_Positions != nullptr && desc.m_Indices != nullptr);
+	m_Occluders.push_back(desc);
+}
+
+float OcclusionCuller::EstimateScreenArea(const OccluderDesc& desc) const
+{
+	__m128 rows[4];
+	LoadRows(m_ViewProj, rows);
+
+	float minX, minY, maxX, maxY, minZ;
+	if (!ProjectBox(rows, desc.m_BoundsMin, desc.m_BoundsMax, minX, minY, maxX, maxY, minZ))
+	{
+		// The camera is close to or inside the occluder, it is likely to cover a lot of the screen.
+		return (float)(c_Width * c_Height);
+	}
+
+	minX = std::max(minX, 0.0f);
+	minY = std::max(minY, 0.0f);
+	maxX = std::min(maxX, (float)c_Width);
+	maxY = std::min(maxY, (float)c_Height);
+	if (maxX <= minX || maxY <= minY || minZ > 1.0f)
+	{
+		return 0.0f;
+	}
+
+	return (maxX - minX) * (maxY - minY);
+}
+
+void OcclusionCuller::RasterizeOccluders()
+{
+	m_Stats.m_OccludersSubmitted = (u32)m_Occluders.size();
+
+	// Biggest on screen first, they hide the most.
+	std::vector<std::pair<float, u32>> ranked;
+	ranked.reserve(m_Occluders.size());
+	for (u32 i = 0; i < (u32)m_Occluders.size(); ++i)
+	{
+		const float area = EstimateScreenArea(m_Occluders[i]);
+		if (area > 0.0f)
+		{
+			ranked.push_back({ area, i });
+		}
+	}
+	std::sort(ranked.begin(), ranked.end(), [](const std::pair<float, u32>& a, const std::pair<float, u32>& b)
+	{
+		return a.first > b.first;
+	});
+
+	std::vector<u32> selected;
+	u32 triangleCount = 0;
+	for (const std::pair<float, u32>& occluder : ranked)
+	{
+		const u32 occluderTriangles = m_Occluders[occluder.second].m_IndexCount / 3;
+		if (triangleCount + occluderTriangles > m_TriangleBudget)
+		{
+			continue;
+		}
+		triangleCount += occluderTriangles;
+		selected.push_back(occluder.second);
+	}
+	m_Stats.m_OccludersRasterized = (u32)selected.size();
+
+	// Transform and bin into per-worker tile lists, so no bin is ever shared between threads.
+	JobCounter binCounter;
+	m_JobSystem->DispatchRange(binCounter, (u32)selected.size(), [this, &selected](u32 index, u32 workerIndex)
+	{
+		BinOccluder(m_Occluders[selected[index]], m_WorkerBins[workerIndex]);
+	});
+	m_JobSystem->Wait(binCounter);
+
+	// Each tile owns its own pixels, so tiles rasterize in parallel without synchronisation.
+	JobCounter rasterCounter;
+	m_JobSystem->DispatchRange(rasterCounter, c_TilesX * c_TilesY, [this](u32 index, u32)
+	{
+		RasterizeTile(index);
+	});
+	m_JobSystem->Wait(rasterCounter);
+
+	for (const WorkerBins& bins : m_WorkerBins)
+	{
+		m_Stats.m_TrianglesRasterized += (u32)bins.m_Triangles.size();
+	}
+}
+
+void OcclusionCuller::BinOccluder(const OccluderDesc& desc, WorkerBins& bins)
+{
+	__m128 rows[4];
+	LoadRows(Multiply(desc.m_World, m_ViewProj), rows);
+
+	const u8* positions = (const u8*)desc.m_Positions;
+	const u16* indices16 = (const u16*)desc.m_Indices + desc.m_StartIndex;
+	const u32* indices32 = (const u32*)desc.m_Indices + desc.m_StartIndex;
+
+	for (u32 i = 0; i + 2 < desc.m_IndexCount; i += 3)
+	{
+		ScreenTriangle tri;
+		bool clipped = false;
+		for (u32 v = 0; v < 3; ++v)
+		{
+			const u32 index = desc.m_Indices16 ? indices16[i + v] : indices32[i + v];
+			const XMFLOAT3& p = *(const XMFLOAT3*)(positions + (size_t)(desc.m_BaseVertex + (s32)index) * desc.m_PositionStride);
+
+			alignas(16) float clip[4];
+			_mm_store_ps(clip, TransformPoint(rows, p.x, p.y, p.z));
+
+			// Dropping a triangle only makes the buffer less occluding, so no near plane clipping is needed.
+			if (clip[3] <= c_MinClipW || clip[2] < 0.0f)
+			{
+				clipped = true;
+				break;
+			}
+
+			const float invW = 1.0f / clip[3];
+			tri.m_X[v] = (clip[0] * invW * 0.5f + 0.5f) * (float)c_Width;
+			tri.m_Y[v] = (0.5f - clip[1] * invW * 0.5f) * (float)c_Height;
+			tri.m_Z[v] = clip[2] * invW;
+		}
+
+		if (clipped)
+		{
+			continue;
+		}
+
+		const float area = (tri.m_X[1] - tri.m_X[0]) * (tri.m_Y[2] - tri.m_Y[0]) - (tri.m_X[2] - tri.m_X[0]) * (tri.m_Y[1] - tri.m_Y[0]);
+		if (std::fabs(area) < 1e-6f)
+		{
+			continue;
+		}
+
+		const float minX = std::min(std::min(tri.m_X[0], tri.m_X[1]), tri.m_X[2]);
+		const float maxX = std::max(std::max(tri.m_X[0], tri.m_X[1]), tri.m_X[2]);
+		const float minY = std::min(std::min(tri.m_Y[0], tri.m_Y[1]), tri.m_Y[2]);
+		const float maxY = std::max(std::max(tri.m_Y[0], tri.m_Y[1]), tri.m_Y[2]);
+		const float minZ = std::min(std::min(tri.m_Z[0], tri.m_Z[1]), tri.m_Z[2]);
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)c_Width || minY >= (float)c_Height || minZ > 1.0f)
+		{
+			continue;
+		}
+
+		const u32 tileX0 = (u32)std::max(minX, 0.0f) / c_TileSize;
+		const u32 tileY0 = (u32)std::max(minY, 0.0f) / c_TileSize;
+		const u32 tileX1 = std::min((u32)maxX / c_TileSize, c_TilesX - 1);
+		const u32 tileY1 = std::min((u32)maxY / c_TileSize, c_TilesY - 1);
+
+		const u32 triIndex = (u32)bins.m_Triangles.size();
+		bins.m_Triangles.push_back(tri);
+		for (u32 ty = tileY0; ty <= tileY1; ++ty)
+		{
+			for (u32 tx = tileX0; tx <= tileX1; ++tx)
+			{
+				bins.m_Tiles[ty * c_TilesX + tx].push_back(triIndex);
+			}
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeTile(u32 tileIndex)
+{
+	const u32 tileX = tileIndex % c_TilesX;
+	const u32 tileY = tileIndex / c_TilesX;
+
+	for (const WorkerBins& bins : m_WorkerBins)
+	{
+		for (u32 triIndex : bins.m_Tiles[tileIndex])
+		{
+			RasterizeTriangle(bins.m_Triangles[triIndex], tileX, tileY);
+		}
+	}
+
+	// Farthest depth in the tile, an occludee nearer than this might be visible somewhere in it.
+	__m128 maxDepth = _mm_setzero_ps();
+	for (u32 y = tileY * c_TileSize; y < (tileY + 1) * c_TileSize; ++y)
+	{
+		const float* row = &m_Depth[y * c_Width];
+		for (u32 x = tileX * c_TileSize; x < (tileX + 1) * c_TileSize; x += 4)
+		{
+			maxDepth = _mm_max_ps(maxDepth, _mm_loadu_ps(row + x));
+		}
+	}
+
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, maxDepth);
+	m_TileMaxDepth[tileIndex] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& tri, u32 tileX, u32 tileY)
+{
+	float x0 = tri.m_X[0], y0 = tri.m_Y[0], z0 = tri.m_Z[0];
+	float x1 = tri.m_X[1], y1 = tri.m_Y[1], z1 = tri.m_Z[1];
+	float x2 = tri.m_X[2], y2 = tri.m_Y[2], z2 = tri.m_Z[2];
+
+	// Occluders are rasterized double sided, flip to a consistent winding.
+	float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+	if (area < 0.0f)
+	{
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+		std::swap(z1, z2);
+		area = -area;
+	}
+
+	// Pixel centres covered by the triangle, limited to this tile.
+	const s32 tileMinX = (s32)(tileX * c_TileSize);
+	const s32 tileMinY = (s32)(tileY * c_TileSize);
+	const s32 minX = std::max(tileMinX, (s32)std::ceil(std::min(std::min(x0, x1), x2) - 0.5f));
+	const s32 maxX = std::min(tileMinX + (s32)c_TileSize - 1, (s32)std::floor(std::max(std::max(x0, x1), x2) - 0.5f));
+	const s32 minY = std::max(tileMinY, (s32)std::ceil(std::min(std::min(y0, y1), y2) - 0.5f));
+	const s32 maxY = std::min(tileMinY + (s32)c_TileSize - 1, (s32)std::floor(std::max(std::max(y0, y1), y2) - 0.5f));
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	// Edge functions E(x, y) = A*x + B*y + C, positive inside.
+	const float a0 = y0 - y1, b0 = x1 - x0, c0 = -(a0 * x0 + b0 * y0);
+	const float a1 = y1 - y2, b1 = x2 - x1, c1 = -(a1 * x1 + b1 * y1);
+	const float a2 = y2 - y0, b2 = x0 - x2, c2 = -(a2 * x2 + b2 * y2);
+
+	// Depth plane from the barycentrics, the edge opposite a vertex weights that vertex.
+	const float invArea = 1.0f / area;
+	const float za = (a1 * z0 + a2 * z1 + a0 * z2) * invArea;
+	const float zb = (b1 * z0 + b2 * z1 + b0 * z2) * invArea;
+	const float zc = (c1 * z0 + c2 * z1 + c0 * z2) * invArea;
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 va0 = _mm_set1_ps(a0), va1 = _mm_set1_ps(a1), va2 = _mm_set1_ps(a2);
+	const __m128 vza = _mm_set1_ps(za);
+
+	// Start on a four pixel boundary. Tiles are a multiple of four wide, so a group never
+	// crosses into a neighbouring tile being rasterized on another thread.
+	const s32 startX = minX & ~3;
+
+	for (s32 y = minY; y <= maxY; ++y)
+	{
+		const float fy = (float)y + 0.5f;
+		const __m128 row0 = _mm_set1_ps(b0 * fy + c0);
+		const __m128 row1 = _mm_set1_ps(b1 * fy + c1);
+		const __m128 row2 = _mm_set1_ps(b2 * fy + c2);
+		const __m128 rowZ = _mm_set1_ps(zb * fy + zc);
+
+		float* depthRow = &m_Depth[y * c_Width];
+		for (s32 x = startX; x <= maxX; x += 4)
+		{
+			const __m128 fx = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+
+			const __m128 e0 = _mm_add_ps(_mm_mul_ps(va0, fx), row0);
+			const __m128 e1 = _mm_add_ps(_mm_mul_ps(va1, fx), row1);
+			const __m128 e2 = _mm_add_ps(_mm_mul_ps(va2, fx), row2);
+			const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(inside) == 0)
+			{
+				continue;
+			}
+
+			const __m128 depth = _mm_add_ps(_mm_mul_ps(vza, fx), rowZ);
+			const __m128 current = _mm_loadu_ps(depthRow + x);
+			const __m128 nearest = _mm_min_ps(current, depth);
+			_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax) const
+{
+	__m128 rows[4];
+	LoadRows(m_ViewProj, rows);
+
+	float minX, minY, maxX, maxY, minZ;
+	if (!ProjectBox(rows, boundsMin, boundsMax, minX, minY, maxX, maxY, minZ))
+	{
+		return true;
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)c_Width || minY >= (float)c_Height || minZ > 1.0f)
+	{
+		return false;
+	}
+
+	// Grow to whole pixels so partially covered pixels are tested too.
+	const s32 pixelMinX = std::max(0, (s32)std::floor(minX));
+	const s32 pixelMinY = std::max(0, (s32)std::floor(minY));
+	const s32 pixelMaxX = std::min((s32)c_Width - 1, (s32)std::ceil(maxX));
+	const s32 pixelMaxY = std::min((s32)c_Height - 1, (s32)std::ceil(maxY));
+
+	minZ = std::max(minZ, 0.0f);
+	const __m128 nearestZ = _mm_set1_ps(minZ);
+	const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+	for (s32 tileY = pixelMinY / (s32)c_TileSize; tileY <= pixelMaxY / (s32)c_TileSize; ++tileY)
+	{
+		for (s32 tileX = pixelMinX / (s32)c_TileSize; tileX <= pixelMaxX / (s32)c_TileSize; ++tileX)
+		{
+			// Every pixel in the tile is nearer than the box, nothing to look at here.
+			if (m_TileMaxDepth[tileY * c_TilesX + tileX] < minZ)
+			{
+				continue;
+			}
+
+			const s32 x0 = std::max(pixelMinX, tileX * (s32)c_TileSize);
+			const s32 x1 = std::min(pixelMaxX, (tileX + 1) * (s32)c_TileSize - 1);
+			const s32 y0 = std::max(pixelMinY, tileY * (s32)c_TileSize);
+			const s32 y1 = std::min(pixelMaxY, (tileY + 1) * (s32)c_TileSize - 1);
+
+			const __m128 laneMin = _mm_set1_ps((float)x0);
+			const __m128 laneMax = _mm_set1_ps((float)x1);
+
+			for (s32 y = y0; y <= y1; ++y)
+			{
+				const float* depthRow = &m_Depth[y * c_Width];
+				for (s32 x = x0 & ~3; x <= x1; x += 4)
+				{
+					const __m128 laneX = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+					const __m128 inRect = _mm_and_ps(_mm_cmpge_ps(laneX, laneMin), _mm_cmple_ps(laneX, laneMax));
+					const __m128 notHidden = _mm_cmpge_ps(_mm_loadu_ps(depthRow + x), nearestZ);
+					if (_mm_movemask_ps(_mm_and_ps(inRect, notHidden)) != 0)
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+void OcclusionCuller::TestVisibility(const XMFLOAT3* boundsMin, const XMFLOAT3* boundsMax, u32 count, u8* visible)
+{
+	JobCounter counter;
+	const u32 jobCount = (count + c_OccludeesPerJob - 1) / c_OccludeesPerJob;
+	m_JobSystem->DispatchRange(counter, jobCount, [=](u32 index, u32)
+	{
+		const u32 first = index * c_OccludeesPerJob;
+		const u32 last = std::min(first + c_OccludeesPerJob, count);
+		for (u32 i = first; i < last; ++i)
+		{
+			visible[i] = IsVisible(boundsMin[i], boundsMax[i]) ? 1 : 0;
+		}
+	});
+	m_JobSystem->Wait(counter);
+
+	m_Stats.m_OccludeesTested += count;
+	for (u32 i = 0; i < count; ++i)
+	{
+		m_Stats.m_OccludeesCulled += visible[i] ? 0 : 1;
+	}
+}
+
+namespace
+{
+	// Left handed look-at and perspective projection, row vector convention.
+	XMFLOAT4X4 BenchmarkViewProj(const XMFLOAT3& eye, const XMFLOAT3& at, float fovY, float aspect, float nearZ, float farZ)
+	{
+		float zx = at.x - eye.x, zy = at.y - eye.y, zz = at.z - eye.z;
+		const float zLength = std::sqrt(zx * zx + zy * zy + zz * zz);
+		zx /= zLength; zy /= zLength; zz /= zLength;
+
+		// x = normalize(cross(up, z)) with y up, y = cross(z, x).
+		const float xLength = std::sqrt(zz * zz + zx * zx);
+		const float xx = zz / xLength, xy = 0.0f, xz = -zx / xLength;
+		const float yx = zy * xz - zz * xy, yy = zz * xx - zx * xz, yz = zx * xy - zy * xx;
+
+		XMFLOAT4X4 view = {};
+		view.m[0][0] = xx; view.m[0][1] = yx; view.m[0][2] = zx;
+		view.m[1][0] = xy; view.m[1][1] = yy; view.m[1][2] = zy;
+		view.m[2][0] = xz; view.m[2][1] = yz; view.m[2][2] = zz;
+		view.m[3][0] = -(xx * eye.x + xy * eye.y + xz * eye.z);
+		view.m[3][1] = -(yx * eye.x + yy * eye.y + yz * eye.z);
+		view.m[3][2] = -(zx * eye.x + zy * eye.y + zz * eye.z);
+		view.m[3][3] = 1.0f;
+
+		const float yScale = 1.0f / std::tan(fovY * 0.5f);
+		XMFLOAT4X4 proj = {};
+		proj.m[0][0] = yScale / aspect;
+		proj.m[1][1] = yScale;
+		proj.m[2][2] = farZ / (farZ - nearZ);
+		proj.m[2][3] = 1.0f;
+		proj.m[3][2] = -nearZ * farZ / (farZ - nearZ);
+
+		return Multiply(view, proj);
+	}
+
+	// False when every corner of the box is outside the same clip plane.
+	bool BenchmarkInFrustum(const XMFLOAT4X4& viewProj, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+	{
+		u32 outside[6] = {};
+		for (u32 corner = 0; corner < 8; ++corner)
+		{
+			const float p[3] =
+			{
+				(corner & 1) ? boundsMax.x : boundsMin.x,
+				(corner & 2) ? boundsMax.y : boundsMin.y,
+				(corner & 4) ? boundsMax.z : boundsMin.z,
+			};
+			float clip[4];
+			for (u32 c = 0; c < 4; ++c)
+			{
+				clip[c] = p[0] * viewProj.m[0][c] + p[1] * viewProj.m[1][c] + p[2] * viewProj.m[2][c] + viewProj.m[3][c];
+			}
+			outside[0] += clip[0] < -clip[3];
+			outside[1] += clip[0] > clip[3];
+			outside[2] += clip[1] < -clip[3];
+			outside[3] += clip[1] > clip[3];
+			outside[4] += clip[2] < 0.0f;
+			outside[5] += clip[2] > clip[3];
+		}
+		return std::find(std::begin(outside), std::end(outside), 8u) == std::end(outside);
+	}
+}
+
+void RunOcclusionBenchmark(std::string& report)
+{
+	const u32 blocksPerSide = 32;
+	const float blockSize = 40.0f;
+	const float streetWidth = 12.0f;
+	const float blockPitch = blockSize + streetWidth;
+	const u32 propsPerBlock = 24;
+	const u32 frameCount = 300;
+
+	// A unit cube, every building is one scaled and moved by its world matrix.
+	static const XMFLOAT3 cubePositions[8] =
+	{
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 },
+		{ 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 },
+	};
+	static const u16 cubeIndices[36] =
+	{
+		0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4,
+		3, 6, 2, 3, 7, 6, 0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5,
+	};
+
+	// Four buildings of random height per block, and props scattered over blocks and streets.
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<OccluderDesc> buildings;
+	std::vector<XMFLOAT3> boundsMin;
+	std::vector<XMFLOAT3> boundsMax;
+	for (u32 blockZ = 0; blockZ < blocksPerSide; ++blockZ)
+	{
+		for (u32 blockX = 0; blockX < blocksPerSide; ++blockX)
+		{
+			for (u32 lot = 0; lot < 4; ++lot)
+			{
+				const float width = 12.0f + 6.0f * unit(random);
+				const float depth = 12.0f + 6.0f * unit(random);
+				const float height = 8.0f + 60.0f * unit(random) * unit(random);
+				const float x = blockX * blockPitch + (lot & 1) * blockSize * 0.5f + 1.0f;
+				const float z = blockZ * blockPitch + (lot >> 1) * blockSize * 0.5f + 1.0f;
+
+				OccluderDesc building;
+				building.m_World = {};
+				building.m_World.m[0][0] = width;
+				building.m_World.m[1][1] = height;
+				building.m_World.m[2][2] = depth;
+				building.m_World.m[3][0] = x;
+				building.m_World.m[3][2] = z;
+				building.m_World.m[3][3] = 1.0f;
+				building.m_Positions = cubePositions;
+				building.m_Indices = cubeIndices;
+				building.m_IndexCount = 36;
+				building.m_BoundsMin = { x, 0.0f, z };
+				building.m_BoundsMax = { x + width, height, z + depth };
+				buildings.push_back(building);
+
+				boundsMin.push_back(building.m_BoundsMin);
+				boundsMax.push_back(building.m_BoundsMax);
+			}
+
+			for (u32 prop = 0; prop < propsPerBlock; ++prop)
+			{
+				const float size = 0.5f + 2.5f * unit(random);
+				const float x = (blockX + unit(random)) * blockPitch;
+				const float z = (blockZ + unit(random)) * blockPitch;
+				boundsMin.push_back({ x, 0.0f, z });
+				boundsMax.push_back({ x + size, size, z + size });
+			}
+		}
+	}
+	const u32 objectCount = (u32)boundsMin.size();
+
+	JobSystem jobSystem;
+	OcclusionCuller culler(&jobSystem);
+	std::vector<u8> visible(objectCount);
+
+	// Down the middle of a street at head height, swinging the view from side to side.
+	const float streetX = (blocksPerSide / 2) * blockPitch - streetWidth * 0.5f;
+	const float cityLength = blocksPerSide * blockPitch;
+	double setupMs = 0.0, rasterMs = 0.0, testMs = 0.0, serialTestMs = 0.0, worstFrameMs = 0.0;
+	u64 trianglesRasterized = 0, inFrustum = 0, occluded = 0;
+	bool matches = true;
+	for (u32 frame = 0; frame < frameCount; ++frame)
+	{
+		const float t = (float)frame / frameCount;
+		const float angle = 0.8f * std::sin(t * 12.0f);
+		const XMFLOAT3 eye = { streetX, 1.8f, cityLength * t };
+		const XMFLOAT3 at = { eye.x + std::sin(angle), 1.8f, eye.z + std::cos(angle) };
+		const XMFLOAT4X4 viewProj = BenchmarkViewProj(eye, at, 1.0f, (float)OcclusionCuller::c_Width / OcclusionCuller::c_Height, 0.5f, 2000.0f);
+
+		auto start = std::chrono::steady_clock::now();
+		culler.BeginFrame(viewProj);
+		for (const OccluderDesc& building : buildings)
+		{
+			culler.AddOccluder(building);
+		}
+		const auto setupEnd = std::chrono::steady_clock::now();
+
+		const auto rasterStart = std::chrono::steady_clock::now();
+		culler.RasterizeOccluders();
+		const auto testStart = std::chrono::steady_clock::now();
+		culler.TestVisibility(boundsMin.data(), boundsMax.data(), objectCount, visible.data());
+		const auto end = std::chrono::steady_clock::now();
+
+		const double frameSetupMs = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+		const double frameRasterMs = std::chrono::duration<double, std::milli>(testStart - rasterStart).count();
+		const double frameTestMs = std::chrono::duration<double, std::milli>(end - testStart).count();
+		setupMs += frameSetupMs;
+		rasterMs += frameRasterMs;
+		testMs += frameTestMs;
+		worstFrameMs = std::max(worstFrameMs, frameSetupMs + frameRasterMs + frameTestMs);
+		trianglesRasterized += culler.GetStats().m_TrianglesRasterized;
+
+		// The engine frustum culls first, so only count what occlusion culled on top of that.
+		for (u32 i = 0; i < objectCount; ++i)
+		{
+			if (BenchmarkInFrustum(viewProj, boundsMin[i], boundsMax[i]))
+			{
+				++inFrustum;
+				occluded += visible[i] ? 0 : 1;
+			}
+		}
+
+		// The same tests on one thread, which must agree with the jobs.
+		start = std::chrono::steady_clock::now();
+		for (u32 i = 0; i < objectCount; ++i)
+		{
+			matches &= (culler.IsVisible(boundsMin[i], boundsMax[i]) ? 1 : 0) == visible[i];
+		}
+		serialTestMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	const u64 tested = (u64)objectCount * frameCount;
+	char text[1024];
+	snprintf(text, sizeof(text),
+		"%u buildings, %u objects, %u frames, %ux%u depth buffer, %u worker indices\n"
+		"Add occluders:    %8.3f ms per frame\n"
+		"Rasterize:        %8.3f ms per frame, %.0f triangles\n"
+		"Test occludees:   %8.3f ms per frame, %8.3f ms on one thread (%.1fx)\n"
+		"Worst frame:      %8.3f ms\n"
+		"In frustum:       %5.1f%% of objects, %5.1f%% of those occluded\n"
+		"Results %s\n",
+		(u32)buildings.size(), objectCount, frameCount, OcclusionCuller::c_Width, OcclusionCuller::c_Height, jobSystem.GetWorkerCount(),
+		setupMs / frameCount,
+		rasterMs / frameCount, (double)trianglesRasterized / frameCount,
+		testMs / frameCount, serialTestMs / frameCount, serialTestMs / testMs,
+		worstFrameMs,
+		100.0 * inFrustum / tested, inFrustum > 0 ? 100.0 * occluded / inFrustum : 0.0,
+		matches ? "match" : "DIFFER");
+	report += text;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <string>
+
+class JobSystem;
+
+// Occluder geometry in object space. Positions are read with positionStride so interleaved vertex
+// buffers can be passed straight in; indices are 16 or 32 bit.
+struct OccluderDesc
+{
+	DirectX::XMFLOAT4X4 m_World;
+
+	const DirectX::XMFLOAT3* m_Positions = nullptr;
+	u32 m_PositionStride = sizeof(DirectX::XMFLOAT3);
+	s32 m_BaseVertex = 0;
+
+	const void* m_Indices = nullptr;
+	bool m_Indices16 = true;
+	u32 m_StartIndex = 0;
+	u32 m_IndexCount = 0;
+
+	// World space bounds, used to rank occluders by how much of the screen they cover.
+	DirectX::XMFLOAT3 m_BoundsMin;
+	DirectX::XMFLOAT3 m_BoundsMax;
+};
+
+struct OcclusionStats
+{
+	u32 m_OccludersSubmitted = 0;
+	u32 m_OccludersRasterized = 0;
+	u32 m_TrianglesRasterized = 0;
+	u32 m_OccludeesTested = 0;
+	u32 m_OccludeesCulled = 0;
+};
+
+// Low resolution CPU depth buffer used to cull objects hidden behind large occluders.
+// Each frame: BeginFrame, AddOccluder for candidate occluders, RasterizeOccluders, then test
+// occludee bounds. Occluders are binned into screen tiles on the job system and each tile is
+// rasterized independently with SSE. Occludees are tested against a per-tile max depth first
+// and only fall back to per-pixel tests where that is inconclusive.
+// Depth is D3D style post-projection z in [0, 1], smaller is nearer.
+class OcclusionCuller
+{
+public:
+	static const u32 c_Width = 320;
+	static const u32 c_Height = 192;
+	static const u32 c_TileSize = 32;
+	static const u32 c_TilesX = c_Width / c_TileSize;
+	static const u32 c_TilesY = c_Height / c_TileSize;
+
+	OcclusionCuller(JobSystem* jobSystem);
+
+	// viewProj maps world space to clip space, row vector convention like the rest of the engine.
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProj);
+
+	// Pointers in desc must stay valid until RasterizeOccluders returns.
+	void AddOccluder(const OccluderDesc& desc);
+
+	// Keeps the largest occluders on screen, up to the triangle budget, and rasterizes them.
+	void RasterizeOccluders();
+
+	// True unless the world space box is completely hidden or off screen.
+	bool IsVisible(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax) const;
+
+	// Tests count boxes in parallel, writing 1 to visible[i] for boxes that should be drawn.
+	void TestVisibility(const DirectX::XMFLOAT3* boundsMin, const DirectX::XMFLOAT3* boundsMax, u32 count, u8* visible);
+
+	void SetTriangleBudget(u32 triangleBudget) { m_TriangleBudget = triangleBudget; }
+
+	const std::vector<float>& GetDepthBuffer() const { return m_Depth; }
+	const OcclusionStats& GetStats() const { return m_Stats; }
+
+private:
+	struct ScreenTriangle
+	{
+		float m_X[3];
+		float m_Y[3];
+		float m_Z[3];
+	};
+
+	struct WorkerBins
+	{
+		std::vector<ScreenTriangle> m_Triangles;
+		std::vector<u32> m_Tiles[c_TilesX * c_TilesY];
+	};
+
+	float EstimateScreenArea(const OccluderDesc& desc) const;
+	void BinOccluder(const OccluderDesc& desc, WorkerBins& bins);
+	void RasterizeTile(u32 tileIndex);
+	void RasterizeTriangle(const ScreenTriangle& tri, u32 tileX, u32 tileY);
+
+	JobSystem* m_JobSystem;
+
+	DirectX::XMFLOAT4X4 m_ViewProj;
+
+	std::vector<float> m_Depth;
+	float m_TileMaxDepth[c_TilesX * c_TilesY];
+
+	std::vector<OccluderDesc> m_Occluders;
+	std::vector<WorkerBins> m_WorkerBins;
+
+	u32 m_TriangleBudget = 16384;
+
+	OcclusionStats m_Stats;
+};
+
+// Walks a camera down the streets of a synthetic city of box buildings and props, with every
+// building an occluder and everything an occludee, and reports the time of each culling step
+// per frame and how much of the city was culled.
+void RunOcclusionBenchmark(std::string& report);
@@ -0,0 +1,125 @@
+#include "PipelineHash.h"
+
+#include "Hash.h"
+
+namespace
+{
+	// Bumped when the hashed fields change, so old keys stop matching.
+	const u32 c_PipelineHashVersion = 1;
+
+	void AddShader(Hasher& hasher, const D3D12_SHADER_BYTECODE& shader)
+	{
+		hasher.AddBytes(shader.pShaderBytecode, shader.pShaderBytecode != nullptr ? shader.BytecodeLength : 0);
+	}
+
+	void AddStencilOp(Hasher& hasher, const D3D12_DEPTH_STENCILOP_DESC& op)
+	{
+		hasher.Add(op.StencilFailOp);
+		hasher.Add(op.StencilDepthFailOp);
+		hasher.Add(op.StencilPassOp);
+		hasher.Add(op.StencilFunc);
+	}
+}
+
+PipelineKey HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, u64 rootSignatureHash)
+{
+	// Field by field, the D3D structs have padding that is not guaranteed to be zeroed.
+	Hasher hasher;
+	hasher.Add(c_PipelineHashVersion);
+	hasher.Add(rootSignatureHash);
+
+	AddShader(hasher, desc.VS);
+	AddShader(hasher, desc.PS);
+	AddShader(hasher, desc.DS);
+	AddShader(hasher, desc.HS);
+	AddShader(hasher, desc.GS);
+
+	const D3D12_STREAM_OUTPUT_DESC& streamOutput = desc.StreamOutput;
+	hasher.Add(streamOutput.NumEntries);
+	for (UINT i = 0; i < streamOutput.NumEntries; ++i)
+	{
+		const D3D12_SO_DECLARATION_ENTRY& entry = streamOutput.pSODeclaration[i];
+		hasher.Add(entry.Stream);
+		hasher.AddString(entry.SemanticName);
+		hasher.Add(entry.SemanticIndex);
+		hasher.Add(entry.StartComponent);
+		hasher.Add(entry.ComponentCount);
+		hasher.Add(entry.OutputSlot);
+	}
+	hasher.Add(streamOutput.NumStrides);
+	for (UINT i = 0; i < streamOutput.NumStrides; ++i)
+	{
+		hasher.Add(streamOutput.pBufferStrides[i]);
+	}
+	hasher.Add(streamOutput.RasterizedStream);
+
+	const D3D12_BLEND_DESC& blend = desc.BlendState;
+	hasher.Add(blend.AlphaToCoverageEnable);
+	hasher.Add(blend.IndependentBlendEnable);
+	for (const D3D12_RENDER_TARGET_BLEND_DESC& target : blend.RenderTarget)
+	{
+		hasher.Add(target.BlendEnable);
+		hasher.Add(target.LogicOpEnable);
+		hasher.Add(target.SrcBlend);
+		hasher.Add(target.DestBlend);
+		hasher.Add(target.BlendOp);
+		hasher.Add(target.SrcBlendAlpha);
+		hasher.Add(target.DestBlendAlpha);
+		hasher.Add(target.BlendOpAlpha);
+		hasher.Add(target.LogicOp);
+		hasher.Add(target.RenderTargetWriteMask);
+	}
+	hasher.Add(desc.SampleMask);
+
+	const D3D12_RASTERIZER_DESC& rasterizer = desc.RasterizerState;
+	hasher.Add(rasterizer.FillMode);
+	hasher.Add(rasterizer.CullMode);
+	hasher.Add(rasterizer.FrontCounterClockwise);
+	hasher.Add(rasterizer.DepthBias);
+	hasher.Add(rasterizer.DepthBiasClamp);
+	hasher.Add(rasterizer.SlopeScaledDepthBias);
+	hasher.Add(rasterizer.DepthClipEnable);
+	hasher.Add(rasterizer.MultisampleEnable);
+	hasher.Add(rasterizer.AntialiasedLineEnable);
+	hasher.Add(rasterizer.ForcedSampleCount);
+	hasher.Add(rasterizer.ConservativeRaster);
+
+	const D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+	hasher.Add(depthStencil.DepthEnable);
+	hasher.Add(depthStencil.DepthWriteMask);
+	hasher.Add(depthStencil.DepthFunc);
+	hasher.Add(depthStencil.StencilEnable);
+	hasher.Add(depthStencil.StencilReadMask);
+	hasher.Add(depthStencil.StencilWriteMask);
+	AddStencilOp(hasher, depthStencil.FrontFace);
+	AddStencilOp(hasher, depthStencil.BackFace);
+
+	const D3D12_INPUT_LAYOUT_DESC& inputLayout = desc.InputLayout;
+	hasher.Add(inputLayout.NumElements);
+	for (UINT i = 0; i < inputLayout.NumElements; ++i)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& element = inputLayout.pInputElementDescs[i];
+		hasher.AddString(element.SemanticName);
+		hasher.Add(element.SemanticIndex);
+		hasher.Add(element.Format);
+		hasher.Add(element.InputSlot);
+		hasher.Add(element.AlignedByteOffset);
+		hasher.Add(element.InputSlotClass);
+		hasher.Add(element.InstanceDataStepRate);
+	}
+
+	hasher.Add(desc.IBStripCutValue);
+	hasher.Add(desc.PrimitiveTopologyType);
+	hasher.Add(desc.NumRenderTargets);
+	for (UINT i = 0; i < desc.NumRenderTargets; ++i)
+	{
+		hasher.Add(desc.RTVFormats[i]);
+	}
+	hasher.Add(desc.DSVFormat);
+	hasher.Add(desc.SampleDesc.Count);
+	hasher.Add(desc.SampleDesc.Quality);
+	hasher.Add(desc.NodeMask);
+	hasher.Add(desc.Flags);
+
+	return hasher.GetHash();
+}
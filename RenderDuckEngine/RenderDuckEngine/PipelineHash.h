@@ -0,0 +1,11 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <d3d12.h>
+
+typedef u64 PipelineKey;
+
+// Hashes everything in desc that affects the compiled pipeline. Pointers are followed, so the key
+// is stable between runs: shader bytecode and input layout semantics are hashed by content and
+// the root signature by rootSignatureHash, the hash of its layout. CachedPSO is ignored.
+PipelineKey HashGraphicsPipelineDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, u64 rootSignatureHash);
@@ -0,0 +1,119 @@
+#include "PipelineStateCache.h"
+
+#include <cwchar>
+#include <fstream>
+#include <iterator>
+
+#include "MappedFile.h"
+
+namespace
+{
+	// Library entries are named by key, LoadGraphicsPipeline also checks the description matches.
+	std::wstring GetPipelineName(PipelineKey key)
+	{
+		wchar_t name[32];
+		swprintf(name, sizeof(name) / sizeof(name[0]), L"%016llx", (unsigned long long)key);
+		return name;
+	}
+}
+
+PipelineStateCache::PipelineStateCache(ID3D12Device* device, const std::filesystem::path& libraryPath)
+	: m_Device(device)
+	, m_LibraryPath(libraryPath)
+{
+	if (SUCCEEDED(m_Device.As(&m_Device1)))
+	{
+		LoadLibrary();
+	}
+}
+
+void PipelineStateCache::LoadLibrary()
+{
+	std::ifstream file(m_LibraryPath, std::ios::binary);
+	if (file)
+	{
+		m_LibraryData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	// A library from another driver or adapter fails with D3D12_ERROR_DRIVER_VERSION_MISMATCH or
+	// D3D12_ERROR_ADAPTER_NOT_FOUND, anything unreadable with E_INVALIDARG. Start empty in every case.
+	if (!m_LibraryData.empty() &&
+		FAILED(m_Device1->CreatePipelineLibrary(m_LibraryData.data(), m_LibraryData.size(), IID_PPV_ARGS(&m_Library))))
+	{
+		m_Library = nullptr;
+		m_LibraryData.clear();
+	}
+}
+
+HRESULT PipelineStateCache::CreatePipeline(PipelineKey key, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	// Loads of different names are safe to run in parallel, each key is only loaded once.
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	if (m_Library != nullptr &&
+		SUCCEEDED(m_Library->LoadGraphicsPipeline(GetPipelineName(key).c_str(), &desc, IID_PPV_ARGS(&pipelineState))))
+	{
+		m_LibraryHits.fetch_add(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		const HRESULT result = m_Device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState));
+		if (FAILED(result))
+		{
+			return result;
+		}
+		m_Creates.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	ASSERTMSG(m_Pipelines.find(key) == m_Pipelines.end(), "Pipeline created twice, or two descriptions share a key");
+	m_Pipelines[key] = pipelineState;
+	return S_OK;
+}
+
+ID3D12PipelineState* PipelineStateCache::Get(PipelineKey key) const
+{
+	const auto it = m_Pipelines.find(key);
+	ASSERTMSG(it != m_Pipelines.end(), "Pipeline has not been created");
+	return it != m_Pipelines.end() ? it->second.Get() : nullptr;
+}
+
+void PipelineStateCache::Save()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_Device1 == nullptr || m_Creates.load(std::memory_order_relaxed) == 0)
+	{
+		return;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> library;
+	if (FAILED(m_Device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&library))))
+	{
+		return;
+	}
+	for (const auto& pipeline : m_Pipelines)
+	{
+		if (FAILED(library->StorePipeline(GetPipelineName(pipeline.first).c_str(), pipeline.second.Get())))
+		{
+			return;
+		}
+	}
+
+	std::vector<u8> data(library->GetSerializedSize());
+	if (data.empty() || FAILED(library->Serialize(data.data(), data.size())))
+	{
+		return;
+	}
+
+	// Failures are ignored, the pipelines are just created again next run.
+	std::error_code error;
+	std::filesystem::create_directories(m_LibraryPath.parent_path(), error);
+	WriteFileAtomic(m_LibraryPath, nullptr, 0, data.data(), data.size());
+}
+
+PipelineStateCacheStats PipelineStateCache::GetStats() const
+{
+	PipelineStateCacheStats stats;
+	stats.m_LibraryHits = m_LibraryHits.load(std::memory_order_relaxed);
+	stats.m_Creates = m_Creates.load(std::memory_order_relaxed);
+	return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+
+#include <wrl/client.h>
+
+#include "PipelineHash.h"
+
+struct PipelineStateCacheStats
+{
+	u32 m_LibraryHits = 0;
+	u32 m_Creates = 0;
+};
+
+// Pipeline states looked up by the key of their description, backed by an ID3D12PipelineLibrary
+// that is persisted between runs. Pipelines found in the library skip driver compilation.
+// A library written by another driver or a corrupt file is dropped and rebuilt, and devices
+// without ID3D12Device1 just create every pipeline.
+// CreatePipeline can be called from several threads. Get is lock free, so it must not overlap
+// CreatePipeline calls.
+class PipelineStateCache
+{
+public:
+	PipelineStateCache(ID3D12Device* device, const std::filesystem::path& libraryPath);
+	PipelineStateCache(const PipelineStateCache& rhs) = delete;
+	PipelineStateCache& operator=(const PipelineStateCache& rhs) = delete;
+
+	HRESULT CreatePipeline(PipelineKey key, const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+	ID3D12PipelineState* Get(PipelineKey key) const;
+
+	// Writes a library holding only the pipelines used this run, so stale entries do not pile up.
+	// Does nothing when every pipeline came from the library.
+	void Save();
+
+	PipelineStateCacheStats GetStats() const;
+
+private:
+	void LoadLibrary();
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_Device;
+	Microsoft::WRL::ComPtr<ID3D12Device1> m_Device1;
+	std::filesystem::path m_LibraryPath;
+
+	// The library reads from this for as long as it lives, so it is declared first.
+	std::vector<u8> m_LibraryData;
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> m_Library;
+
+	std::unordered_map<PipelineKey, Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_Pipelines;
+
+	std::atomic<u32> m_LibraryHits = 0;
+	std::atomic<u32> m_Creates = 0;
+
+	// Guards m_Pipelines.
+	mutable std::mutex m_Mutex;
+};
@@ -0,0 +1,384 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+namespace
+{
+	const u32 c_WriteStates = (u32)RGResourceState::RenderTarget | (u32)RGResourceState::UnorderedAccess |
+		(u32)RGResourceState::DepthWrite | (u32)RGResourceState::CopyDest;
+
+	bool IsReadOnlyState(RGResourceState state)
+	{
+		return state != RGResourceState::Common && ((u32)state & c_WriteStates) == 0;
+	}
+
+	u64 AlignUp(u64 value, u64 alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool LifetimesOverlap(const RGResource& a, const RGResource& b)
+	{
+		return a.m_FirstPass <= b.m_LastPass && b.m_FirstPass <= a.m_LastPass;
+	}
+
+	bool MemoryOverlaps(u64 offsetA, u64 sizeA, u64 offsetB, u64 sizeB)
+	{
+		return offsetA < offsetB + sizeB && offsetB < offsetA + sizeA;
+	}
+}
+
+void RenderGraph::Reset()
+{
+	m_Passes.clear();
+	m_Resources.clear();
+	m_FinalBarriers.clear();
+	m_TransientHeapSize = 0;
+}
+
+RGResourceHandle RenderGraph::ImportResource(const std::string& name, RGResourceState initialState, RGResourceState finalState)
+{
+	RGResource resource;
+	resource.m_Name = name;
+	resource.m_Imported = true;
+	resource.m_InitialState = initialState;
+	resource.m_FinalState = finalState;
+	m_Resources.push_back(resource);
+
+	return (RGResourceHandle)m_Resources.size() - 1;
+}
+
+RGResourceHandle RenderGraph::CreateTransient(const std::string& name, const RGResourceDesc& desc)
+{
+	ASSERTMSG(desc.m_SizeInBytes > 0 && desc.m_Alignment > 0, "Transient resource needs a size and alignment");
+
+	RGResource resource;
+	resource.m_Name = name;
+	resource.m_Desc = desc;
+	m_Resources.push_back(resource);
+
+	return (RGResourceHandle)m_Resources.size() - 1;
+}
+
+RGPassHandle RenderGraph::AddPass(const std::string& name, bool hasSideEffects)
+{
+	RGPass pass;
+	pass.m_Name = name;
+	pass.m_HasSideEffects = hasSideEffects;
+	m_Passes.push_back(pass);
+
+	return (RGPassHandle)m_Passes.size() - 1;
+}
+
+void RenderGraph::Read(RGPassHandle pass, RGResourceHandle resource, RGResourceState state)
+{
+	assert(pass < m_Passes.size() && resource < m_Resources.size());
+
+	// Several reads of one resource in a pass combine into a single read state.
+	for (RGAccess& access : m_Passes[pass].m_Accesses)
+	{
+		if (access.m_Resource == resource)
+		{
+			if (!access.m_Write)
+			{
+				access.m_State = access.m_State | state;
+			}
+			return;
+		}
+	}
+
+	m_Passes[pass].m_Accesses.push_back({ resource, state, false });
+}
+
+void RenderGraph::Write(RGPassHandle pass, RGResourceHandle resource, RGResourceState state)
+{
+	assert(pass < m_Passes.size() && resource < m_Resources.size());
+
+	// A write replaces any read of the same resource, the write state has to cover both.
+	for (RGAccess& access : m_Passes[pass].m_Accesses)
+	{
+		if (access.m_Resource == resource)
+		{
+			ASSERTMSG(!access.m_Write || access.m_State == state, "Resource written in two different states in one pass");
+			access.m_State = state;
+			access.m_Write = true;
+			return;
+		}
+	}
+
+	m_Passes[pass].m_Accesses.push_back({ resource, state, true });
+}
+
+void RenderGraph::Compile()
+{
+	for (RGPass& pass : m_Passes)
+	{
+		pass.m_Culled = false;
+		pass.m_Barriers.clear();
+	}
+	m_FinalBarriers.clear();
+
+	CullPasses();
+	ComputeLifetimes();
+	AllocateTransients();
+	BuildBarriers();
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walk backwards from the passes whose output leaves the graph. Imported resources are always
+	// needed, transient ones only once a surviving later pass reads them.
+	std::vector<bool> needed(m_Resources.size());
+	for (size_t i = 0; i < m_Resources.size(); ++i)
+	{
+		needed[i] = m_Resources[i].m_Imported;
+	}
+
+	for (size_t p = m_Passes.size(); p-- > 0;)
+	{
+		RGPass& pass = m_Passes[p];
+
+		bool keep = pass.m_HasSideEffects;
+		for (const RGAccess& access : pass.m_Accesses)
+		{
+			if (access.m_Write && needed[access.m_Resource])
+			{
+				keep = true;
+				break;
+			}
+		}
+
+		pass.m_Culled = !keep;
+		if (!keep)
+		{
+			continue;
+		}
+
+		for (const RGAccess& access : pass.m_Accesses)
+		{
+			if (!access.m_Write)
+			{
+				needed[access.m_Resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::ComputeLifetimes()
+{
+	for (RGResource& resource : m_Resources)
+	{
+		resource.m_FirstPass = c_InvalidRGHandle;
+		resource.m_LastPass = c_InvalidRGHandle;
+		resource.m_HeapOffset = 0;
+	}
+
+	for (u32 p = 0; p < (u32)m_Passes.size(); ++p)
+	{
+		if (m_Passes[p].m_Culled)
+		{
+			continue;
+		}
+
+		for (const RGAccess& access : m_Passes[p].m_Accesses)
+		{
+			RGResource& resource = m_Resources[access.m_Resource];
+			if (resource.m_FirstPass == c_InvalidRGHandle)
+			{
+				resource.m_FirstPass = p;
+			}
+			resource.m_LastPass = p;
+		}
+	}
+}
+
+void RenderGraph::AllocateTransients()
+{
+	m_TransientHeapSize = 0;
+
+	std::vector<RGResourceHandle> transients;
+	for (u32 i = 0; i < (u32)m_Resources.size(); ++i)
+	{
+		if (!m_Resources[i].m_Imported && m_Resources[i].m_FirstPass != c_InvalidRGHandle)
+		{
+			transients.push_back(i);
+		}
+	}
+
+	// Place the largest resources first, they are the hardest to fit around the others.
+	std::stable_sort(transients.begin(), transients.end(), [this](RGResourceHandle a, RGResourceHandle b)
+	{
+		return m_Resources[a].m_Desc.m_SizeInBytes > m_Resources[b].m_Desc.m_SizeInBytes;
+	});
+
+	std::vector<RGResourceHandle> placed;
+	for (RGResourceHandle handle : transients)
+	{
+		RGResource& resource = m_Resources[handle];
+
+		// Memory is only shared with resources whose lifetimes do not overlap, so the candidates
+		// are the start of the heap and the end of every live neighbour.
+		std::vector<u64> candidates = { 0 };
+		for (RGResourceHandle other : placed)
+		{
+			const RGResource& otherResource = m_Resources[other];
+			if (LifetimesOverlap(resource, otherResource))
+			{
+				candidates.push_back(AlignUp(otherResource.m_HeapOffset + otherResource.m_Desc.m_SizeInBytes, resource.m_Desc.m_Alignment));
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for (u64 offset : candidates)
+		{
+			bool fits = true;
+			for (RGResourceHandle other : placed)
+			{
+				const RGResource& otherResource = m_Resources[other];
+				if (LifetimesOverlap(resource, otherResource) &&
+					MemoryOverlaps(offset, resource.m_Desc.m_SizeInBytes, otherResource.m_HeapOffset, otherResource.m_Desc.m_SizeInBytes))
+				{
+					fits = false;
+					break;
+				}
+			}
+
+			if (fits)
+			{
+				resource.m_HeapOffset = offset;
+				break;
+			}
+		}
+
+		placed.push_back(handle);
+		m_TransientHeapSize = std::max(m_TransientHeapSize, resource.m_HeapOffset + resource.m_Desc.m_SizeInBytes);
+	}
+}
+
+void RenderGraph::BuildBarriers()
+{
+	std::vector<RGResourceState> currentState(m_Resources.size());
+
+	// Unordered access work since the last barrier on each resource, by passes already visited.
+	std::vector<bool> uavWritten(m_Resources.size());
+	std::vector<bool> uavRead(m_Resources.size());
+
+	for (size_t i = 0; i < m_Resources.size(); ++i)
+	{
+		currentState[i] = m_Resources[i].m_InitialState;
+	}
+
+	for (u32 p = 0; p < (u32)m_Passes.size(); ++p)
+	{
+		RGPass& pass = m_Passes[p];
+		if (pass.m_Culled)
+		{
+			continue;
+		}
+
+		for (const RGAccess& access : pass.m_Accesses)
+		{
+			RGResource& resource = m_Resources[access.m_Resource];
+			const bool unorderedAccess = access.m_State == RGResourceState::UnorderedAccess;
+
+			if (!resource.m_Imported && resource.m_FirstPass == p)
+			{
+				// A transient is created in the state of its first access, but has to wait for the
+				// last resource that used the same memory to finish with it.
+				resource.m_CreateState = access.m_State;
+				currentState[access.m_Resource] = access.m_State;
+
+				RGResourceHandle aliasBefore = c_InvalidRGHandle;
+				for (u32 other = 0; other < (u32)m_Resources.size(); ++other)
+				{
+					const RGResource& otherResource = m_Resources[other];
+					if (otherResource.m_Imported || otherResource.m_FirstPass == c_InvalidRGHandle || otherResource.m_LastPass >= p)
+					{
+						continue;
+					}
+
+					if (MemoryOverlaps(resource.m_HeapOffset, resource.m_Desc.m_SizeInBytes, otherResource.m_HeapOffset, otherResource.m_Desc.m_SizeInBytes) &&
+						(aliasBefore == c_InvalidRGHandle || otherResource.m_LastPass > m_Resources[aliasBefore].m_LastPass))
+					{
+						aliasBefore = other;
+					}
+				}
+
+				if (aliasBefore != c_InvalidRGHandle)
+				{
+					RGBarrier barrier;
+					barrier.m_Type = RGBarrierType::Aliasing;
+					barrier.m_Resource = access.m_Resource;
+					barrier.m_AliasBefore = aliasBefore;
+					pass.m_Barriers.push_back(barrier);
+				}
+
+				uavWritten[access.m_Resource] = unorderedAccess && access.m_Write;
+				uavRead[access.m_Resource] = unorderedAccess && !access.m_Write;
+				continue;
+			}
+
+			const RGResourceState current = currentState[access.m_Resource];
+			if (current == access.m_State)
+			{
+				// Staying in UnorderedAccess does not order anything, a pass that reads what an
+				// earlier one wrote, or writes what it read or wrote, waits on a UAV barrier.
+				if (unorderedAccess)
+				{
+					if (uavWritten[access.m_Resource] || (access.m_Write && uavRead[access.m_Resource]))
+					{
+						RGBarrier barrier;
+						barrier.m_Type = RGBarrierType::UnorderedAccess;
+						barrier.m_Resource = access.m_Resource;
+						pass.m_Barriers.push_back(barrier);
+
+						uavWritten[access.m_Resource] = false;
+						uavRead[access.m_Resource] = false;
+					}
+					uavWritten[access.m_Resource] = uavWritten[access.m_Resource] || access.m_Write;
+					uavRead[access.m_Resource] = uavRead[access.m_Resource] || !access.m_Write;
+				}
+				continue;
+			}
+
+			// A combined read state such as GenericRead already covers any read it contains.
+			if (!access.m_Write && IsReadOnlyState(current) && ((u32)current & (u32)access.m_State) == (u32)access.m_State)
+			{
+				continue;
+			}
+
+			// Reads of an imported resource go straight to its final state when that covers them,
+			// which saves a transition at the end of the frame.
+			RGResourceState after = access.m_State;
+			if (!access.m_Write && resource.m_Imported && IsReadOnlyState(resource.m_FinalState) &&
+				((u32)resource.m_FinalState & (u32)after) == (u32)after)
+			{
+				after = resource.m_FinalState;
+			}
+
+			RGBarrier barrier;
+			barrier.m_Resource = access.m_Resource;
+			barrier.m_Before = current;
+			barrier.m_After = after;
+			pass.m_Barriers.push_back(barrier);
+
+			// The transition waits for all earlier work on the resource.
+			currentState[access.m_Resource] = after;
+			uavWritten[access.m_Resource] = unorderedAccess && access.m_Write;
+			uavRead[access.m_Resource] = unorderedAccess && !access.m_Write;
+		}
+	}
+
+	for (u32 i = 0; i < (u32)m_Resources.size(); ++i)
+	{
+		const RGResource& resource = m_Resources[i];
+		if (resource.m_Imported && currentState[i] != resource.m_FinalState)
+		{
+			RGBarrier barrier;
+			barrier.m_Resource = i;
+			barrier.m_Before = currentState[i];
+			barrier.m_After = resource.m_FinalState;
+			m_FinalBarriers.push_back(barrier);
+		}
+	}
+}
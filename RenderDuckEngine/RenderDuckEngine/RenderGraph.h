@@ -0,0 +1,141 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <string>
+
+// Resource states understood by the render graph. Values match D3D12_RESOURCE_STATES so the
+// renderer can cast them straight through, but the graph itself never touches the device.
+enum class RGResourceState : u32
+{
+	Common = 0,
+	Present = 0,
+	RenderTarget = 0x4,
+	UnorderedAccess = 0x8,
+	DepthWrite = 0x10,
+	DepthRead = 0x20,
+	NonPixelShaderResource = 0x40,
+	PixelShaderResource = 0x80,
+	CopyDest = 0x400,
+	CopySource = 0x800,
+	GenericRead = 0xac3
+};
+
+inline RGResourceState operator|(RGResourceState a, RGResourceState b) { return (RGResourceState)((u32)a | (u32)b); }
+
+typedef u32 RGResourceHandle;
+typedef u32 RGPassHandle;
+
+const u32 c_InvalidRGHandle = UINT32_MAX;
+
+// Memory requirements of a transient resource, as reported by GetResourceAllocationInfo.
+struct RGResourceDesc
+{
+	u64 m_SizeInBytes = 0;
+	u64 m_Alignment = 65536;
+};
+
+struct RGResource
+{
+	std::string m_Name;
+	RGResourceDesc m_Desc;
+
+	// Imported resources are owned elsewhere and persist across frames. They start the frame in
+	// m_InitialState and are returned to m_FinalState once the graph has executed.
+	bool m_Imported = false;
+	RGResourceState m_InitialState = RGResourceState::Common;
+	RGResourceState m_FinalState = RGResourceState::Common;
+
+	// Filled in by Compile. Lifetime is the range of non-culled passes that use the resource.
+	u32 m_FirstPass = c_InvalidRGHandle;
+	u32 m_LastPass = c_InvalidRGHandle;
+
+	// Transient resources only: offset into the shared heap, and the state the resource should be
+	// created in (the state of its first access).
+	u64 m_HeapOffset = 0;
+	RGResourceState m_CreateState = RGResourceState::Common;
+};
+
+struct RGAccess
+{
+	RGResourceHandle m_Resource;
+	RGResourceState m_State;
+	bool m_Write;
+};
+
+enum class RGBarrierType : u32
+{
+	Transition,
+	Aliasing,
+
+	// Orders unordered access work of two passes on a resource that stays in UnorderedAccess.
+	UnorderedAccess
+};
+
+struct RGBarrier
+{
+	RGBarrierType m_Type = RGBarrierType::Transition;
+	RGResourceHandle m_Resource = c_InvalidRGHandle;
+
+	// Transition barriers.
+	RGResourceState m_Before = RGResourceState::Common;
+	RGResourceState m_After = RGResourceState::Common;
+
+	// Aliasing barriers: the resource that previously occupied the memory.
+	RGResourceHandle m_AliasBefore = c_InvalidRGHandle;
+};
+
+struct RGPass
+{
+	std::string m_Name;
+	std::vector<RGAccess> m_Accesses;
+
+	// Passes with side effects outside the graph are never culled.
+	bool m_HasSideEffects = false;
+
+	// Filled in by Compile.
+	bool m_Culled = false;
+	std::vector<RGBarrier> m_Barriers;
+};
+
+// Collects passes and the resources they read and write, then works out which passes are needed,
+// the barriers to issue before each one and where transient resources can share memory.
+// Rebuilt every frame: Reset, declare resources and passes in execution order, Compile, then
+// record each pass after issuing GetPassBarriers(pass) in a single ResourceBarrier call.
+class RenderGraph
+{
+public:
+	void Reset();
+
+	RGResourceHandle ImportResource(const std::string& name, RGResourceState initialState, RGResourceState finalState);
+	RGResourceHandle CreateTransient(const std::string& name, const RGResourceDesc& desc);
+
+	RGPassHandle AddPass(const std::string& name, bool hasSideEffects = false);
+	void Read(RGPassHandle pass, RGResourceHandle resource, RGResourceState state);
+	void Write(RGPassHandle pass, RGResourceHandle resource, RGResourceState state);
+
+	void Compile();
+
+	bool IsPassCulled(RGPassHandle pass) const { return m_Passes[pass].m_Culled; }
+	const std::vector<RGBarrier>& GetPassBarriers(RGPassHandle pass) const { return m_Passes[pass].m_Barriers; }
+
+	// Transitions returning imported resources to their final state, issued after the last pass.
+	const std::vector<RGBarrier>& GetFinalBarriers() const { return m_FinalBarriers; }
+
+	// Size of the heap every transient resource is placed in, 0 if none are used.
+	u64 GetTransientHeapSize() const { return m_TransientHeapSize; }
+
+	const std::vector<RGPass>& GetPasses() const { return m_Passes; }
+	const std::vector<RGResource>& GetResources() const { return m_Resources; }
+
+private:
+	void CullPasses();
+	void ComputeLifetimes();
+	void AllocateTransients();
+	void BuildBarriers();
+
+	std::vector<RGPass> m_Passes;
+	std::vector<RGResource> m_Resources;
+	std::vector<RGBarrier> m_FinalBarriers;
+
+	u64 m_TransientHeapSize = 0;
+};
@@ -1,8 +1,12 @@
 #pragma once
 #include "Settings.h"
+#include "FramePacer.h"
 
 PROPERTY_CONFIG_BEGIN(RenderSettings)
 	PROPERTY(ImVec4, MainViewportClearColour, ImVec4(30.f / 255.f, 30.f / 255.f, 30.f / 255.f, 1.f))
+	PROPERTY(u32, MaxFramesInFlight, 3u)
+	PROPERTY(bool, LowLatencyMode, false)
+	PROPERTY(u32, TextureStreamingBudgetMB, 64u)
 PROPERTY_CONFIG_END
 
 class IRenderSettings
@@ -10,6 +14,7 @@ class IRenderSettings
 public:
 	virtual void SetRenderToMainRTV(bool renderToMainRTV) = 0;
 	virtual RenderSettings& GetRenderSettings() = 0;
+	virtual const FramePacingReport& GetFramePacingReport() const = 0;
 };
 
 typedef std::shared_ptr<IRenderSettings> RendererInterfaceRef;
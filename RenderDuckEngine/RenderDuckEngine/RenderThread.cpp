@@ -0,0 +1,139 @@
+#include "RenderThread.h"
+
+#include <chrono>
+#include <emmintrin.h>
+
+namespace
+{
+	// Spins with pause for a few iterations, yields for a few milliseconds, then sleeps.
+	const u32 c_PauseSpins = 64;
+	const std::chrono::milliseconds c_YieldTime(4);
+	const std::chrono::milliseconds c_SleepTime(1);
+
+	template<typename Predicate>
+	void SpinUntil(Predicate done)
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (u32 spin = 0; !done(); ++spin)
+		{
+			if (spin < c_PauseSpins)
+			{
+				_mm_pause();
+			}
+			else if (std::chrono::steady_clock::now() - start < c_YieldTime)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				std::this_thread::sleep_for(c_SleepTime);
+			}
+		}
+	}
+}
+
+RenderThread::~RenderThread()
+{
+	Stop();
+}
+
+void RenderThread::Start(FrameFunc frameFunc)
+{
+	ASSERTMSG(!IsRunning(), "Render thread is already running");
+
+	m_FrameFunc = std::move(frameFunc);
+	m_Stop.store(false, std::memory_order_relaxed);
+	m_Thread = std::thread(&RenderThread::Run, this);
+}
+
+void RenderThread::Stop()
+{
+	if (!IsRunning())
+	{
+		return;
+	}
+
+	m_Stop.store(true, std::memory_order_release);
+	m_Thread.join();
+}
+
+void RenderThread::Run()
+{
+	try
+	{
+		while (!m_Stop.load(std::memory_order_acquire))
+		{
+			m_FrameFunc();
+		}
+	}
+	catch (...)
+	{
+		m_FrameError = std::current_exception();
+		m_Failed.store(true, std::memory_order_release);
+	}
+}
+
+void RenderThread::RethrowFrameError()
+{
+	if (m_Failed.exchange(false, std::memory_order_acquire))
+	{
+		std::rethrow_exception(m_FrameError);
+	}
+}
+
+void RenderThread::WaitForAcquire()
+{
+	if (!IsRunning())
+	{
+		return;
+	}
+
+	SpinUntil([this]()
+	{
+		return m_AcquiredFrame.load(std::memory_order_acquire) == m_PublishedFrame.load(std::memory_order_relaxed) ||
+			m_Failed.load(std::memory_order_relaxed);
+	});
+	RethrowFrameError();
+}
+
+void RenderThread::Publish()
+{
+	// Release makes everything written for the frame visible to the render thread.
+	m_PublishedFrame.fetch_add(1, std::memory_order_release);
+}
+
+void RenderThread::WaitForIdle()
+{
+	if (!IsRunning())
+	{
+		return;
+	}
+
+	SpinUntil([this]()
+	{
+		return m_RenderedFrame.load(std::memory_order_acquire) == m_PublishedFrame.load(std::memory_order_relaxed) ||
+			m_Failed.load(std::memory_order_relaxed);
+	});
+	RethrowFrameError();
+}
+
+bool RenderThread::WaitForPublish()
+{
+	SpinUntil([this]()
+	{
+		return m_PublishedFrame.load(std::memory_order_acquire) != m_AcquiredFrame.load(std::memory_order_relaxed) ||
+			m_Stop.load(std::memory_order_relaxed);
+	});
+	return !m_Stop.load(std::memory_order_acquire);
+}
+
+void RenderThread::MarkAcquired()
+{
+	// The simulation waits for this before publishing again, so there is exactly one new frame.
+	m_AcquiredFrame.store(m_PublishedFrame.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+void RenderThread::MarkRendered()
+{
+	m_RenderedFrame.store(m_AcquiredFrame.load(std::memory_order_relaxed), std::memory_order_release);
+}
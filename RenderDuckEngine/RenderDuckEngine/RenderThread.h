@@ -0,0 +1,62 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+
+// Runs the frame function on its own thread, one frame behind the simulation thread.
+// The simulation thread fills in a snapshot, calls Publish, and calls WaitForAcquire before it
+// starts the next one, so it is never more than one frame ahead. The render thread calls
+// WaitForPublish, takes the snapshot, calls MarkAcquired as soon as it no longer needs the
+// simulation to hold still, and MarkRendered once the frame is submitted.
+// Hand overs are atomic frame counters. Waits spin briefly, then yield, then sleep, so an idle
+// side does not burn a core while the other is paused.
+class RenderThread
+{
+public:
+	typedef std::function<void()> FrameFunc;
+
+	RenderThread() = default;
+	RenderThread(const RenderThread& rhs) = delete;
+	RenderThread& operator=(const RenderThread& rhs) = delete;
+	~RenderThread();
+
+	void Start(FrameFunc frameFunc);
+
+	// Lets the current frame finish and joins the thread.
+	void Stop();
+
+	bool IsRunning() const { return m_Thread.joinable(); }
+
+	// Simulation thread. Waits rethrow any exception thrown by the frame function.
+	void WaitForAcquire();
+	void Publish();
+
+	// Blocks until every published frame has been submitted, for work such as resizing the swap
+	// chain that must not overlap recording.
+	void WaitForIdle();
+
+	// Render thread. WaitForPublish returns false when the thread is stopping.
+	bool WaitForPublish();
+	void MarkAcquired();
+	void MarkRendered();
+
+private:
+	void Run();
+	void RethrowFrameError();
+
+	std::thread m_Thread;
+	FrameFunc m_FrameFunc;
+
+	std::atomic<u64> m_PublishedFrame = 0;
+	std::atomic<u64> m_AcquiredFrame = 0;
+	std::atomic<u64> m_RenderedFrame = 0;
+
+	std::atomic<bool> m_Stop = false;
+
+	// Set by the render thread if the frame function throws, handed to the simulation thread.
+	std::atomic<bool> m_Failed = false;
+	std::exception_ptr m_FrameError;
+};
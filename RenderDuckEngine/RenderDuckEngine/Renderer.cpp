@@ -4,20 +4,116 @@
 
 #include "Renderer.h"
 
-#include "UploadBuffer.h"
+#include <map>
+#include <unordered_set>
+
 #include "GeometryGenerator.h"
 #include "EngineUtils.h"
+#include "Hash.h"
+#include "TextureAtlas.h"
+#include "WicImageDecoder.h"
 
 const int gNumFrameResources = 3;
 const u32 c_MaxSrvDescriptors = 10000;
 
+// The SRV heap is split into this many independently locked shards, see DescriptorAllocator.
+const u32 c_SrvHeapShards = 8;
+
+// Descriptors each frame can allocate for tables it rebuilds every frame, after the persistent ones.
+const u32 c_TransientSrvDescriptorsPerFrame = 256;
+const u32 c_SrvHeapSize = c_MaxSrvDescriptors + c_TransientSrvDescriptorsPerFrame * gNumFrameResources;
+
+// Opaque passes are only split across recording workers once they have this many items per list.
+const u32 c_MinItemsPerRecordTask = 64;
+
+// Number of horizontal + vertical blur iterations applied to the SSAO map.
+const u32 c_SsaoBlurCount = 0;
+
+// Projected geometric error, in pixels, a LOD level may have before a finer one is used.
+const float c_LodErrorThreshold = 1.0f;
+
+// The shadow map is lower frequency than the main view, so shadows use this many coarser levels.
+const u32 c_ShadowLodBias = 1;
+
+// Size of the ring every frame suballocates its constants from, shared by all frames in flight.
+const u64 c_FrameUploadHeapSize = 8 * 1024 * 1024;
+
+// Size of the staging ring used to copy static buffers and textures on the copy queue.
+const u64 c_UploadStagingSize = 32 * 1024 * 1024;
+
+// Streamed textures start with only the mips no larger than this, and are never dropped below them.
+const u32 c_StreamedTextureInitialSize = 64;
+
+// Texture reloads in flight at once, so streaming does not flood the copy queue.
+const u32 c_MaxTextureStreamingRequests = 4;
+
+// Closest distance texel density is measured at, so the eye inside an item's bounds stays finite.
+const float c_MinTextureStreamingDistance = 0.1f;
+
+// Compiled shaders are kept here between runs, relative to the working directory like the shaders.
+const char* c_ShaderCacheDirectory = "ShaderCache";
+
+// Serialized pipeline states, stored with the shader cache since it is invalidated the same way.
+const char* c_PipelineLibraryFile = "PipelineLibrary.bin";
+
+// Cooked textures are kept here between runs, next to the shader cache.
+const char* c_TextureCacheDirectory = "TextureCache";
+
+// Materials whose textures are no larger than this share atlas pages, when nothing tiles them.
+const u32 c_AtlasMaxTextureSize = 256;
+
+// Bump whenever atlas pages are built differently, so older pages in the cache are rebuilt.
+const u32 c_AtlasVersion = 1;
+
+namespace
+{
+    float MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    TextureUsage GetTextureUsage(const Texture& texture)
+    {
+        return texture.IsNormalMap ? TextureUsage::NormalMap : TextureUsage::Colour;
+    }
+
+    // Whether UVs in the unit square stay inside it, which is all an atlas region can hold.
+    bool KeepsUvsInUnitSquare(FXMMATRIX uvTransform)
+    {
+        const float epsilon = 1e-4f;
+        for (u32 corner = 0; corner < 4; ++corner)
+        {
+            const XMVECTOR uv = XMVector4Transform(XMVectorSet((float)(corner & 1), (float)(corner >> 1), 0.0f, 1.0f), uvTransform);
+            const float u = XMVectorGetX(uv);
+            const float v = XMVectorGetY(uv);
+            if (u < -epsilon || u > 1.0f + epsilon || v < -epsilon || v > 1.0f + epsilon)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // jobMs is the sum of every job's own time, what the stage would take on one thread.
+    void LogStartupStage(const char* stage, u32 jobCount, float wallMs, float jobMs)
+    {
+        char text[256];
+        snprintf(text, sizeof(text), "Startup: %s, %u jobs, %.2f ms wall clock, %.2f ms in jobs\n", stage, jobCount, wallMs, jobMs);
+        OutputDebugStringA(text);
+    }
+}
+
 
 Renderer::Renderer(HINSTANCE hInstance)
     : D3DApp(hInstance)
-    , m_DescriptorCount(0)
-    , m_MainRTVIndex(-1)
-    , m_MainSRVIndex(-1)
+    , m_RenderToRTV(false)
 {
+    m_JobSystem = std::make_unique<JobSystem>();
+    m_CommandRecorder = std::make_unique<ParallelCommandRecorder>(m_JobSystem.get());
+    m_OcclusionCuller = std::make_unique<OcclusionCuller>(m_JobSystem.get());
+    m_ShaderCompiler = std::make_unique<D3DShaderCompiler>();
+    m_ShaderCache = std::make_unique<ShaderCache>(m_ShaderCompiler.get(), c_ShaderCacheDirectory);
+
     // Estimate the scene bounding sphere manually since we know how the scene was constructed.
     // The grid is the "widest object" with a width of 20 and depth of 30.0f, and centered at
     // the world space origin.  In general, you need to loop over every world space vertex
@@ -28,8 +124,21 @@ Renderer::Renderer(HINSTANCE hInstance)
 
 Renderer::~Renderer()
 {
+    m_RenderThread.Stop();
+
+    // Initialization can throw while shaders are still compiling into m_PendingShaders.
+    m_JobSystem->Wait(m_ShaderCounter);
+
+    // The image pool drops textures the last frames may still sample.
     if(m_d3dDevice != nullptr)
         FlushCommandQueue();
+
+    // Texture and image jobs stage into the upload queue, so they have to finish before it goes.
+    m_TextureLoader.reset();
+    m_ImageDecodePool.reset();
+
+    // ImGui frees its descriptors on shutdown, which needs the heap still alive.
+    m_UIManager.reset();
 }
 
 bool Renderer::Initialize()
@@ -40,34 +149,49 @@ bool Renderer::Initialize()
     // Reset the command list to prep for initialization commands.
     ThrowIfFailed(m_CommandList->Reset(m_DirectCmdListAlloc.Get(), nullptr));
 
+    // Starts shader compilation on the workers, BuildPSOs joins it.
+    BuildShadersAndInputLayout();
+
 	m_Camera.SetPosition(0.0f, 2.0f, -15.0f);
  
     m_ShadowMap = std::make_unique<ShadowMap>(m_d3dDevice.Get(),
         2048, 2048);
 
+    m_FrameTimeline = std::make_unique<FenceTimeline>(m_Fence.Get());
+    m_UploadQueue = std::make_unique<UploadQueue>(m_d3dDevice.Get(), c_UploadStagingSize);
+    m_ImageDecodePool = std::make_unique<ImageDecodePool>(m_d3dDevice.Get(), m_JobSystem.get(), m_UploadQueue.get(), m_FrameTimeline.get(), DecodeImageWic);
+
     m_Ssao = std::make_unique<Ssao>(
         m_d3dDevice.Get(),
-        m_CommandList.Get(),
+        m_UploadQueue.get(),
         m_ClientWidth, m_ClientHeight);
 
 	LoadTextures();
+    m_RootSignatureCache = std::make_unique<RootSignatureCache>(m_d3dDevice.Get(), c_ShaderCacheDirectory);
     BuildRootSignature();
     BuildSsaoRootSignature();
 	BuildDescriptorHeaps();
-    BuildShadersAndInputLayout();
     BuildShapeGeometry();
     BuildSkullGeometry();
 	BuildMaterials();
     BuildRenderItems();
+    PackMaterialTextures();
+    StartTextureLoads();
+    m_FrameUploadHeap = std::make_unique<FrameUploadHeap>(m_d3dDevice.Get(), m_Fence.Get(), c_FrameUploadHeapSize);
+    m_FramePacer = std::make_unique<FramePacer>(m_FrameTimeline.get(), gNumFrameResources);
     BuildFrameResources();
     BuildPSOs();
 
-    m_Ssao->SetPSOs(m_PSOs["ssao"].Get(), m_PSOs["ssaoBlur"].Get());
+    m_Ssao->SetPSOs(GetPipeline(PipelineId::Ssao), GetPipeline(PipelineId::SsaoBlur));
 
     m_UIManager = std::make_shared<UIManager>();
-    m_UIManager->InitialiseForDX12(MainWnd(), m_d3dDevice.Get(), m_CommandQueue.Get(), m_SrvDescriptorHeap.Get(), s_SwapChainBufferCount, this);
+    m_UIManager->InitialiseForDX12(MainWnd(), m_d3dDevice.Get(), m_CommandQueue.Get(), m_SrvHeap.get(), m_ImageDecodePool.get(), gNumFrameResources, this);
     m_UIManager->InitStyle();
 
+    // Geometry and generated textures were queued on the copy queue, send them in one batch
+    // and make the direct queue wait for it before anything draws with them.
+    m_UploadQueue->WaitOnQueue(m_CommandQueue.Get(), m_UploadQueue->Submit());
+
     // Execute the initialization commands.
     ThrowIfFailed(m_CommandList->Close());
     ID3D12CommandList* cmdsLists[] = { m_CommandList.Get() };
@@ -76,41 +200,15 @@ bool Renderer::Initialize()
     // Wait until initialization is complete.
     FlushCommandQueue();
 
-    return true;
-}
-
-UINT Renderer::AllocateDescriptors(u32 descriptorCount)
-{
-    UINT startIndex = -1;
-    for (int i = 0; i < descriptorCount; ++i)
-    {
-        if (i >  0)
-        {
-            AllocateDescriptor();
-        }
-        else
-        {
-            startIndex = AllocateDescriptor();
-        }
-    }
-
-    return startIndex;
-}
-
-void Renderer::ImGuiAllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* outCpuHandle, D3D12_GPU_DESCRIPTOR_HANDLE* outGpuHandle)
-{
-    s_SrvDescriptorHeapAllocator.Alloc(outCpuHandle, outGpuHandle);
-}
-
-void Renderer::ImGuiFreeDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle, D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle)
-{
-    s_SrvDescriptorHeapAllocator.Free(cpuHandle, gpuHandle);
+    m_RenderThread.Start([this]() { RenderFrame(); });
 
+    return true;
 }
 
 void Renderer::BuildMainRTV()
 {
-    if (m_MainRTVIndex == -1)
+    // The first resize comes from D3DApp::Initialize, before the descriptor heap exists.
+    if (!m_MainSrv.IsValid())
     {
         return;
     }
@@ -152,17 +250,11 @@ void Renderer::BuildMainRTV()
     srvDesc.Texture2D.MostDetailedMip = 0;
     srvDesc.Texture2D.MipLevels = 1;
 
-    m_MainCpuSrv = GetCpuSrv(m_MainRTVIndex);
-    m_MainGpuSrv = GetGpuSrv(m_MainRTVIndex);
+    m_MainGpuSrv = m_SrvHeap->GetGpuHandle(m_MainSrv);
     m_MainCpuRtv = GetRtv(s_SwapChainBufferCount + 3);
 
     m_d3dDevice->CreateRenderTargetView(m_MainRTV.Get(), &rtvDesc, m_MainCpuRtv);
-    m_d3dDevice->CreateShaderResourceView(m_MainRTV.Get(), &srvDesc, m_MainCpuSrv);
-}
-
-UINT Renderer::AllocateDescriptor()
-{
-    return s_SrvDescriptorHeapAllocator.Alloc();
+    m_d3dDevice->CreateShaderResourceView(m_MainRTV.Get(), &srvDesc, m_SrvHeap->GetCpuHandle(m_MainSrv));
 }
 
 void Renderer::CreateRtvAndDsvDescriptorHeaps()
@@ -188,6 +280,9 @@ void Renderer::CreateRtvAndDsvDescriptorHeaps()
  
 void Renderer::OnResize()
 {
+    // The swap chain and screen sized targets are about to be recreated, nothing may be recording.
+    m_RenderThread.WaitForIdle();
+
     D3DApp::OnResize();
 
 	m_Camera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
@@ -205,21 +300,11 @@ void Renderer::OnResize()
 
 void Renderer::Update(const GameTimer& gt)
 {
-    OnKeyboardInput(gt);
+    // Simulation runs at most one frame ahead of rendering. In low latency mode the render thread
+    // only takes the previous frame once the GPU has caught up, so input is read after that wait.
+    m_RenderThread.WaitForAcquire();
 
-    // Cycle through the circular frame resource array.
-    m_CurrFrameResourceIndex = (m_CurrFrameResourceIndex + 1) % gNumFrameResources;
-    m_CurrFrameResource = m_FrameResources[m_CurrFrameResourceIndex].get();
-
-    // Has the GPU finished processing the commands of the current frame resource?
-    // If not, wait until the GPU has completed commands up to this fence point.
-    if(m_CurrFrameResource->Fence != 0 && m_Fence->GetCompletedValue() < m_CurrFrameResource->Fence)
-    {
-        HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
-        ThrowIfFailed(m_Fence->SetEventOnCompletion(m_CurrFrameResource->Fence, eventHandle));
-        WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
-    }
+    OnKeyboardInput(gt);
 
     //
     // Animate the lights (and hence shadows).
@@ -235,158 +320,470 @@ void Renderer::Update(const GameTimer& gt)
         XMStoreFloat3(&m_RotatedLightDirections[i], lightDir);
     }
 
-	AnimateMaterials(gt);
-	UpdateObjectCBs(gt);
-	UpdateMaterialBuffer(gt);
-    UpdateShadowTransform(gt);
-	UpdateMainPassCB(gt);
-    UpdateShadowPassCB(gt);
-    UpdateSsaoCB(gt);
+    RenderSnapshot& snapshot = m_Snapshots.GetWriteSlot();
+
+    // ImGui is not thread safe and gets its input on this thread, so the UI is built here and
+    // only its draw data goes to the render thread.
+    m_FramePacingReports.Acquire();
+    m_ImageDecodePool->Update();
+    m_UIManager->BeginRender();
+
+    // submit debug views
+    m_UIManager->SubmitViewportTexture("Scene Normals", m_Ssao->NormalMapSrv(), m_ClientWidth, m_ClientHeight);
+    m_UIManager->SubmitViewportTexture("SSAO", m_Ssao->AmbientMapSrv(), m_ClientWidth, m_ClientHeight);
+    m_UIManager->SubmitViewportTexture(m_UIManager->GetDefaultViewName(), m_MainGpuSrv, m_ClientWidth, m_ClientHeight);
+
+    m_UIManager->Render();
+    m_UIManager->EndRender(snapshot.m_UIDrawData);
+
+    // After the UI, so settings changed this frame are already in the snapshot.
+    BuildSnapshot(gt, snapshot);
 }
 
 void Renderer::Draw(const GameTimer& gt)
 {
-    const DirectX::XMVECTORF32 mainRtvClearColour = DirectXColorFromImVec4(m_RenderSettings.m_MainViewportClearColour.GetValue());
+    // Recording happens on the render thread while the next frame is simulated.
+    m_Snapshots.Publish();
+    m_RenderThread.Publish();
+}
+
+void Renderer::BuildSnapshot(const GameTimer& gt, RenderSnapshot& snapshot)
+{
+    snapshot.m_TotalTime = gt.TotalTime();
+    snapshot.m_DeltaTime = gt.DeltaTime();
+
+    snapshot.m_Camera = m_Camera;
+    for (int i = 0; i < 3; ++i)
+    {
+        snapshot.m_LightDirections[i] = m_RotatedLightDirections[i];
+    }
 
-    auto cmdListAlloc = m_CurrFrameResource->CmdListAlloc;
+    snapshot.m_ItemWorlds.resize(m_AllRitems.size());
+    for (const auto& ri : m_AllRitems)
+    {
+        snapshot.m_ItemWorlds[ri->m_ObjCBIndex] = ri->m_World;
+    }
+
+    snapshot.m_ClientWidth = m_ClientWidth;
+    snapshot.m_ClientHeight = m_ClientHeight;
+
+    snapshot.m_ClearColour = m_RenderSettings.m_MainViewportClearColour.GetValue();
+    snapshot.m_RenderToRTV = m_RenderToRTV;
+    snapshot.m_MaxFramesInFlight = m_RenderSettings.m_MaxFramesInFlight.GetValue();
+    snapshot.m_LowLatencyMode = m_RenderSettings.m_LowLatencyMode.GetValue();
+    snapshot.m_TextureStreamingBudgetMB = m_RenderSettings.m_TextureStreamingBudgetMB.GetValue();
+}
+
+void Renderer::RenderFrame()
+{
+    // In low latency mode the wait for the GPU happens here, before the next snapshot is taken.
+    m_FramePacer->BeginFrame();
 
+    if (!m_RenderThread.WaitForPublish())
+    {
+        return;
+    }
+
+    // The simulation only publishes after the previous frame was acquired, so there is always
+    // exactly one new snapshot. Once it is ours the simulation can move on to the next frame.
+    const bool acquired = m_Snapshots.Acquire();
+    ASSERTMSG(acquired, "Render thread woke up without a new snapshot");
+    m_FrameSnapshot = &m_Snapshots.GetReadSlot();
+    m_RenderThread.MarkAcquired();
+
+    const RenderSnapshot& frame = *m_FrameSnapshot;
+
+    // Wait until the GPU is done with this frame's resources, unless that already happened above.
+    m_FramePacer->SetMaxFramesInFlight(frame.m_MaxFramesInFlight);
+    m_FramePacer->SetLowLatencyMode(frame.m_LowLatencyMode);
+    m_FramePacer->WaitForFrameResources();
+    m_CurrFrameResourceIndex = m_FramePacer->GetFrameResourceIndex();
+    m_CurrFrameResource = m_FrameResources[m_CurrFrameResourceIndex].get();
+    m_SrvHeap->BeginFrame(m_CurrFrameResourceIndex);
+
+    // Swap in textures whose uploads have landed before the material buffer is written.
+    UpdateTextureLoads();
+
+    // Release the upload memory of every frame the GPU has finished, then take this frame's constants.
+    m_FrameUploadHeap->Retire();
+    m_CurrFrameResource->PassCB = m_FrameUploadHeap->AllocateConstants<PassConstants>(2);
+    m_CurrFrameResource->ObjectCB = m_FrameUploadHeap->AllocateConstants<ObjectConstants>((u32)m_AllRitems.size());
+    m_CurrFrameResource->SsaoCB = m_FrameUploadHeap->AllocateConstants<SsaoConstants>(1);
+    m_CurrFrameResource->MaterialBuffer = m_FrameUploadHeap->AllocateStructured<MaterialData>((u32)m_Materials.size());
+
+	AnimateMaterials(frame);
+	UpdateObjectCBs(frame);
+	UpdateMaterialBuffer(frame);
+    UpdateShadowTransform(frame);
+	UpdateMainPassCB(frame);
+    UpdateShadowPassCB(frame);
+    UpdateSsaoCB(frame);
+
+    SelectLods(frame);
+    CullOpaqueRenderItems(frame);
+    UpdateTextureStreaming(frame);
+
+    DrawFrame();
+
+    FramePacingReport& report = m_FramePacingReports.GetWriteSlot();
+    m_FramePacer->FillReport(report);
+    for (u32 view = 0; view < (u32)LodView::Count; ++view)
+    {
+        report.m_LodStats[view] = m_LodSelector.GetStats((LodView)view);
+    }
+    m_FramePacingReports.Publish();
+
+    m_RenderThread.MarkRendered();
+}
+
+void Renderer::DrawFrame()
+{
     // Reuse the memory associated with command recording.
     // We can only reset when the associated command lists have finished execution on the GPU.
-    ThrowIfFailed(cmdListAlloc->Reset());
+    for (auto& cmdListAlloc : m_CurrFrameResource->WorkerCmdListAllocs)
+    {
+        ThrowIfFailed(cmdListAlloc->Reset());
+    }
+
+    BuildRenderGraph();
+    BuildSceneSrvTable();
+
+    // Passes must be added in RenderPass order, RecordTask switches on the pass index.
+    // The shadow pass draws from the light, so it cannot use the camera's occlusion results.
+    const u32 opaqueCount = (u32)m_RitemLayer[(int)RenderLayer::Opaque].size();
+    const u32 visibleOpaqueCount = (u32)m_VisibleOpaqueRitems.size();
+    m_CommandRecorder->BeginFrame();
+    m_CommandRecorder->AddPass("Shadow", opaqueCount, c_MinItemsPerRecordTask);
+    m_CommandRecorder->AddPass("NormalsDepth", visibleOpaqueCount, c_MinItemsPerRecordTask);
+    m_CommandRecorder->AddPass("Ssao", 1);
+    m_CommandRecorder->AddPass("Main", visibleOpaqueCount, c_MinItemsPerRecordTask);
+    m_CommandRecorder->AddPass("UI", 1);
+    assert(m_CommandRecorder->GetPasses().size() == (size_t)RenderPass::Count);
+
+    BuildPassCommandLists((u32)RenderPass::Count * m_CommandRecorder->GetMaxTasksPerPass());
+
+    // Records every pass on the worker threads and submits them with one ExecuteCommandLists.
+    m_CommandRecorder->Record(*this);
+
+    // Swap the back and front buffers
+    ThrowIfFailed(m_SwapChain->Present(0, 0));
+	m_CurrBackBuffer = (m_CurrBackBuffer + 1) % s_SwapChainBufferCount;
+
+    // Advance the fence value to mark commands up to this fence point.
+    ++m_CurrentFence;
+
+    // Add an instruction to the command queue to set a new fence point. 
+    // Because we are on the GPU timeline, the new fence point won't be 
+    // set until the GPU finishes processing all the commands prior to this Signal().
+    m_CommandQueue->Signal(m_Fence.Get(), m_CurrentFence);
+
+    // This frame's upload memory, frame resources, freed descriptors and released images can be
+    // reused once the GPU reaches the fence.
+    m_FrameUploadHeap->EndFrame(m_CurrentFence);
+    m_SrvHeap->Commit(m_CurrentFence);
+    m_ImageDecodePool->Commit(m_CurrentFence);
+    m_FramePacer->EndFrame(m_CurrentFence);
+}
+
+void Renderer::BuildSceneSrvTable()
+{
+    // The main pass samples the sky, shadow map and SSAO map as one table. Writing the views into
+    // transient descriptors each frame keeps the three free to live anywhere in the heap.
+    const DescriptorHandle table = m_SrvHeap->AllocateTransient(3);
+
+    ID3D12Resource* skyCubeMap = GetBoundTexture("skyCubeMap").Resource.Get();
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+    srvDesc.Format = skyCubeMap->GetDesc().Format;
+    srvDesc.TextureCube.MipLevels = skyCubeMap->GetDesc().MipLevels;
+    m_d3dDevice->CreateShaderResourceView(skyCubeMap, &srvDesc, m_SrvHeap->GetCpuHandle(table, 0));
+
+    srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    srvDesc.Texture2D.MipLevels = 1;
+    srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+    m_d3dDevice->CreateShaderResourceView(m_ShadowMap->Resource(), &srvDesc, m_SrvHeap->GetCpuHandle(table, 1));
+
+    srvDesc.Format = Ssao::AmbientMapFormat;
+    m_d3dDevice->CreateShaderResourceView(m_Ssao->AmbientMap(), &srvDesc, m_SrvHeap->GetCpuHandle(table, 2));
+
+    m_SceneSrvTable = m_SrvHeap->GetGpuHandle(table);
+}
+
+void Renderer::RecordCommandList(u32 workerIndex, u32 listIndex, const RecordTask& task)
+{
+    ID3D12CommandAllocator* cmdListAlloc = m_CurrFrameResource->WorkerCmdListAllocs[workerIndex].Get();
+    ID3D12GraphicsCommandList* cmdList = m_PassCommandLists[listIndex].Get();
 
     // A command list can be reset after it has been added to the command queue via ExecuteCommandList.
     // Reusing the command list reuses memory.
-    ThrowIfFailed(m_CommandList->Reset(cmdListAlloc.Get(), m_PSOs["opaque"].Get()));
+    ThrowIfFailed(cmdList->Reset(cmdListAlloc, nullptr));
 
-    ID3D12DescriptorHeap* descriptorHeaps[] = { m_SrvDescriptorHeap.Get() };
-    m_CommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+    // Command lists do not inherit state, so every list binds its own heaps.
+    ID3D12DescriptorHeap* descriptorHeaps[] = { m_SrvHeap->GetHeap() };
+    cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-    m_UIManager->BeginRender();
+    const RGPassHandle graphPass = m_GraphPassStart[task.m_PassIndex];
+    if (m_RenderGraph.IsPassCulled(graphPass))
+    {
+        ThrowIfFailed(cmdList->Close());
+        return;
+    }
 
-    m_CommandList->SetGraphicsRootSignature(m_RootSignature.Get());
+    // The first slice of a pass issues the transitions the graph batched up for it.
+    if (task.m_FirstInPass)
+    {
+        IssueGraphBarriers(cmdList, m_RenderGraph.GetPassBarriers(graphPass));
+    }
 
-	//
-	// Shadow map pass.
-	//
+    switch ((RenderPass)task.m_PassIndex)
+    {
+    case RenderPass::Shadow:
+        DrawSceneToShadowMap(cmdList, task);
+        break;
+    case RenderPass::NormalsDepth:
+        DrawNormalsAndDepth(cmdList, task);
+        break;
+    case RenderPass::Ssao:
+        cmdList->SetGraphicsRootSignature(m_SsaoRootSignature.Get());
+        m_Ssao->ComputeSsao(cmdList, m_CurrFrameResource);
+
+        // Each blur direction is its own graph pass so the ping-pong transitions come from the graph.
+        for (RGPassHandle blurPass = graphPass + 1; blurPass < m_GraphPassStart[task.m_PassIndex + 1]; ++blurPass)
+        {
+            IssueGraphBarriers(cmdList, m_RenderGraph.GetPassBarriers(blurPass));
+            m_Ssao->BlurAmbientMap(cmdList, m_CurrFrameResource, (blurPass - graphPass) % 2 == 1);
+        }
+        break;
+    case RenderPass::Main:
+        DrawMainPass(cmdList, task);
+        break;
+    case RenderPass::UI:
+        // The main pass leaves the back buffer bound, but that binding does not carry over to this list.
+        cmdList->RSSetViewports(1, &m_ScreenViewport);
+        cmdList->RSSetScissorRects(1, &m_ScissorRect);
+        cmdList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, nullptr);
+        m_UIManager->RenderDrawData(m_FrameSnapshot->m_UIDrawData, cmdList);
+        break;
+    default:
+        ASSERTFAILMSG("Unhandled render pass");
+        break;
+    }
 
-    // Bind all the materials used in this scene.  For structured buffers, we can bypass the heap and 
-    // set as a root descriptor.
-    auto matBuffer = m_CurrFrameResource->MaterialBuffer->Resource();
-    m_CommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
-	
-    // Bind null SRV for shadow map pass.
-    m_CommandList->SetGraphicsRootDescriptorTable(3, m_NullSrv);	 
+    // The last list returns imported resources to the states the next frame expects.
+    if (task.m_PassIndex == (u32)RenderPass::Count - 1 && task.m_LastInPass)
+    {
+        IssueGraphBarriers(cmdList, m_RenderGraph.GetFinalBarriers());
+    }
+
+    // Done recording commands.
+    ThrowIfFailed(cmdList->Close());
+}
+
+void Renderer::SubmitRecordedLists(u32 listCount)
+{
+    std::vector<ID3D12CommandList*> cmdsLists(listCount);
+    for (u32 i = 0; i < listCount; ++i)
+    {
+        cmdsLists[i] = m_PassCommandLists[i].Get();
+    }
 
-    // Bind all the textures used in this scene.  Observe
-    // that we only have to specify the first descriptor in the table.  
-    // The root signature knows how many descriptors are expected in the table.
-    m_CommandList->SetGraphicsRootDescriptorTable(4, m_SrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+    // Add the command lists to the queue for execution.
+    m_CommandQueue->ExecuteCommandLists(listCount, cmdsLists.data());
+}
+
+void Renderer::BuildPassCommandLists(u32 listCount)
+{
+    // Lists are created closed and reset against a worker allocator when recorded.
+    ID3D12CommandAllocator* cmdListAlloc = m_CurrFrameResource->WorkerCmdListAllocs[0].Get();
+    while (m_PassCommandLists.size() < listCount)
+    {
+        ComPtr<ID3D12GraphicsCommandList> cmdList;
+        ThrowIfFailed(m_d3dDevice->CreateCommandList(
+            0,
+            D3D12_COMMAND_LIST_TYPE_DIRECT,
+            cmdListAlloc,
+            nullptr,
+            IID_PPV_ARGS(cmdList.GetAddressOf())));
+        ThrowIfFailed(cmdList->Close());
+
+        m_PassCommandLists.push_back(cmdList);
+    }
+}
 
-    DrawSceneToShadowMap();
+void Renderer::BuildRenderGraph()
+{
+    m_RenderGraph.Reset();
+    m_GraphResources.clear();
 
-	// Normal/depth pass.	
-	DrawNormalsAndDepth();
-	
+    // Everything is owned by the renderer, ShadowMap or Ssao and persists between frames, so each
+    // resource is imported in the state it is left in at the end of a frame.
+    auto importResource = [this](const std::string& name, ID3D12Resource* resource, RGResourceState state)
+    {
+        m_GraphResources.push_back(resource);
+        return m_RenderGraph.ImportResource(name, state, state);
+    };
 
-	// Compute SSAO.	
-    m_CommandList->SetGraphicsRootSignature(m_SsaoRootSignature.Get());
-    m_Ssao->ComputeSsao(m_CommandList.Get(), m_CurrFrameResource, 0);
-	
+    const RGResourceHandle backBuffer = importResource("BackBuffer", CurrentBackBuffer(), RGResourceState::Present);
+    const RGResourceHandle depthBuffer = importResource("DepthBuffer", m_DepthStencilBuffer.Get(), RGResourceState::DepthWrite);
+    const RGResourceHandle shadowMap = importResource("ShadowMap", m_ShadowMap->Resource(), RGResourceState::GenericRead);
+    const RGResourceHandle normalMap = importResource("NormalMap", m_Ssao->NormalMap(), RGResourceState::GenericRead);
+    const RGResourceHandle ambientMap = importResource("AmbientMap", m_Ssao->AmbientMap(), RGResourceState::GenericRead);
+    const RGResourceHandle ambientBlurMap = importResource("AmbientBlurMap", m_Ssao->AmbientBlurMap(), RGResourceState::GenericRead);
+    const RGResourceHandle mainRTV = importResource("MainRTV", m_MainRTV.Get(), RGResourceState::GenericRead);
+
+    const RGResourceState depthSrv = RGResourceState::DepthRead | RGResourceState::PixelShaderResource;
+
+    // Graph passes are added in RenderPass order, m_GraphPassStart maps each RenderPass to its first graph pass.
+    m_GraphPassStart[(u32)RenderPass::Shadow] = m_RenderGraph.AddPass("Shadow");
+    m_RenderGraph.Write(m_GraphPassStart[(u32)RenderPass::Shadow], shadowMap, RGResourceState::DepthWrite);
+
+    const RGPassHandle normalsPass = m_RenderGraph.AddPass("NormalsDepth");
+    m_GraphPassStart[(u32)RenderPass::NormalsDepth] = normalsPass;
+    m_RenderGraph.Write(normalsPass, normalMap, RGResourceState::RenderTarget);
+    m_RenderGraph.Write(normalsPass, depthBuffer, RGResourceState::DepthWrite);
+
+    const RGPassHandle ssaoPass = m_RenderGraph.AddPass("Ssao");
+    m_GraphPassStart[(u32)RenderPass::Ssao] = ssaoPass;
+    m_RenderGraph.Read(ssaoPass, normalMap, RGResourceState::PixelShaderResource);
+    m_RenderGraph.Read(ssaoPass, depthBuffer, depthSrv);
+    m_RenderGraph.Write(ssaoPass, ambientMap, RGResourceState::RenderTarget);
+
+    for (u32 i = 0; i < c_SsaoBlurCount * 2; ++i)
+    {
+        const bool horzBlur = i % 2 == 0;
+        const RGPassHandle blurPass = m_RenderGraph.AddPass(horzBlur ? "SsaoBlurH" : "SsaoBlurV");
+        m_RenderGraph.Read(blurPass, normalMap, RGResourceState::PixelShaderResource);
+        m_RenderGraph.Read(blurPass, depthBuffer, depthSrv);
+        m_RenderGraph.Read(blurPass, horzBlur ? ambientMap : ambientBlurMap, RGResourceState::PixelShaderResource);
+        m_RenderGraph.Write(blurPass, horzBlur ? ambientBlurMap : ambientMap, RGResourceState::RenderTarget);
+    }
+
+    const RGPassHandle mainPass = m_RenderGraph.AddPass("Main");
+    m_GraphPassStart[(u32)RenderPass::Main] = mainPass;
+    m_RenderGraph.Read(mainPass, shadowMap, RGResourceState::PixelShaderResource);
+    m_RenderGraph.Read(mainPass, ambientMap, RGResourceState::PixelShaderResource);
+    m_RenderGraph.Write(mainPass, depthBuffer, RGResourceState::DepthWrite);
+    m_RenderGraph.Write(mainPass, backBuffer, RGResourceState::RenderTarget);
+    if (m_FrameSnapshot->m_RenderToRTV)
+    {
+        m_RenderGraph.Write(mainPass, mainRTV, RGResourceState::RenderTarget);
+    }
+
+    // The UI samples the debug views, which keeps them alive until the end of the frame.
+    const RGPassHandle uiPass = m_RenderGraph.AddPass("UI");
+    m_GraphPassStart[(u32)RenderPass::UI] = uiPass;
+    m_RenderGraph.Read(uiPass, normalMap, RGResourceState::PixelShaderResource);
+    m_RenderGraph.Read(uiPass, ambientMap, RGResourceState::PixelShaderResource);
+    m_RenderGraph.Read(uiPass, mainRTV, RGResourceState::PixelShaderResource);
+    m_RenderGraph.Write(uiPass, backBuffer, RGResourceState::RenderTarget);
+
+    m_GraphPassStart[(u32)RenderPass::Count] = (RGPassHandle)m_RenderGraph.GetPasses().size();
+
+    m_RenderGraph.Compile();
+}
 
-	// Main rendering pass.	
-    m_CommandList->SetGraphicsRootSignature(m_RootSignature.Get());
+void Renderer::IssueGraphBarriers(ID3D12GraphicsCommandList* cmdList, const std::vector<RGBarrier>& graphBarriers)
+{
+    if (graphBarriers.empty())
+    {
+        return;
+    }
 
-    // Rebind state whenever graphics root signature changes.
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    barriers.reserve(graphBarriers.size());
+    for (const RGBarrier& barrier : graphBarriers)
+    {
+        if (barrier.m_Type == RGBarrierType::Aliasing)
+        {
+            ID3D12Resource* before = barrier.m_AliasBefore != c_InvalidRGHandle ? m_GraphResources[barrier.m_AliasBefore] : nullptr;
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(before, m_GraphResources[barrier.m_Resource]));
+        }
+        else if (barrier.m_Type == RGBarrierType::UnorderedAccess)
+        {
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(m_GraphResources[barrier.m_Resource]));
+        }
+        else
+        {
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_GraphResources[barrier.m_Resource],
+                (D3D12_RESOURCE_STATES)barrier.m_Before, (D3D12_RESOURCE_STATES)barrier.m_After));
+        }
+    }
+
+    cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+}
+
+void Renderer::BindScenePassState(ID3D12GraphicsCommandList* cmdList)
+{
+    cmdList->SetGraphicsRootSignature(m_RootSignature.Get());
 
     // Bind all the materials used in this scene.  For structured buffers, we can bypass the heap and 
     // set as a root descriptor.
-    matBuffer = m_CurrFrameResource->MaterialBuffer->Resource();
-    m_CommandList->SetGraphicsRootShaderResourceView(2, matBuffer->GetGPUVirtualAddress());
+    cmdList->SetGraphicsRootShaderResourceView(2, m_CurrFrameResource->MaterialBuffer.GetGpuAddress());
 
+    // Bind null SRV, passes that sample the sky or shadow map rebind this slot.
+    cmdList->SetGraphicsRootDescriptorTable(3, m_NullSrv);
 
-    m_CommandList->RSSetViewports(1, &m_ScreenViewport);
-    m_CommandList->RSSetScissorRects(1, &m_ScissorRect);
+    // Bind the whole heap as the texture table, materials index it with their textures' heap indices.
+    cmdList->SetGraphicsRootDescriptorTable(4, m_SrvHeap->GetHeap()->GetGPUDescriptorHandleForHeapStart());
+}
+
+void Renderer::DrawMainPass(ID3D12GraphicsCommandList* cmdList, const RecordTask& task)
+{
+    const DirectX::XMVECTORF32 mainRtvClearColour = DirectXColorFromImVec4(m_FrameSnapshot->m_ClearColour);
+    const bool renderToRTV = m_FrameSnapshot->m_RenderToRTV;
+
+    BindScenePassState(cmdList);
+
+    cmdList->RSSetViewports(1, &m_ScreenViewport);
+    cmdList->RSSetScissorRects(1, &m_ScissorRect);
 
     // Specify the buffers we are going to render to.
-    if (!m_RenderToRTV)
+    // Only the first slice of the pass clears the target.
+    if (!renderToRTV)
     {
-        m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-            D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
-        m_CommandList->ClearRenderTargetView(CurrentBackBufferView(), mainRtvClearColour, 0, nullptr);
-        m_CommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+        if (task.m_FirstInPass)
+        {
+            cmdList->ClearRenderTargetView(CurrentBackBufferView(), mainRtvClearColour, 0, nullptr);
+        }
+        cmdList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
     }
     else
     {
-        m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_MainRTV.Get(),
-            D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
-        m_CommandList->ClearRenderTargetView(m_MainCpuRtv, mainRtvClearColour, 0, nullptr);
-        m_CommandList->OMSetRenderTargets(1, &m_MainCpuRtv, true, &DepthStencilView());
-        
+        if (task.m_FirstInPass)
+        {
+            cmdList->ClearRenderTargetView(m_MainCpuRtv, mainRtvClearColour, 0, nullptr);
+        }
+        cmdList->OMSetRenderTargets(1, &m_MainCpuRtv, true, &DepthStencilView());
     }
 
-	// Bind all the textures used in this scene.  Observe
-    // that we only have to specify the first descriptor in the table.  
-    // The root signature knows how many descriptors are expected in the table.
-    m_CommandList->SetGraphicsRootDescriptorTable(4, m_SrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	
-    auto passCB = m_CurrFrameResource->PassCB->Resource();
-	m_CommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	cmdList->SetGraphicsRootConstantBufferView(1, m_CurrFrameResource->PassCB.GetGpuAddress(0));
 
     // Bind the sky cube map.  For our demos, we just use one "world" cube map representing the environment
     // from far away, so all objects will use the same cube map and we only need to set it once per-frame.  
     // If we wanted to use "local" cube maps, we would have to change them per-object, or dynamically
     // index into an array of cube maps.
 
-    CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(m_SrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-    skyTexDescriptor.Offset(m_SkyTexHeapIndex, m_CbvSrvUavDescriptorSize);
-    m_CommandList->SetGraphicsRootDescriptorTable(3, skyTexDescriptor);
+    cmdList->SetGraphicsRootDescriptorTable(3, m_SceneSrvTable);
 
 
-    //m_CommandList->SetPipelineState(m_PSOs["sky"].Get());
-    //DrawRenderItems(m_CommandList.Get(), m_RitemLayer[(int)RenderLayer::Sky]);
+    //cmdList->SetPipelineState(GetPipeline(PipelineId::Sky));
+    //DrawRenderItems(cmdList, m_RitemLayer[(int)RenderLayer::Sky]);
 
-    m_CommandList->SetPipelineState(m_PSOs["opaque"].Get());
-    DrawRenderItems(m_CommandList.Get(), m_RitemLayer[(int)RenderLayer::Opaque]);
+    cmdList->SetPipelineState(GetPipeline(PipelineId::Opaque));
+    DrawRenderItems(cmdList, m_VisibleOpaqueRitems, task.m_FirstItem, task.m_ItemCount, LodView::Main);
 
-    //m_CommandList->SetPipelineState(m_PSOs["debug"].Get());
-    //DrawRenderItems(m_CommandList.Get(), m_RitemLayer[(int)RenderLayer::Debug]);
+    //cmdList->SetPipelineState(GetPipeline(PipelineId::Debug));
+    //DrawRenderItems(cmdList, m_RitemLayer[(int)RenderLayer::Debug]);
 
-    // Indicate a state transition on the resource usage.
-    if (m_RenderToRTV)
+    // The scene went to the main RTV, clear the back buffer the UI draws into.
+    if (task.m_LastInPass && renderToRTV)
     {
-        m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_MainRTV.Get(),
-            D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
-        m_CommandList->ClearRenderTargetView(CurrentBackBufferView(), mainRtvClearColour, 0, nullptr);
-        m_CommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+        cmdList->ClearRenderTargetView(CurrentBackBufferView(), mainRtvClearColour, 0, nullptr);
+        cmdList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
     }
-    
-    // submit debug views
-    m_UIManager->SubmitViewportTexture("Scene Normals", m_Ssao->NormalMapSrv(), m_ClientWidth, m_ClientHeight);
-    m_UIManager->SubmitViewportTexture("SSAO", m_Ssao->AmbientMapSrv(), m_ClientWidth, m_ClientHeight);
-    m_UIManager->SubmitViewportTexture(m_UIManager->GetDefaultViewName(), m_MainGpuSrv, m_ClientWidth, m_ClientHeight);
-
-    // Draw Imui
-    m_UIManager->Render();
-    m_UIManager->EndRender(m_CommandList.Get(), CurrentBackBuffer());
-
-    // Done recording commands.
-    ThrowIfFailed(m_CommandList->Close());
-
-    // Add the command list to the queue for execution.
-    ID3D12CommandList* cmdsLists[] = { m_CommandList.Get() };
-    m_CommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
-
-    // Swap the back and front buffers
-    ThrowIfFailed(m_SwapChain->Present(0, 0));
-	m_CurrBackBuffer = (m_CurrBackBuffer + 1) % s_SwapChainBufferCount;
-
-    // Advance the fence value to mark commands up to this fence point.
-    m_CurrFrameResource->Fence = ++m_CurrentFence;
-
-    // Add an instruction to the command queue to set a new fence point. 
-    // Because we are on the GPU timeline, the new fence point won't be 
-    // set until the GPU finishes processing all the commands prior to this Signal().
-    m_CommandQueue->Signal(m_Fence.Get(), m_CurrentFence);
 }
 
 void Renderer::OnMouseDown(WPARAM btnState, int x, int y)
@@ -444,68 +841,53 @@ void Renderer::OnKeyboardInput(const GameTimer& gt)
 	m_Camera.UpdateViewMatrix();
 }
  
-void Renderer::AnimateMaterials(const GameTimer& gt)
+void Renderer::AnimateMaterials(const RenderSnapshot& frame)
 {
 	
 }
 
-void Renderer::UpdateObjectCBs(const GameTimer& gt)
+void Renderer::UpdateObjectCBs(const RenderSnapshot& frame)
 {
-	auto currObjectCB = m_CurrFrameResource->ObjectCB.get();
+	// The frame's constants are freshly allocated, so every item is written each frame.
+	auto& currObjectCB = m_CurrFrameResource->ObjectCB;
 	for(auto& e : m_AllRitems)
 	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if(e->m_NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->m_World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->m_TexTransform);
-
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-			objConstants.MaterialIndex = e->m_Mat->MatCBIndex;
+		XMMATRIX world = XMLoadFloat4x4(&frame.m_ItemWorlds[e->m_ObjCBIndex]);
+		XMMATRIX texTransform = XMLoadFloat4x4(&e->m_TexTransform);
 
-			currObjectCB->CopyData(e->m_ObjCBIndex, objConstants);
+		ObjectConstants objConstants;
+		XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+		XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+		objConstants.MaterialIndex = e->m_Mat->MatCBIndex;
 
-			// Next FrameResource need to be updated too.
-			e->m_NumFramesDirty--;
-		}
+		currObjectCB.CopyData(e->m_ObjCBIndex, objConstants);
 	}
 }
 
-void Renderer::UpdateMaterialBuffer(const GameTimer& gt)
+void Renderer::UpdateMaterialBuffer(const RenderSnapshot& frame)
 {
-	auto currMaterialBuffer = m_CurrFrameResource->MaterialBuffer.get();
+	auto& currMaterialBuffer = m_CurrFrameResource->MaterialBuffer;
 	for(auto& e : m_Materials)
 	{
-		// Only update the cbuffer data if the constants have changed.  If the cbuffer
-		// data changes, it needs to be updated for each FrameResource.
 		Material* mat = e.second.get();
-		if(mat->NumFramesDirty > 0)
-		{
-			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+		XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
 
-			MaterialData matData;
-			matData.DiffuseAlbedo = mat->DiffuseAlbedo;
-			matData.FresnelR0 = mat->FresnelR0;
-			matData.Roughness = mat->Roughness;
-			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
-			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
-			matData.NormalMapIndex = mat->NormalSrvHeapIndex;
+		MaterialData matData;
+		matData.DiffuseAlbedo = mat->DiffuseAlbedo;
+		matData.FresnelR0 = mat->FresnelR0;
+		matData.Roughness = mat->Roughness;
+		XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
+		matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
+		matData.NormalMapIndex = mat->NormalSrvHeapIndex;
 
-			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
-
-			// Next FrameResource need to be updated too.
-			mat->NumFramesDirty--;
-		}
+		currMaterialBuffer.CopyData(mat->MatCBIndex, matData);
 	}
 }
 
-void Renderer::UpdateShadowTransform(const GameTimer& gt)
+void Renderer::UpdateShadowTransform(const RenderSnapshot& frame)
 {
     // Only the first "main" light casts a shadow.
-    XMVECTOR lightDir = XMLoadFloat3(&m_RotatedLightDirections[0]);
+    XMVECTOR lightDir = XMLoadFloat3(&frame.m_LightDirections[0]);
     XMVECTOR lightPos = -2.0f*m_SceneBounds.Radius*lightDir;
     XMVECTOR targetPos = XMLoadFloat3(&m_SceneBounds.Center);
     XMVECTOR lightUp = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
@@ -542,10 +924,10 @@ void Renderer::UpdateShadowTransform(const GameTimer& gt)
     XMStoreFloat4x4(&m_ShadowTransform, S);
 }
 
-void Renderer::UpdateMainPassCB(const GameTimer& gt)
+void Renderer::UpdateMainPassCB(const RenderSnapshot& frame)
 {
-	XMMATRIX view = m_Camera.GetView();
-	XMMATRIX proj = m_Camera.GetProj();
+	XMMATRIX view = frame.m_Camera.GetView();
+	XMMATRIX proj = frame.m_Camera.GetProj();
 
 	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
 	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
@@ -570,26 +952,25 @@ void Renderer::UpdateMainPassCB(const GameTimer& gt)
 	XMStoreFloat4x4(&m_MainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
     XMStoreFloat4x4(&m_MainPassCB.ViewProjTex, XMMatrixTranspose(viewProjTex));
     XMStoreFloat4x4(&m_MainPassCB.ShadowTransform, XMMatrixTranspose(shadowTransform));
-	m_MainPassCB.EyePosW = m_Camera.GetPosition3f();
-	m_MainPassCB.RenderTargetSize = XMFLOAT2((float)m_ClientWidth, (float)m_ClientHeight);
-	m_MainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / m_ClientWidth, 1.0f / m_ClientHeight);
+	m_MainPassCB.EyePosW = frame.m_Camera.GetPosition3f();
+	m_MainPassCB.RenderTargetSize = XMFLOAT2((float)frame.m_ClientWidth, (float)frame.m_ClientHeight);
+	m_MainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / frame.m_ClientWidth, 1.0f / frame.m_ClientHeight);
 	m_MainPassCB.NearZ = 1.0f;
 	m_MainPassCB.FarZ = 1000.0f;
-	m_MainPassCB.TotalTime = gt.TotalTime();
-	m_MainPassCB.DeltaTime = gt.DeltaTime();
+	m_MainPassCB.TotalTime = frame.m_TotalTime;
+	m_MainPassCB.DeltaTime = frame.m_DeltaTime;
 	m_MainPassCB.AmbientLight = { 0.4f, 0.4f, 0.6f, 1.0f };
-	m_MainPassCB.Lights[0].Direction = m_RotatedLightDirections[0];
+	m_MainPassCB.Lights[0].Direction = frame.m_LightDirections[0];
 	m_MainPassCB.Lights[0].Strength = { 0.4f, 0.4f, 0.5f };
-	m_MainPassCB.Lights[1].Direction = m_RotatedLightDirections[1];
+	m_MainPassCB.Lights[1].Direction = frame.m_LightDirections[1];
 	m_MainPassCB.Lights[1].Strength = { 0.1f, 0.1f, 0.1f };
-	m_MainPassCB.Lights[2].Direction = m_RotatedLightDirections[2];
+	m_MainPassCB.Lights[2].Direction = frame.m_LightDirections[2];
 	m_MainPassCB.Lights[2].Strength = { 0.0f, 0.0f, 0.0f };
  
-	auto currPassCB = m_CurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, m_MainPassCB);
+	m_CurrFrameResource->PassCB.CopyData(0, m_MainPassCB);
 }
 
-void Renderer::UpdateShadowPassCB(const GameTimer& gt)
+void Renderer::UpdateShadowPassCB(const RenderSnapshot& frame)
 {
     XMMATRIX view = XMLoadFloat4x4(&m_LightView);
     XMMATRIX proj = XMLoadFloat4x4(&m_LightProj);
@@ -599,96 +980,501 @@ void Renderer::UpdateShadowPassCB(const GameTimer& gt)
     XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
     XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
 
-    UINT w = m_ShadowMap->Width();
-    UINT h = m_ShadowMap->Height();
+    UINT w = m_ShadowMap->Width();
+    UINT h = m_ShadowMap->Height();
+
+    XMStoreFloat4x4(&m_ShadowPassCB.View, XMMatrixTranspose(view));
+    XMStoreFloat4x4(&m_ShadowPassCB.InvView, XMMatrixTranspose(invView));
+    XMStoreFloat4x4(&m_ShadowPassCB.Proj, XMMatrixTranspose(proj));
+    XMStoreFloat4x4(&m_ShadowPassCB.InvProj, XMMatrixTranspose(invProj));
+    XMStoreFloat4x4(&m_ShadowPassCB.ViewProj, XMMatrixTranspose(viewProj));
+    XMStoreFloat4x4(&m_ShadowPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
+    m_ShadowPassCB.EyePosW = m_LightPosW;
+    m_ShadowPassCB.RenderTargetSize = XMFLOAT2((float)w, (float)h);
+    m_ShadowPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / w, 1.0f / h);
+    m_ShadowPassCB.NearZ = m_LightNearZ;
+    m_ShadowPassCB.FarZ = m_LightFarZ;
+
+    m_CurrFrameResource->PassCB.CopyData(1, m_ShadowPassCB);
+}
+
+void Renderer::UpdateSsaoCB(const RenderSnapshot& frame)
+{
+    SsaoConstants ssaoCB;
+
+    XMMATRIX P = frame.m_Camera.GetProj();
+
+    // Transform NDC space [-1,+1]^2 to texture space [0,1]^2
+    XMMATRIX T(
+        0.5f, 0.0f, 0.0f, 0.0f,
+        0.0f, -0.5f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.5f, 0.5f, 0.0f, 1.0f);
+
+    ssaoCB.Proj    = m_MainPassCB.Proj;
+    ssaoCB.InvProj = m_MainPassCB.InvProj;
+    XMStoreFloat4x4(&ssaoCB.ProjTex, XMMatrixTranspose(P*T));
+
+    m_Ssao->GetOffsetVectors(ssaoCB.OffsetVectors);
+
+    auto blurWeights = m_Ssao->CalcGaussWeights(2.5f);
+    ssaoCB.BlurWeights[0] = XMFLOAT4(&blurWeights[0]);
+    ssaoCB.BlurWeights[1] = XMFLOAT4(&blurWeights[4]);
+    ssaoCB.BlurWeights[2] = XMFLOAT4(&blurWeights[8]);
+
+    ssaoCB.InvRenderTargetSize = XMFLOAT2(1.0f / m_Ssao->SsaoMapWidth(), 1.0f / m_Ssao->SsaoMapHeight());
+
+    // Coordinates given in view space.
+    ssaoCB.OcclusionRadius = 0.5f;
+    ssaoCB.OcclusionFadeStart = 0.2f;
+    ssaoCB.OcclusionFadeEnd = 1.0f;
+    ssaoCB.SurfaceEpsilon = 0.05f;
+ 
+    m_CurrFrameResource->SsaoCB.CopyData(0, ssaoCB);
+}
+
+void Renderer::LoadTextures()
+{
+    m_TextureCache = std::make_unique<TextureCache>();
+    m_TextureCooker = std::make_unique<TextureCooker>(c_TextureCacheDirectory);
+    m_TextureLoader = std::make_unique<TextureLoader>(m_d3dDevice.Get(), m_JobSystem.get(), m_UploadQueue.get(), m_TextureCooker.get());
+    m_TextureLoadStart = std::chrono::steady_clock::now();
+
+    const u64 streamingBudget = (u64)m_RenderSettings.m_TextureStreamingBudgetMB.GetValue() * 1024 * 1024;
+    m_TextureStreaming = std::make_unique<TextureStreamingPolicy>(streamingBudget, c_MaxTextureStreamingRequests);
+
+    // Placeholders are bound until the real textures are resident, so they load up front and go
+    // out with the initialization batch.
+    auto defaultDiffuseMap = std::make_unique<Texture>();
+    defaultDiffuseMap->Name = "defaultDiffuseMap";
+    defaultDiffuseMap->Filename = L"Assets/Textures/white1x1.dds";
+    defaultDiffuseMap->Resource = m_TextureLoader->LoadNow(defaultDiffuseMap->Filename);
+    m_Textures[defaultDiffuseMap->Name] = std::move(defaultDiffuseMap);
+
+    auto defaultNormalMap = std::make_unique<Texture>();
+    defaultNormalMap->Name = "defaultNormalMap";
+    defaultNormalMap->Filename = L"Assets/Textures/default_nmap.dds";
+    defaultNormalMap->Resource = m_TextureLoader->LoadNow(defaultNormalMap->Filename);
+    m_Textures[defaultNormalMap->Name] = std::move(defaultNormalMap);
+
+    // Mid grey, so reflections stay plausible while the sky loads.
+    auto placeholderCubeMap = std::make_unique<Texture>();
+    placeholderCubeMap->Name = "placeholderCubeMap";
+    placeholderCubeMap->Resource = m_TextureLoader->CreateSolidTexture(0xff808080, true);
+    placeholderCubeMap->IsCubeMap = true;
+    m_Textures[placeholderCubeMap->Name] = std::move(placeholderCubeMap);
+
+	std::vector<std::string> texNames = 
+	{
+		"bricksDiffuseMap",
+		"bricksNormalMap",
+		"tileDiffuseMap",
+		"tileNormalMap",
+		"skyCubeMap"
+	};
+	
+    std::vector<std::wstring> texFilenames =
+    {
+        L"Assets/Textures/bricks2.dds",
+        L"Assets/Textures/bricks2_nmap.dds",
+        L"Assets/Textures/tile.dds",
+        L"Assets/Textures/tile_nmap.dds",
+        L"Assets/Textures/sunsetcube1024.dds"
+    };
+
+    std::vector<std::string> texPlaceholders =
+    {
+        "defaultDiffuseMap",
+        "defaultNormalMap",
+        "defaultDiffuseMap",
+        "defaultNormalMap",
+        "placeholderCubeMap"
+    };
+
+    std::vector<bool> texIsNormalMap =
+    {
+        false,
+        true,
+        false,
+        true,
+        false
+    };
+	
+	for(int i = 0; i < (int)texNames.size(); ++i)
+	{
+		auto texMap = std::make_unique<Texture>();
+		texMap->Name = texNames[i];
+		texMap->Filename = texFilenames[i];
+		texMap->Placeholder = texPlaceholders[i];
+		texMap->IsNormalMap = texIsNormalMap[i];
+		m_Textures[texMap->Name] = std::move(texMap);
+	}		
+}
+
+void Renderer::PackMaterialTextures()
+{
+    // Atlas UVs have to stay inside their region, so materials that are tiled anywhere, by their
+    // own transform or an item's, keep their textures.
+    std::unordered_set<const Material*> tiledMaterials;
+    for (const auto& e : m_Materials)
+    {
+        if (!KeepsUvsInUnitSquare(XMLoadFloat4x4(&e.second->MatTransform)))
+        {
+            tiledMaterials.insert(e.second.get());
+        }
+    }
+    for (const auto& ri : m_AllRitems)
+    {
+        if (!KeepsUvsInUnitSquare(XMLoadFloat4x4(&ri->m_TexTransform) * XMLoadFloat4x4(&ri->m_Mat->MatTransform)))
+        {
+            tiledMaterials.insert(ri->m_Mat);
+        }
+    }
+
+    struct AtlasSource
+    {
+        MappedFile m_File;
+        std::vector<u8> m_Pixels;
+        TextureAtlasImage m_Image;
+    };
+
+    // Placeholders are loaded up front and bound in place of other textures, so they stay apart.
+    // Pages are built linear, so sRGB textures stay apart as well.
+    std::unordered_map<std::string, std::unique_ptr<AtlasSource>> sources;
+    auto getSource = [&](const std::string& textureName) -> const AtlasSource*
+    {
+        std::unique_ptr<AtlasSource>& source = sources[textureName];
+        if (source == nullptr)
+        {
+            source = std::make_unique<AtlasSource>();
+            const Texture& texture = *m_Textures.at(textureName);
+            DdsFile dds;
+            if (texture.Resource == nullptr && !texture.Filename.empty() && source->m_File.Open(texture.Filename) &&
+                dds.Parse(source->m_File.GetData(), source->m_File.GetSize()) == DdsError::None)
+            {
+                const DdsTextureDesc& desc = dds.GetDesc();
+                if (desc.m_ArraySize == 1 && !IsDdsFormatSRGB(desc.m_Format) &&
+                    desc.m_Width <= c_AtlasMaxTextureSize && desc.m_Height <= c_AtlasMaxTextureSize &&
+                    ReadDdsTextureRgba(dds, source->m_Pixels))
+                {
+                    source->m_Image.m_Pixels = source->m_Pixels.data();
+                    source->m_Image.m_Width = desc.m_Width;
+                    source->m_Image.m_Height = desc.m_Height;
+                }
+            }
+        }
+        return source->m_Image.m_Pixels != nullptr ? source.get() : nullptr;
+    };
+
+    // Materials sharing a pair of textures share an entry. The pages are keyed on every source
+    // file, so they are built once and loaded from the texture cache after that.
+    TextureAtlasPacker packer(2);
+    std::map<std::pair<std::string, std::string>, u32> entries;
+    std::vector<std::vector<Material*>> entryMaterials;
+    Hasher hasher;
+    hasher.Add(c_AtlasVersion);
+    for (auto& e : m_Materials)
+    {
+        Material* mat = e.second.get();
+        if (tiledMaterials.count(mat) != 0)
+        {
+            continue;
+        }
+
+        const auto textures = std::make_pair(mat->DiffuseTextureName, mat->NormalTextureName);
+        const auto entry = entries.find(textures);
+        if (entry != entries.end())
+        {
+            entryMaterials[entry->second].push_back(mat);
+            continue;
+        }
+
+        const AtlasSource* diffuse = getSource(mat->DiffuseTextureName);
+        const AtlasSource* normal = getSource(mat->NormalTextureName);
+        const TextureAtlasImage layers[2] = { diffuse != nullptr ? diffuse->m_Image : TextureAtlasImage(), normal != nullptr ? normal->m_Image : TextureAtlasImage() };
+        if (diffuse == nullptr || normal == nullptr || !packer.CanAdd(layers))
+        {
+            continue;
+        }
+
+        entries[textures] = packer.Add(layers);
+        entryMaterials.push_back({ mat });
+        hasher.AddBytes(diffuse->m_File.GetData(), diffuse->m_File.GetSize());
+        hasher.AddBytes(normal->m_File.GetData(), normal->m_File.GetSize());
+    }
+
+    // A single entry would only trade one pair of textures for another.
+    if (packer.GetEntryCount() < 2)
+    {
+        return;
+    }
+
+    packer.Pack();
+
+    std::vector<u8> file;
+    for (u32 page = 0; page < packer.GetPageCount(); ++page)
+    {
+        for (u32 layer = 0; layer < 2; ++layer)
+        {
+            Hasher pageHasher = hasher;
+            pageHasher.Add(page);
+            pageHasher.Add(layer);
+            const std::filesystem::path path = m_TextureCooker->GetCachePath(pageHasher.GetHash());
+
+            std::error_code error;
+            if (!std::filesystem::exists(path, error))
+            {
+                packer.BuildPage(page, layer, false, file, m_JobSystem.get());
+                if (!m_TextureCooker->WriteToDisk(path, file))
+                {
+                    OutputDebugStringA(("Texture atlas page could not be written: " + path.string() + "\n").c_str());
+                    return;
+                }
+            }
+
+            auto texMap = std::make_unique<Texture>();
+            texMap->Name = "atlas" + std::to_string(page) + (layer == 0 ? "DiffuseMap" : "NormalMap");
+            texMap->Filename = path.wstring();
+            texMap->Placeholder = layer == 0 ? "defaultDiffuseMap" : "defaultNormalMap";
+            texMap->IsNormalMap = layer == 1;
+            m_Textures[texMap->Name] = std::move(texMap);
+        }
+    }
+
+    // Redirect the materials. The region transform goes after the material's own, so it maps the
+    // final UVs into the region.
+    for (u32 entry = 0; entry < packer.GetEntryCount(); ++entry)
+    {
+        const TextureAtlasRegion& region = packer.GetRegion(entry);
+        const XMMATRIX regionTransform = XMMatrixScaling(region.m_ScaleU, region.m_ScaleV, 1.0f) *
+            XMMatrixTranslation(region.m_OffsetU, region.m_OffsetV, 0.0f);
+        for (Material* mat : entryMaterials[entry])
+        {
+            mat->DiffuseTextureName = "atlas" + std::to_string(region.m_Page) + "DiffuseMap";
+            mat->NormalTextureName = "atlas" + std::to_string(region.m_Page) + "NormalMap";
+            XMStoreFloat4x4(&mat->MatTransform, XMLoadFloat4x4(&mat->MatTransform) * regionTransform);
+        }
+    }
+
+    // Textures no material refers to any more are never loaded.
+    std::unordered_set<std::string> referenced;
+    for (const auto& e : m_Materials)
+    {
+        referenced.insert(e.second->DiffuseTextureName);
+        referenced.insert(e.second->NormalTextureName);
+    }
+    for (const auto& e : sources)
+    {
+        if (e.second->m_Image.m_Pixels != nullptr && referenced.count(e.first) == 0)
+        {
+            m_Textures.erase(e.first);
+        }
+    }
+
+    char text[128];
+    snprintf(text, sizeof(text), "Startup: %u texture pairs packed into %u atlas pages\n", packer.GetEntryCount(), packer.GetPageCount());
+    OutputDebugStringA(text);
+
+    BindMaterialTextures();
+}
+
+void Renderer::StartTextureLoads()
+{
+    // Resident textures are acquired first, so a file with the same texels as a placeholder is
+    // never loaded. Names are sorted so the same one owns a shared texture every run.
+    std::vector<std::string> names;
+    for (const auto& e : m_Textures)
+    {
+        if (!e.second->Filename.empty())
+        {
+            names.push_back(e.first);
+        }
+    }
+    std::sort(names.begin(), names.end(), [this](const std::string& a, const std::string& b)
+    {
+        const bool residentA = m_Textures[a]->Resource != nullptr;
+        const bool residentB = m_Textures[b]->Resource != nullptr;
+        return residentA != residentB ? residentA : a < b;
+    });
+
+    std::unordered_map<TextureCacheId, std::shared_ptr<Texture>> sharedTextures;
+    for (const std::string& name : names)
+    {
+        std::shared_ptr<Texture>& texture = m_Textures[name];
+        bool isNew = false;
+        const TextureCacheId id = m_TextureCache->Acquire(texture->Filename, isNew);
+        if (id != c_InvalidTextureCacheId && !isNew)
+        {
+            texture = sharedTextures[id];
+            continue;
+        }
+
+        // Files that cannot be read are loaded anyway, so the loader reports why.
+        if (id != c_InvalidTextureCacheId)
+        {
+            sharedTextures[id] = texture;
+        }
+        if (texture->Resource == nullptr)
+        {
+            m_LoadingTextures[m_TextureLoader->Load(texture->Filename, 0, c_StreamedTextureInitialSize, GetTextureUsage(*texture))] = texture->Name;
+        }
+    }
+
+    const TextureCacheStats cacheStats = m_TextureCache->GetStats();
+    char text[128];
+    snprintf(text, sizeof(text), "Startup: %u textures shared, %.2f MB not loaded twice\n",
+        cacheStats.m_PathHits + cacheStats.m_ContentHits, cacheStats.m_SavedBytes / (1024.0f * 1024.0f));
+    OutputDebugStringA(text);
+}
+
+void Renderer::UpdateTextureLoads()
+{
+    const u64 completedFence = m_FrameTimeline->GetCompletedValue();
+    m_RetiredTextures.erase(std::remove_if(m_RetiredTextures.begin(), m_RetiredTextures.end(),
+        [completedFence](const auto& retired) { return retired.first <= completedFence; }), m_RetiredTextures.end());
+
+    if (m_TextureLoader->IsIdle())
+    {
+        return;
+    }
+
+    m_TextureLoader->Update(m_TextureLoadUpdate);
+
+    for (TextureLoadId id : m_TextureLoadUpdate.m_Resident)
+    {
+        const std::string name = m_LoadingTextures[id];
+        Texture* texture = m_Textures[name].get();
+
+        // A reload replaces a texture frames still in flight may sample.
+        if (texture->Resource != nullptr)
+        {
+            m_RetiredTextures.emplace_back(m_CurrentFence, texture->Resource);
+            m_SrvHeap->Free(m_TextureSrvs[name]);
+        }
+
+        texture->Resource = m_TextureLoader->GetResource(id);
+        texture->IsCubeMap = m_TextureLoader->IsCubeMap(id);
+        CreateTextureSrv(*texture);
+
+        const auto streamed = m_StreamedTextureIds.find(name);
+        if (streamed != m_StreamedTextureIds.end())
+        {
+            m_TextureStreaming->OnRequestComplete(streamed->second, true);
+        }
+        else
+        {
+            // First load, the mips it skipped are streamed in once the texture is seen up close.
+            const DdsTextureDesc& desc = m_TextureLoader->GetDesc(id);
+            std::vector<u64> mipSizes(desc.m_MipCount);
+            for (u32 mip = 0; mip < desc.m_MipCount; ++mip)
+            {
+                mipSizes[mip] = GetDdsMipSize(desc, mip);
+            }
+            m_StreamedTextureIds[name] = m_TextureStreaming->AddTexture(desc.m_Width, desc.m_Height, mipSizes, m_TextureLoader->GetFirstMip(id));
+            m_StreamedTextureNames.push_back(name);
+        }
+
+        m_LoadingTextures.erase(id);
+        m_TextureLoader->Release(id);
+    }
+
+    // A texture that fails to load keeps its placeholder, or the mips it already had.
+    for (TextureLoadId id : m_TextureLoadUpdate.m_Failed)
+    {
+        std::string message = "Texture load failed: " + m_TextureLoader->GetPath(id).string() + ": " + m_TextureLoader->GetError(id) + "\n";
+        OutputDebugStringA(message.c_str());
+
+        const auto streamed = m_StreamedTextureIds.find(m_LoadingTextures[id]);
+        if (streamed != m_StreamedTextureIds.end())
+        {
+            m_TextureStreaming->OnRequestComplete(streamed->second, false);
+        }
+
+        m_LoadingTextures.erase(id);
+        m_TextureLoader->Release(id);
+    }
 
-    XMStoreFloat4x4(&m_ShadowPassCB.View, XMMatrixTranspose(view));
-    XMStoreFloat4x4(&m_ShadowPassCB.InvView, XMMatrixTranspose(invView));
-    XMStoreFloat4x4(&m_ShadowPassCB.Proj, XMMatrixTranspose(proj));
-    XMStoreFloat4x4(&m_ShadowPassCB.InvProj, XMMatrixTranspose(invProj));
-    XMStoreFloat4x4(&m_ShadowPassCB.ViewProj, XMMatrixTranspose(viewProj));
-    XMStoreFloat4x4(&m_ShadowPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
-    m_ShadowPassCB.EyePosW = m_LightPosW;
-    m_ShadowPassCB.RenderTargetSize = XMFLOAT2((float)w, (float)h);
-    m_ShadowPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / w, 1.0f / h);
-    m_ShadowPassCB.NearZ = m_LightNearZ;
-    m_ShadowPassCB.FarZ = m_LightFarZ;
+    if (!m_TextureLoadUpdate.m_Resident.empty())
+    {
+        BindMaterialTextures();
+    }
 
-    auto currPassCB = m_CurrFrameResource->PassCB.get();
-    currPassCB->CopyData(1, m_ShadowPassCB);
+    if (m_TextureLoader->IsIdle() && !m_TextureLoadTimeLogged)
+    {
+        char text[128];
+        snprintf(text, sizeof(text), "Startup: textures resident after %.2f ms\n", MillisecondsSince(m_TextureLoadStart));
+        OutputDebugStringA(text);
+
+        const TextureCookerStats cookerStats = m_TextureCooker->GetStats();
+        snprintf(text, sizeof(text), "Startup: %u textures cooked, %u from cache, %.2f MB cooked to %.2f MB\n",
+            cookerStats.m_Cooks, cookerStats.m_DiskHits, cookerStats.m_SourceBytes / (1024.0f * 1024.0f), cookerStats.m_CookedBytes / (1024.0f * 1024.0f));
+        OutputDebugStringA(text);
+        m_TextureLoadTimeLogged = true;
+    }
 }
 
-void Renderer::UpdateSsaoCB(const GameTimer& gt)
+void Renderer::UpdateTextureStreaming(const RenderSnapshot& frame)
 {
-    SsaoConstants ssaoCB;
-
-    XMMATRIX P = m_Camera.GetProj();
-
-    // Transform NDC space [-1,+1]^2 to texture space [0,1]^2
-    XMMATRIX T(
-        0.5f, 0.0f, 0.0f, 0.0f,
-        0.0f, -0.5f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.0f, 1.0f);
+    m_TextureStreaming->SetBudget((u64)frame.m_TextureStreamingBudgetMB * 1024 * 1024);
+    m_TextureStreaming->BeginFrame();
 
-    ssaoCB.Proj    = m_MainPassCB.Proj;
-    ssaoCB.InvProj = m_MainPassCB.InvProj;
-    XMStoreFloat4x4(&ssaoCB.ProjTex, XMMatrixTranspose(P*T));
+    const XMFLOAT3 eyePosW = frame.m_Camera.GetPosition3f();
+    const XMVECTOR eyePos = XMLoadFloat3(&eyePosW);
+    const float projectionScale = (float)frame.m_ClientHeight / (2.0f * tanf(0.5f * frame.m_Camera.GetFovY()));
 
-    m_Ssao->GetOffsetVectors(ssaoCB.OffsetVectors);
+    // Texture coordinates are taken to span [0, 1] across an item's bounding sphere before its
+    // texture transform, which is close enough for the shapes in the scene.
+    for (const RenderItem* ri : m_VisibleOpaqueRitems)
+    {
+        BoundingBox worldBounds;
+        ri->m_Bounds.Transform(worldBounds, XMLoadFloat4x4(&frame.m_ItemWorlds[ri->m_ObjCBIndex]));
+        BoundingSphere worldSphere;
+        BoundingSphere::CreateFromBoundingBox(worldSphere, worldBounds);
+
+        float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&worldSphere.Center) - eyePos)) - worldSphere.Radius;
+        distance = MathHelper::Max(distance, c_MinTextureStreamingDistance);
+        const float pixelsAcross = 2.0f * worldSphere.Radius * projectionScale / distance;
+
+        // The material transform shrinks the UVs of atlas regions, which raises their density.
+        XMMATRIX texTransform = XMLoadFloat4x4(&ri->m_TexTransform) * XMLoadFloat4x4(&ri->m_Mat->MatTransform);
+        float uvScale = XMVectorGetX(XMVector3Length(texTransform.r[0]));
+        uvScale = MathHelper::Max(uvScale, XMVectorGetX(XMVector3Length(texTransform.r[1])));
+
+        const float pixelsPerUv = pixelsAcross / uvScale;
+        RequestStreamedTexture(ri->m_Mat->DiffuseTextureName, pixelsPerUv);
+        RequestStreamedTexture(ri->m_Mat->NormalTextureName, pixelsPerUv);
+    }
 
-    auto blurWeights = m_Ssao->CalcGaussWeights(2.5f);
-    ssaoCB.BlurWeights[0] = XMFLOAT4(&blurWeights[0]);
-    ssaoCB.BlurWeights[1] = XMFLOAT4(&blurWeights[4]);
-    ssaoCB.BlurWeights[2] = XMFLOAT4(&blurWeights[8]);
+    // The sky surrounds the camera, so each cube face spans a 90 degree field of view.
+    RequestStreamedTexture("skyCubeMap", 2.0f * projectionScale);
 
-    ssaoCB.InvRenderTargetSize = XMFLOAT2(1.0f / m_Ssao->SsaoMapWidth(), 1.0f / m_Ssao->SsaoMapHeight());
+    m_TextureStreaming->Update(m_TextureStreamingRequests);
+    for (const TextureStreamingRequest& request : m_TextureStreamingRequests)
+    {
+        const Texture& texture = *m_Textures[m_StreamedTextureNames[request.m_Texture]];
+        m_LoadingTextures[m_TextureLoader->Load(texture.Filename, request.m_FirstMip, 0, GetTextureUsage(texture))] = texture.Name;
+    }
+}
 
-    // Coordinates given in view space.
-    ssaoCB.OcclusionRadius = 0.5f;
-    ssaoCB.OcclusionFadeStart = 0.2f;
-    ssaoCB.OcclusionFadeEnd = 1.0f;
-    ssaoCB.SurfaceEpsilon = 0.05f;
- 
-    auto currSsaoCB = m_CurrFrameResource->SsaoCB.get();
-    currSsaoCB->CopyData(0, ssaoCB);
+void Renderer::RequestStreamedTexture(const std::string& textureName, float pixelsPerUv)
+{
+    // Placeholders and textures still on their first load are not streamed. Shared textures are
+    // streamed under the name of their owner.
+    const auto it = m_StreamedTextureIds.find(m_Textures.at(textureName)->Name);
+    if (it != m_StreamedTextureIds.end())
+    {
+        m_TextureStreaming->RequestDensity(it->second, pixelsPerUv);
+    }
 }
 
-void Renderer::LoadTextures()
+void Renderer::BindMaterialTextures()
 {
-	std::vector<std::string> texNames = 
-	{
-		"bricksDiffuseMap",
-		"bricksNormalMap",
-		"tileDiffuseMap",
-		"tileNormalMap",
-		"defaultDiffuseMap",
-		"defaultNormalMap",
-		"skyCubeMap"
-	};
-	
-    std::vector<std::wstring> texFilenames =
+    for (auto& e : m_Materials)
     {
-        L"Assets/Textures/bricks2.dds",
-        L"Assets/Textures/bricks2_nmap.dds",
-        L"Assets/Textures/tile.dds",
-        L"Assets/Textures/tile_nmap.dds",
-        L"Assets/Textures/white1x1.dds",
-        L"Assets/Textures/default_nmap.dds",
-        L"Assets/Textures/sunsetcube1024.dds"
-    };
-	
-	for(int i = 0; i < (int)texNames.size(); ++i)
-	{
-		auto texMap = std::make_unique<Texture>();
-		texMap->Name = texNames[i];
-		texMap->Filename = texFilenames[i];
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(m_d3dDevice.Get(),
-			m_CommandList.Get(), texMap->Filename.c_str(),
-			texMap->Resource, texMap->UploadHeap));
-			
-		m_Textures[texMap->Name] = std::move(texMap);
-	}		
+        Material* mat = e.second.get();
+        mat->DiffuseSrvHeapIndex = GetTextureSrvIndex(mat->DiffuseTextureName);
+        mat->NormalSrvHeapIndex = GetTextureSrvIndex(mat->NormalTextureName);
+    }
 }
 
 void Renderer::BuildRootSignature()
@@ -697,42 +1483,22 @@ void Renderer::BuildRootSignature()
 	texTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 3, 0, 0);
 
 	CD3DX12_DESCRIPTOR_RANGE texTable1;
-	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 10, 3, 0);
-
-    // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[5];
+	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, c_SrvHeapSize, 3, 0);
 
 	// Perfomance TIP: Order from most frequent to least frequent.
-    slotRootParameter[0].InitAsConstantBufferView(0);
-    slotRootParameter[1].InitAsConstantBufferView(1);
-    slotRootParameter[2].InitAsShaderResourceView(0, 1);
-	slotRootParameter[3].InitAsDescriptorTable(1, &texTable0, D3D12_SHADER_VISIBILITY_PIXEL);
-	slotRootParameter[4].InitAsDescriptorTable(1, &texTable1, D3D12_SHADER_VISIBILITY_PIXEL);
-
-	auto staticSamplers = GetStaticSamplers();
-
-    // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
-		(UINT)staticSamplers.size(), staticSamplers.data(),
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
-
-    // create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
-    ComPtr<ID3DBlob> serializedRootSig = nullptr;
-    ComPtr<ID3DBlob> errorBlob = nullptr;
-    HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-        serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
-
-    if(errorBlob != nullptr)
-    {
-        ::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-    }
-    ThrowIfFailed(hr);
-
-    ThrowIfFailed(m_d3dDevice->CreateRootSignature(
-		0,
-        serializedRootSig->GetBufferPointer(),
-        serializedRootSig->GetBufferSize(),
-        IID_PPV_ARGS(m_RootSignature.GetAddressOf())));
+    RootSignatureDesc desc;
+    desc.AddConstantBufferView(0);
+    desc.AddConstantBufferView(1);
+    desc.AddShaderResourceView(0, 1);
+	desc.AddDescriptorTable(&texTable0, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+	desc.AddDescriptorTable(&texTable1, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+
+	const auto& staticSamplers = GetStaticSamplers();
+    desc.AddStaticSamplers(staticSamplers.data(), (u32)staticSamplers.size());
+    desc.SetFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+
+    m_RootSignature = m_RootSignatureCache->GetRootSignature(desc);
+    m_RootSignatureHash = desc.GetHash();
 }
 
 void Renderer::BuildSsaoRootSignature()
@@ -743,14 +1509,12 @@ void Renderer::BuildSsaoRootSignature()
     CD3DX12_DESCRIPTOR_RANGE texTable1;
     texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2, 0);
 
-    // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
-
     // Perfomance TIP: Order from most frequent to least frequent.
-    slotRootParameter[0].InitAsConstantBufferView(0);
-    slotRootParameter[1].InitAsConstants(1, 1);
-    slotRootParameter[2].InitAsDescriptorTable(1, &texTable0, D3D12_SHADER_VISIBILITY_PIXEL);
-    slotRootParameter[3].InitAsDescriptorTable(1, &texTable1, D3D12_SHADER_VISIBILITY_PIXEL);
+    RootSignatureDesc desc;
+    desc.AddConstantBufferView(0);
+    desc.AddConstants(1, 1);
+    desc.AddDescriptorTable(&texTable0, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+    desc.AddDescriptorTable(&texTable1, 1, D3D12_SHADER_VISIBILITY_PIXEL);
 
     const CD3DX12_STATIC_SAMPLER_DESC pointClamp(
         0, // shaderRegister
@@ -784,33 +1548,16 @@ void Renderer::BuildSsaoRootSignature()
         D3D12_TEXTURE_ADDRESS_MODE_WRAP,  // addressV
         D3D12_TEXTURE_ADDRESS_MODE_WRAP); // addressW
 
-    std::array<CD3DX12_STATIC_SAMPLER_DESC, 4> staticSamplers =
+    const std::array<CD3DX12_STATIC_SAMPLER_DESC, 4> staticSamplers =
     {
         pointClamp, linearClamp, depthMapSam, linearWrap
     };
 
-    // A root signature is an array of root parameters.
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
-        (UINT)staticSamplers.size(), staticSamplers.data(),
-        D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
-
-    // create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
-    ComPtr<ID3DBlob> serializedRootSig = nullptr;
-    ComPtr<ID3DBlob> errorBlob = nullptr;
-    HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-        serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
-
-    if(errorBlob != nullptr)
-    {
-        ::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-    }
-    ThrowIfFailed(hr);
+    desc.AddStaticSamplers(staticSamplers.data(), (u32)staticSamplers.size());
+    desc.SetFlags(D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
-    ThrowIfFailed(m_d3dDevice->CreateRootSignature(
-        0,
-        serializedRootSig->GetBufferPointer(),
-        serializedRootSig->GetBufferSize(),
-        IID_PPV_ARGS(m_SsaoRootSignature.GetAddressOf())));
+    m_SsaoRootSignature = m_RootSignatureCache->GetRootSignature(desc);
+    m_SsaoRootSignatureHash = desc.GetHash();
 }
 
 void Renderer::BuildDescriptorHeaps()
@@ -818,85 +1565,61 @@ void Renderer::BuildDescriptorHeaps()
 	//
 	// Create the SRV heap.
 	//
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = c_MaxSrvDescriptors;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(m_d3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&m_SrvDescriptorHeap)));
-
-    s_SrvDescriptorHeapAllocator.Create(m_d3dDevice.Get(), m_SrvDescriptorHeap.Get());
+    m_SrvHeap = std::make_unique<BindlessDescriptorHeap>(m_d3dDevice.Get(), c_MaxSrvDescriptors, c_SrvHeapShards,
+        c_TransientSrvDescriptorsPerFrame, gNumFrameResources, m_FrameTimeline.get());
 
 	//
 	// Fill out the heap with actual descriptors.
 	//
 
-	std::vector<ComPtr<ID3D12Resource>> tex2DList = 
+	// Textures still loading get their SRVs once they are resident.
+	for (auto& e : m_Textures)
 	{
-		m_Textures["bricksDiffuseMap"]->Resource,
-		m_Textures["bricksNormalMap"]->Resource,
-		m_Textures["tileDiffuseMap"]->Resource,
-		m_Textures["tileNormalMap"]->Resource,
-		m_Textures["defaultDiffuseMap"]->Resource,
-		m_Textures["defaultNormalMap"]->Resource
-	};
-	
-	auto skyCubeMap = m_Textures["skyCubeMap"]->Resource;
+		if (e.second->Resource != nullptr)
+		{
+			CreateTextureSrv(*e.second);
+		}
+	}
 
     {
         D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
         srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Texture2D.MostDetailedMip = 0;
-        srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-        for (UINT i = 0; i < (UINT)tex2DList.size(); ++i)
-        {
-            srvDesc.Format = tex2DList[i]->GetDesc().Format;
-            srvDesc.Texture2D.MipLevels = tex2DList[i]->GetDesc().MipLevels;
-            CreateSrv(tex2DList[i].Get(), &srvDesc);
-        }
-
         srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+        srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
         srvDesc.TextureCube.MostDetailedMip = 0;
-        srvDesc.TextureCube.MipLevels = skyCubeMap->GetDesc().MipLevels;
+        srvDesc.TextureCube.MipLevels = 1;
         srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
-        srvDesc.Format = skyCubeMap->GetDesc().Format;
-        m_SkyTexHeapIndex = CreateSrv(skyCubeMap.Get(), &srvDesc);
 
-        m_ShadowMapHeapIndex = AllocateDescriptor();
-        m_SsaoHeapIndexStart = AllocateDescriptor();
-        m_SsaoAmbientMapIndex = AllocateDescriptors(3);
-        m_NullCubeSrvIndex = AllocateDescriptors(5);
-        m_NullTexSrvIndex1 = AllocateDescriptor();
-        m_NullTexSrvIndex2 = AllocateDescriptor();
-        m_MainRTVIndex = AllocateDescriptor();
-        m_MainSRVIndex = AllocateDescriptor();
+        // Ssao reserves 5 contiguous SRVs.
+        m_ShadowMapSrv = m_SrvHeap->Allocate();
+        m_SsaoSrvs = m_SrvHeap->Allocate(5);
 
-        auto nullSrv = GetCpuSrv(m_NullCubeSrvIndex);
-        m_NullSrv = GetGpuSrv(m_NullCubeSrvIndex);
+        // Null cube map and two null 2D textures, bound in place of the scene table by passes that do
+        // not sample it.
+        m_NullSrvs = m_SrvHeap->Allocate(3);
+        m_MainSrv = m_SrvHeap->Allocate();
 
-        m_d3dDevice->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
-        nullSrv.Offset(1, m_CbvSrvUavDescriptorSize);
+        m_NullSrv = m_SrvHeap->GetGpuHandle(m_NullSrvs);
+
+        m_d3dDevice->CreateShaderResourceView(nullptr, &srvDesc, m_SrvHeap->GetCpuHandle(m_NullSrvs, 0));
 
         srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
         srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
         srvDesc.Texture2D.MostDetailedMip = 0;
         srvDesc.Texture2D.MipLevels = 1;
         srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-        m_d3dDevice->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
-
-        nullSrv.Offset(1, m_CbvSrvUavDescriptorSize);
-        m_d3dDevice->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
+        m_d3dDevice->CreateShaderResourceView(nullptr, &srvDesc, m_SrvHeap->GetCpuHandle(m_NullSrvs, 1));
+        m_d3dDevice->CreateShaderResourceView(nullptr, &srvDesc, m_SrvHeap->GetCpuHandle(m_NullSrvs, 2));
 
         m_ShadowMap->BuildDescriptors(
-            GetCpuSrv(m_ShadowMapHeapIndex),
-            GetGpuSrv(m_ShadowMapHeapIndex),
+            m_SrvHeap->GetCpuHandle(m_ShadowMapSrv),
+            m_SrvHeap->GetGpuHandle(m_ShadowMapSrv),
             GetDsv(1));
 
         m_Ssao->BuildDescriptors(
             m_DepthStencilBuffer.Get(),
-            GetCpuSrv(m_SsaoHeapIndexStart),
-            GetGpuSrv(m_SsaoHeapIndexStart),
+            m_SrvHeap->GetCpuHandle(m_SsaoSrvs),
+            m_SrvHeap->GetGpuHandle(m_SsaoSrvs),
             GetRtv(s_SwapChainBufferCount),
             m_CbvSrvUavDescriptorSize,
             m_RtvDescriptorSize);
@@ -907,33 +1630,46 @@ void Renderer::BuildDescriptorHeaps()
 
 void Renderer::BuildShadersAndInputLayout()
 {
-	const D3D_SHADER_MACRO alphaTestDefines[] =
+	const std::vector<ShaderDefine> alphaTestDefines =
 	{
-		"ALPHA_TEST", "1",
-		NULL, NULL
+		{ "ALPHA_TEST", "1" }
 	};
 
-	m_Shaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
-	m_Shaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_1");
+	m_PendingShaders =
+	{
+		{ "standardVS", { L"Shaders\\Default.hlsl", {}, "VS", "vs_5_1" } },
+		{ "opaquePS", { L"Shaders\\Default.hlsl", {}, "PS", "ps_5_1" } },
 
-    m_Shaders["shadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "VS", "vs_5_1");
-    m_Shaders["shadowOpaquePS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "PS", "ps_5_1");
-    m_Shaders["shadowAlphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", alphaTestDefines, "PS", "ps_5_1");
-	
-    m_Shaders["debugVS"] = d3dUtil::CompileShader(L"Shaders\\ShadowDebug.hlsl", nullptr, "VS", "vs_5_1");
-    m_Shaders["debugPS"] = d3dUtil::CompileShader(L"Shaders\\ShadowDebug.hlsl", nullptr, "PS", "ps_5_1");
+		{ "shadowVS", { L"Shaders\\Shadows.hlsl", {}, "VS", "vs_5_1" } },
+		{ "shadowOpaquePS", { L"Shaders\\Shadows.hlsl", {}, "PS", "ps_5_1" } },
+		{ "shadowAlphaTestedPS", { L"Shaders\\Shadows.hlsl", alphaTestDefines, "PS", "ps_5_1" } },
 
-    m_Shaders["drawNormalsVS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", nullptr, "VS", "vs_5_1");
-    m_Shaders["drawNormalsPS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", nullptr, "PS", "ps_5_1");
+		{ "debugVS", { L"Shaders\\ShadowDebug.hlsl", {}, "VS", "vs_5_1" } },
+		{ "debugPS", { L"Shaders\\ShadowDebug.hlsl", {}, "PS", "ps_5_1" } },
 
-    m_Shaders["ssaoVS"] = d3dUtil::CompileShader(L"Shaders\\Ssao.hlsl", nullptr, "VS", "vs_5_1");
-    m_Shaders["ssaoPS"] = d3dUtil::CompileShader(L"Shaders\\Ssao.hlsl", nullptr, "PS", "ps_5_1");
+		{ "drawNormalsVS", { L"Shaders\\DrawNormals.hlsl", {}, "VS", "vs_5_1" } },
+		{ "drawNormalsPS", { L"Shaders\\DrawNormals.hlsl", {}, "PS", "ps_5_1" } },
 
-    m_Shaders["ssaoBlurVS"] = d3dUtil::CompileShader(L"Shaders\\SsaoBlur.hlsl", nullptr, "VS", "vs_5_1");
-    m_Shaders["ssaoBlurPS"] = d3dUtil::CompileShader(L"Shaders\\SsaoBlur.hlsl", nullptr, "PS", "ps_5_1");
+		{ "ssaoVS", { L"Shaders\\Ssao.hlsl", {}, "VS", "vs_5_1" } },
+		{ "ssaoPS", { L"Shaders\\Ssao.hlsl", {}, "PS", "ps_5_1" } },
 
-	m_Shaders["skyVS"] = d3dUtil::CompileShader(L"Shaders\\Sky.hlsl", nullptr, "VS", "vs_5_1");
-	m_Shaders["skyPS"] = d3dUtil::CompileShader(L"Shaders\\Sky.hlsl", nullptr, "PS", "ps_5_1");
+		{ "ssaoBlurVS", { L"Shaders\\SsaoBlur.hlsl", {}, "VS", "vs_5_1" } },
+		{ "ssaoBlurPS", { L"Shaders\\SsaoBlur.hlsl", {}, "PS", "ps_5_1" } },
+
+		{ "skyVS", { L"Shaders\\Sky.hlsl", {}, "VS", "vs_5_1" } },
+		{ "skyPS", { L"Shaders\\Sky.hlsl", {}, "PS", "ps_5_1" } },
+	};
+
+	// Every permutation is independent, compile them all on the workers while the rest of
+	// initialization carries on. Failures are reported in WaitForShaders.
+	m_ShaderDispatchTime = std::chrono::steady_clock::now();
+	m_JobSystem->DispatchRange(m_ShaderCounter, (u32)m_PendingShaders.size(), [this](u32 index, u32 workerIndex)
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		PendingShader& pending = m_PendingShaders[index];
+		pending.m_Shader = m_ShaderCache->GetShader(pending.m_Desc);
+		pending.m_CompileMs = MillisecondsSince(start);
+	});
 
     m_InputLayout =
     {
@@ -944,6 +1680,36 @@ void Renderer::BuildShadersAndInputLayout()
     };
 }
 
+void Renderer::WaitForShaders()
+{
+    const std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    m_JobSystem->Wait(m_ShaderCounter);
+    const float waitMs = MillisecondsSince(waitStart);
+
+    float compileMs = 0.0f;
+    for (PendingShader& pending : m_PendingShaders)
+    {
+        // The compiler has already written the errors to the debug output.
+        if (pending.m_Shader == nullptr)
+        {
+            ThrowIfFailed(E_FAIL);
+        }
+
+        m_Shaders[pending.m_Name] = pending.m_Shader;
+        compileMs += pending.m_CompileMs;
+    }
+
+    LogStartupStage("shaders", (u32)m_PendingShaders.size(), MillisecondsSince(m_ShaderDispatchTime), compileMs);
+
+    const ShaderCacheStats stats = m_ShaderCache->GetStats();
+    char text[256];
+    snprintf(text, sizeof(text), "Startup: shader cache %u memory hits, %u disk hits, %u compiled, waited %.2f ms at the join\n",
+        stats.m_MemoryHits, stats.m_DiskHits, stats.m_Compiles, waitMs);
+    OutputDebugStringA(text);
+
+    m_PendingShaders.clear();
+}
+
 void Renderer::BuildShapeGeometry()
 {
     GeometryGenerator geoGen;
@@ -997,6 +1763,18 @@ void Renderer::BuildShapeGeometry()
     quadSubmesh.StartIndexLocation = quadIndexOffset;
     quadSubmesh.BaseVertexLocation = quadVertexOffset;
 
+    // Object space bounds, used for culling.
+    auto computeBounds = [](SubmeshGeometry& submesh, const GeometryGenerator::MeshData& mesh)
+    {
+        BoundingBox::CreateFromPoints(submesh.Bounds, mesh.Vertices.size(),
+            &mesh.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+    };
+    computeBounds(boxSubmesh, box);
+    computeBounds(gridSubmesh, grid);
+    computeBounds(sphereSubmesh, sphere);
+    computeBounds(cylinderSubmesh, cylinder);
+    computeBounds(quadSubmesh, quad);
+
 	//
 	// Extract the vertex elements we are interested in and pack the
 	// vertices of all the meshes into one vertex buffer.
@@ -1059,6 +1837,65 @@ void Renderer::BuildShapeGeometry()
 	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
     indices.insert(indices.end(), std::begin(quad.GetIndices16()), std::end(quad.GetIndices16()));
 
+    //
+    // Coarser versions of the curved shapes for LOD selection, appended after the shapes
+    // above so their offsets are unchanged.
+    //
+
+    auto appendLodMesh = [&](const GeometryGenerator::MeshData& mesh)
+    {
+        SubmeshGeometry submesh;
+        submesh.IndexCount = (UINT)mesh.Indices32.size();
+        submesh.StartIndexLocation = (UINT)indices.size();
+        submesh.BaseVertexLocation = (INT)vertices.size();
+        computeBounds(submesh, mesh);
+
+        for (const GeometryGenerator::Vertex& meshVertex : mesh.Vertices)
+        {
+            Vertex vertex;
+            vertex.Pos = meshVertex.Position;
+            vertex.Normal = meshVertex.Normal;
+            vertex.TexC = meshVertex.TexC;
+            vertex.TangentU = meshVertex.TangentU;
+            vertices.push_back(vertex);
+        }
+        GeometryGenerator::MeshData indexSource = mesh;
+        indices.insert(indices.end(), std::begin(indexSource.GetIndices16()), std::end(indexSource.GetIndices16()));
+
+        return submesh;
+    };
+
+    // Largest distance between a circle and an inscribed polygon with this many segments.
+    auto chordError = [](float radius, UINT segments)
+    {
+        return radius * (1.0f - cosf(XM_PI / (float)segments));
+    };
+
+    SubmeshGeometry sphereLod1Submesh = appendLodMesh(geoGen.CreateSphere(0.5f, 10, 10));
+    SubmeshGeometry sphereLod2Submesh = appendLodMesh(geoGen.CreateSphere(0.5f, 6, 6));
+    SubmeshGeometry cylinderLod1Submesh = appendLodMesh(geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 10, 1));
+    SubmeshGeometry cylinderLod2Submesh = appendLodMesh(geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 6, 1));
+
+    auto lodLevel = [](const SubmeshGeometry& submesh, float geometricError)
+    {
+        LodLevel level;
+        level.m_DrawArgs.m_IndexCount = submesh.IndexCount;
+        level.m_DrawArgs.m_StartIndexLocation = submesh.StartIndexLocation;
+        level.m_DrawArgs.m_BaseVertexLocation = submesh.BaseVertexLocation;
+        level.m_GeometricError = geometricError;
+        return level;
+    };
+
+    m_LodSets["sphere"].m_Levels = {
+        lodLevel(sphereSubmesh, chordError(0.5f, 20)),
+        lodLevel(sphereLod1Submesh, chordError(0.5f, 10)),
+        lodLevel(sphereLod2Submesh, chordError(0.5f, 6)) };
+
+    m_LodSets["cylinder"].m_Levels = {
+        lodLevel(cylinderSubmesh, chordError(0.5f, 20)),
+        lodLevel(cylinderLod1Submesh, chordError(0.5f, 10)),
+        lodLevel(cylinderLod2Submesh, chordError(0.5f, 6)) };
+
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
     const UINT ibByteSize = (UINT)indices.size()  * sizeof(std::uint16_t);
 
@@ -1071,11 +1908,8 @@ void Renderer::BuildShapeGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-		m_CommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-		m_CommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->VertexBufferGPU = m_UploadQueue->CreateBuffer(vertices.data(), vbByteSize);
+	geo->IndexBufferGPU = m_UploadQueue->CreateBuffer(indices.data(), ibByteSize);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -1181,11 +2015,8 @@ void Renderer::BuildSkullGeometry()
     ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
     CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-    geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-        m_CommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
-    geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-        m_CommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+    geo->VertexBufferGPU = m_UploadQueue->CreateBuffer(vertices.data(), vbByteSize);
+    geo->IndexBufferGPU = m_UploadQueue->CreateBuffer(indices.data(), ibByteSize);
 
     geo->VertexByteStride = sizeof(Vertex);
     geo->VertexBufferByteSize = vbByteSize;
@@ -1205,6 +2036,13 @@ void Renderer::BuildSkullGeometry()
 
 void Renderer::BuildPSOs()
 {
+    // Every PSO below needs compiled shaders.
+    WaitForShaders();
+
+    // Descriptions are filled in here and the PSOs created together on the workers at the end,
+    // the device is free threaded.
+    std::vector<std::pair<PipelineId, D3D12_GRAPHICS_PIPELINE_STATE_DESC>> psoDescs;
+
     D3D12_GRAPHICS_PIPELINE_STATE_DESC basePsoDesc;
 
 	
@@ -1213,12 +2051,12 @@ void Renderer::BuildPSOs()
     basePsoDesc.pRootSignature = m_RootSignature.Get();
     basePsoDesc.VS =
 	{ 
-		reinterpret_cast<BYTE*>(m_Shaders["standardVS"]->GetBufferPointer()), 
+		reinterpret_cast<const BYTE*>(m_Shaders["standardVS"]->GetBufferPointer()), 
 		m_Shaders["standardVS"]->GetBufferSize()
 	};
     basePsoDesc.PS =
 	{ 
-		reinterpret_cast<BYTE*>(m_Shaders["opaquePS"]->GetBufferPointer()),
+		reinterpret_cast<const BYTE*>(m_Shaders["opaquePS"]->GetBufferPointer()),
 		m_Shaders["opaquePS"]->GetBufferSize()
 	};
     basePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
@@ -1239,7 +2077,7 @@ void Renderer::BuildPSOs()
     D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc = basePsoDesc;
     opaquePsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
     opaquePsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
-    ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&m_PSOs["opaque"])));
+    psoDescs.push_back({ PipelineId::Opaque, opaquePsoDesc });
 
     //
     // PSO for shadow map pass.
@@ -1251,19 +2089,19 @@ void Renderer::BuildPSOs()
     smapPsoDesc.pRootSignature = m_RootSignature.Get();
     smapPsoDesc.VS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["shadowVS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["shadowVS"]->GetBufferPointer()),
         m_Shaders["shadowVS"]->GetBufferSize()
     };
     smapPsoDesc.PS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["shadowOpaquePS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["shadowOpaquePS"]->GetBufferPointer()),
         m_Shaders["shadowOpaquePS"]->GetBufferSize()
     };
     
     // Shadow map pass does not have a render target.
     smapPsoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
     smapPsoDesc.NumRenderTargets = 0;
-    ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&smapPsoDesc, IID_PPV_ARGS(&m_PSOs["shadow_opaque"])));
+    psoDescs.push_back({ PipelineId::ShadowOpaque, smapPsoDesc });
 
     //
     // PSO for debug layer.
@@ -1272,15 +2110,15 @@ void Renderer::BuildPSOs()
     debugPsoDesc.pRootSignature = m_RootSignature.Get();
     debugPsoDesc.VS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["debugVS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["debugVS"]->GetBufferPointer()),
         m_Shaders["debugVS"]->GetBufferSize()
     };
     debugPsoDesc.PS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["debugPS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["debugPS"]->GetBufferPointer()),
         m_Shaders["debugPS"]->GetBufferSize()
     };
-    ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&debugPsoDesc, IID_PPV_ARGS(&m_PSOs["debug"])));
+    psoDescs.push_back({ PipelineId::Debug, debugPsoDesc });
 
     //
     // PSO for drawing normals.
@@ -1288,19 +2126,19 @@ void Renderer::BuildPSOs()
     D3D12_GRAPHICS_PIPELINE_STATE_DESC drawNormalsPsoDesc = basePsoDesc;
     drawNormalsPsoDesc.VS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["drawNormalsVS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["drawNormalsVS"]->GetBufferPointer()),
         m_Shaders["drawNormalsVS"]->GetBufferSize()
     };
     drawNormalsPsoDesc.PS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["drawNormalsPS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["drawNormalsPS"]->GetBufferPointer()),
         m_Shaders["drawNormalsPS"]->GetBufferSize()
     };
     drawNormalsPsoDesc.RTVFormats[0] = Ssao::NormalMapFormat;
     drawNormalsPsoDesc.SampleDesc.Count = 1;
     drawNormalsPsoDesc.SampleDesc.Quality = 0;
     drawNormalsPsoDesc.DSVFormat = m_DepthStencilFormat;
-    ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&drawNormalsPsoDesc, IID_PPV_ARGS(&m_PSOs["drawNormals"])));
+    psoDescs.push_back({ PipelineId::DrawNormals, drawNormalsPsoDesc });
 
     //
     // PSO for SSAO.
@@ -1310,12 +2148,12 @@ void Renderer::BuildPSOs()
     ssaoPsoDesc.pRootSignature = m_SsaoRootSignature.Get();
     ssaoPsoDesc.VS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["ssaoVS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["ssaoVS"]->GetBufferPointer()),
         m_Shaders["ssaoVS"]->GetBufferSize()
     };
     ssaoPsoDesc.PS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["ssaoPS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["ssaoPS"]->GetBufferPointer()),
         m_Shaders["ssaoPS"]->GetBufferSize()
     };
 
@@ -1326,7 +2164,7 @@ void Renderer::BuildPSOs()
     ssaoPsoDesc.SampleDesc.Count = 1;
     ssaoPsoDesc.SampleDesc.Quality = 0;
     ssaoPsoDesc.DSVFormat = DXGI_FORMAT_UNKNOWN;
-    ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&ssaoPsoDesc, IID_PPV_ARGS(&m_PSOs["ssao"])));
+    psoDescs.push_back({ PipelineId::Ssao, ssaoPsoDesc });
 
     //
     // PSO for SSAO blur.
@@ -1334,15 +2172,15 @@ void Renderer::BuildPSOs()
     D3D12_GRAPHICS_PIPELINE_STATE_DESC ssaoBlurPsoDesc = ssaoPsoDesc;
     ssaoBlurPsoDesc.VS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["ssaoBlurVS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["ssaoBlurVS"]->GetBufferPointer()),
         m_Shaders["ssaoBlurVS"]->GetBufferSize()
     };
     ssaoBlurPsoDesc.PS =
     {
-        reinterpret_cast<BYTE*>(m_Shaders["ssaoBlurPS"]->GetBufferPointer()),
+        reinterpret_cast<const BYTE*>(m_Shaders["ssaoBlurPS"]->GetBufferPointer()),
         m_Shaders["ssaoBlurPS"]->GetBufferSize()
     };
-    ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&ssaoBlurPsoDesc, IID_PPV_ARGS(&m_PSOs["ssaoBlur"])));
+    psoDescs.push_back({ PipelineId::SsaoBlur, ssaoBlurPsoDesc });
 
 	//
 	// PSO for sky.
@@ -1359,24 +2197,72 @@ void Renderer::BuildPSOs()
 	skyPsoDesc.pRootSignature = m_RootSignature.Get();
 	skyPsoDesc.VS =
 	{
-		reinterpret_cast<BYTE*>(m_Shaders["skyVS"]->GetBufferPointer()),
+		reinterpret_cast<const BYTE*>(m_Shaders["skyVS"]->GetBufferPointer()),
 		m_Shaders["skyVS"]->GetBufferSize()
 	};
 	skyPsoDesc.PS =
 	{
-		reinterpret_cast<BYTE*>(m_Shaders["skyPS"]->GetBufferPointer()),
+		reinterpret_cast<const BYTE*>(m_Shaders["skyPS"]->GetBufferPointer()),
 		m_Shaders["skyPS"]->GetBufferSize()
 	};
-	ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&skyPsoDesc, IID_PPV_ARGS(&m_PSOs["sky"])));
+	psoDescs.push_back({ PipelineId::Sky, skyPsoDesc });
+
+    // Keys follow the shader bytecode and root signature contents, so a recompiled shader or an
+    // edited root signature misses the library and creates a new pipeline.
+    for (const auto& psoDesc : psoDescs)
+    {
+        const u64 rootSignatureHash = psoDesc.second.pRootSignature == m_SsaoRootSignature.Get() ? m_SsaoRootSignatureHash : m_RootSignatureHash;
+        m_PipelineKeys[(u32)psoDesc.first] = HashGraphicsPipelineDesc(psoDesc.second, rootSignatureHash);
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<HRESULT> results(psoDescs.size());
+    std::vector<float> createMs(psoDescs.size());
+
+    m_PipelineCache = std::make_unique<PipelineStateCache>(m_d3dDevice.Get(), std::filesystem::path(c_ShaderCacheDirectory) / c_PipelineLibraryFile);
+
+    JobCounter counter;
+    m_JobSystem->DispatchRange(counter, (u32)psoDescs.size(), [&](u32 index, u32 workerIndex)
+    {
+        const std::chrono::steady_clock::time_point psoStart = std::chrono::steady_clock::now();
+        results[index] = m_PipelineCache->CreatePipeline(m_PipelineKeys[(u32)psoDescs[index].first], psoDescs[index].second);
+        createMs[index] = MillisecondsSince(psoStart);
+    });
+    m_JobSystem->Wait(counter);
+
+    // Errors are thrown here on the calling thread, a throw inside a job would terminate.
+    float jobMs = 0.0f;
+    for (size_t i = 0; i < psoDescs.size(); ++i)
+    {
+        ThrowIfFailed(results[i]);
+        jobMs += createMs[i];
+    }
+
+    m_PipelineCache->Save();
 
+    LogStartupStage("pipeline states", (u32)psoDescs.size(), MillisecondsSince(start), jobMs);
+
+    const PipelineStateCacheStats stats = m_PipelineCache->GetStats();
+    char text[128];
+    snprintf(text, sizeof(text), "Startup: pipeline library %u loaded, %u created\n", stats.m_LibraryHits, stats.m_Creates);
+    OutputDebugStringA(text);
+
+    const RootSignatureCacheStats rootSignatureStats = m_RootSignatureCache->GetStats();
+    snprintf(text, sizeof(text), "Startup: root signatures %u loaded, %u serialized, %u shared\n",
+        rootSignatureStats.m_DiskHits, rootSignatureStats.m_Serializes, rootSignatureStats.m_MemoryHits);
+    OutputDebugStringA(text);
+}
+
+ID3D12PipelineState* Renderer::GetPipeline(PipelineId id) const
+{
+    return m_PipelineCache->Get(m_PipelineKeys[(u32)id]);
 }
 
 void Renderer::BuildFrameResources()
 {
     for(int i = 0; i < gNumFrameResources; ++i)
     {
-        m_FrameResources.push_back(std::make_unique<FrameResource>(m_d3dDevice.Get(),
-            2, (UINT)m_AllRitems.size(), (UINT)m_Materials.size()));
+        m_FrameResources.push_back(std::make_unique<FrameResource>(m_d3dDevice.Get(), m_JobSystem->GetWorkerCount()));
     }
 }
 
@@ -1385,8 +2271,8 @@ void Renderer::BuildMaterials()
     auto bricks0 = std::make_unique<Material>();
     bricks0->Name = "bricks0";
     bricks0->MatCBIndex = 0;
-    bricks0->DiffuseSrvHeapIndex = 0;
-    bricks0->NormalSrvHeapIndex = 1;
+    bricks0->DiffuseTextureName = "bricksDiffuseMap";
+    bricks0->NormalTextureName = "bricksNormalMap";
     bricks0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     bricks0->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
     bricks0->Roughness = 0.3f;
@@ -1394,8 +2280,8 @@ void Renderer::BuildMaterials()
     auto tile0 = std::make_unique<Material>();
     tile0->Name = "tile0";
     tile0->MatCBIndex = 2;
-    tile0->DiffuseSrvHeapIndex = 2;
-    tile0->NormalSrvHeapIndex = 3;
+    tile0->DiffuseTextureName = "tileDiffuseMap";
+    tile0->NormalTextureName = "tileNormalMap";
     tile0->DiffuseAlbedo = XMFLOAT4(0.9f, 0.9f, 0.9f, 1.0f);
     tile0->FresnelR0 = XMFLOAT3(0.2f, 0.2f, 0.2f);
     tile0->Roughness = 0.1f;
@@ -1403,8 +2289,8 @@ void Renderer::BuildMaterials()
     auto mirror0 = std::make_unique<Material>();
     mirror0->Name = "mirror0";
     mirror0->MatCBIndex = 3;
-    mirror0->DiffuseSrvHeapIndex = 4;
-    mirror0->NormalSrvHeapIndex = 5;
+    mirror0->DiffuseTextureName = "defaultDiffuseMap";
+    mirror0->NormalTextureName = "defaultNormalMap";
     mirror0->DiffuseAlbedo = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
     mirror0->FresnelR0 = XMFLOAT3(0.98f, 0.97f, 0.95f);
     mirror0->Roughness = 0.1f;
@@ -1412,8 +2298,8 @@ void Renderer::BuildMaterials()
     auto skullMat = std::make_unique<Material>();
     skullMat->Name = "skullMat";
     skullMat->MatCBIndex = 3;
-    skullMat->DiffuseSrvHeapIndex = 4;
-    skullMat->NormalSrvHeapIndex = 5;
+    skullMat->DiffuseTextureName = "defaultDiffuseMap";
+    skullMat->NormalTextureName = "defaultNormalMap";
     skullMat->DiffuseAlbedo = XMFLOAT4(0.3f, 0.3f, 0.3f, 1.0f);
     skullMat->FresnelR0 = XMFLOAT3(0.6f, 0.6f, 0.6f);
     skullMat->Roughness = 0.2f;
@@ -1421,8 +2307,8 @@ void Renderer::BuildMaterials()
     auto sky = std::make_unique<Material>();
     sky->Name = "sky";
     sky->MatCBIndex = 4;
-    sky->DiffuseSrvHeapIndex = 6;
-    sky->NormalSrvHeapIndex = 7;
+    sky->DiffuseTextureName = "skyCubeMap";
+    sky->NormalTextureName = "defaultNormalMap";
     sky->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     sky->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
     sky->Roughness = 1.0f;
@@ -1432,6 +2318,8 @@ void Renderer::BuildMaterials()
     m_Materials["mirror0"] = std::move(mirror0);
     m_Materials["skullMat"] = std::move(skullMat);
     m_Materials["sky"] = std::move(sky);
+
+    BindMaterialTextures();
 }
 
 void Renderer::BuildRenderItems()
@@ -1446,6 +2334,7 @@ void Renderer::BuildRenderItems()
 	skyRitem->m_IndexCount = skyRitem->m_Geo->DrawArgs["sphere"].IndexCount;
 	skyRitem->m_StartIndexLocation = skyRitem->m_Geo->DrawArgs["sphere"].StartIndexLocation;
 	skyRitem->m_BaseVertexLocation = skyRitem->m_Geo->DrawArgs["sphere"].BaseVertexLocation;
+	skyRitem->m_Bounds = skyRitem->m_Geo->DrawArgs["sphere"].Bounds;
 
 	m_RitemLayer[(int)RenderLayer::Sky].push_back(skyRitem.get());
 	m_AllRitems.push_back(std::move(skyRitem));
@@ -1460,6 +2349,7 @@ void Renderer::BuildRenderItems()
     quadRitem->m_IndexCount = quadRitem->m_Geo->DrawArgs["quad"].IndexCount;
     quadRitem->m_StartIndexLocation = quadRitem->m_Geo->DrawArgs["quad"].StartIndexLocation;
     quadRitem->m_BaseVertexLocation = quadRitem->m_Geo->DrawArgs["quad"].BaseVertexLocation;
+    quadRitem->m_Bounds = quadRitem->m_Geo->DrawArgs["quad"].Bounds;
 
     m_RitemLayer[(int)RenderLayer::Debug].push_back(quadRitem.get());
     m_AllRitems.push_back(std::move(quadRitem));
@@ -1474,6 +2364,8 @@ void Renderer::BuildRenderItems()
 	boxRitem->m_IndexCount = boxRitem->m_Geo->DrawArgs["box"].IndexCount;
 	boxRitem->m_StartIndexLocation = boxRitem->m_Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->m_BaseVertexLocation = boxRitem->m_Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->m_Bounds = boxRitem->m_Geo->DrawArgs["box"].Bounds;
+	boxRitem->m_Occluder = true;
 
 	m_RitemLayer[(int)RenderLayer::Opaque].push_back(boxRitem.get());
 	m_AllRitems.push_back(std::move(boxRitem));
@@ -1488,6 +2380,7 @@ void Renderer::BuildRenderItems()
     skullRitem->m_IndexCount = skullRitem->m_Geo->DrawArgs["skull"].IndexCount;
     skullRitem->m_StartIndexLocation = skullRitem->m_Geo->DrawArgs["skull"].StartIndexLocation;
     skullRitem->m_BaseVertexLocation = skullRitem->m_Geo->DrawArgs["skull"].BaseVertexLocation;
+    skullRitem->m_Bounds = skullRitem->m_Geo->DrawArgs["skull"].Bounds;
 
 	m_RitemLayer[(int)RenderLayer::Opaque].push_back(skullRitem.get());
 	m_AllRitems.push_back(std::move(skullRitem));
@@ -1502,6 +2395,7 @@ void Renderer::BuildRenderItems()
     gridRitem->m_IndexCount = gridRitem->m_Geo->DrawArgs["grid"].IndexCount;
     gridRitem->m_StartIndexLocation = gridRitem->m_Geo->DrawArgs["grid"].StartIndexLocation;
     gridRitem->m_BaseVertexLocation = gridRitem->m_Geo->DrawArgs["grid"].BaseVertexLocation;
+    gridRitem->m_Bounds = gridRitem->m_Geo->DrawArgs["grid"].Bounds;
 
 	m_RitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
 	m_AllRitems.push_back(std::move(gridRitem));
@@ -1525,6 +2419,9 @@ void Renderer::BuildRenderItems()
 	leftCylRitem->m_IndexCount = leftCylRitem->m_Geo->DrawArgs["cylinder"].IndexCount;
 	leftCylRitem->m_StartIndexLocation = leftCylRitem->m_Geo->DrawArgs["cylinder"].StartIndexLocation;
 	leftCylRitem->m_BaseVertexLocation = leftCylRitem->m_Geo->DrawArgs["cylinder"].BaseVertexLocation;
+	leftCylRitem->m_Bounds = leftCylRitem->m_Geo->DrawArgs["cylinder"].Bounds;
+	leftCylRitem->m_Occluder = true;
+	leftCylRitem->m_LodSet = &m_LodSets["cylinder"];
 
 	XMStoreFloat4x4(&leftSphereRitem->m_World, leftSphereWorld);
 	leftSphereRitem->m_TexTransform = MathHelper::Identity4x4();
@@ -1535,22 +2432,151 @@ void Renderer::BuildRenderItems()
 	leftSphereRitem->m_IndexCount = leftSphereRitem->m_Geo->DrawArgs["sphere"].IndexCount;
 	leftSphereRitem->m_StartIndexLocation = leftSphereRitem->m_Geo->DrawArgs["sphere"].StartIndexLocation;
 	leftSphereRitem->m_BaseVertexLocation = leftSphereRitem->m_Geo->DrawArgs["sphere"].BaseVertexLocation;
+	leftSphereRitem->m_Bounds = leftSphereRitem->m_Geo->DrawArgs["sphere"].Bounds;
+	leftSphereRitem->m_LodSet = &m_LodSets["sphere"];
 
 	m_RitemLayer[(int)RenderLayer::Opaque].push_back(leftCylRitem.get());
 	m_RitemLayer[(int)RenderLayer::Opaque].push_back(leftSphereRitem.get());
 
 	m_AllRitems.push_back(std::move(leftCylRitem));
 	m_AllRitems.push_back(std::move(leftSphereRitem));
+
+    // Every view draws the full mesh until LOD selection says otherwise.
+    for (auto& ri : m_AllRitems)
+    {
+        LodDrawArgs drawArgs;
+        drawArgs.m_IndexCount = ri->m_IndexCount;
+        drawArgs.m_StartIndexLocation = ri->m_StartIndexLocation;
+        drawArgs.m_BaseVertexLocation = ri->m_BaseVertexLocation;
+        for (LodDrawArgs& viewDrawArgs : ri->m_ViewDrawArgs)
+        {
+            viewDrawArgs = drawArgs;
+        }
+
+        if (ri->m_LodSet != nullptr)
+        {
+            ri->m_LodItem = m_LodSelector.AddItem(ri->m_LodSet);
+        }
+    }
+}
+
+void Renderer::SelectLods(const RenderSnapshot& frame)
+{
+    for (auto& ri : m_AllRitems)
+    {
+        if (ri->m_LodSet == nullptr)
+        {
+            continue;
+        }
+
+        XMMATRIX world = XMLoadFloat4x4(&frame.m_ItemWorlds[ri->m_ObjCBIndex]);
+
+        BoundingBox worldBounds;
+        ri->m_Bounds.Transform(worldBounds, world);
+        BoundingSphere worldSphere;
+        BoundingSphere::CreateFromBoundingBox(worldSphere, worldBounds);
+
+        // Errors are in object space, scale them by the largest axis scale of the world matrix.
+        float scale = XMVectorGetX(XMVector3Length(world.r[0]));
+        scale = MathHelper::Max(scale, XMVectorGetX(XMVector3Length(world.r[1])));
+        scale = MathHelper::Max(scale, XMVectorGetX(XMVector3Length(world.r[2])));
+
+        m_LodSelector.SetItemBounds(ri->m_LodItem, worldSphere.Center, worldSphere.Radius, scale);
+    }
+
+    LodViewParams mainParams;
+    mainParams.m_EyePosW = frame.m_Camera.GetPosition3f();
+    mainParams.m_ProjectionScale = (float)frame.m_ClientHeight / (2.0f * tanf(0.5f * frame.m_Camera.GetFovY()));
+    mainParams.m_ErrorThreshold = c_LodErrorThreshold;
+    m_LodSelector.Select(LodView::Main, mainParams);
+
+    LodViewParams shadowParams = mainParams;
+    shadowParams.m_LodBias = c_ShadowLodBias;
+    m_LodSelector.Select(LodView::Shadow, shadowParams);
+
+    for (auto& ri : m_AllRitems)
+    {
+        if (ri->m_LodSet == nullptr)
+        {
+            continue;
+        }
+
+        for (u32 view = 0; view < (u32)LodView::Count; ++view)
+        {
+            ri->m_ViewDrawArgs[view] = m_LodSelector.GetSelectedDrawArgs((LodView)view, ri->m_LodItem);
+        }
+    }
+}
+
+void Renderer::CullOpaqueRenderItems(const RenderSnapshot& frame)
+{
+    XMFLOAT4X4 viewProj;
+    XMStoreFloat4x4(&viewProj, XMMatrixMultiply(frame.m_Camera.GetView(), frame.m_Camera.GetProj()));
+    m_OcclusionCuller->BeginFrame(viewProj);
+
+    const std::vector<RenderItem*>& opaqueRitems = m_RitemLayer[(int)RenderLayer::Opaque];
+    const u32 ritemCount = (u32)opaqueRitems.size();
+    m_OccludeeBoundsMin.resize(ritemCount);
+    m_OccludeeBoundsMax.resize(ritemCount);
+    m_OccludeeVisible.resize(ritemCount);
+
+    for (u32 i = 0; i < ritemCount; ++i)
+    {
+        const RenderItem* ri = opaqueRitems[i];
+        const XMFLOAT4X4& riWorld = frame.m_ItemWorlds[ri->m_ObjCBIndex];
+
+        BoundingBox worldBounds;
+        ri->m_Bounds.Transform(worldBounds, XMLoadFloat4x4(&riWorld));
+
+        XMVECTOR center = XMLoadFloat3(&worldBounds.Center);
+        XMVECTOR extents = XMLoadFloat3(&worldBounds.Extents);
+        XMStoreFloat3(&m_OccludeeBoundsMin[i], center - extents);
+        XMStoreFloat3(&m_OccludeeBoundsMax[i], center + extents);
+
+        // Occluders are drawn with their real mesh from the CPU copy of the geometry.
+        if (ri->m_Occluder)
+        {
+            OccluderDesc occluder;
+            occluder.m_World = riWorld;
+            occluder.m_Positions = (const XMFLOAT3*)ri->m_Geo->VertexBufferCPU->GetBufferPointer();
+            occluder.m_PositionStride = ri->m_Geo->VertexByteStride;
+            occluder.m_BaseVertex = ri->m_BaseVertexLocation;
+            occluder.m_Indices = ri->m_Geo->IndexBufferCPU->GetBufferPointer();
+            occluder.m_Indices16 = ri->m_Geo->IndexFormat == DXGI_FORMAT_R16_UINT;
+            occluder.m_StartIndex = ri->m_StartIndexLocation;
+            occluder.m_IndexCount = ri->m_IndexCount;
+            occluder.m_BoundsMin = m_OccludeeBoundsMin[i];
+            occluder.m_BoundsMax = m_OccludeeBoundsMax[i];
+            m_OcclusionCuller->AddOccluder(occluder);
+        }
+    }
+
+    m_OcclusionCuller->RasterizeOccluders();
+    m_OcclusionCuller->TestVisibility(m_OccludeeBoundsMin.data(), m_OccludeeBoundsMax.data(), ritemCount, m_OccludeeVisible.data());
+
+    m_VisibleOpaqueRitems.clear();
+    for (u32 i = 0; i < ritemCount; ++i)
+    {
+        if (m_OccludeeVisible[i])
+        {
+            m_VisibleOpaqueRitems.push_back(opaqueRitems[i]);
+        }
+    }
 }
 
 void Renderer::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
-    UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
- 
-	auto objectCB = m_CurrFrameResource->ObjectCB->Resource();
+    DrawRenderItems(cmdList, ritems, 0, (u32)ritems.size(), LodView::Main);
+}
+
+void Renderer::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems, u32 firstItem, u32 itemCount, LodView view)
+{
+    assert(firstItem + itemCount <= ritems.size());
+
+	const UploadAllocation& objectCB = m_CurrFrameResource->ObjectCB;
 
     // For each render item...
-    for(size_t i = 0; i < ritems.size(); ++i)
+    for(size_t i = firstItem; i < firstItem + itemCount; ++i)
     {
         auto ri = ritems[i];
 
@@ -1558,90 +2584,66 @@ void Renderer::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
         cmdList->IASetIndexBuffer(&ri->m_Geo->IndexBufferView());
         cmdList->IASetPrimitiveTopology(ri->m_PrimitiveType);
 
-        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->m_ObjCBIndex*objCBByteSize;
+        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB.GetGpuAddress(ri->m_ObjCBIndex);
 
 		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
-        cmdList->DrawIndexedInstanced(ri->m_IndexCount, 1, ri->m_StartIndexLocation, ri->m_BaseVertexLocation, 0);
+        const LodDrawArgs& drawArgs = ri->m_ViewDrawArgs[(u32)view];
+        cmdList->DrawIndexedInstanced(drawArgs.m_IndexCount, 1, drawArgs.m_StartIndexLocation, drawArgs.m_BaseVertexLocation, 0);
     }
 }
 
-void Renderer::DrawSceneToShadowMap()
+void Renderer::DrawSceneToShadowMap(ID3D12GraphicsCommandList* cmdList, const RecordTask& task)
 {
-    m_CommandList->RSSetViewports(1, &m_ShadowMap->Viewport());
-    m_CommandList->RSSetScissorRects(1, &m_ShadowMap->ScissorRect());
+    BindScenePassState(cmdList);
 
-    // Change to DEPTH_WRITE.
-    m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_ShadowMap->Resource(),
-        D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_DEPTH_WRITE));
+    cmdList->RSSetViewports(1, &m_ShadowMap->Viewport());
+    cmdList->RSSetScissorRects(1, &m_ShadowMap->ScissorRect());
 
-    // Clear the back buffer and depth buffer.
-    m_CommandList->ClearDepthStencilView(m_ShadowMap->Dsv(), 
-        D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+    if (task.m_FirstInPass)
+    {
+        // Clear the back buffer and depth buffer.
+        cmdList->ClearDepthStencilView(m_ShadowMap->Dsv(), 
+            D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+    }
 
     // Specify the buffers we are going to render to.
-    m_CommandList->OMSetRenderTargets(0, nullptr, false, &m_ShadowMap->Dsv());
+    cmdList->OMSetRenderTargets(0, nullptr, false, &m_ShadowMap->Dsv());
 
     // Bind the pass constant buffer for the shadow map pass.
-    UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
-    auto passCB = m_CurrFrameResource->PassCB->Resource();
-    D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + 1*passCBByteSize;
-    m_CommandList->SetGraphicsRootConstantBufferView(1, passCBAddress);
+    cmdList->SetGraphicsRootConstantBufferView(1, m_CurrFrameResource->PassCB.GetGpuAddress(1));
 
-    m_CommandList->SetPipelineState(m_PSOs["shadow_opaque"].Get());
+    cmdList->SetPipelineState(GetPipeline(PipelineId::ShadowOpaque));
 
-    DrawRenderItems(m_CommandList.Get(), m_RitemLayer[(int)RenderLayer::Opaque]);
-
-    // Change back to GENERIC_READ so we can read the texture in a shader.
-    m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_ShadowMap->Resource(),
-        D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ));
+    DrawRenderItems(cmdList, m_RitemLayer[(int)RenderLayer::Opaque], task.m_FirstItem, task.m_ItemCount, LodView::Shadow);
 }
  
-void Renderer::DrawNormalsAndDepth()
+void Renderer::DrawNormalsAndDepth(ID3D12GraphicsCommandList* cmdList, const RecordTask& task)
 {
-	m_CommandList->RSSetViewports(1, &m_ScreenViewport);
-    m_CommandList->RSSetScissorRects(1, &m_ScissorRect);
+    BindScenePassState(cmdList);
+
+	cmdList->RSSetViewports(1, &m_ScreenViewport);
+    cmdList->RSSetScissorRects(1, &m_ScissorRect);
 
-	auto normalMap = m_Ssao->NormalMap();
 	auto normalMapRtv = m_Ssao->NormalMapRtv();
 	
-    // Change to RENDER_TARGET.
-    m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(normalMap,
-        D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
-
-	// Clear the screen normal map and depth buffer.
-	float clearValue[] = {0.0f, 0.0f, 1.0f, 0.0f};
-    m_CommandList->ClearRenderTargetView(normalMapRtv, clearValue, 0, nullptr);
-    m_CommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+    if (task.m_FirstInPass)
+    {
+        // Clear the screen normal map and depth buffer.
+        float clearValue[] = {0.0f, 0.0f, 1.0f, 0.0f};
+        cmdList->ClearRenderTargetView(normalMapRtv, clearValue, 0, nullptr);
+        cmdList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+    }
 
 	// Specify the buffers we are going to render to.
-    m_CommandList->OMSetRenderTargets(1, &normalMapRtv, true, &DepthStencilView());
+    cmdList->OMSetRenderTargets(1, &normalMapRtv, true, &DepthStencilView());
 
     // Bind the constant buffer for this pass.
-    auto passCB = m_CurrFrameResource->PassCB->Resource();
-    m_CommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
-
-    m_CommandList->SetPipelineState(m_PSOs["drawNormals"].Get());
-
-    DrawRenderItems(m_CommandList.Get(), m_RitemLayer[(int)RenderLayer::Opaque]);
-
-    // Change back to GENERIC_READ so we can read the texture in a shader.
-    m_CommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(normalMap,
-        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ));
-}
+    cmdList->SetGraphicsRootConstantBufferView(1, m_CurrFrameResource->PassCB.GetGpuAddress(0));
 
-CD3DX12_CPU_DESCRIPTOR_HANDLE Renderer::GetCpuSrv(int index)const
-{
-    auto srv = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_SrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-    srv.Offset(index, m_CbvSrvUavDescriptorSize);
-    return srv;
-}
+    cmdList->SetPipelineState(GetPipeline(PipelineId::DrawNormals));
 
-CD3DX12_GPU_DESCRIPTOR_HANDLE Renderer::GetGpuSrv(int index)const
-{
-    auto srv = CD3DX12_GPU_DESCRIPTOR_HANDLE(m_SrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-    srv.Offset(index, m_CbvSrvUavDescriptorSize);
-    return srv;
+    DrawRenderItems(cmdList, m_VisibleOpaqueRitems, task.m_FirstItem, task.m_ItemCount, LodView::Main);
 }
 
 CD3DX12_CPU_DESCRIPTOR_HANDLE Renderer::GetDsv(int index)const
@@ -1658,10 +2660,11 @@ CD3DX12_CPU_DESCRIPTOR_HANDLE Renderer::GetRtv(int index)const
     return rtv;
 }
 
-std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> Renderer::GetStaticSamplers()
+const std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7>& Renderer::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
 	// and keep them available as part of the root signature.  
+	// Built once and shared by every root signature that uses the common set.
 
 	const CD3DX12_STATIC_SAMPLER_DESC pointWrap(
 		0, // shaderRegister
@@ -1720,19 +2723,56 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> Renderer::GetStaticSamplers()
         D3D12_COMPARISON_FUNC_LESS_EQUAL,
         D3D12_STATIC_BORDER_COLOR_OPAQUE_BLACK);
 
-	return { 
+	static const std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> samplers = { 
 		pointWrap, pointClamp,
 		linearWrap, linearClamp, 
 		anisotropicWrap, anisotropicClamp,
         shadow 
     };
+    return samplers;
+}
+
+DescriptorHandle Renderer::CreateSrv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
+{
+    const DescriptorHandle handle = m_SrvHeap->Allocate();
+    m_d3dDevice->CreateShaderResourceView(resource, desc, m_SrvHeap->GetCpuHandle(handle));
+    return handle;
+}
+
+void Renderer::CreateTextureSrv(const Texture& texture)
+{
+    const D3D12_RESOURCE_DESC resourceDesc = texture.Resource->GetDesc();
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Format = resourceDesc.Format;
+    if (texture.IsCubeMap)
+    {
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+        srvDesc.TextureCube.MostDetailedMip = 0;
+        srvDesc.TextureCube.MipLevels = resourceDesc.MipLevels;
+        srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+    }
+    else
+    {
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MostDetailedMip = 0;
+        srvDesc.Texture2D.MipLevels = resourceDesc.MipLevels;
+        srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+    }
+    m_TextureSrvs[texture.Name] = CreateSrv(texture.Resource.Get(), &srvDesc);
 }
 
-UINT Renderer::CreateSrv(ComPtr<ID3D12Resource> resource, D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
-{    
-    UINT idx = AllocateDescriptor();
-    D3D12_CPU_DESCRIPTOR_HANDLE& descriptorHandle = GetCpuSrv(idx);
-    m_d3dDevice->CreateShaderResourceView(resource.Get(), desc, descriptorHandle);
-    return idx;
+const Texture& Renderer::GetBoundTexture(const std::string& textureName) const
+{
+    const Texture& texture = *m_Textures.at(textureName);
+    return texture.Resource != nullptr ? texture : *m_Textures.at(texture.Placeholder);
+}
+
+int Renderer::GetTextureSrvIndex(const std::string& textureName) const
+{
+    const auto it = m_TextureSrvs.find(GetBoundTexture(textureName).Name);
+    ASSERTMSG(it != m_TextureSrvs.end(), "Texture has no SRV");
+    return it != m_TextureSrvs.end() ? (int)it->second.m_Index : -1;
 }
 
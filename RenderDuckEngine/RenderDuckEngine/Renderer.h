@@ -1,6 +1,8 @@
 #pragma once
 #include "EngineCore.h"
 
+#include <chrono>
+
 #include "d3dApp.h"
 #include "d3dUtil.h"
 #include "FrameResource.h"
@@ -12,7 +14,24 @@
 
 #include "RenderSettings.h"
 
-#include "DescriptorHeapAllocator.h"
+#include "BindlessDescriptorHeap.h"
+
+#include "JobSystem.h"
+#include "CommandRecorder.h"
+#include "RenderGraph.h"
+#include "OcclusionCuller.h"
+#include "LodSelector.h"
+#include "UploadQueue.h"
+#include "FramePacer.h"
+#include "ImageDecodePool.h"
+#include "D3DShaderCompiler.h"
+#include "PipelineStateCache.h"
+#include "RootSignatureCache.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "TextureStreamingPolicy.h"
+#include "TripleBuffer.h"
+#include "RenderThread.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -30,12 +49,6 @@ struct RenderItem
 
     XMFLOAT4X4 m_TexTransform = MathHelper::Identity4x4();
 
-    // Dirty flag indicating the object data has changed and we need to update the constant buffer.
-    // Because we have an object cbuffer for each FrameResource, we have to apply the
-    // update to each FrameResource.  Thus, when we modify obect data we should set 
-    // NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-    int m_NumFramesDirty = gNumFrameResources;
-
     // Index into GPU constant buffer corresponding to the ObjectCB for this render item.
     UINT m_ObjCBIndex = -1;
 
@@ -49,6 +62,19 @@ struct RenderItem
     UINT m_IndexCount = 0;
     UINT m_StartIndexLocation = 0;
     int m_BaseVertexLocation = 0;
+
+    // Object space bounds of the drawn geometry.
+    DirectX::BoundingBox m_Bounds;
+
+    // Solid geometry that is rasterized into the occlusion buffer to hide what is behind it.
+    bool m_Occluder = false;
+
+    // Optional cheaper versions of the mesh, level 0 matches the draw args above.
+    const LodSet* m_LodSet = nullptr;
+    u32 m_LodItem = 0;
+
+    // Draw args picked by LOD selection for each view, rewritten every frame.
+    LodDrawArgs m_ViewDrawArgs[(u32)LodView::Count];
 };
 
 enum class RenderLayer : int
@@ -59,7 +85,56 @@ enum class RenderLayer : int
     Count
 };
 
-class Renderer : public D3DApp, IRenderSettings
+// Everything the render thread reads from the simulation, copied once per frame so simulation of
+// the next frame can run while this one is recorded.
+struct RenderSnapshot
+{
+    float m_TotalTime = 0.0f;
+    float m_DeltaTime = 0.0f;
+
+    Camera m_Camera;
+    XMFLOAT3 m_LightDirections[3];
+
+    // Indexed by RenderItem::m_ObjCBIndex.
+    std::vector<XMFLOAT4X4> m_ItemWorlds;
+
+    int m_ClientWidth = 0;
+    int m_ClientHeight = 0;
+
+    ImVec4 m_ClearColour;
+    bool m_RenderToRTV = false;
+    u32 m_MaxFramesInFlight = 1;
+    bool m_LowLatencyMode = false;
+    u32 m_TextureStreamingBudgetMB = 0;
+
+    UIDrawData m_UIDrawData;
+};
+
+// Passes recorded each frame, in submission order.
+enum class RenderPass : u32
+{
+    Shadow = 0,
+    NormalsDepth,
+    Ssao,
+    Main,
+    UI,
+    Count
+};
+
+// Pipeline states the renderer creates, each looked up by the key of its description.
+enum class PipelineId : u32
+{
+    Opaque = 0,
+    ShadowOpaque,
+    Debug,
+    DrawNormals,
+    Ssao,
+    SsaoBlur,
+    Sky,
+    Count
+};
+
+class Renderer : public D3DApp, IRenderSettings, ICommandListRecorder
 {
 public:
     friend class UIManager;
@@ -74,6 +149,7 @@ public:
     // render settings
     virtual void SetRenderToMainRTV(bool renderToMainRTV) override { m_RenderToRTV = renderToMainRTV; }
     virtual RenderSettings& GetRenderSettings() override { return m_RenderSettings; }
+    virtual const FramePacingReport& GetFramePacingReport() const override { return m_FramePacingReports.GetReadSlot(); }
 
 private:
     virtual void CreateRtvAndDsvDescriptorHeaps()override;
@@ -85,45 +161,69 @@ private:
     virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
     virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
 
+    // command list recording
+    virtual void RecordCommandList(u32 workerIndex, u32 listIndex, const RecordTask& task) override;
+    virtual void SubmitRecordedLists(u32 listCount) override;
+
     void OnKeyboardInput(const GameTimer& gt);
-    void AnimateMaterials(const GameTimer& gt);
-    void UpdateObjectCBs(const GameTimer& gt);
-    void UpdateMaterialBuffer(const GameTimer& gt);
-    void UpdateShadowTransform(const GameTimer& gt);
-    void UpdateMainPassCB(const GameTimer& gt);
-    void UpdateShadowPassCB(const GameTimer& gt);
-    void UpdateSsaoCB(const GameTimer& gt);
+    void BuildSnapshot(const GameTimer& gt, RenderSnapshot& snapshot);
+
+    // Render thread.
+    void RenderFrame();
+    void DrawFrame();
+    void AnimateMaterials(const RenderSnapshot& frame);
+    void UpdateObjectCBs(const RenderSnapshot& frame);
+    void UpdateMaterialBuffer(const RenderSnapshot& frame);
+    void UpdateShadowTransform(const RenderSnapshot& frame);
+    void UpdateMainPassCB(const RenderSnapshot& frame);
+    void UpdateShadowPassCB(const RenderSnapshot& frame);
+    void UpdateSsaoCB(const RenderSnapshot& frame);
 
     void LoadTextures();
+    void PackMaterialTextures();
+    void StartTextureLoads();
+    void UpdateTextureLoads();
+    void UpdateTextureStreaming(const RenderSnapshot& frame);
+    void RequestStreamedTexture(const std::string& textureName, float pixelsPerUv);
+    void BindMaterialTextures();
     void BuildRootSignature();
     void BuildSsaoRootSignature();
     void BuildDescriptorHeaps();
     void BuildShadersAndInputLayout();
+    void WaitForShaders();
     void BuildShapeGeometry();
     void BuildSkullGeometry();
     void BuildPSOs();
+    ID3D12PipelineState* GetPipeline(PipelineId id) const;
     void BuildFrameResources();
     void BuildMaterials();
     void BuildRenderItems();
+    void SelectLods(const RenderSnapshot& frame);
+    void CullOpaqueRenderItems(const RenderSnapshot& frame);
+    void BuildPassCommandLists(u32 listCount);
+    void BuildRenderGraph();
+    void BuildSceneSrvTable();
+    void IssueGraphBarriers(ID3D12GraphicsCommandList* cmdList, const std::vector<RGBarrier>& graphBarriers);
+    void BindScenePassState(ID3D12GraphicsCommandList* cmdList);
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
-    void DrawSceneToShadowMap();
-    void DrawNormalsAndDepth();
+    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems, u32 firstItem, u32 itemCount, LodView view);
+    void DrawSceneToShadowMap(ID3D12GraphicsCommandList* cmdList, const RecordTask& task);
+    void DrawNormalsAndDepth(ID3D12GraphicsCommandList* cmdList, const RecordTask& task);
+    void DrawMainPass(ID3D12GraphicsCommandList* cmdList, const RecordTask& task);
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE GetCpuSrv(int index)const;
-    CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuSrv(int index)const;
     CD3DX12_CPU_DESCRIPTOR_HANDLE GetDsv(int index)const;
     CD3DX12_CPU_DESCRIPTOR_HANDLE GetRtv(int index)const;
 
-    std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> GetStaticSamplers();
+    const std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7>& GetStaticSamplers();
 
-    UINT CreateSrv(ComPtr<ID3D12Resource> resource, D3D12_SHADER_RESOURCE_VIEW_DESC* desc);
+    DescriptorHandle CreateSrv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc);
+    void CreateTextureSrv(const Texture& texture);
 
-    // Descriptor allocators - returns heap index
-    UINT AllocateDescriptor();
-    UINT AllocateDescriptors(u32 descriptorCount);
+    // The texture itself once it is resident, its placeholder until then.
+    const Texture& GetBoundTexture(const std::string& textureName) const;
 
-    static void ImGuiAllocateDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE* outCpuHandle, D3D12_GPU_DESCRIPTOR_HANDLE* outGpuHandleStart);
-    static void ImGuiFreeDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle, D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle);
+    // Heap index shaders use to sample the texture.
+    int GetTextureSrvIndex(const std::string& textureName) const;
 
     void BuildMainRTV();
 
@@ -134,31 +234,106 @@ private:
 
     std::shared_ptr<UIManager> m_UIManager;
 
+    std::unique_ptr<JobSystem> m_JobSystem;
+    std::unique_ptr<ParallelCommandRecorder> m_CommandRecorder;
+
+    // One list per record task, grown on demand. Index matches the task index.
+    std::vector<ComPtr<ID3D12GraphicsCommandList>> m_PassCommandLists;
+
+    // Rebuilt every frame. m_GraphResources is indexed by graph resource handle, and
+    // RenderPass i records graph passes [m_GraphPassStart[i], m_GraphPassStart[i + 1]).
+    RenderGraph m_RenderGraph;
+    std::vector<ID3D12Resource*> m_GraphResources;
+    RGPassHandle m_GraphPassStart[(u32)RenderPass::Count + 1] = {};
+
     std::vector<std::unique_ptr<FrameResource>> m_FrameResources;
+    std::unique_ptr<FrameUploadHeap> m_FrameUploadHeap;
+    std::unique_ptr<UploadQueue> m_UploadQueue;
+
+    // Images the UI loads from disk, on the message loop thread with the rest of the UI.
+    std::unique_ptr<ImageDecodePool> m_ImageDecodePool;
+
+    std::unique_ptr<FenceTimeline> m_FrameTimeline;
+    std::unique_ptr<FramePacer> m_FramePacer;
     FrameResource* m_CurrFrameResource = nullptr;
     int m_CurrFrameResourceIndex = 0;
 
-    u32 m_DescriptorCount;
+    // Update and Draw run the simulation on the message loop thread and publish a snapshot,
+    // RenderFrame records it on the render thread. m_FrameSnapshot is the one being recorded.
+    RenderThread m_RenderThread;
+    TripleBuffer<RenderSnapshot> m_Snapshots;
+    RenderSnapshot* m_FrameSnapshot = nullptr;
+
+    // Pacing stats sent back the other way for the UI.
+    TripleBuffer<FramePacingReport> m_FramePacingReports;
 
     bool m_RenderToRTV;
-    int m_MainRTVIndex;
-    int m_MainSRVIndex;
 
     Microsoft::WRL::ComPtr<ID3D12Resource> m_MainRTV;
     CD3DX12_CPU_DESCRIPTOR_HANDLE m_MainCpuRtv;
-    CD3DX12_CPU_DESCRIPTOR_HANDLE m_MainCpuSrv;
+    DescriptorHandle m_MainSrv;
     CD3DX12_GPU_DESCRIPTOR_HANDLE m_MainGpuSrv;
 
     ComPtr<ID3D12RootSignature> m_RootSignature = nullptr;
     ComPtr<ID3D12RootSignature> m_SsaoRootSignature = nullptr;
 
-    ComPtr<ID3D12DescriptorHeap> m_SrvDescriptorHeap = nullptr;
+    // Owns every root signature, the members above only hold references.
+    std::unique_ptr<RootSignatureCache> m_RootSignatureCache;
+
+    // Hashes of the root signature layouts, part of every pipeline key that uses them.
+    u64 m_RootSignatureHash = 0;
+    u64 m_SsaoRootSignatureHash = 0;
+
+    std::unique_ptr<BindlessDescriptorHeap> m_SrvHeap;
+    std::unordered_map<std::string, DescriptorHandle> m_TextureSrvs;
 
     std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> m_Geometries;
     std::unordered_map<std::string, std::unique_ptr<Material>> m_Materials;
-    std::unordered_map<std::string, std::unique_ptr<Texture>> m_Textures;
-    std::unordered_map<std::string, ComPtr<ID3DBlob>> m_Shaders;
-    std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> m_PSOs;
+
+    // Names whose files hold the same texels share one Texture, named after the first of them.
+    std::unordered_map<std::string, std::shared_ptr<Texture>> m_Textures;
+    std::unique_ptr<TextureCache> m_TextureCache;
+
+    // Block compressed copies of uncompressed textures, used by the loader's jobs.
+    std::unique_ptr<TextureCooker> m_TextureCooker;
+
+    // Textures still loading on the job system, by load id. Only the render thread touches
+    // these, and m_Textures and m_TextureSrvs, once it has started.
+    std::unique_ptr<TextureLoader> m_TextureLoader;
+    std::unordered_map<TextureLoadId, std::string> m_LoadingTextures;
+    TextureLoadUpdate m_TextureLoadUpdate;
+    std::chrono::steady_clock::time_point m_TextureLoadStart;
+    bool m_TextureLoadTimeLogged = false;
+
+    // Textures loaded with the job system get more mips as they are seen up close, and lose them
+    // again to stay in budget. Ids index m_StreamedTextureNames.
+    std::unique_ptr<TextureStreamingPolicy> m_TextureStreaming;
+    std::unordered_map<std::string, StreamedTextureId> m_StreamedTextureIds;
+    std::vector<std::string> m_StreamedTextureNames;
+    std::vector<TextureStreamingRequest> m_TextureStreamingRequests;
+
+    // Textures replaced by a reload, released once the GPU passes the fence value.
+    std::vector<std::pair<u64, Microsoft::WRL::ComPtr<ID3D12Resource>>> m_RetiredTextures;
+
+    std::unique_ptr<D3DShaderCompiler> m_ShaderCompiler;
+    std::unique_ptr<ShaderCache> m_ShaderCache;
+    std::unordered_map<std::string, ShaderBytecodeRef> m_Shaders;
+
+    // Shaders compile on the job system from BuildShadersAndInputLayout until WaitForShaders,
+    // which BuildPSOs calls before the first use.
+    struct PendingShader
+    {
+        std::string m_Name;
+        ShaderDesc m_Desc;
+        ShaderBytecodeRef m_Shader;
+        float m_CompileMs = 0.0f;
+    };
+    std::vector<PendingShader> m_PendingShaders;
+    JobCounter m_ShaderCounter;
+    std::chrono::steady_clock::time_point m_ShaderDispatchTime;
+
+    std::unique_ptr<PipelineStateCache> m_PipelineCache;
+    PipelineKey m_PipelineKeys[(u32)PipelineId::Count] = {};
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> m_InputLayout;
 
@@ -168,15 +343,22 @@ private:
     // Render items divided by PSO.
     std::vector<RenderItem*> m_RitemLayer[(int)RenderLayer::Count];
 
-    UINT m_SkyTexHeapIndex = 0;
-    UINT m_ShadowMapHeapIndex = 0;
-    UINT m_SsaoAmbientMapIndex = 0;
-    UINT m_SsaoHeapIndexStart = 0;
+    // Opaque items that survived occlusion culling this frame, drawn by the camera passes.
+    std::unique_ptr<OcclusionCuller> m_OcclusionCuller;
+    std::vector<RenderItem*> m_VisibleOpaqueRitems;
+    std::vector<XMFLOAT3> m_OccludeeBoundsMin;
+    std::vector<XMFLOAT3> m_OccludeeBoundsMax;
+    std::vector<u8> m_OccludeeVisible;
+
+    std::unordered_map<std::string, LodSet> m_LodSets;
+    LodSelector m_LodSelector;
 
-    UINT m_NullCubeSrvIndex = 0;
-    UINT m_NullTexSrvIndex1 = 0;
-    UINT m_NullTexSrvIndex2 = 0;
+    DescriptorHandle m_ShadowMapSrv;
+    DescriptorHandle m_SsaoSrvs;
+    DescriptorHandle m_NullSrvs;
 
+    // Sky, shadow map and SSAO map for the main pass, in this frame's transient descriptors.
+    CD3DX12_GPU_DESCRIPTOR_HANDLE m_SceneSrvTable;
     CD3DX12_GPU_DESCRIPTOR_HANDLE m_NullSrv;
 
     PassConstants m_MainPassCB;  // index 0 of pass cbuffer.
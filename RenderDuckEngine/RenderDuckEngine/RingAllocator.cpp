@@ -0,0 +1,108 @@
+#include "RingAllocator.h"
+
+#include <algorithm>
+
+RingAllocator::RingAllocator(u64 capacity, const IGpuTimeline* timeline)
+	: m_Timeline(timeline)
+	, m_Capacity(capacity)
+{
+	ASSERTMSG(capacity > 0, "Ring allocator needs a capacity");
+	assert(timeline != nullptr);
+}
+
+u64 RingAllocator::Allocate(u64 size, u64 alignment)
+{
+	ASSERTMSG(alignment > 0 && (alignment & (alignment - 1)) == 0, "Ring allocation alignment must be a power of two");
+
+	u64 offset = TryAllocate(size, alignment);
+	if (offset == c_InvalidRingOffset)
+	{
+		Retire();
+		offset = TryAllocate(size, alignment);
+	}
+
+	return offset;
+}
+
+u64 RingAllocator::TryAllocate(u64 size, u64 alignment)
+{
+	if (size > m_Capacity)
+	{
+		return c_InvalidRingOffset;
+	}
+
+	// Nothing is in flight, start again from the beginning so the whole ring is contiguous.
+	if (m_UsedBytes == 0)
+	{
+		m_Head = 0;
+		m_Tail = 0;
+	}
+
+	const u64 aligned = (m_Head + alignment - 1) & ~(alignment - 1);
+
+	if (m_Head >= m_Tail && m_UsedBytes < m_Capacity)
+	{
+		// Free space is [head, capacity) followed by [0, tail).
+		if (aligned + size <= m_Capacity)
+		{
+			Consume(aligned + size - m_Head);
+			return aligned;
+		}
+
+		// Skip the end of the ring, offset 0 is always aligned.
+		if (size <= m_Tail)
+		{
+			Consume(m_Capacity - m_Head + size);
+			return 0;
+		}
+	}
+	else if (m_Head < m_Tail)
+	{
+		// Free space is [head, tail).
+		if (aligned + size <= m_Tail)
+		{
+			Consume(aligned + size - m_Head);
+			return aligned;
+		}
+	}
+
+	return c_InvalidRingOffset;
+}
+
+void RingAllocator::Consume(u64 size)
+{
+	m_Head = (m_Head + size) % m_Capacity;
+	m_UsedBytes += size;
+	m_OpenBlockSize += size;
+	m_PeakUsedBytes = std::max(m_PeakUsedBytes, m_UsedBytes);
+}
+
+void RingAllocator::Commit(u64 fenceValue)
+{
+	ASSERTMSG(m_Blocks.empty() || m_Blocks.back().m_FenceValue <= fenceValue, "Ring blocks must be committed in fence order");
+
+	if (m_OpenBlockSize == 0)
+	{
+		return;
+	}
+
+	m_Blocks.push_back({ fenceValue, m_OpenBlockSize });
+	m_OpenBlockSize = 0;
+}
+
+void RingAllocator::Retire()
+{
+	const u64 completedValue = m_Timeline->GetCompletedValue();
+	while (!m_Blocks.empty() && m_Blocks.front().m_FenceValue <= completedValue)
+	{
+		const Block& block = m_Blocks.front();
+		m_Tail = (m_Tail + block.m_Size) % m_Capacity;
+		m_UsedBytes -= block.m_Size;
+		m_Blocks.pop_front();
+	}
+}
+
+u64 RingAllocator::GetOldestPendingFence() const
+{
+	return m_Blocks.empty() ? 0 : m_Blocks.front().m_FenceValue;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <deque>
+
+#include "GpuTimeline.h"
+
+const u64 c_InvalidRingOffset = ~0ull;
+
+// Hands out offsets into a fixed size ring. Allocations are grouped into blocks, Commit closes the
+// current block with the fence value the GPU signals once it has finished with it, and the memory
+// is reused when the timeline reaches that value. Only offsets are managed, the memory itself
+// belongs to the caller.
+class RingAllocator
+{
+public:
+	RingAllocator(u64 capacity, const IGpuTimeline* timeline);
+
+	// Returns c_InvalidRingOffset when there is no room even after retiring completed blocks.
+	// alignment must be a power of two.
+	u64 Allocate(u64 size, u64 alignment);
+
+	// Everything allocated since the last commit is released once the timeline reaches fenceValue.
+	void Commit(u64 fenceValue);
+
+	// Releases every committed block the GPU has finished with.
+	void Retire();
+
+	bool HasPendingBlocks() const { return !m_Blocks.empty(); }
+	u64 GetOldestPendingFence() const;
+
+	u64 GetCapacity() const { return m_Capacity; }
+	u64 GetUsedBytes() const { return m_UsedBytes; }
+	u64 GetPeakUsedBytes() const { return m_PeakUsedBytes; }
+
+private:
+	struct Block
+	{
+		u64 m_FenceValue;
+		u64 m_Size;
+	};
+
+	u64 TryAllocate(u64 size, u64 alignment);
+	void Consume(u64 size);
+
+	const IGpuTimeline* m_Timeline;
+	u64 m_Capacity;
+
+	// Allocations are made at the head and released from the tail. Bytes skipped for alignment or
+	// when wrapping are counted in the block that skipped them, so the tail can simply move on by
+	// each block's size.
+	u64 m_Head = 0;
+	u64 m_Tail = 0;
+	u64 m_UsedBytes = 0;
+	u64 m_PeakUsedBytes = 0;
+	u64 m_OpenBlockSize = 0;
+
+	std::deque<Block> m_Blocks;
+};
@@ -0,0 +1,134 @@
+#include "RootSignatureCache.h"
+
+#include <cstring>
+
+#include "MappedFile.h"
+
+namespace
+{
+	const u32 c_CacheFileMagic = 0x53524452; // "RDRS"
+	const u32 c_CacheFileVersion = 1;
+
+	struct CacheFileHeader
+	{
+		u32 m_Magic;
+		u32 m_Version;
+		u64 m_Key;
+		u64 m_BlobSize;
+	};
+}
+
+RootSignatureCache::RootSignatureCache(ID3D12Device* device, const std::filesystem::path& cacheDirectory)
+	: m_Device(device)
+	, m_CacheDirectory(cacheDirectory)
+{
+	// Failing to create the directory only means nothing gets cached.
+	std::error_code error;
+	std::filesystem::create_directories(m_CacheDirectory, error);
+}
+
+ID3D12RootSignature* RootSignatureCache::GetRootSignature(const RootSignatureDesc& desc)
+{
+	const u64 key = desc.GetHash();
+
+	// Creating a root signature is quick, so it runs under the lock and every layout is only
+	// created once even when several threads ask for it together.
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto found = m_RootSignatures.find(key);
+	if (found != m_RootSignatures.end())
+	{
+		ASSERTMSG(found->second.m_Desc == desc, "Two root signature layouts share a key");
+		++m_Stats.m_MemoryHits;
+		return found->second.m_RootSignature.Get();
+	}
+
+	Entry entry;
+	entry.m_Desc = desc;
+	entry.m_RootSignature = LoadFromDisk(key);
+	if (entry.m_RootSignature != nullptr)
+	{
+		++m_Stats.m_DiskHits;
+	}
+	else
+	{
+		std::vector<D3D12_ROOT_PARAMETER> parameters;
+		const D3D12_ROOT_SIGNATURE_DESC rootSigDesc = desc.GetDesc(parameters);
+
+		Microsoft::WRL::ComPtr<ID3DBlob> serializedRootSig = nullptr;
+		Microsoft::WRL::ComPtr<ID3DBlob> errorBlob = nullptr;
+		HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+			serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+		if (errorBlob != nullptr)
+		{
+			::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+		}
+		ThrowIfFailed(hr);
+
+		ThrowIfFailed(m_Device->CreateRootSignature(
+			0,
+			serializedRootSig->GetBufferPointer(),
+			serializedRootSig->GetBufferSize(),
+			IID_PPV_ARGS(entry.m_RootSignature.GetAddressOf())));
+
+		++m_Stats.m_Serializes;
+		WriteToDisk(key, serializedRootSig->GetBufferPointer(), serializedRootSig->GetBufferSize());
+	}
+
+	ID3D12RootSignature* rootSignature = entry.m_RootSignature.Get();
+	m_RootSignatures[key] = std::move(entry);
+	return rootSignature;
+}
+
+RootSignatureCacheStats RootSignatureCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+std::filesystem::path RootSignatureCache::GetCachePath(u64 key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.rs", (unsigned long long)key);
+	return m_CacheDirectory / name;
+}
+
+Microsoft::WRL::ComPtr<ID3D12RootSignature> RootSignatureCache::LoadFromDisk(u64 key) const
+{
+	MappedFile file;
+	CacheFileHeader header;
+	if (!file.Open(GetCachePath(key)) || file.GetSize() < sizeof(header))
+	{
+		return nullptr;
+	}
+
+	// Anything that does not look like a complete file for this key, or that the device rejects,
+	// is treated as a miss and overwritten once the layout is serialized again.
+	memcpy(&header, file.GetData(), sizeof(header));
+	if (header.m_Magic != c_CacheFileMagic || header.m_Version != c_CacheFileVersion || header.m_Key != key ||
+		header.m_BlobSize == 0 || header.m_BlobSize != file.GetSize() - sizeof(header))
+	{
+		return nullptr;
+	}
+
+	// The device copies the blob, so the file can be closed straight after.
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature;
+	if (FAILED(m_Device->CreateRootSignature(0, file.GetData() + sizeof(header), header.m_BlobSize,
+		IID_PPV_ARGS(rootSignature.GetAddressOf()))))
+	{
+		return nullptr;
+	}
+	return rootSignature;
+}
+
+void RootSignatureCache::WriteToDisk(u64 key, const void* blob, u64 size) const
+{
+	CacheFileHeader header;
+	header.m_Magic = c_CacheFileMagic;
+	header.m_Version = c_CacheFileVersion;
+	header.m_Key = key;
+	header.m_BlobSize = size;
+
+	// Failures are ignored, the layout is just serialized next run.
+	WriteFileAtomic(GetCachePath(key), &header, sizeof(header), blob, size);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <filesystem>
+#include <mutex>
+
+#include "d3dUtil.h"
+#include "RootSignatureDesc.h"
+
+struct RootSignatureCacheStats
+{
+	u32 m_MemoryHits = 0;
+	u32 m_DiskHits = 0;
+	u32 m_Serializes = 0;
+};
+
+// Root signatures looked up by the hash of their layout, each distinct layout is created once.
+// Serialized blobs are written next to the compiled shaders and read back on later runs, so a
+// layout is only serialized the first time it is ever seen. Hash collisions are caught by
+// comparing the full layout.
+// GetRootSignature can be called from several threads.
+class RootSignatureCache
+{
+public:
+	RootSignatureCache(ID3D12Device* device, const std::filesystem::path& cacheDirectory);
+	RootSignatureCache(const RootSignatureCache& rhs) = delete;
+	RootSignatureCache& operator=(const RootSignatureCache& rhs) = delete;
+
+	// Throws if the layout does not serialize, with the serializer output in the debug log.
+	ID3D12RootSignature* GetRootSignature(const RootSignatureDesc& desc);
+
+	RootSignatureCacheStats GetStats() const;
+
+private:
+	struct Entry
+	{
+		RootSignatureDesc m_Desc;
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> m_RootSignature;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> LoadFromDisk(u64 key) const;
+	void WriteToDisk(u64 key, const void* blob, u64 size) const;
+	std::filesystem::path GetCachePath(u64 key) const;
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_Device;
+	std::filesystem::path m_CacheDirectory;
+
+	std::unordered_map<u64, Entry> m_RootSignatures;
+
+	RootSignatureCacheStats m_Stats;
+
+	// Guards m_RootSignatures and m_Stats.
+	mutable std::mutex m_Mutex;
+};
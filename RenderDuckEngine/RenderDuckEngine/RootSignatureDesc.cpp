@@ -0,0 +1,125 @@
+#include "RootSignatureDesc.h"
+
+#include <cstring>
+
+#include "Hash.h"
+
+namespace
+{
+	// Bumped when the hashed fields change, so old keys stop matching.
+	const u32 c_RootSignatureHashVersion = 1;
+
+	// Ranges and samplers are hashed and compared as bytes, which needs them to be free of padding.
+	static_assert(sizeof(D3D12_DESCRIPTOR_RANGE) == 5 * sizeof(u32), "D3D12_DESCRIPTOR_RANGE has padding");
+	static_assert(sizeof(D3D12_STATIC_SAMPLER_DESC) == 13 * sizeof(u32), "D3D12_STATIC_SAMPLER_DESC has padding");
+
+	template<typename T>
+	bool BytesEqual(const std::vector<T>& lhs, const std::vector<T>& rhs)
+	{
+		return lhs.size() == rhs.size() && (lhs.empty() || memcmp(lhs.data(), rhs.data(), lhs.size() * sizeof(T)) == 0);
+	}
+
+	template<typename T>
+	void AddVector(Hasher& hasher, const std::vector<T>& values)
+	{
+		hasher.AddBytes(values.data(), values.size() * sizeof(T));
+	}
+}
+
+void RootSignatureDesc::AddParameter(D3D12_ROOT_PARAMETER_TYPE type, u32 shaderRegister, u32 registerSpace, u32 num32BitValues, D3D12_SHADER_VISIBILITY visibility)
+{
+	Parameter parameter = {};
+	parameter.m_Type = type;
+	parameter.m_Visibility = visibility;
+	parameter.m_ShaderRegister = shaderRegister;
+	parameter.m_RegisterSpace = registerSpace;
+	parameter.m_Num32BitValues = num32BitValues;
+	m_Parameters.push_back(parameter);
+}
+
+void RootSignatureDesc::AddConstantBufferView(u32 shaderRegister, u32 registerSpace, D3D12_SHADER_VISIBILITY visibility)
+{
+	AddParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, shaderRegister, registerSpace, 0, visibility);
+}
+
+void RootSignatureDesc::AddShaderResourceView(u32 shaderRegister, u32 registerSpace, D3D12_SHADER_VISIBILITY visibility)
+{
+	AddParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, shaderRegister, registerSpace, 0, visibility);
+}
+
+void RootSignatureDesc::AddConstants(u32 num32BitValues, u32 shaderRegister, u32 registerSpace, D3D12_SHADER_VISIBILITY visibility)
+{
+	AddParameter(D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, shaderRegister, registerSpace, num32BitValues, visibility);
+}
+
+void RootSignatureDesc::AddDescriptorTable(const D3D12_DESCRIPTOR_RANGE* ranges, u32 rangeCount, D3D12_SHADER_VISIBILITY visibility)
+{
+	ASSERTMSG(ranges != nullptr && rangeCount > 0, "Descriptor table needs at least one range");
+
+	AddParameter(D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE, 0, 0, 0, visibility);
+	m_Parameters.back().m_FirstRange = (u32)m_Ranges.size();
+	m_Parameters.back().m_RangeCount = rangeCount;
+	m_Ranges.insert(m_Ranges.end(), ranges, ranges + rangeCount);
+}
+
+void RootSignatureDesc::AddStaticSamplers(const D3D12_STATIC_SAMPLER_DESC* samplers, u32 samplerCount)
+{
+	m_StaticSamplers.insert(m_StaticSamplers.end(), samplers, samplers + samplerCount);
+}
+
+D3D12_ROOT_SIGNATURE_DESC RootSignatureDesc::GetDesc(std::vector<D3D12_ROOT_PARAMETER>& parameters) const
+{
+	parameters.resize(m_Parameters.size());
+	for (size_t i = 0; i < m_Parameters.size(); ++i)
+	{
+		const Parameter& source = m_Parameters[i];
+		D3D12_ROOT_PARAMETER& parameter = parameters[i];
+		parameter = {};
+		parameter.ParameterType = source.m_Type;
+		parameter.ShaderVisibility = source.m_Visibility;
+
+		switch (source.m_Type)
+		{
+		case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+			parameter.DescriptorTable.NumDescriptorRanges = source.m_RangeCount;
+			parameter.DescriptorTable.pDescriptorRanges = &m_Ranges[source.m_FirstRange];
+			break;
+		case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+			parameter.Constants.ShaderRegister = source.m_ShaderRegister;
+			parameter.Constants.RegisterSpace = source.m_RegisterSpace;
+			parameter.Constants.Num32BitValues = source.m_Num32BitValues;
+			break;
+		default:
+			parameter.Descriptor.ShaderRegister = source.m_ShaderRegister;
+			parameter.Descriptor.RegisterSpace = source.m_RegisterSpace;
+			break;
+		}
+	}
+
+	D3D12_ROOT_SIGNATURE_DESC desc = {};
+	desc.NumParameters = (UINT)parameters.size();
+	desc.pParameters = parameters.empty() ? nullptr : parameters.data();
+	desc.NumStaticSamplers = (UINT)m_StaticSamplers.size();
+	desc.pStaticSamplers = m_StaticSamplers.empty() ? nullptr : m_StaticSamplers.data();
+	desc.Flags = m_Flags;
+	return desc;
+}
+
+u64 RootSignatureDesc::GetHash() const
+{
+	Hasher hasher;
+	hasher.Add(c_RootSignatureHashVersion);
+	AddVector(hasher, m_Parameters);
+	AddVector(hasher, m_Ranges);
+	AddVector(hasher, m_StaticSamplers);
+	hasher.Add(m_Flags);
+	return hasher.GetHash();
+}
+
+bool RootSignatureDesc::operator==(const RootSignatureDesc& rhs) const
+{
+	return m_Flags == rhs.m_Flags &&
+		BytesEqual(m_Parameters, rhs.m_Parameters) &&
+		BytesEqual(m_Ranges, rhs.m_Ranges) &&
+		BytesEqual(m_StaticSamplers, rhs.m_StaticSamplers);
+}
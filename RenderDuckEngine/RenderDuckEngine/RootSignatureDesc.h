@@ -0,0 +1,47 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <d3d12.h>
+
+// Root signature layout that owns its parameters, ranges and static samplers, so it can be kept
+// as a cache key, hashed and compared. Parameters are added in root parameter order.
+class RootSignatureDesc
+{
+public:
+	void AddConstantBufferView(u32 shaderRegister, u32 registerSpace = 0, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+	void AddShaderResourceView(u32 shaderRegister, u32 registerSpace = 0, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+	void AddConstants(u32 num32BitValues, u32 shaderRegister, u32 registerSpace = 0, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+	void AddDescriptorTable(const D3D12_DESCRIPTOR_RANGE* ranges, u32 rangeCount, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+	void AddStaticSamplers(const D3D12_STATIC_SAMPLER_DESC* samplers, u32 samplerCount);
+	void SetFlags(D3D12_ROOT_SIGNATURE_FLAGS flags) { m_Flags = flags; }
+
+	// The returned desc points into parameters and into this object, so both have to outlive it.
+	D3D12_ROOT_SIGNATURE_DESC GetDesc(std::vector<D3D12_ROOT_PARAMETER>& parameters) const;
+
+	u64 GetHash() const;
+	bool operator==(const RootSignatureDesc& rhs) const;
+	bool operator!=(const RootSignatureDesc& rhs) const { return !(*this == rhs); }
+
+	u32 GetParameterCount() const { return (u32)m_Parameters.size(); }
+
+private:
+	// Flattened root parameter, tables refer to a run of m_Ranges. Every field is 32 bits wide, so
+	// there is no padding and the struct can be hashed and compared as bytes.
+	struct Parameter
+	{
+		D3D12_ROOT_PARAMETER_TYPE m_Type;
+		D3D12_SHADER_VISIBILITY m_Visibility;
+		u32 m_ShaderRegister;
+		u32 m_RegisterSpace;
+		u32 m_Num32BitValues;
+		u32 m_FirstRange;
+		u32 m_RangeCount;
+	};
+
+	void AddParameter(D3D12_ROOT_PARAMETER_TYPE type, u32 shaderRegister, u32 registerSpace, u32 num32BitValues, D3D12_SHADER_VISIBILITY visibility);
+
+	std::vector<Parameter> m_Parameters;
+	std::vector<D3D12_DESCRIPTOR_RANGE> m_Ranges;
+	std::vector<D3D12_STATIC_SAMPLER_DESC> m_StaticSamplers;
+	D3D12_ROOT_SIGNATURE_FLAGS m_Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+};
@@ -0,0 +1,251 @@
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "Hash.h"
+
+namespace
+{
+	const u32 c_CacheFileMagic = 0x48534452; // "RDSH"
+	const u32 c_CacheFileVersion = 1;
+
+	struct CacheFileHeader
+	{
+		u32 m_Magic;
+		u32 m_Version;
+		u64 m_Key;
+		u64 m_ByteCodeSize;
+	};
+
+	bool ReadTextFile(const std::filesystem::path& path, std::string& text)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	// Names from #include "name" and #include <name> lines. Includes inside comments or disabled
+	// #if blocks are picked up too, which only makes the key more conservative.
+	void FindIncludes(const std::string& source, std::vector<std::string>& includes)
+	{
+		size_t lineStart = 0;
+		while (lineStart < source.size())
+		{
+			size_t lineEnd = source.find('\n', lineStart);
+			if (lineEnd == std::string::npos)
+			{
+				lineEnd = source.size();
+			}
+
+			const size_t directive = source.find_first_not_of(" \t", lineStart);
+			if (directive < lineEnd && source.compare(directive, 8, "#include") == 0)
+			{
+				const size_t open = source.find_first_of("\"<", directive + 8);
+				if (open < lineEnd)
+				{
+					const size_t close = source.find(source[open] == '"' ? '"' : '>', open + 1);
+					if (close < lineEnd)
+					{
+						includes.push_back(source.substr(open + 1, close - open - 1));
+					}
+				}
+			}
+
+			lineStart = lineEnd + 1;
+		}
+	}
+
+	// Hashes the file and, depth first, every file it includes. Includes resolve relative to the
+	// including file like D3D_COMPILE_STANDARD_FILE_INCLUDE, and each file is hashed once.
+	bool HashSourceTree(const std::filesystem::path& path, std::vector<std::filesystem::path>& visited, u64& hash)
+	{
+		std::string source;
+		if (!ReadTextFile(path, source))
+		{
+			return false;
+		}
+
+		visited.push_back(path.lexically_normal());
+		hash = HashString(source, hash);
+
+		std::vector<std::string> includes;
+		FindIncludes(source, includes);
+		for (const std::string& include : includes)
+		{
+			const std::filesystem::path includePath = (path.parent_path() / include).lexically_normal();
+			if (std::find(visited.begin(), visited.end(), includePath) != visited.end())
+			{
+				continue;
+			}
+
+			hash = HashString(include, hash);
+			if (!HashSourceTree(includePath, visited, hash))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+ShaderCache::ShaderCache(IShaderCompiler* compiler, const std::filesystem::path& cacheDirectory)
+	: m_Compiler(compiler)
+	, m_CacheDirectory(cacheDirectory)
+{
+	assert(compiler != nullptr);
+
+	// Failing to create the directory only means nothing gets cached.
+	std::error_code error;
+	std::filesystem::create_directories(m_CacheDirectory, error);
+}
+
+bool ShaderCache::ComputeKey(const ShaderDesc& desc, u64& key) const
+{
+	u64 hash = HashString(m_Compiler->GetVersion());
+	hash = HashString(desc.m_Target, hash);
+	hash = HashString(desc.m_EntryPoint, hash);
+
+	hash = HashValue((u64)desc.m_Defines.size(), hash);
+	for (const ShaderDefine& define : desc.m_Defines)
+	{
+		hash = HashString(define.m_Name, hash);
+		hash = HashString(define.m_Value, hash);
+	}
+
+	std::vector<std::filesystem::path> visited;
+	if (!HashSourceTree(desc.m_Path, visited, hash))
+	{
+		return false;
+	}
+
+	key = hash;
+	return true;
+}
+
+ShaderBytecodeRef ShaderCache::GetShader(const ShaderDesc& desc, std::string* errors)
+{
+	u64 key = 0;
+	const bool cacheable = ComputeKey(desc, key);
+
+	if (cacheable)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto loaded = m_Loaded.find(key);
+			if (loaded != m_Loaded.end())
+			{
+				++m_Stats.m_MemoryHits;
+				return loaded->second;
+			}
+		}
+
+		ShaderBytecodeRef shader = LoadFromDisk(key);
+		if (shader != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			++m_Stats.m_DiskHits;
+			m_Loaded[key] = shader;
+			return shader;
+		}
+	}
+
+	// Two threads asking for the same new key both compile it, the second result wins the table
+	// and is identical, so that is cheaper than making one wait for the other.
+	std::vector<u8> byteCode;
+	std::string compileErrors;
+	const bool compiled = m_Compiler->Compile(desc, byteCode, compileErrors);
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_Stats.m_Compiles;
+		m_Stats.m_Failures += compiled ? 0 : 1;
+	}
+
+	if (!compiled)
+	{
+		if (errors != nullptr)
+		{
+			*errors = compileErrors;
+		}
+		return nullptr;
+	}
+
+	if (cacheable)
+	{
+		WriteToDisk(key, byteCode);
+	}
+
+	std::shared_ptr<ShaderBytecode> shader = std::make_shared<ShaderBytecode>();
+	shader->m_Compiled = std::move(byteCode);
+	shader->m_Data = shader->m_Compiled.data();
+	shader->m_Size = shader->m_Compiled.size();
+
+	if (cacheable)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Loaded[key] = shader;
+	}
+	return shader;
+}
+
+ShaderCacheStats ShaderCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+std::filesystem::path ShaderCache::GetCachePath(u64 key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.cso", (unsigned long long)key);
+	return m_CacheDirectory / name;
+}
+
+ShaderBytecodeRef ShaderCache::LoadFromDisk(u64 key) const
+{
+	std::shared_ptr<ShaderBytecode> shader = std::make_shared<ShaderBytecode>();
+	if (!shader->m_File.Open(GetCachePath(key)))
+	{
+		return nullptr;
+	}
+
+	// Anything that does not look like a complete file for this key is treated as a miss and
+	// overwritten by the recompile.
+	const MappedFile& file = shader->m_File;
+	CacheFileHeader header;
+	if (file.GetSize() < sizeof(header))
+	{
+		return nullptr;
+	}
+
+	memcpy(&header, file.GetData(), sizeof(header));
+	if (header.m_Magic != c_CacheFileMagic || header.m_Version != c_CacheFileVersion || header.m_Key != key ||
+		header.m_ByteCodeSize == 0 || header.m_ByteCodeSize != file.GetSize() - sizeof(header))
+	{
+		return nullptr;
+	}
+
+	shader->m_Data = file.GetData() + sizeof(header);
+	shader->m_Size = header.m_ByteCodeSize;
+	return shader;
+}
+
+void ShaderCache::WriteToDisk(u64 key, const std::vector<u8>& byteCode) const
+{
+	CacheFileHeader header;
+	header.m_Magic = c_CacheFileMagic;
+	header.m_Version = c_CacheFileVersion;
+	header.m_Key = key;
+	header.m_ByteCodeSize = byteCode.size();
+
+	// Failures are ignored, the shader is just compiled again next run.
+	WriteFileAtomic(GetCachePath(key), &header, sizeof(header), byteCode.data(), byteCode.size());
+}
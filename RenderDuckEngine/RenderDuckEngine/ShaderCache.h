@@ -0,0 +1,97 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+
+#include "MappedFile.h"
+
+struct ShaderDefine
+{
+	std::string m_Name;
+	std::string m_Value;
+};
+
+struct ShaderDesc
+{
+	std::filesystem::path m_Path;
+	std::vector<ShaderDefine> m_Defines;
+	std::string m_EntryPoint;
+	std::string m_Target;
+};
+
+// Turns HLSL into bytecode. The cache only decides when to call it, so tests can pass a stub.
+class IShaderCompiler
+{
+public:
+	virtual ~IShaderCompiler() = default;
+
+	// Identifies the compiler and its flags. Changing it invalidates every cached shader.
+	virtual std::string GetVersion() const = 0;
+
+	// Returns false and fills errors when the shader does not compile.
+	virtual bool Compile(const ShaderDesc& desc, std::vector<u8>& byteCode, std::string& errors) = 0;
+};
+
+// Compiled shader code, either mapped straight from a cache file or owned after compiling.
+class ShaderBytecode
+{
+public:
+	const void* GetBufferPointer() const { return m_Data; }
+	u64 GetBufferSize() const { return m_Size; }
+
+private:
+	friend class ShaderCache;
+
+	MappedFile m_File;
+	std::vector<u8> m_Compiled;
+
+	const u8* m_Data = nullptr;
+	u64 m_Size = 0;
+};
+
+typedef std::shared_ptr<const ShaderBytecode> ShaderBytecodeRef;
+
+struct ShaderCacheStats
+{
+	u32 m_MemoryHits = 0;
+	u32 m_DiskHits = 0;
+	u32 m_Compiles = 0;
+	u32 m_Failures = 0;
+};
+
+// Content addressed cache of compiled shaders. The key hashes the source, every file it includes,
+// the defines, entry point, target and compiler version, so any edit that could change the
+// output picks a new key. Compiled blobs are written to the cache directory and memory mapped
+// when a later run asks for the same key.
+// GetShader can be called from several threads, compilation itself runs outside the lock.
+class ShaderCache
+{
+public:
+	ShaderCache(IShaderCompiler* compiler, const std::filesystem::path& cacheDirectory);
+
+	// Returns nullptr, with the compiler output in errors, when the shader does not compile.
+	ShaderBytecodeRef GetShader(const ShaderDesc& desc, std::string* errors = nullptr);
+
+	// False when a source or include could not be read, the shader is then compiled uncached.
+	bool ComputeKey(const ShaderDesc& desc, u64& key) const;
+
+	ShaderCacheStats GetStats() const;
+
+private:
+	ShaderBytecodeRef LoadFromDisk(u64 key) const;
+	void WriteToDisk(u64 key, const std::vector<u8>& byteCode) const;
+	std::filesystem::path GetCachePath(u64 key) const;
+
+	IShaderCompiler* m_Compiler;
+	std::filesystem::path m_CacheDirectory;
+
+	// Shaders already handed out this run, so permutations shared by several users load once.
+	std::unordered_map<u64, ShaderBytecodeRef> m_Loaded;
+
+	ShaderCacheStats m_Stats;
+
+	// Guards m_Loaded and m_Stats.
+	mutable std::mutex m_Mutex;
+};
@@ -36,7 +36,8 @@ Texture2D gSsaoMap   : register(t2);
 
 // An array of textures, which is only supported in shader model 5.1+.  Unlike Texture2DArray, the textures
 // in this array can be different sizes and formats, making it more flexible than texture arrays.
-Texture2D gTextureMaps[10] : register(t3);
+// The whole SRV heap is bound here, materials index it with their textures' heap indices.
+Texture2D gTextureMaps[] : register(t3);
 
 // Put in space1, so the texture array does not overlap with these resources.  
 // The texture array will occupy registers t0, t1, ..., t3 in space0. 
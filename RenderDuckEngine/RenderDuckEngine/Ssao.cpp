@@ -11,7 +11,7 @@ using namespace Microsoft::WRL;
 
 Ssao::Ssao(
     ID3D12Device* device,
-    ID3D12GraphicsCommandList* cmdList, 
+    UploadQueue* uploadQueue, 
     UINT width, UINT height)
 
 {
@@ -20,7 +20,7 @@ Ssao::Ssao(
     OnResize(width, height);
 
 	BuildOffsetVectors();
-	BuildRandomVectorTexture(cmdList);
+	BuildRandomVectorTexture(uploadQueue);
 }
 
 UINT Ssao::SsaoMapWidth()const
@@ -81,6 +81,11 @@ ID3D12Resource* Ssao::AmbientMap()
     return mAmbientMap0.Get();
 }
 
+ID3D12Resource* Ssao::AmbientBlurMap()
+{
+    return mAmbientMap1.Get();
+}
+
 CD3DX12_CPU_DESCRIPTOR_HANDLE Ssao::NormalMapRtv()const
 {
     return mhNormalMapCpuRtv;
@@ -188,17 +193,12 @@ void Ssao::OnResize(UINT newWidth, UINT newHeight)
 
 void Ssao::ComputeSsao(
     ID3D12GraphicsCommandList* cmdList,
-    FrameResource* currFrame, 
-    int blurCount)
+    FrameResource* currFrame)
 {
 	cmdList->RSSetViewports(1, &mViewport);
     cmdList->RSSetScissorRects(1, &mScissorRect);
 
 	// We compute the initial SSAO to AmbientMap0.
-
-    // Change to RENDER_TARGET.
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mAmbientMap0.Get(),
-        D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
   
 	float clearValue[] = {1.0f, 1.0f, 1.0f, 1.0f};
     cmdList->ClearRenderTargetView(mhAmbientMap0CpuRtv, clearValue, 0, nullptr);
@@ -207,7 +207,7 @@ void Ssao::ComputeSsao(
     cmdList->OMSetRenderTargets(1, &mhAmbientMap0CpuRtv, true, nullptr);
 
     // Bind the constant buffer for this pass.
-    auto ssaoCBAddress = currFrame->SsaoCB->Resource()->GetGPUVirtualAddress();
+    auto ssaoCBAddress = currFrame->SsaoCB.GetGpuAddress();
     cmdList->SetGraphicsRootConstantBufferView(0, ssaoCBAddress);
     cmdList->SetGraphicsRoot32BitConstant(1, 0, 0);
 
@@ -224,31 +224,20 @@ void Ssao::ComputeSsao(
     cmdList->IASetIndexBuffer(nullptr);
     cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	cmdList->DrawInstanced(6, 1, 0, 0);
-   
-	// Change back to GENERIC_READ so we can read the texture in a shader.
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mAmbientMap0.Get(),
-        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ));
-
-    BlurAmbientMap(cmdList, currFrame, blurCount);
 }
  
-void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame, int blurCount)
+void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame, bool horzBlur)
 {
     cmdList->SetPipelineState(mBlurPso);
 
-    auto ssaoCBAddress = currFrame->SsaoCB->Resource()->GetGPUVirtualAddress();
+    auto ssaoCBAddress = currFrame->SsaoCB.GetGpuAddress();
     cmdList->SetGraphicsRootConstantBufferView(0, ssaoCBAddress);
  
-    for(int i = 0; i < blurCount; ++i)
-    {
-        BlurAmbientMap(cmdList, true);
-        BlurAmbientMap(cmdList, false);
-    }
+    BlurAmbientMap(cmdList, horzBlur);
 }
 
 void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, bool horzBlur)
 {
-	ID3D12Resource* output = nullptr;
 	CD3DX12_GPU_DESCRIPTOR_HANDLE inputSrv;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE outputRtv;
 	
@@ -256,22 +245,17 @@ void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, bool horzBlur)
 	// horizontal and vertical blur passes.
 	if(horzBlur == true)
 	{
-		output = mAmbientMap1.Get();
 		inputSrv = mhAmbientMap0GpuSrv;
 		outputRtv = mhAmbientMap1CpuRtv;
         cmdList->SetGraphicsRoot32BitConstant(1, 1, 0);
 	}
 	else
 	{
-		output = mAmbientMap0.Get();
 		inputSrv = mhAmbientMap1GpuSrv;
 		outputRtv = mhAmbientMap0CpuRtv;
         cmdList->SetGraphicsRoot32BitConstant(1, 0, 0);
 	}
  
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(output,
-        D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_RENDER_TARGET));
-
 	float clearValue[] = { 1.0f, 1.0f, 1.0f, 1.0f };
     cmdList->ClearRenderTargetView(outputRtv, clearValue, 0, nullptr);
  
@@ -291,9 +275,6 @@ void Ssao::BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, bool horzBlur)
     cmdList->IASetIndexBuffer(nullptr);
     cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	cmdList->DrawInstanced(6, 1, 0, 0);
-   
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(output,
-        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ));
 }
  
 void Ssao::BuildResources()
@@ -353,7 +334,7 @@ void Ssao::BuildResources()
         IID_PPV_ARGS(&mAmbientMap1)));
 }
 
-void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
+void Ssao::BuildRandomVectorTexture(UploadQueue* uploadQueue)
 {
     D3D12_RESOURCE_DESC texDesc;
     ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
@@ -373,26 +354,10 @@ void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
         &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
         D3D12_HEAP_FLAG_NONE,
         &texDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
+        D3D12_RESOURCE_STATE_COMMON,
         nullptr,
         IID_PPV_ARGS(&mRandomVectorMap)));
 
-    //
-    // In order to copy CPU memory data into our default buffer, we need to create
-    // an intermediate upload heap. 
-    //
-
-    const UINT num2DSubresources = texDesc.DepthOrArraySize * texDesc.MipLevels;
-    const UINT64 uploadBufferSize = GetRequiredIntermediateSize(mRandomVectorMap.Get(), 0, num2DSubresources);
-
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-        D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(mRandomVectorMapUploadBuffer.GetAddressOf())));
-
     XMCOLOR initData[256 * 256];
     for(int i = 0; i < 256; ++i)
     {
@@ -411,17 +376,11 @@ void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
     subResourceData.SlicePitch = subResourceData.RowPitch * 256;
 
     //
-    // Schedule to copy the data to the default resource, and change states.
-    // Note that mCurrSol is put in the GENERIC_READ state so it can be 
-    // read by a shader.
+    // Queue the copy on the upload queue.  The texture decays back to COMMON once the copy
+    // lands and is promoted to a shader resource state when the SSAO pass first reads it.
     //
 
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mRandomVectorMap.Get(),
-        D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
-    UpdateSubresources(cmdList, mRandomVectorMap.Get(), mRandomVectorMapUploadBuffer.Get(),
-		0, 0, num2DSubresources, &subResourceData);
-    cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mRandomVectorMap.Get(),
-        D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+    uploadQueue->UploadTexture(mRandomVectorMap.Get(), 0, 1, &subResourceData);
 }
  
 void Ssao::BuildOffsetVectors()
@@ -9,6 +9,7 @@
 
 #include "d3dUtil.h"
 #include "FrameResource.h"
+#include "UploadQueue.h"
  
  
 class Ssao
@@ -16,7 +17,7 @@ class Ssao
 public:
 
 	Ssao(ID3D12Device* device, 
-        ID3D12GraphicsCommandList* cmdList, 
+        UploadQueue* uploadQueue, 
         UINT width, UINT height);
     Ssao(const Ssao& rhs) = delete;
     Ssao& operator=(const Ssao& rhs) = delete;
@@ -36,6 +37,7 @@ public:
 
 	ID3D12Resource* NormalMap();
 	ID3D12Resource* AmbientMap();
+	ID3D12Resource* AmbientBlurMap();
 	
     CD3DX12_CPU_DESCRIPTOR_HANDLE NormalMapRtv()const;
 	CD3DX12_GPU_DESCRIPTOR_HANDLE NormalMapSrv()const;
@@ -63,25 +65,26 @@ public:
     /// quad to kick off the pixel shader to compute the AmbientMap.  We still keep the
     /// main depth buffer binded to the pipeline, but depth buffer read/writes
     /// are disabled, as we do not need the depth buffer computing the Ambient map.
+    /// The caller transitions AmbientMap to RENDER_TARGET beforehand.
     ///</summary>
 	void ComputeSsao(
         ID3D12GraphicsCommandList* cmdList, 
-        FrameResource* currFrame, 
-        int blurCount);
- 
+        FrameResource* currFrame);
 
-private:
- 
     ///<summary>
     /// Blurs the ambient map to smooth out the noise caused by only taking a
     /// few random samples per pixel.  We use an edge preserving blur so that 
     /// we do not blur across discontinuities--we want edges to remain edges.
+    /// A horizontal blur reads AmbientMap and writes AmbientBlurMap, a vertical
+    /// blur the reverse.  The caller transitions the output to RENDER_TARGET.
     ///</summary>
-    void BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame, int blurCount);
+    void BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, FrameResource* currFrame, bool horzBlur);
+
+private:
 	void BlurAmbientMap(ID3D12GraphicsCommandList* cmdList, bool horzBlur);
 
     void BuildResources();
-    void BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList);
+    void BuildRandomVectorTexture(UploadQueue* uploadQueue);
  
 	void BuildOffsetVectors();
 
@@ -95,7 +98,6 @@ private:
     ID3D12PipelineState* mBlurPso = nullptr;
 	 
     Microsoft::WRL::ComPtr<ID3D12Resource> mRandomVectorMap;
-	Microsoft::WRL::ComPtr<ID3D12Resource> mRandomVectorMapUploadBuffer;
     Microsoft::WRL::ComPtr<ID3D12Resource> mNormalMap;
     Microsoft::WRL::ComPtr<ID3D12Resource> mAmbientMap0;
     Microsoft::WRL::ComPtr<ID3D12Resource> mAmbientMap1;
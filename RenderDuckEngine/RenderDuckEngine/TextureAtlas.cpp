@@ -0,0 +1,211 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "DdsFile.h"
+#include "MipGenerator.h"
+
+// imgui builds its own static copy for font packing, this one is private to this file too.
+#define STBRP_STATIC
+#define STBRP_ASSERT(x) assert(x)
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+namespace
+{
+	// Copies a width x height image into dest at (x, y) surrounded by gutter texels on every side,
+	// each repeating the nearest edge texel. A 1x1 source fills the whole region with its colour.
+	void BlitWithGutter(const u8* source, u32 sourceWidth, u32 sourceHeight, u32 width, u32 height, u32 gutter,
+		u8* dest, u32 destRowPitch, u32 x, u32 y)
+	{
+		for (u32 row = 0; row < height + 2 * gutter; ++row)
+		{
+			const u32 sourceRow = (u32)std::clamp((s32)row - (s32)gutter, 0, (s32)sourceHeight - 1);
+			const u32* sourceTexels = (const u32*)(source + (u64)sourceRow * sourceWidth * 4);
+			u32* destTexels = (u32*)(dest + (u64)(y + row) * destRowPitch) + x;
+
+			for (u32 column = 0; column < width + 2 * gutter; ++column)
+			{
+				destTexels[column] = sourceTexels[std::clamp((s32)column - (s32)gutter, 0, (s32)sourceWidth - 1)];
+			}
+		}
+	}
+}
+
+TextureAtlasPacker::TextureAtlasPacker(u32 layerCount, const TextureAtlasSettings& settings)
+	: m_LayerCount(layerCount)
+	, m_Settings(settings)
+	, m_Alignment(4u << (settings.m_MipCount - 1))
+{
+	ASSERTMSG(layerCount > 0, "An atlas needs at least one layer");
+	ASSERTMSG(settings.m_MipCount > 0 && m_Alignment * 3 <= settings.m_PageSize, "Atlas pages are too small for their mip count");
+}
+
+bool TextureAtlasPacker::CanAdd(const TextureAtlasImage* layers) const
+{
+	u32 width = 0;
+	u32 height = 0;
+	for (u32 layer = 0; layer < m_LayerCount; ++layer)
+	{
+		const TextureAtlasImage& image = layers[layer];
+		if (image.m_Pixels == nullptr || image.m_Width == 0 || image.m_Height == 0)
+		{
+			return false;
+		}
+		if (image.m_Width == 1 && image.m_Height == 1)
+		{
+			continue;
+		}
+		if ((width != 0 && (image.m_Width != width || image.m_Height != height)) ||
+			image.m_Width % m_Alignment != 0 || image.m_Height % m_Alignment != 0)
+		{
+			return false;
+		}
+		width = image.m_Width;
+		height = image.m_Height;
+	}
+	return std::max(width, m_Alignment) + 2 * m_Alignment <= m_Settings.m_PageSize &&
+		std::max(height, m_Alignment) + 2 * m_Alignment <= m_Settings.m_PageSize;
+}
+
+u32 TextureAtlasPacker::Add(const TextureAtlasImage* layers)
+{
+	ASSERTMSG(CanAdd(layers), "Texture cannot be packed");
+
+	m_Images.insert(m_Images.end(), layers, layers + m_LayerCount);
+	m_Regions.emplace_back();
+	return (u32)m_Regions.size() - 1;
+}
+
+void TextureAtlasPacker::Pack()
+{
+	// Packing happens in alignment units, so every position the packer picks is aligned already.
+	const s32 pageUnits = (s32)(m_Settings.m_PageSize / m_Alignment);
+	std::vector<stbrp_rect> rects(m_Regions.size());
+	for (u32 entry = 0; entry < (u32)m_Regions.size(); ++entry)
+	{
+		u32 width = 0;
+		u32 height = 0;
+		GetEntrySize(&m_Images[entry * m_LayerCount], width, height);
+
+		stbrp_rect& rect = rects[entry];
+		rect.id = (s32)entry;
+		rect.w = (s32)(width / m_Alignment) + 2;
+		rect.h = (s32)(height / m_Alignment) + 2;
+		m_Regions[entry].m_Width = width;
+		m_Regions[entry].m_Height = height;
+	}
+
+	m_PageSizes.clear();
+	std::vector<stbrp_node> nodes(pageUnits);
+	while (!rects.empty())
+	{
+		stbrp_context context;
+		stbrp_init_target(&context, pageUnits, pageUnits, nodes.data(), (s32)nodes.size());
+		stbrp_pack_rects(&context, rects.data(), (s32)rects.size());
+
+		const u32 page = (u32)m_PageSizes.size();
+		u32 usedWidth = 0;
+		u32 usedHeight = 0;
+		std::vector<stbrp_rect> unpacked;
+		for (const stbrp_rect& rect : rects)
+		{
+			if (!rect.was_packed)
+			{
+				unpacked.push_back(rect);
+				continue;
+			}
+
+			TextureAtlasRegion& region = m_Regions[rect.id];
+			region.m_Page = page;
+			region.m_X = (u32)(rect.x + 1) * m_Alignment;
+			region.m_Y = (u32)(rect.y + 1) * m_Alignment;
+			usedWidth = std::max(usedWidth, (u32)(rect.x + rect.w) * m_Alignment);
+			usedHeight = std::max(usedHeight, (u32)(rect.y + rect.h) * m_Alignment);
+		}
+
+		// CanAdd keeps out anything that does not fit on an empty page.
+		ASSERTMSG(unpacked.size() < rects.size(), "Atlas entry larger than a page");
+		if (unpacked.size() == rects.size())
+		{
+			break;
+		}
+
+		m_PageSizes.emplace_back(usedWidth, usedHeight);
+		rects.swap(unpacked);
+	}
+
+	for (TextureAtlasRegion& region : m_Regions)
+	{
+		const std::pair<u32, u32>& pageSize = m_PageSizes[region.m_Page];
+		region.m_ScaleU = (float)region.m_Width / pageSize.first;
+		region.m_ScaleV = (float)region.m_Height / pageSize.second;
+		region.m_OffsetU = (float)region.m_X / pageSize.first;
+		region.m_OffsetV = (float)region.m_Y / pageSize.second;
+	}
+}
+
+void TextureAtlasPacker::BuildPage(u32 page, u32 layer, bool srgb, std::vector<u8>& file, JobSystem* jobSystem) const
+{
+	const std::pair<u32, u32>& pageSize = m_PageSizes[page];
+	const MipFormat format = srgb ? MipFormat::RGBA8_UNorm_SRGB : MipFormat::RGBA8_UNorm;
+	const u32 mipCount = m_Settings.m_MipCount;
+
+	DdsTextureDesc desc;
+	desc.m_Format = srgb ? DdsFormat::R8G8B8A8_UNorm_SRGB : DdsFormat::R8G8B8A8_UNorm;
+	desc.m_Width = pageSize.first;
+	desc.m_Height = pageSize.second;
+	desc.m_MipCount = mipCount;
+
+	// Tightly packed mips one after the other is the order DDS files store them in.
+	file.clear();
+	WriteDdsHeaders(desc, file);
+	const size_t headerSize = file.size();
+	std::vector<MipLevelLayout> pageLevels;
+	file.resize(headerSize + (size_t)GetMipChainLayout(format, desc.m_Width, desc.m_Height, mipCount, 1, 1, pageLevels), 0);
+	u8* pageData = file.data() + headerSize;
+
+	MipGenerator generator(jobSystem);
+	std::vector<MipLevelLayout> levels;
+	std::vector<u8> chain;
+	for (u32 entry = 0; entry < (u32)m_Regions.size(); ++entry)
+	{
+		const TextureAtlasRegion& region = m_Regions[entry];
+		if (region.m_Page != page)
+		{
+			continue;
+		}
+
+		// Regions are whole alignment units, so every mip of one is exactly half the one above.
+		const TextureAtlasImage& image = m_Images[entry * m_LayerCount + layer];
+		const bool solid = image.m_Width == 1 && image.m_Height == 1;
+		if (!solid)
+		{
+			chain.resize((size_t)GetMipChainLayout(format, image.m_Width, image.m_Height, mipCount, 1, 1, levels));
+			generator.Generate(format, srgb ? MipFilter::Kaiser : MipFilter::Box, image.m_Pixels, image.m_Width * 4, chain.data(), levels);
+		}
+
+		for (u32 mip = 0; mip < mipCount; ++mip)
+		{
+			const u32 gutter = m_Alignment >> mip;
+			const u8* source = solid ? image.m_Pixels : chain.data() + levels[mip].m_Offset;
+			const u32 sourceWidth = solid ? 1 : levels[mip].m_Width;
+			const u32 sourceHeight = solid ? 1 : levels[mip].m_Height;
+			BlitWithGutter(source, sourceWidth, sourceHeight, region.m_Width >> mip, region.m_Height >> mip, gutter,
+				pageData + pageLevels[mip].m_Offset, pageLevels[mip].m_RowPitch, (region.m_X >> mip) - gutter, (region.m_Y >> mip) - gutter);
+		}
+	}
+}
+
+void TextureAtlasPacker::GetEntrySize(const TextureAtlasImage* layers, u32& width, u32& height) const
+{
+	// An entry of nothing but 1x1 layers takes a single alignment unit.
+	width = m_Alignment;
+	height = m_Alignment;
+	for (u32 layer = 0; layer < m_LayerCount; ++layer)
+	{
+		width = std::max(width, layers[layer].m_Width);
+		height = std::max(height, layers[layer].m_Height);
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "EngineCore.h"
+
+class JobSystem;
+
+struct TextureAtlasSettings
+{
+	// Largest side of a page. Entries that would not fit on an empty page cannot be added.
+	u32 m_PageSize = 2048;
+
+	// Mips every page is built with. Regions start and end on whole 4x4 blocks at every one of them,
+	// which aligns them to 4 << (m_MipCount - 1) texels on the top mip.
+	u32 m_MipCount = 3;
+};
+
+// Tightly packed RGBA8.
+struct TextureAtlasImage
+{
+	const u8* m_Pixels = nullptr;
+	u32 m_Width = 0;
+	u32 m_Height = 0;
+};
+
+// Where an entry ended up, in texels of the top mip, not counting its gutter.
+struct TextureAtlasRegion
+{
+	u32 m_Page = 0;
+	u32 m_X = 0;
+	u32 m_Y = 0;
+	u32 m_Width = 0;
+	u32 m_Height = 0;
+
+	// Maps the entry's UVs onto its page, pageUv = uv * scale + offset.
+	float m_ScaleU = 1.0f;
+	float m_ScaleV = 1.0f;
+	float m_OffsetU = 0.0f;
+	float m_OffsetV = 0.0f;
+};
+
+// Packs small textures onto shared pages with imstb_rectpack, so they take one resource and one
+// descriptor between them. Each entry holds one texture per layer and every layer is built into a
+// page texture of its own with the same layout, so a material's colour and normal map stay
+// addressed by one UV transform. 1x1 layers are stretched to the entry's size, so a material that
+// pairs a texture with a default map can still be packed.
+// Every region is surrounded by a gutter of its own edge texels, one alignment unit wide, and the
+// mips of each entry are filtered from that entry alone, so neither bilinear filtering nor lower
+// mips pick up a neighbour.
+class TextureAtlasPacker
+{
+public:
+	explicit TextureAtlasPacker(u32 layerCount, const TextureAtlasSettings& settings = TextureAtlasSettings());
+	TextureAtlasPacker(const TextureAtlasPacker& rhs) = delete;
+	TextureAtlasPacker& operator=(const TextureAtlasPacker& rhs) = delete;
+
+	// Layers must share one size or be 1x1, with sides that are a whole number of alignment units,
+	// and fit on a page with their gutter.
+	bool CanAdd(const TextureAtlasImage* layers) const;
+
+	// Takes one image per layer. The pixels are not copied and have to outlive BuildPage. Returns the
+	// entry's index.
+	u32 Add(const TextureAtlasImage* layers);
+
+	// Places every entry, starting a new page whenever the current one is full. Pages are trimmed to
+	// the area their regions use.
+	void Pack();
+
+	u32 GetAlignment() const { return m_Alignment; }
+	u32 GetEntryCount() const { return (u32)m_Regions.size(); }
+	u32 GetPageCount() const { return (u32)m_PageSizes.size(); }
+	const TextureAtlasRegion& GetRegion(u32 entry) const { return m_Regions[entry]; }
+
+	// Writes one layer of a page as an RGBA8 DDS file with the settings' mip count. With a job
+	// system, mips are generated in parallel.
+	void BuildPage(u32 page, u32 layer, bool srgb, std::vector<u8>& file, JobSystem* jobSystem = nullptr) const;
+
+private:
+	void GetEntrySize(const TextureAtlasImage* layers, u32& width, u32& height) const;
+
+	u32 m_LayerCount;
+	TextureAtlasSettings m_Settings;
+	u32 m_Alignment;
+
+	// m_LayerCount images per entry.
+	std::vector<TextureAtlasImage> m_Images;
+	std::vector<TextureAtlasRegion> m_Regions;
+
+	// Width and height of each page's top mip.
+	std::vector<std::pair<u32, u32>> m_PageSizes;
+};
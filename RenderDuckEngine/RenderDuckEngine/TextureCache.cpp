@@ -0,0 +1,173 @@
+#include "TextureCache.h"
+
+#include "Hash.h"
+#include "MappedFile.h"
+
+namespace
+{
+	u64 GetContentSize(const DdsFile& file)
+	{
+		u64 size = 0;
+		for (const DdsSubresource& subresource : file.GetSubresources())
+		{
+			size += subresource.m_SlicePitch * subresource.m_Depth;
+		}
+		return size;
+	}
+}
+
+u64 HashDdsContent(const DdsFile& file)
+{
+	// Field by field, the description has padding.
+	const DdsTextureDesc& desc = file.GetDesc();
+	Hasher hasher;
+	hasher.Add(desc.m_Dimension);
+	hasher.Add(desc.m_Format);
+	hasher.Add(desc.m_Width);
+	hasher.Add(desc.m_Height);
+	hasher.Add(desc.m_Depth);
+	hasher.Add(desc.m_ArraySize);
+	hasher.Add(desc.m_MipCount);
+	hasher.Add(desc.m_IsCubeMap);
+	hasher.Add(desc.m_AlphaMode);
+
+	for (const DdsSubresource& subresource : file.GetSubresources())
+	{
+		hasher.AddBytes(subresource.m_Data, subresource.m_SlicePitch * subresource.m_Depth);
+	}
+	return hasher.GetHash();
+}
+
+TextureCacheId TextureCache::Acquire(const std::filesystem::path& path, bool& isNew)
+{
+	isNew = false;
+	const std::wstring key = path.lexically_normal().generic_wstring();
+
+	std::error_code error;
+	const u64 fileSize = std::filesystem::file_size(path, error);
+	const std::filesystem::file_time_type writeTime = error ? std::filesystem::file_time_type() : std::filesystem::last_write_time(path, error);
+
+	// A path still pointing at a live texture whose file has not changed needs no reading at all.
+	const auto it = m_ByPath.find(key);
+	if (!error && it != m_ByPath.end() && it->second.m_FileSize == fileSize && it->second.m_WriteTime == writeTime &&
+		GetRefCount(it->second.m_Id) > 0 && m_Entries[it->second.m_Id].m_Hash == it->second.m_Hash)
+	{
+		Entry& entry = m_Entries[it->second.m_Id];
+		++entry.m_RefCount;
+		++m_Stats.m_Acquires;
+		++m_Stats.m_PathHits;
+		m_Stats.m_SavedBytes += entry.m_DataSize;
+		return it->second.m_Id;
+	}
+
+	MappedFile mapped;
+	if (error || !mapped.Open(path))
+	{
+		++m_Stats.m_Acquires;
+		++m_Stats.m_Failures;
+		return c_InvalidTextureCacheId;
+	}
+
+	const TextureCacheId id = Acquire(mapped.GetData(), mapped.GetSize(), isNew);
+	if (id != c_InvalidTextureCacheId)
+	{
+		PathRecord& record = m_ByPath[key];
+		record.m_Id = id;
+		record.m_Hash = m_Entries[id].m_Hash;
+		record.m_FileSize = fileSize;
+		record.m_WriteTime = writeTime;
+	}
+	return id;
+}
+
+TextureCacheId TextureCache::Acquire(const u8* data, u64 size, bool& isNew)
+{
+	isNew = false;
+	++m_Stats.m_Acquires;
+
+	DdsFile file;
+	if (file.Parse(data, size) != DdsError::None)
+	{
+		++m_Stats.m_Failures;
+		return c_InvalidTextureCacheId;
+	}
+	return AcquireContent(file, isNew);
+}
+
+void TextureCache::AddRef(TextureCacheId id)
+{
+	ASSERTMSG(GetRefCount(id) > 0, "Texture is not in the cache");
+	++m_Entries[id].m_RefCount;
+}
+
+bool TextureCache::Release(TextureCacheId id)
+{
+	ASSERTMSG(GetRefCount(id) > 0, "Texture is not in the cache");
+	Entry& entry = m_Entries[id];
+	if (--entry.m_RefCount > 0)
+	{
+		return false;
+	}
+
+	// Path records are left behind, the reference count and hash tell a stale one apart.
+	m_ByContent.erase(entry.m_Hash);
+	m_FreeEntries.push_back(id);
+	--m_Stats.m_Textures;
+	m_Stats.m_TextureBytes -= entry.m_DataSize;
+	return true;
+}
+
+u32 TextureCache::GetRefCount(TextureCacheId id) const
+{
+	return id < m_Entries.size() ? m_Entries[id].m_RefCount : 0;
+}
+
+u64 TextureCache::GetContentHash(TextureCacheId id) const
+{
+	assert(GetRefCount(id) > 0);
+	return m_Entries[id].m_Hash;
+}
+
+const DdsTextureDesc& TextureCache::GetDesc(TextureCacheId id) const
+{
+	assert(GetRefCount(id) > 0);
+	return m_Entries[id].m_Desc;
+}
+
+TextureCacheId TextureCache::AcquireContent(const DdsFile& file, bool& isNew)
+{
+	const u64 hash = HashDdsContent(file);
+	const auto it = m_ByContent.find(hash);
+	if (it != m_ByContent.end())
+	{
+		Entry& entry = m_Entries[it->second];
+		++entry.m_RefCount;
+		++m_Stats.m_ContentHits;
+		m_Stats.m_SavedBytes += entry.m_DataSize;
+		return it->second;
+	}
+
+	TextureCacheId id = (TextureCacheId)m_Entries.size();
+	if (!m_FreeEntries.empty())
+	{
+		id = m_FreeEntries.back();
+		m_FreeEntries.pop_back();
+	}
+	else
+	{
+		m_Entries.emplace_back();
+	}
+
+	Entry& entry = m_Entries[id];
+	entry.m_Hash = hash;
+	entry.m_DataSize = GetContentSize(file);
+	entry.m_Desc = file.GetDesc();
+	entry.m_RefCount = 1;
+	m_ByContent[hash] = id;
+
+	isNew = true;
+	++m_Stats.m_Misses;
+	++m_Stats.m_Textures;
+	m_Stats.m_TextureBytes += entry.m_DataSize;
+	return id;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+#include "DdsFile.h"
+
+typedef u32 TextureCacheId;
+const TextureCacheId c_InvalidTextureCacheId = ~0u;
+
+struct TextureCacheStats
+{
+	u32 m_Acquires = 0;
+
+	// Acquires of a path seen before whose file has not changed, answered without reading it.
+	u32 m_PathHits = 0;
+
+	// Acquires of a new or changed file whose texel data matched a texture already in the cache.
+	u32 m_ContentHits = 0;
+
+	u32 m_Misses = 0;
+	u32 m_Failures = 0;
+
+	// Unique textures still referenced, and their texel data.
+	u32 m_Textures = 0;
+	u64 m_TextureBytes = 0;
+
+	// Texel data of every hit, which the caller did not have to load again.
+	u64 m_SavedBytes = 0;
+};
+
+// Hashes the texel data and the parts of the description that decide how it is read. The headers
+// themselves are left out, so files that only differ in flags or unused fields share a key.
+u64 HashDdsContent(const DdsFile& file);
+
+// Reference counted textures keyed by their content, so the same file, or the same pixels under
+// another file name, are loaded once and shared. Paths are remembered with the size and write time
+// of their file, a path acquired again is only read and hashed again once its file changes.
+// The cache only hands out ids and knows nothing of the device, the caller keeps whatever it loads
+// for an id until Release says the last reference is gone.
+// Not thread safe.
+class TextureCache
+{
+public:
+	TextureCache() = default;
+	TextureCache(const TextureCache& rhs) = delete;
+	TextureCache& operator=(const TextureCache& rhs) = delete;
+
+	// Takes a reference to the texture in the file at path. isNew is set when nothing in the cache
+	// has the same content, so the caller has to load it, otherwise the id is shared with an earlier
+	// acquire. Returns c_InvalidTextureCacheId when the file cannot be read as a DDS file.
+	TextureCacheId Acquire(const std::filesystem::path& path, bool& isNew);
+
+	// Same for a file already in memory, which is always hashed.
+	TextureCacheId Acquire(const u8* data, u64 size, bool& isNew);
+
+	void AddRef(TextureCacheId id);
+
+	// Returns true when this dropped the last reference. The caller frees what it loaded for the
+	// id, which may be handed out again by a later acquire.
+	bool Release(TextureCacheId id);
+
+	u32 GetRefCount(TextureCacheId id) const;
+	u64 GetContentHash(TextureCacheId id) const;
+	const DdsTextureDesc& GetDesc(TextureCacheId id) const;
+
+	TextureCacheStats GetStats() const { return m_Stats; }
+
+private:
+	struct Entry
+	{
+		u64 m_Hash = 0;
+		u64 m_DataSize = 0;
+		DdsTextureDesc m_Desc;
+		u32 m_RefCount = 0;
+	};
+
+	struct PathRecord
+	{
+		TextureCacheId m_Id = c_InvalidTextureCacheId;
+
+		// Of the content the id held, ids of released textures are reused.
+		u64 m_Hash = 0;
+		u64 m_FileSize = 0;
+		std::filesystem::file_time_type m_WriteTime;
+	};
+
+	TextureCacheId AcquireContent(const DdsFile& file, bool& isNew);
+
+	std::vector<Entry> m_Entries;
+	std::vector<TextureCacheId> m_FreeEntries;
+	std::unordered_map<u64, TextureCacheId> m_ByContent;
+
+	// By normalised path.
+	std::unordered_map<std::wstring, PathRecord> m_ByPath;
+
+	TextureCacheStats m_Stats;
+};
@@ -0,0 +1,554 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include "Hash.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+
+namespace
+{
+	// Bump whenever the cooked output changes, so older cache entries are cooked again.
+	const u32 c_CookerVersion = 2;
+
+	// Encodes repeat until this much time has passed, so small textures still give a stable rate.
+	const double c_BenchmarkSeconds = 0.1;
+
+	// Texels on each side of the random BC7 image the decode benchmark ends with.
+	const u32 c_RandomBc7Size = 1024;
+
+	bool IsRgbaFormat(DdsFormat format)
+	{
+		switch (format)
+		{
+		case DdsFormat::R8G8B8A8_UNorm:
+		case DdsFormat::R8G8B8A8_UNorm_SRGB:
+		case DdsFormat::B8G8R8A8_UNorm:
+		case DdsFormat::B8G8R8A8_UNorm_SRGB:
+		case DdsFormat::B8G8R8X8_UNorm:
+		case DdsFormat::B8G8R8X8_UNorm_SRGB:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool IsSrgbFormat(DdsFormat format)
+	{
+		return format == DdsFormat::R8G8B8A8_UNorm_SRGB || format == DdsFormat::B8G8R8A8_UNorm_SRGB ||
+			format == DdsFormat::B8G8R8X8_UNorm_SRGB;
+	}
+
+	bool IsOpaqueFormat(DdsFormat format)
+	{
+		return format == DdsFormat::B8G8R8X8_UNorm || format == DdsFormat::B8G8R8X8_UNorm_SRGB;
+	}
+
+	// Converts one subresource to tightly packed RGBA8.
+	void ReadRgba(DdsFormat format, const DdsSubresource& subresource, u8* pixels)
+	{
+		const bool bgra = format != DdsFormat::R8G8B8A8_UNorm && format != DdsFormat::R8G8B8A8_UNorm_SRGB;
+		const bool opaque = IsOpaqueFormat(format);
+		for (u32 y = 0; y < subresource.m_Height; ++y)
+		{
+			const u8* source = subresource.m_Data + (u64)y * subresource.m_RowPitch;
+			u8* dest = pixels + (u64)y * subresource.m_Width * 4;
+			for (u32 x = 0; x < subresource.m_Width; ++x, source += 4, dest += 4)
+			{
+				dest[0] = source[bgra ? 2 : 0];
+				dest[1] = source[1];
+				dest[2] = source[bgra ? 0 : 2];
+				dest[3] = opaque ? 255 : source[3];
+			}
+		}
+	}
+
+	DdsFormat GetCookedFormat(BcFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case BcFormat::BC1: return srgb ? DdsFormat::BC1_UNorm_SRGB : DdsFormat::BC1_UNorm;
+		case BcFormat::BC2: return srgb ? DdsFormat::BC2_UNorm_SRGB : DdsFormat::BC2_UNorm;
+		case BcFormat::BC3: return srgb ? DdsFormat::BC3_UNorm_SRGB : DdsFormat::BC3_UNorm;
+		case BcFormat::BC4: return DdsFormat::BC4_UNorm;
+		case BcFormat::BC5: return DdsFormat::BC5_UNorm;
+		case BcFormat::BC7: return srgb ? DdsFormat::BC7_UNorm_SRGB : DdsFormat::BC7_UNorm;
+		}
+		return DdsFormat::Unknown;
+	}
+
+	const char* GetBcFormatName(BcFormat format)
+	{
+		switch (format)
+		{
+		case BcFormat::BC1: return "BC1";
+		case BcFormat::BC2: return "BC2";
+		case BcFormat::BC3: return "BC3";
+		case BcFormat::BC4: return "BC4";
+		case BcFormat::BC5: return "BC5";
+		case BcFormat::BC7: return "BC7";
+		}
+		return "?";
+	}
+
+	// Over the first channelCount channels of each texel, the ones the format stores.
+	double GetPsnr(const u8* reference, const u8* decoded, u64 texelCount, u32 channelCount)
+	{
+		double squaredError = 0.0;
+		for (u64 i = 0; i < texelCount; ++i)
+		{
+			for (u32 c = 0; c < channelCount; ++c)
+			{
+				const double delta = (double)reference[i * 4 + c] - (double)decoded[i * 4 + c];
+				squaredError += delta * delta;
+			}
+		}
+
+		const double meanSquaredError = squaredError / (double)(texelCount * channelCount);
+		return meanSquaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+	}
+
+	struct BcDecodeImage
+	{
+		BcFormat m_Format = BcFormat::BC1;
+		const u8* m_Blocks = nullptr;
+		u32 m_BlockRowPitch = 0;
+		u32 m_Width = 0;
+		u32 m_Height = 0;
+	};
+
+	// Decodes every image over and over for c_BenchmarkSeconds and returns megabytes of RGBA8
+	// written per second.
+	double MeasureBcDecode(const std::vector<BcDecodeImage>& images, JobSystem* jobSystem)
+	{
+		u64 imageBytes = 0;
+		u64 largestImage = 0;
+		for (const BcDecodeImage& image : images)
+		{
+			imageBytes += (u64)image.m_Width * image.m_Height * 4;
+			largestImage = std::max(largestImage, (u64)image.m_Width * image.m_Height * 4);
+		}
+		std::vector<u8> pixels(largestImage);
+
+		u32 iterations = 0;
+		double seconds = 0.0;
+		const auto start = std::chrono::steady_clock::now();
+		do
+		{
+			for (const BcDecodeImage& image : images)
+			{
+				DecodeBcImage(image.m_Format, image.m_Blocks, image.m_BlockRowPitch, image.m_Width, image.m_Height,
+					pixels.data(), image.m_Width * 4, jobSystem);
+			}
+			++iterations;
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		} while (seconds < c_BenchmarkSeconds);
+		return (double)imageBytes * iterations / 1e6 / seconds;
+	}
+
+	std::vector<std::filesystem::path> FindDdsFiles(const std::filesystem::path& directory)
+	{
+		std::vector<std::filesystem::path> paths;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+		{
+			if (entry.path().extension() == ".dds")
+			{
+				paths.push_back(entry.path());
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	}
+}
+
+bool CanCookDdsTexture(const DdsFile& source)
+{
+	const DdsTextureDesc& desc = source.GetDesc();
+	return desc.m_Dimension == DdsDimension::Texture2D && IsRgbaFormat(desc.m_Format) &&
+		(desc.m_Width & 3) == 0 && (desc.m_Height & 3) == 0;
+}
+
+BcFormat ChooseBcFormat(const DdsFile& source, TextureUsage usage)
+{
+	if (usage == TextureUsage::NormalMap)
+	{
+		return BcFormat::BC3;
+	}
+
+	if (IsOpaqueFormat(source.GetDesc().m_Format))
+	{
+		return BcFormat::BC1;
+	}
+	for (const DdsSubresource& subresource : source.GetSubresources())
+	{
+		for (u32 y = 0; y < subresource.m_Height; ++y)
+		{
+			const u8* row = subresource.m_Data + (u64)y * subresource.m_RowPitch;
+			for (u32 x = 0; x < subresource.m_Width; ++x)
+			{
+				if (row[x * 4 + 3] != 255)
+				{
+					return BcFormat::BC3;
+				}
+			}
+		}
+	}
+	return BcFormat::BC1;
+}
+
+bool GetBcFormat(DdsFormat format, BcFormat& bcFormat)
+{
+	switch (format)
+	{
+	case DdsFormat::BC1_UNorm:
+	case DdsFormat::BC1_UNorm_SRGB:
+		bcFormat = BcFormat::BC1;
+		return true;
+	case DdsFormat::BC2_UNorm:
+	case DdsFormat::BC2_UNorm_SRGB:
+		bcFormat = BcFormat::BC2;
+		return true;
+	case DdsFormat::BC3_UNorm:
+	case DdsFormat::BC3_UNorm_SRGB:
+		bcFormat = BcFormat::BC3;
+		return true;
+	case DdsFormat::BC4_UNorm:
+		bcFormat = BcFormat::BC4;
+		return true;
+	case DdsFormat::BC5_UNorm:
+		bcFormat = BcFormat::BC5;
+		return true;
+	case DdsFormat::BC7_UNorm:
+	case DdsFormat::BC7_UNorm_SRGB:
+		bcFormat = BcFormat::BC7;
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool ReadDdsTextureRgba(const DdsFile& source, std::vector<u8>& pixels, JobSystem* jobSystem)
+{
+	const DdsTextureDesc& desc = source.GetDesc();
+	if (desc.m_Dimension != DdsDimension::Texture2D)
+	{
+		return false;
+	}
+
+	pixels.resize((size_t)desc.m_Width * desc.m_Height * 4);
+	const DdsSubresource& top = source.GetSubresource(0, 0);
+	if (IsRgbaFormat(desc.m_Format))
+	{
+		ReadRgba(desc.m_Format, top, pixels.data());
+		return true;
+	}
+
+	BcFormat format;
+	if (!GetBcFormat(desc.m_Format, format))
+	{
+		return false;
+	}
+	DecodeBcImage(format, top.m_Data, top.m_RowPitch, desc.m_Width, desc.m_Height, pixels.data(), desc.m_Width * 4, jobSystem);
+	return true;
+}
+
+bool CookDdsTexture(const DdsFile& source, BcFormat format, std::vector<u8>& file, JobSystem* jobSystem)
+{
+	if (!CanCookDdsTexture(source))
+	{
+		return false;
+	}
+
+	const DdsTextureDesc& sourceDesc = source.GetDesc();
+	const bool srgb = IsSrgbFormat(sourceDesc.m_Format);
+	const bool generateMips = sourceDesc.m_MipCount == 1;
+
+	DdsTextureDesc desc = sourceDesc;
+	desc.m_Format = GetCookedFormat(format, srgb);
+	if (generateMips)
+	{
+		desc.m_MipCount = GetFullMipCount(desc.m_Width, desc.m_Height);
+	}
+
+	file.clear();
+	WriteDdsHeaders(desc, file);
+
+	// Every mip of one slice as RGBA8, either read from the source or generated from its top mip.
+	const MipFormat mipFormat = srgb ? MipFormat::RGBA8_UNorm_SRGB : MipFormat::RGBA8_UNorm;
+	std::vector<MipLevelLayout> levels;
+	std::vector<u8> chain((size_t)GetMipChainLayout(mipFormat, desc.m_Width, desc.m_Height, desc.m_MipCount, 4, 1, levels));
+	std::vector<u8> top;
+	MipGenerator generator(jobSystem);
+
+	for (u32 slice = 0; slice < desc.m_ArraySize; ++slice)
+	{
+		if (generateMips)
+		{
+			top.resize((size_t)desc.m_Width * desc.m_Height * 4);
+			ReadRgba(sourceDesc.m_Format, source.GetSubresource(0, slice), top.data());
+			generator.Generate(mipFormat, srgb ? MipFilter::Kaiser : MipFilter::Box, top.data(), desc.m_Width * 4, chain.data(), levels);
+		}
+		else
+		{
+			for (u32 mip = 0; mip < desc.m_MipCount; ++mip)
+			{
+				ReadRgba(sourceDesc.m_Format, source.GetSubresource(mip, slice), chain.data() + levels[mip].m_Offset);
+			}
+		}
+
+		for (u32 mip = 0; mip < desc.m_MipCount; ++mip)
+		{
+			const MipLevelLayout& level = levels[mip];
+			u32 rowPitch = 0;
+			u32 rowCount = 0;
+			u64 slicePitch = 0;
+			GetDdsSurfaceInfo(desc.m_Format, level.m_Width, level.m_Height, rowPitch, rowCount, slicePitch);
+
+			const size_t offset = file.size();
+			file.resize(offset + (size_t)slicePitch);
+			EncodeBcImage(format, chain.data() + level.m_Offset, level.m_Width, level.m_Height, level.m_RowPitch,
+				file.data() + offset, rowPitch, jobSystem);
+		}
+	}
+	return true;
+}
+
+TextureCooker::TextureCooker(const std::filesystem::path& cacheDirectory)
+	: m_CacheDirectory(cacheDirectory)
+{
+	// Failing to create the directory only means every texture loads uncooked.
+	std::error_code error;
+	std::filesystem::create_directories(m_CacheDirectory, error);
+}
+
+std::filesystem::path TextureCooker::GetCookedPath(const std::filesystem::path& source, TextureUsage usage)
+{
+	MappedFile mapped;
+	DdsFile dds;
+	if (!mapped.Open(source) || dds.Parse(mapped.GetData(), mapped.GetSize()) != DdsError::None || !CanCookDdsTexture(dds))
+	{
+		return source;
+	}
+
+	Hasher hasher;
+	hasher.Add(c_CookerVersion);
+	hasher.Add(usage);
+	hasher.AddBytes(mapped.GetData(), mapped.GetSize());
+	const std::filesystem::path path = GetCachePath(hasher.GetHash());
+
+	// Anything that does not parse is treated as a miss and overwritten by the new cook.
+	DdsFile cached;
+	std::error_code error;
+	if (cached.Open(path) == DdsError::None)
+	{
+		const u64 cookedSize = std::filesystem::file_size(path, error);
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_Stats.m_DiskHits;
+		m_Stats.m_SourceBytes += mapped.GetSize();
+		m_Stats.m_CookedBytes += error ? 0 : cookedSize;
+		return path;
+	}
+
+	std::vector<u8> file;
+	if (!CookDdsTexture(dds, ChooseBcFormat(dds, usage), file) || !WriteToDisk(path, file))
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_Stats.m_Failures;
+		return source;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	++m_Stats.m_Cooks;
+	m_Stats.m_SourceBytes += mapped.GetSize();
+	m_Stats.m_CookedBytes += file.size();
+	return path;
+}
+
+TextureCookerStats TextureCooker::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+std::filesystem::path TextureCooker::GetCachePath(u64 key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.dds", (unsigned long long)key);
+	return m_CacheDirectory / name;
+}
+
+bool TextureCooker::WriteToDisk(const std::filesystem::path& path, const std::vector<u8>& file) const
+{
+	// Written under a temporary name per thread and renamed, so a crash or another writer never
+	// leaves a partial file.
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	bool written = false;
+	{
+		std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+		stream.write((const char*)file.data(), file.size());
+		written = (bool)stream;
+	}
+
+	std::error_code error;
+	if (written)
+	{
+		std::filesystem::rename(tempPath, path, error);
+	}
+	if (!written || error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+void RunTextureCookerBenchmark(const std::filesystem::path& directory, JobSystem* jobSystem, std::string& report)
+{
+	const std::vector<std::filesystem::path> paths = FindDdsFiles(directory);
+
+	char line[256];
+	snprintf(line, sizeof(line), "%-24s %-6s %10s %12s\n", "Texture", "Format", "PSNR dB", "Encode MP/s");
+	report += line;
+
+	const BcFormat formats[] = { BcFormat::BC1, BcFormat::BC2, BcFormat::BC3, BcFormat::BC4, BcFormat::BC5, BcFormat::BC7 };
+	for (const std::filesystem::path& path : paths)
+	{
+		DdsFile dds;
+		if (dds.Open(path) != DdsError::None || !CanCookDdsTexture(dds))
+		{
+			continue;
+		}
+
+		const DdsSubresource& top = dds.GetSubresource(0, 0);
+		std::vector<u8> pixels((size_t)top.m_Width * top.m_Height * 4);
+		ReadRgba(dds.GetDesc().m_Format, top, pixels.data());
+		std::vector<u8> decoded(pixels.size());
+
+		for (BcFormat format : formats)
+		{
+			const u32 blockRowPitch = (top.m_Width / 4) * GetBcBlockSize(format);
+			std::vector<u8> blocks((size_t)blockRowPitch * (top.m_Height / 4));
+
+			u32 iterations = 0;
+			double seconds = 0.0;
+			const auto start = std::chrono::steady_clock::now();
+			do
+			{
+				EncodeBcImage(format, pixels.data(), top.m_Width, top.m_Height, top.m_Width * 4, blocks.data(), blockRowPitch, jobSystem);
+				++iterations;
+				seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			} while (seconds < c_BenchmarkSeconds);
+
+			DecodeBcImage(format, blocks.data(), blockRowPitch, top.m_Width, top.m_Height, decoded.data(), top.m_Width * 4);
+			const u32 channelCount = format == BcFormat::BC1 ? 3 : format == BcFormat::BC4 ? 1 : format == BcFormat::BC5 ? 2 : 4;
+			const double psnr = GetPsnr(pixels.data(), decoded.data(), (u64)top.m_Width * top.m_Height, channelCount);
+			const double megapixels = (double)top.m_Width * top.m_Height * iterations / 1e6;
+
+			snprintf(line, sizeof(line), "%-24s %-6s %10.2f %12.2f\n", path.filename().string().c_str(), GetBcFormatName(format),
+				psnr, megapixels / seconds);
+			report += line;
+		}
+	}
+}
+
+void RunBcDecodeBenchmark(const std::filesystem::path& directory, JobSystem* jobSystem, std::string& report)
+{
+	const std::vector<std::filesystem::path> paths = FindDdsFiles(directory);
+
+	char line[256];
+	snprintf(line, sizeof(line), "%-24s %-6s %8s %14s %14s\n", "Texture", "Format", "KB", "1 thread MB/s", "Jobs MB/s");
+	report += line;
+
+	// Files as they are, every mip and array slice.
+	for (const std::filesystem::path& path : paths)
+	{
+		DdsFile dds;
+		BcFormat format;
+		if (dds.Open(path) != DdsError::None || !GetBcFormat(dds.GetDesc().m_Format, format))
+		{
+			continue;
+		}
+
+		std::vector<BcDecodeImage> images;
+		u64 blockBytes = 0;
+		for (const DdsSubresource& subresource : dds.GetSubresources())
+		{
+			images.push_back({ format, subresource.m_Data, subresource.m_RowPitch, subresource.m_Width, subresource.m_Height });
+			blockBytes += subresource.m_SlicePitch;
+		}
+
+		snprintf(line, sizeof(line), "%-24s %-6s %8.1f %14.1f %14.1f\n", path.filename().string().c_str(), GetBcFormatName(format),
+			blockBytes / 1024.0, MeasureBcDecode(images, nullptr), MeasureBcDecode(images, jobSystem));
+		report += line;
+	}
+
+	// The assets only use some of the formats, so the top mip of every texture is also encoded to
+	// each format and the set decoded back.
+	struct TopMip
+	{
+		u32 m_Width;
+		u32 m_Height;
+		std::vector<u8> m_Pixels;
+	};
+	std::vector<TopMip> tops;
+	for (const std::filesystem::path& path : paths)
+	{
+		DdsFile dds;
+		TopMip top;
+		if (dds.Open(path) == DdsError::None && ReadDdsTextureRgba(dds, top.m_Pixels))
+		{
+			top.m_Width = dds.GetDesc().m_Width;
+			top.m_Height = dds.GetDesc().m_Height;
+			tops.push_back(std::move(top));
+		}
+	}
+
+	const BcFormat formats[] = { BcFormat::BC1, BcFormat::BC2, BcFormat::BC3, BcFormat::BC4, BcFormat::BC5, BcFormat::BC7 };
+	for (BcFormat format : formats)
+	{
+		std::vector<std::vector<u8>> blocks(tops.size());
+		std::vector<BcDecodeImage> images;
+		u64 blockBytes = 0;
+		for (size_t i = 0; i < tops.size(); ++i)
+		{
+			const TopMip& top = tops[i];
+			const u32 blockRowPitch = ((top.m_Width + 3) / 4) * GetBcBlockSize(format);
+			blocks[i].resize((size_t)blockRowPitch * ((top.m_Height + 3) / 4));
+			EncodeBcImage(format, top.m_Pixels.data(), top.m_Width, top.m_Height, top.m_Width * 4, blocks[i].data(), blockRowPitch, jobSystem);
+			images.push_back({ format, blocks[i].data(), blockRowPitch, top.m_Width, top.m_Height });
+			blockBytes += blocks[i].size();
+		}
+
+		snprintf(line, sizeof(line), "%-24s %-6s %8.1f %14.1f %14.1f\n", "All top mips", GetBcFormatName(format),
+			blockBytes / 1024.0, MeasureBcDecode(images, nullptr), MeasureBcDecode(images, jobSystem));
+		report += line;
+	}
+
+	// The encoder only writes two BC7 modes, so random blocks cover the other six.
+	const u32 blockRowPitch = (c_RandomBc7Size / 4) * 16;
+	std::vector<u8> randomBlocks((size_t)blockRowPitch * (c_RandomBc7Size / 4));
+	std::mt19937 random(1);
+	for (size_t i = 0; i < randomBlocks.size(); i += 16)
+	{
+		for (u32 b = 0; b < 16; ++b)
+		{
+			randomBlocks[i + b] = (u8)random();
+		}
+		const u32 mode = random() % 8;
+		randomBlocks[i] = (u8)((randomBlocks[i] & ~((2u << mode) - 1)) | (1u << mode));
+	}
+
+	const std::vector<BcDecodeImage> images = { { BcFormat::BC7, randomBlocks.data(), blockRowPitch, c_RandomBc7Size, c_RandomBc7Size } };
+	snprintf(line, sizeof(line), "%-24s %-6s %8.1f %14.1f %14.1f\n", "Random, all modes", "BC7",
+		randomBlocks.size() / 1024.0, MeasureBcDecode(images, nullptr), MeasureBcDecode(images, jobSystem));
+	report += line;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+
+#include "BcCodec.h"
+#include "DdsFile.h"
+
+class JobSystem;
+
+// How a texture is sampled, which decides what it is cooked to.
+enum class TextureUsage : u32
+{
+	// BC1 when every texel is opaque, BC3 otherwise.
+	Colour = 0,
+
+	// BC3. The shaders take gloss from the normal map's alpha, which BC5 has no room for, and
+	// BC3's separate alpha block keeps gloss far better than the single subset BC7 modes the
+	// encoder writes, at the same size.
+	NormalMap,
+};
+
+struct TextureCookerStats
+{
+	u32 m_DiskHits = 0;
+	u32 m_Cooks = 0;
+	u32 m_Failures = 0;
+
+	// File sizes of the sources handed out cooked, and of their cooked copies.
+	u64 m_SourceBytes = 0;
+	u64 m_CookedBytes = 0;
+};
+
+// False for sources that are not an uncompressed 8 bit RGBA 2D texture with a top mip that is
+// a whole number of blocks, which D3D12 needs of BC textures.
+bool CanCookDdsTexture(const DdsFile& source);
+
+BcFormat ChooseBcFormat(const DdsFile& source, TextureUsage usage);
+
+// The BcCodec format that decodes blocks of a DDS format, false when BcCodec has none.
+bool GetBcFormat(DdsFormat format, BcFormat& bcFormat);
+
+// Converts the top mip of a 2D texture to tightly packed RGBA8. Takes the formats the cooker takes,
+// at any size, and the BC formats BcCodec decodes. With a job system, blocks are decoded in
+// parallel.
+bool ReadDdsTextureRgba(const DdsFile& source, std::vector<u8>& pixels, JobSystem* jobSystem = nullptr);
+
+// Builds a complete DDS file in format from source, generating the mip chain first when the
+// source has a single mip. With a job system, blocks are encoded in parallel.
+bool CookDdsTexture(const DdsFile& source, BcFormat format, std::vector<u8>& file, JobSystem* jobSystem = nullptr);
+
+// Content addressed cache of block compressed copies of uncompressed textures. The key hashes
+// the source file, the usage and the cooker version, so an edited source cooks again. Cooked files
+// are written to the cache directory once and loaded from there on later runs.
+// GetCookedPath can be called from several threads, cooking itself runs outside the lock.
+class TextureCooker
+{
+public:
+	explicit TextureCooker(const std::filesystem::path& cacheDirectory);
+
+	// The file to load in place of source. That is the cooked copy, cooked now on a miss, or source
+	// itself when it is already compressed or cannot be cooked.
+	std::filesystem::path GetCookedPath(const std::filesystem::path& source, TextureUsage usage);
+
+	TextureCookerStats GetStats() const;
+
+	// Also where textures built at runtime, such as atlas pages, are kept under keys of their own.
+	std::filesystem::path GetCachePath(u64 key) const;
+	bool WriteToDisk(const std::filesystem::path& path, const std::vector<u8>& file) const;
+
+private:
+
+	std::filesystem::path m_CacheDirectory;
+	TextureCookerStats m_Stats;
+
+	// Guards m_Stats.
+	mutable std::mutex m_Mutex;
+};
+
+// Encodes the top mip of every cookable texture in directory to each format and reports PSNR
+// against the source and encode throughput, one line per texture and format.
+void RunTextureCookerBenchmark(const std::filesystem::path& directory, JobSystem* jobSystem, std::string& report);
+
+// Decodes every block compressed texture in directory, all mips and slices, then the top mips of
+// all textures encoded to each format, then random BC7 blocks of every mode. Reports megabytes of
+// RGBA8 decoded per second on one thread and across the job system.
+void RunBcDecodeBenchmark(const std::filesystem::path& directory, JobSystem* jobSystem, std::string& report);
@@ -0,0 +1,295 @@
+#include "TextureLoader.h"
+
+#include <algorithm>
+
+#include "MipGenerator.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	u32 ChooseFirstMip(const DdsTextureDesc& desc, u32 firstMip, u32 maxSize)
+	{
+		u32 mip = std::min(firstMip, desc.m_MipCount - 1);
+		while (maxSize != 0 && mip + 1 < desc.m_MipCount &&
+			std::max(desc.m_Width >> mip, std::max(desc.m_Height >> mip, desc.m_Depth >> mip)) > maxSize)
+		{
+			++mip;
+		}
+
+		// Step back to the nearest mip that is still a whole number of blocks.
+		if (IsDdsFormatBlockCompressed(desc.m_Format))
+		{
+			while (mip > 0 && (((desc.m_Width >> mip) & 3) != 0 || ((desc.m_Height >> mip) & 3) != 0))
+			{
+				--mip;
+			}
+		}
+		return mip;
+	}
+
+	bool GetMipFormat(DdsFormat format, MipFormat& mipFormat)
+	{
+		switch (format)
+		{
+		case DdsFormat::R8G8B8A8_UNorm:
+		case DdsFormat::B8G8R8A8_UNorm:
+		case DdsFormat::B8G8R8X8_UNorm:
+			mipFormat = MipFormat::RGBA8_UNorm;
+			return true;
+		case DdsFormat::R8G8B8A8_UNorm_SRGB:
+		case DdsFormat::B8G8R8A8_UNorm_SRGB:
+		case DdsFormat::B8G8R8X8_UNorm_SRGB:
+			mipFormat = MipFormat::RGBA8_UNorm_SRGB;
+			return true;
+		case DdsFormat::R16G16B16A16_Float:
+			mipFormat = MipFormat::RGBA16_Float;
+			return true;
+		case DdsFormat::R16_UNorm:
+			mipFormat = MipFormat::R16_UNorm;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	CD3DX12_RESOURCE_DESC GetResourceDesc(const DdsTextureDesc& desc, u32 firstMip)
+	{
+		const DXGI_FORMAT format = (DXGI_FORMAT)desc.m_Format;
+		const u32 width = std::max(1u, desc.m_Width >> firstMip);
+		const u32 height = std::max(1u, desc.m_Height >> firstMip);
+		const u32 depth = std::max(1u, desc.m_Depth >> firstMip);
+		const UINT16 mipCount = (UINT16)(desc.m_MipCount - firstMip);
+		switch (desc.m_Dimension)
+		{
+		case DdsDimension::Texture1D:
+			return CD3DX12_RESOURCE_DESC::Tex1D(format, width, (UINT16)desc.m_ArraySize, mipCount);
+		case DdsDimension::Texture3D:
+			return CD3DX12_RESOURCE_DESC::Tex3D(format, width, height, (UINT16)depth, mipCount);
+		default:
+			return CD3DX12_RESOURCE_DESC::Tex2D(format, width, height, (UINT16)desc.m_ArraySize, mipCount);
+		}
+	}
+
+	ComPtr<ID3D12Resource> CreateTexture(ID3D12Device* device, const D3D12_RESOURCE_DESC& desc)
+	{
+		// Created in COMMON, copy queue writes decay back to it and the first read promotes it.
+		ComPtr<ID3D12Resource> texture;
+		if (FAILED(device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(texture.GetAddressOf()))))
+		{
+			return nullptr;
+		}
+		return texture;
+	}
+}
+
+TextureLoader::TextureLoader(ID3D12Device* device, JobSystem* jobSystem, UploadQueue* uploadQueue, TextureCooker* cooker)
+	: m_Device(device)
+	, m_UploadQueue(uploadQueue)
+	, m_Cooker(cooker)
+	, m_Requests(jobSystem, uploadQueue)
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+	m_Requests.WaitForJobs();
+}
+
+const char* TextureLoader::Stage(Request& request)
+{
+	// The file only has to stay mapped until its texels are copied into the staging ring.
+	DdsFile file;
+	const DdsError error = file.Open(m_Cooker != nullptr ? m_Cooker->GetCookedPath(request.m_Path, request.m_Usage) : request.m_Path);
+	if (error != DdsError::None)
+	{
+		return GetDdsErrorString(error);
+	}
+
+	// Files saved without mips get their chain built here, so they filter properly at a distance
+	// and can be streamed like the rest.
+	DdsTextureDesc desc = file.GetDesc();
+	MipFormat mipFormat = MipFormat::RGBA8_UNorm;
+	const bool generateMips = desc.m_MipCount == 1 && desc.m_Dimension == DdsDimension::Texture2D &&
+		std::max(desc.m_Width, desc.m_Height) > 1 && GetMipFormat(desc.m_Format, mipFormat);
+	if (generateMips)
+	{
+		desc.m_MipCount = GetFullMipCount(desc.m_Width, desc.m_Height);
+	}
+
+	const u32 firstMip = ChooseFirstMip(desc, request.m_FirstMip, request.m_MaxSize);
+	request.m_Resource = CreateTexture(m_Device, GetResourceDesc(desc, firstMip));
+	if (request.m_Resource == nullptr)
+	{
+		return "texture could not be created";
+	}
+
+	// Volumes have one slice whatever their depth.
+	const u32 sliceCount = desc.m_Dimension == DdsDimension::Texture3D ? 1 : desc.m_ArraySize;
+
+	std::vector<MipLevelLayout> levels;
+	std::vector<u8> generated;
+	u64 generatedSliceSize = 0;
+	if (generateMips)
+	{
+		// Tightly packed, the upload queue lays the mips out for the copy. This already runs as a
+		// job per texture, so the generator keeps to this thread.
+		generatedSliceSize = GetMipChainLayout(mipFormat, desc.m_Width, desc.m_Height, desc.m_MipCount,
+			GetMipFormatPixelSize(mipFormat), 1, levels);
+		generated.resize((size_t)(generatedSliceSize * sliceCount));
+
+		// Colour gets the sharper filter, data such as normals and heights the box, which does not ring.
+		const MipFilter filter = mipFormat == MipFormat::RGBA8_UNorm_SRGB ? MipFilter::Kaiser : MipFilter::Box;
+		MipGenerator generator;
+		for (u32 slice = 0; slice < sliceCount; ++slice)
+		{
+			const DdsSubresource& top = file.GetSubresource(0, slice);
+			generator.Generate(mipFormat, filter, top.m_Data, top.m_RowPitch, generated.data() + generatedSliceSize * slice, levels);
+		}
+	}
+
+	std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+	subresources.reserve(sliceCount * (desc.m_MipCount - firstMip));
+	for (u32 slice = 0; slice < sliceCount; ++slice)
+	{
+		for (u32 mip = firstMip; mip < desc.m_MipCount; ++mip)
+		{
+			D3D12_SUBRESOURCE_DATA data;
+			if (generateMips)
+			{
+				const MipLevelLayout& level = levels[mip];
+				data.pData = generated.data() + generatedSliceSize * slice + level.m_Offset;
+				data.RowPitch = level.m_RowPitch;
+				data.SlicePitch = (LONG_PTR)level.m_RowPitch * level.m_Height;
+			}
+			else
+			{
+				const DdsSubresource& subresource = file.GetSubresource(mip, slice);
+				data.pData = subresource.m_Data;
+				data.RowPitch = subresource.m_RowPitch;
+				data.SlicePitch = (LONG_PTR)subresource.m_SlicePitch;
+			}
+			subresources.push_back(data);
+		}
+	}
+
+	m_UploadQueue->UploadTexture(request.m_Resource.Get(), 0, (u32)subresources.size(), subresources.data());
+	request.m_Desc = desc;
+	request.m_LoadedFirstMip = firstMip;
+	request.m_IsCubeMap = desc.m_IsCubeMap;
+	return nullptr;
+}
+
+TextureLoadId TextureLoader::Load(const std::filesystem::path& path, u32 firstMip, u32 maxSize, TextureUsage usage)
+{
+	std::unique_ptr<Request> request = std::make_unique<Request>();
+	request->m_Path = path;
+	request->m_FirstMip = firstMip;
+	request->m_MaxSize = maxSize;
+	request->m_Usage = usage;
+
+	return m_Requests.Dispatch(std::move(request), [this](Request& job)
+	{
+		try
+		{
+			job.m_Error = Stage(job);
+		}
+		catch (...)
+		{
+			job.m_Error = "upload failed";
+		}
+		return job.m_Error == nullptr;
+	});
+}
+
+ComPtr<ID3D12Resource> TextureLoader::LoadNow(const std::filesystem::path& path, bool* isCubeMap)
+{
+	Request request;
+	request.m_Path = path;
+	const char* error = Stage(request);
+	if (error != nullptr)
+	{
+		std::string message = "Texture load failed: " + path.string() + ": " + error + "\n";
+		OutputDebugStringA(message.c_str());
+		ThrowIfFailed(E_FAIL);
+	}
+
+	if (isCubeMap != nullptr)
+	{
+		*isCubeMap = request.m_IsCubeMap;
+	}
+	return request.m_Resource;
+}
+
+ComPtr<ID3D12Resource> TextureLoader::CreateSolidTexture(u32 rgba, bool isCubeMap)
+{
+	const u32 faceCount = isCubeMap ? 6 : 1;
+	ComPtr<ID3D12Resource> resource = CreateTexture(m_Device,
+		CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, (UINT16)faceCount, 1));
+	if (resource == nullptr)
+	{
+		ThrowIfFailed(E_FAIL);
+	}
+
+	D3D12_SUBRESOURCE_DATA faces[6];
+	for (u32 face = 0; face < faceCount; ++face)
+	{
+		faces[face].pData = &rgba;
+		faces[face].RowPitch = sizeof(rgba);
+		faces[face].SlicePitch = sizeof(rgba);
+	}
+	m_UploadQueue->UploadTexture(resource.Get(), 0, faceCount, faces);
+	return resource;
+}
+
+void TextureLoader::Update(TextureLoadUpdate& update)
+{
+	update.m_Resident.clear();
+	update.m_Failed.clear();
+	m_Requests.Update(
+		[&update](TextureLoadId id, Request&) { update.m_Resident.push_back(id); },
+		[&update](TextureLoadId id, Request&) { update.m_Failed.push_back(id); });
+}
+
+void TextureLoader::Release(TextureLoadId id)
+{
+	const UploadRequestState state = m_Requests.GetState(id);
+	ASSERTMSG(state == UploadRequestState::Landed || state == UploadRequestState::FailureReported, "Only reported loads can be released");
+	m_Requests.Release(id);
+}
+
+ID3D12Resource* TextureLoader::GetResource(TextureLoadId id) const
+{
+	return m_Requests.GetState(id) == UploadRequestState::Landed ? m_Requests[id].m_Resource.Get() : nullptr;
+}
+
+bool TextureLoader::IsCubeMap(TextureLoadId id) const
+{
+	return m_Requests[id].m_IsCubeMap;
+}
+
+const std::filesystem::path& TextureLoader::GetPath(TextureLoadId id) const
+{
+	return m_Requests[id].m_Path;
+}
+
+const char* TextureLoader::GetError(TextureLoadId id) const
+{
+	return m_Requests[id].m_Error;
+}
+
+const DdsTextureDesc& TextureLoader::GetDesc(TextureLoadId id) const
+{
+	return m_Requests[id].m_Desc;
+}
+
+u32 TextureLoader::GetFirstMip(TextureLoadId id) const
+{
+	return m_Requests[id].m_LoadedFirstMip;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <filesystem>
+
+#include "d3dUtil.h"
+#include "DdsFile.h"
+#include "JobSystem.h"
+#include "TextureCooker.h"
+#include "UploadQueue.h"
+#include "UploadRequestList.h"
+
+typedef u32 TextureLoadId;
+
+struct TextureLoadUpdate
+{
+	std::vector<TextureLoadId> m_Resident;
+	std::vector<TextureLoadId> m_Failed;
+};
+
+// Loads DDS textures in the background. Each file is mapped, parsed and staged into the upload
+// queue by a job, Update sends everything staged since the last call to the copy queue as one
+// batch and reports textures whose batch has landed, so they can be bound in place of a
+// placeholder from then on. A load can skip the most detailed mips, so textures can be brought in
+// at low resolution first and reloaded with more mips later. With a cooker, uncompressed files are
+// swapped for their block compressed copies before loading.
+// Load, LoadNow, Update and Release must not be called from more than one thread at a time.
+class TextureLoader
+{
+public:
+	TextureLoader(ID3D12Device* device, JobSystem* jobSystem, UploadQueue* uploadQueue, TextureCooker* cooker = nullptr);
+	TextureLoader(const TextureLoader& rhs) = delete;
+	TextureLoader& operator=(const TextureLoader& rhs) = delete;
+
+	// Waits for jobs still reading files.
+	~TextureLoader();
+
+	// Skips the mips before firstMip and any with a side larger than maxSize, 0 for no limit. The
+	// smallest mip is always loaded.
+	TextureLoadId Load(const std::filesystem::path& path, u32 firstMip = 0, u32 maxSize = 0, TextureUsage usage = TextureUsage::Colour);
+
+	// Loads on the calling thread and stages the copy in the upload queue's open batch, for
+	// placeholders that must exist before the first frame. Throws if the file cannot be loaded.
+	Microsoft::WRL::ComPtr<ID3D12Resource> LoadNow(const std::filesystem::path& path, bool* isCubeMap = nullptr);
+
+	// 1x1 texture of one RGBA8 colour, six faces when isCubeMap is set. Staged like LoadNow.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateSolidTexture(u32 rgba, bool isCubeMap);
+
+	// Each id is reported once, either resident or failed.
+	void Update(TextureLoadUpdate& update);
+
+	// Hands a reported id back. The loader drops its reference to the texture and may reuse the id.
+	void Release(TextureLoadId id);
+
+	ID3D12Resource* GetResource(TextureLoadId id) const;
+	bool IsCubeMap(TextureLoadId id) const;
+	const std::filesystem::path& GetPath(TextureLoadId id) const;
+	const char* GetError(TextureLoadId id) const;
+
+	// The whole file, and the mip of it the texture starts at. Valid once the load is resident.
+	const DdsTextureDesc& GetDesc(TextureLoadId id) const;
+	u32 GetFirstMip(TextureLoadId id) const;
+
+	bool IsIdle() const { return m_Requests.IsIdle(); }
+
+private:
+	struct Request : UploadRequest
+	{
+		std::filesystem::path m_Path;
+		u32 m_FirstMip = 0;
+		u32 m_MaxSize = 0;
+		TextureUsage m_Usage = TextureUsage::Colour;
+
+		DdsTextureDesc m_Desc;
+		u32 m_LoadedFirstMip = 0;
+		bool m_IsCubeMap = false;
+		const char* m_Error = nullptr;
+	};
+
+	// Returns why the file could not be loaded, nullptr once its copy is staged.
+	const char* Stage(Request& request);
+
+	ID3D12Device* m_Device;
+	UploadQueue* m_UploadQueue;
+	TextureCooker* m_Cooker;
+
+	UploadRequestList<Request> m_Requests;
+};
@@ -0,0 +1,253 @@
+#include "TextureStreamingPolicy.h"
+
+#include <algorithm>
+#include <cmath>
+
+TextureStreamingPolicy::TextureStreamingPolicy(u64 budgetBytes, u32 maxPendingRequests)
+	: m_MaxPendingRequests(std::max(1u, maxPendingRequests))
+{
+	m_Stats.m_BudgetBytes = budgetBytes;
+}
+
+StreamedTextureId TextureStreamingPolicy::AddTexture(u32 width, u32 height, const std::vector<u64>& mipSizes, u32 residentMip)
+{
+	ASSERTMSG(!mipSizes.empty() && residentMip < mipSizes.size(), "Resident mip is past the end of the texture");
+
+	Texture texture;
+	texture.m_Width = width;
+	texture.m_Height = height;
+	texture.m_BytesFrom.resize(mipSizes.size() + 1, 0);
+	for (u32 mip = (u32)mipSizes.size(); mip-- > 0;)
+	{
+		texture.m_BytesFrom[mip] = texture.m_BytesFrom[mip + 1] + mipSizes[mip];
+	}
+	texture.m_TailMip = residentMip;
+	texture.m_ResidentMip = residentMip;
+	texture.m_PendingMip = residentMip;
+	texture.m_RequestedMip = residentMip;
+
+	m_Textures.push_back(std::move(texture));
+	return (StreamedTextureId)(m_Textures.size() - 1);
+}
+
+void TextureStreamingPolicy::BeginFrame()
+{
+	++m_Frame;
+	for (Texture& texture : m_Textures)
+	{
+		texture.m_RequestedMip = texture.m_TailMip;
+	}
+}
+
+void TextureStreamingPolicy::RequestDensity(StreamedTextureId id, float pixelsPerUv)
+{
+	assert(id < m_Textures.size());
+	const Texture& texture = m_Textures[id];
+
+	// One mip per halving of the texels that land on each pixel, rounded towards more detail.
+	u32 mip = texture.m_TailMip;
+	if (pixelsPerUv > 0.0f)
+	{
+		const float texelsPerPixel = (float)std::max(texture.m_Width, texture.m_Height) / pixelsPerUv;
+		mip = texelsPerPixel > 1.0f ? (u32)std::min(floorf(log2f(texelsPerPixel)), (float)texture.m_TailMip) : 0;
+	}
+	RequestMip(id, mip);
+}
+
+void TextureStreamingPolicy::RequestMip(StreamedTextureId id, u32 mip)
+{
+	assert(id < m_Textures.size());
+	Texture& texture = m_Textures[id];
+	texture.m_RequestedMip = std::min(texture.m_RequestedMip, std::min(mip, texture.m_TailMip));
+	texture.m_LastUsedFrame = m_Frame;
+}
+
+u64 TextureStreamingPolicy::GetChargedBytes(const Texture& texture) const
+{
+	// Until a request lands both the old and the new texture exist, the larger one is charged.
+	return texture.m_BytesFrom[std::min(texture.m_ResidentMip, texture.m_PendingMip)];
+}
+
+void TextureStreamingPolicy::Update(std::vector<TextureStreamingRequest>& requests)
+{
+	requests.clear();
+
+	// Bytes already on their way out, which later loads can count on.
+	u64 charged = 0;
+	u64 pendingFree = 0;
+	for (const Texture& texture : m_Textures)
+	{
+		charged += GetChargedBytes(texture);
+		if (texture.m_PendingMip > texture.m_ResidentMip)
+		{
+			pendingFree += texture.m_BytesFrom[texture.m_ResidentMip] - texture.m_BytesFrom[texture.m_PendingMip];
+		}
+	}
+
+	// Already over, for example after the budget was lowered.
+	const u64 budget = m_Stats.m_BudgetBytes;
+	if (charged > budget + pendingFree)
+	{
+		Evict(charged - budget - pendingFree, requests);
+	}
+
+	// Textures furthest from the detail they are seen at go first.
+	m_Candidates.clear();
+	for (StreamedTextureId id = 0; id < (StreamedTextureId)m_Textures.size(); ++id)
+	{
+		const Texture& texture = m_Textures[id];
+		if (!texture.m_Failed && texture.m_PendingMip == texture.m_ResidentMip && texture.m_LastUsedFrame == m_Frame &&
+			texture.m_RequestedMip < texture.m_ResidentMip)
+		{
+			m_Candidates.push_back(id);
+		}
+	}
+	std::sort(m_Candidates.begin(), m_Candidates.end(), [this](StreamedTextureId a, StreamedTextureId b)
+	{
+		const u32 missingA = m_Textures[a].m_ResidentMip - m_Textures[a].m_RequestedMip;
+		const u32 missingB = m_Textures[b].m_ResidentMip - m_Textures[b].m_RequestedMip;
+		return missingA != missingB ? missingA > missingB : a < b;
+	});
+
+	for (StreamedTextureId id : m_Candidates)
+	{
+		if (m_Stats.m_PendingRequests >= m_MaxPendingRequests)
+		{
+			break;
+		}
+
+		const Texture& texture = m_Textures[id];
+		const u64 available = budget > charged ? budget - charged : 0;
+		const u64 needed = texture.m_BytesFrom[texture.m_RequestedMip] - texture.m_BytesFrom[texture.m_ResidentMip];
+
+		// The most detailed mip that fits now. Whatever does not fit is freed up for a later frame.
+		u32 firstMip = texture.m_ResidentMip;
+		for (u32 mip = texture.m_RequestedMip; mip < texture.m_ResidentMip; ++mip)
+		{
+			if (texture.m_BytesFrom[mip] - texture.m_BytesFrom[texture.m_ResidentMip] <= available)
+			{
+				firstMip = mip;
+				break;
+			}
+		}
+
+		if (needed > available)
+		{
+			const u64 shortfall = needed - available;
+			if (shortfall > pendingFree)
+			{
+				pendingFree += Evict(shortfall - pendingFree, requests);
+			}
+			pendingFree -= std::min(pendingFree, shortfall);
+		}
+
+		if (firstMip < texture.m_ResidentMip && m_Stats.m_PendingRequests < m_MaxPendingRequests)
+		{
+			charged += texture.m_BytesFrom[firstMip] - texture.m_BytesFrom[texture.m_ResidentMip];
+			Issue(id, firstMip, requests);
+			++m_Stats.m_Loads;
+		}
+	}
+
+	m_Stats.m_ResidentBytes = charged;
+}
+
+u64 TextureStreamingPolicy::Evict(u64 bytes, std::vector<TextureStreamingRequest>& requests)
+{
+	// A texture seen this frame only gives up the detail it no longer needs, one that was not
+	// seen can go all the way back to its tail.
+	auto getFloor = [this](const Texture& texture)
+	{
+		return texture.m_LastUsedFrame == m_Frame ? texture.m_RequestedMip : texture.m_TailMip;
+	};
+
+	m_EvictionCandidates.clear();
+	for (StreamedTextureId id = 0; id < (StreamedTextureId)m_Textures.size(); ++id)
+	{
+		const Texture& texture = m_Textures[id];
+		if (!texture.m_Failed && texture.m_PendingMip == texture.m_ResidentMip && getFloor(texture) > texture.m_ResidentMip)
+		{
+			m_EvictionCandidates.push_back(id);
+		}
+	}
+	std::sort(m_EvictionCandidates.begin(), m_EvictionCandidates.end(), [this](StreamedTextureId a, StreamedTextureId b)
+	{
+		const u64 usedA = m_Textures[a].m_LastUsedFrame;
+		const u64 usedB = m_Textures[b].m_LastUsedFrame;
+		return usedA != usedB ? usedA < usedB : a < b;
+	});
+
+	u64 freed = 0;
+	for (StreamedTextureId id : m_EvictionCandidates)
+	{
+		if (freed >= bytes || m_Stats.m_PendingRequests >= m_MaxPendingRequests)
+		{
+			break;
+		}
+
+		// Drop as few of the most detailed mips as cover the rest.
+		const Texture& texture = m_Textures[id];
+		const u32 floor = getFloor(texture);
+		u32 firstMip = floor;
+		for (u32 mip = texture.m_ResidentMip + 1; mip < floor; ++mip)
+		{
+			if (texture.m_BytesFrom[texture.m_ResidentMip] - texture.m_BytesFrom[mip] >= bytes - freed)
+			{
+				firstMip = mip;
+				break;
+			}
+		}
+
+		freed += texture.m_BytesFrom[texture.m_ResidentMip] - texture.m_BytesFrom[firstMip];
+		Issue(id, firstMip, requests);
+		++m_Stats.m_Evictions;
+	}
+	return freed;
+}
+
+void TextureStreamingPolicy::Issue(StreamedTextureId id, u32 firstMip, std::vector<TextureStreamingRequest>& requests)
+{
+	m_Textures[id].m_PendingMip = firstMip;
+
+	TextureStreamingRequest request;
+	request.m_Texture = id;
+	request.m_FirstMip = firstMip;
+	requests.push_back(request);
+	++m_Stats.m_PendingRequests;
+}
+
+void TextureStreamingPolicy::OnRequestComplete(StreamedTextureId id, bool succeeded)
+{
+	assert(id < m_Textures.size());
+	Texture& texture = m_Textures[id];
+	ASSERTMSG(texture.m_PendingMip != texture.m_ResidentMip, "Texture has no request in flight");
+
+	if (succeeded)
+	{
+		texture.m_ResidentMip = texture.m_PendingMip;
+	}
+	else
+	{
+		texture.m_PendingMip = texture.m_ResidentMip;
+		texture.m_Failed = true;
+	}
+	--m_Stats.m_PendingRequests;
+}
+
+u32 TextureStreamingPolicy::GetResidentMip(StreamedTextureId id) const
+{
+	assert(id < m_Textures.size());
+	return m_Textures[id].m_ResidentMip;
+}
+
+u32 TextureStreamingPolicy::GetRequestedMip(StreamedTextureId id) const
+{
+	assert(id < m_Textures.size());
+	return m_Textures[id].m_RequestedMip;
+}
+
+bool TextureStreamingPolicy::IsPending(StreamedTextureId id) const
+{
+	assert(id < m_Textures.size());
+	return m_Textures[id].m_PendingMip != m_Textures[id].m_ResidentMip;
+}
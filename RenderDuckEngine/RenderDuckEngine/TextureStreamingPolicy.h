@@ -0,0 +1,107 @@
+#pragma once
+#include "EngineCore.h"
+
+typedef u32 StreamedTextureId;
+
+// The texture should be reloaded holding every mip from m_FirstMip down to the smallest.
+struct TextureStreamingRequest
+{
+	StreamedTextureId m_Texture = 0;
+	u32 m_FirstMip = 0;
+};
+
+struct TextureStreamingStats
+{
+	// Bytes of every texture's resident mips, counting textures mid request at their larger size.
+	u64 m_ResidentBytes = 0;
+	u64 m_BudgetBytes = 0;
+
+	u32 m_PendingRequests = 0;
+
+	// Requests issued so far that add mips, and that drop them.
+	u32 m_Loads = 0;
+	u32 m_Evictions = 0;
+};
+
+// Decides which mips of each streamed texture should be resident. Every frame the caller reports
+// how densely each visible texture is sampled on screen, Update then turns that into requests to
+// load more detail, and, when the budget would be exceeded, to drop the most detailed mips of the
+// textures that were used least recently. Textures start with only their small mips resident,
+// those are never dropped.
+// Nothing here touches the device, the caller carries out the requests and reports back with
+// OnRequestComplete, so the policy can be driven by a simulation.
+class TextureStreamingPolicy
+{
+public:
+	TextureStreamingPolicy(u64 budgetBytes, u32 maxPendingRequests);
+
+	// mipSizes has the bytes of every mip of the texture, most detailed first. Mips from
+	// residentMip down are resident already and stay resident.
+	StreamedTextureId AddTexture(u32 width, u32 height, const std::vector<u64>& mipSizes, u32 residentMip);
+
+	void SetBudget(u64 budgetBytes) { m_Stats.m_BudgetBytes = budgetBytes; }
+
+	// Starts collecting this frame's feedback.
+	void BeginFrame();
+
+	// pixelsPerUv is how many screen pixels one unit of texture coordinate covers where the
+	// texture is drawn. Call once per use, the densest use wins.
+	void RequestDensity(StreamedTextureId id, float pixelsPerUv);
+
+	// Mip the texture would be drawn at without a budget, from this frame's feedback.
+	void RequestMip(StreamedTextureId id, u32 mip);
+
+	// Requests for this frame, at most one per texture until it completes.
+	void Update(std::vector<TextureStreamingRequest>& requests);
+
+	// A texture whose request failed keeps its mips and is not streamed again.
+	void OnRequestComplete(StreamedTextureId id, bool succeeded);
+
+	u32 GetResidentMip(StreamedTextureId id) const;
+	u32 GetRequestedMip(StreamedTextureId id) const;
+	bool IsPending(StreamedTextureId id) const;
+
+	u32 GetTextureCount() const { return (u32)m_Textures.size(); }
+	const TextureStreamingStats& GetStats() const { return m_Stats; }
+
+private:
+	struct Texture
+	{
+		u32 m_Width = 0;
+		u32 m_Height = 0;
+
+		// m_BytesFrom[mip] is the size of the texture holding every mip from mip down.
+		std::vector<u64> m_BytesFrom;
+
+		// Least detailed mip the texture may be dropped to, the first one that was resident.
+		u32 m_TailMip = 0;
+		u32 m_ResidentMip = 0;
+
+		// Same as m_ResidentMip unless a request is in flight.
+		u32 m_PendingMip = 0;
+
+		u32 m_RequestedMip = 0;
+		u64 m_LastUsedFrame = 0;
+		bool m_Failed = false;
+	};
+
+	u64 GetChargedBytes(const Texture& texture) const;
+
+	// Issues evictions to free bytes, least recently used textures first. Returns what they free
+	// once complete, which can fall short when nothing else may be dropped.
+	u64 Evict(u64 bytes, std::vector<TextureStreamingRequest>& requests);
+
+	void Issue(StreamedTextureId id, u32 firstMip, std::vector<TextureStreamingRequest>& requests);
+
+	std::vector<Texture> m_Textures;
+	u32 m_MaxPendingRequests;
+
+	// Frame 0 means never used, so counting starts at 1.
+	u64 m_Frame = 1;
+
+	// Scratch, kept to avoid allocating every frame.
+	std::vector<StreamedTextureId> m_Candidates;
+	std::vector<StreamedTextureId> m_EvictionCandidates;
+
+	TextureStreamingStats m_Stats;
+};
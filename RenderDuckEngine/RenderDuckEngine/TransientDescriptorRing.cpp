@@ -0,0 +1,44 @@
+#include "TransientDescriptorRing.h"
+
+#include "DescriptorAllocator.h"
+
+TransientDescriptorRing::TransientDescriptorRing(u32 firstIndex, u32 descriptorsPerFrame, u32 frameCount, IGpuTimeline* timeline)
+	: m_Timeline(timeline)
+	, m_FirstIndex(firstIndex)
+	, m_DescriptorsPerFrame(descriptorsPerFrame)
+	, m_FrameCount(frameCount)
+	, m_PartitionFences(frameCount, 0)
+{
+	ASSERTMSG(descriptorsPerFrame > 0 && frameCount > 0, "Transient descriptor ring needs at least one descriptor per frame");
+	assert(timeline != nullptr);
+}
+
+void TransientDescriptorRing::BeginFrame(u32 frameIndex)
+{
+	ASSERTMSG(frameIndex < m_FrameCount, "Frame index out of range");
+
+	// Normally the frame resource wait already covered this and it returns straight away.
+	m_Timeline->Wait(m_PartitionFences[frameIndex]);
+
+	m_Partition = frameIndex;
+	m_Used.store(0, std::memory_order_relaxed);
+}
+
+u32 TransientDescriptorRing::Allocate(u32 count)
+{
+	ASSERTMSG(count > 0, "Descriptor ranges need at least one descriptor");
+
+	const u32 offset = m_Used.fetch_add(count, std::memory_order_relaxed);
+	if (offset + count > m_DescriptorsPerFrame)
+	{
+		return c_InvalidDescriptorIndex;
+	}
+
+	return m_FirstIndex + m_Partition * m_DescriptorsPerFrame + offset;
+}
+
+void TransientDescriptorRing::EndFrame(u64 fenceValue)
+{
+	m_PartitionFences[m_Partition] = fenceValue;
+	m_PeakUsed = std::max(m_PeakUsed, GetUsedCount());
+}
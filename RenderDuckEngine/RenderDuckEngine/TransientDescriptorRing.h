@@ -0,0 +1,50 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "GpuTimeline.h"
+
+// Descriptors that only live for one frame, such as per pass tables rebuilt every frame.
+// A fixed region of the heap is split into one partition per frame resource. BeginFrame switches to
+// the frame's partition and empties it, after waiting for the GPU to finish the frame that used it
+// last, and allocation is an atomic bump so recording workers can allocate without locking.
+// Only indices are managed, so it runs without a device.
+class TransientDescriptorRing
+{
+public:
+	TransientDescriptorRing(u32 firstIndex, u32 descriptorsPerFrame, u32 frameCount, IGpuTimeline* timeline);
+	TransientDescriptorRing(const TransientDescriptorRing& rhs) = delete;
+	TransientDescriptorRing& operator=(const TransientDescriptorRing& rhs) = delete;
+
+	// Must not overlap Allocate calls.
+	void BeginFrame(u32 frameIndex);
+
+	// Safe from any thread between BeginFrame and EndFrame. Returns c_InvalidDescriptorIndex when
+	// the frame's partition is full.
+	u32 Allocate(u32 count);
+
+	// The partition is reused once the timeline reaches fenceValue.
+	void EndFrame(u64 fenceValue);
+
+	bool Contains(u32 index) const { return index >= m_FirstIndex && index - m_FirstIndex < m_DescriptorsPerFrame * m_FrameCount; }
+
+	u32 GetDescriptorsPerFrame() const { return m_DescriptorsPerFrame; }
+	u32 GetUsedCount() const { return std::min(m_Used.load(std::memory_order_relaxed), m_DescriptorsPerFrame); }
+	u32 GetPeakUsedCount() const { return m_PeakUsed; }
+
+private:
+	IGpuTimeline* m_Timeline;
+	u32 m_FirstIndex;
+	u32 m_DescriptorsPerFrame;
+	u32 m_FrameCount;
+
+	// Fence value of the last frame that used each partition.
+	std::vector<u64> m_PartitionFences;
+	u32 m_Partition = 0;
+
+	// Keeps counting past the end of the partition, so failed allocations never wrap into used space.
+	std::atomic<u32> m_Used = 0;
+	u32 m_PeakUsed = 0;
+};
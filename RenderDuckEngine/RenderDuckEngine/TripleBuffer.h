@@ -0,0 +1,52 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <atomic>
+
+// Lock-free single producer, single consumer hand over of the latest value of T.
+// The writer fills GetWriteSlot and calls Publish, the reader calls Acquire and reads GetReadSlot.
+// Each side owns one slot and the third is swapped between them with one atomic exchange, so
+// neither side ever waits for the other and the reader always sees the newest complete value.
+// Slots are reused, so containers inside T keep their capacity from frame to frame.
+template<typename T>
+class TripleBuffer
+{
+public:
+	// Writer side.
+	T& GetWriteSlot() { return m_Slots[m_WriteIndex]; }
+
+	void Publish()
+	{
+		// Release makes the slot contents visible to the reader that picks it up.
+		const u8 previous = m_Shared.exchange(m_WriteIndex | c_FreshBit, std::memory_order_acq_rel);
+		m_WriteIndex = previous & c_IndexMask;
+	}
+
+	// Reader side. Returns false, and keeps the current read slot, when nothing new was published.
+	bool Acquire()
+	{
+		if ((m_Shared.load(std::memory_order_relaxed) & c_FreshBit) == 0)
+		{
+			return false;
+		}
+
+		const u8 previous = m_Shared.exchange(m_ReadIndex, std::memory_order_acq_rel);
+		m_ReadIndex = previous & c_IndexMask;
+		return true;
+	}
+
+	T& GetReadSlot() { return m_Slots[m_ReadIndex]; }
+	const T& GetReadSlot() const { return m_Slots[m_ReadIndex]; }
+
+private:
+	static const u8 c_IndexMask = 0x3;
+	static const u8 c_FreshBit = 0x4;
+
+	T m_Slots[3];
+
+	u8 m_WriteIndex = 0;
+	u8 m_ReadIndex = 1;
+
+	// Index of the slot between the two sides, with c_FreshBit set while the reader has not taken it.
+	std::atomic<u8> m_Shared = 2;
+};
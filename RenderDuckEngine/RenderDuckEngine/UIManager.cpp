@@ -5,6 +5,7 @@
 #include <functional>
 #include <queue>
 #include <string.h>
+#include <algorithm>
 
 #include <filesystem>
 
@@ -12,7 +13,10 @@ typedef std::function<void()> VoidFunc;
 typedef std::pair<VoidFunc, VoidFunc> VoidFuncPair;
 
 UIManager::UIManager()
-    : m_NextViewportHandle(-1)
+    : m_DescriptorHeap(nullptr)
+    , m_ImagePool(nullptr)
+    , m_NextViewportHandle(-1)
+    , m_BrowserImagesLoaded(false)
 {
 }
 
@@ -99,7 +103,7 @@ void UIManager::InitStyle()
     io.Fonts->Build();
 }
 
-void UIManager::InitialiseForDX12(HWND window, ID3D12Device* device, ID3D12CommandQueue* commandQueue, ID3D12DescriptorHeap* descriptorHeap, int swapchainBufferCount, IRenderSettings* renderer)
+void UIManager::InitialiseForDX12(HWND window, ID3D12Device* device, ID3D12CommandQueue* commandQueue, BindlessDescriptorHeap* descriptorHeap, ImageDecodePool* imagePool, int framesInFlight, IRenderSettings* renderer)
 {
     assert(device);
     assert(commandQueue);
@@ -118,14 +122,25 @@ void UIManager::InitialiseForDX12(HWND window, ID3D12Device* device, ID3D12Comma
     ImGui_ImplDX12_InitInfo init_info = {};
     init_info.Device = device;
     init_info.CommandQueue = commandQueue;
-    init_info.NumFramesInFlight = swapchainBufferCount;
+    init_info.NumFramesInFlight = framesInFlight;
     init_info.RTVFormat = DXGI_FORMAT_R8G8B8A8_UNORM; // Or your render target format.
 
     // Allocating SRV descriptors (for textures) is up to the application, so we provide callbacks.
-    // The example_win32_directx12/main.cpp application include a simple free-list based allocator.
-    init_info.SrvDescriptorHeap = descriptorHeap;
-    init_info.SrvDescriptorAllocFn = [](ImGui_ImplDX12_InitInfo*, D3D12_CPU_DESCRIPTOR_HANDLE* out_cpu_handle, D3D12_GPU_DESCRIPTOR_HANDLE* out_gpu_handle) { return Renderer::ImGuiAllocateDescriptor(out_cpu_handle, out_gpu_handle); };
-    init_info.SrvDescriptorFreeFn = [](ImGui_ImplDX12_InitInfo*, D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle, D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle) { return Renderer::ImGuiFreeDescriptor(cpu_handle, gpu_handle); };
+    // ImGui only keeps the raw handles, frees look the range up again from the CPU handle.
+    init_info.SrvDescriptorHeap = descriptorHeap->GetHeap();
+    init_info.UserData = descriptorHeap;
+    init_info.SrvDescriptorAllocFn = [](ImGui_ImplDX12_InitInfo* info, D3D12_CPU_DESCRIPTOR_HANDLE* out_cpu_handle, D3D12_GPU_DESCRIPTOR_HANDLE* out_gpu_handle)
+    {
+        BindlessDescriptorHeap* heap = (BindlessDescriptorHeap*)info->UserData;
+        const DescriptorHandle handle = heap->Allocate();
+        *out_cpu_handle = heap->GetCpuHandle(handle);
+        *out_gpu_handle = heap->GetGpuHandle(handle);
+    };
+    init_info.SrvDescriptorFreeFn = [](ImGui_ImplDX12_InitInfo* info, D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle, D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle)
+    {
+        BindlessDescriptorHeap* heap = (BindlessDescriptorHeap*)info->UserData;
+        heap->Free(heap->FindHandle(cpu_handle));
+    };
 
     ImGui_ImplDX12_Init(&init_info);
 
@@ -135,6 +150,8 @@ void UIManager::InitialiseForDX12(HWND window, ID3D12Device* device, ID3D12Comma
     //}
 
     m_Renderer = renderer;
+    m_DescriptorHeap = descriptorHeap;
+    m_ImagePool = imagePool;
 }
 
 void UIManager::Render()
@@ -145,6 +162,7 @@ void UIManager::Render()
     
     MainMenuBar();       
     SettingsWindow();
+    ImageBrowserWindow();
     DrawViewports();
 }
  
@@ -269,25 +287,52 @@ void UIManager::BeginRender()
     ImGui::PushFont(m_DefaultFont);
 }
 
-void UIManager::EndRender(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* backBuffer)
+void UIManager::EndRender(UIDrawData& drawData)
 {
     ImGui::PopFont();
     ImGui::Render();
-    D3D12_RESOURCE_BARRIER barrier = {};
-    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    barrier.Transition.pResource = backBuffer;
-    barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
-    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
-    ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), cmdList);
-    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-    cmdList->ResourceBarrier(1, &barrier);
+
+    // The next NewFrame overwrites ImGui's draw lists, so copy them for the render thread.
+    // Copies resize into the slot's lists instead of assigning, to keep their allocations.
+    const ImDrawData* source = ImGui::GetDrawData();
+    while (drawData.m_DrawLists.size() < (size_t)source->CmdListsCount)
+    {
+        drawData.m_DrawLists.push_back(std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData()));
+    }
+
+    ImDrawData& copy = drawData.m_DrawData;
+    copy.Valid = source->Valid;
+    copy.CmdListsCount = source->CmdListsCount;
+    copy.TotalIdxCount = source->TotalIdxCount;
+    copy.TotalVtxCount = source->TotalVtxCount;
+    copy.DisplayPos = source->DisplayPos;
+    copy.DisplaySize = source->DisplaySize;
+    copy.FramebufferScale = source->FramebufferScale;
+    copy.OwnerViewport = source->OwnerViewport;
+    copy.CmdLists.resize(source->CmdListsCount);
+    for (int i = 0; i < source->CmdListsCount; ++i)
+    {
+        const ImDrawList* sourceList = source->CmdLists[i];
+        ImDrawList* list = drawData.m_DrawLists[i].get();
+        list->CmdBuffer.resize(sourceList->CmdBuffer.Size);
+        list->IdxBuffer.resize(sourceList->IdxBuffer.Size);
+        list->VtxBuffer.resize(sourceList->VtxBuffer.Size);
+        memcpy(list->CmdBuffer.Data, sourceList->CmdBuffer.Data, sourceList->CmdBuffer.size_in_bytes());
+        memcpy(list->IdxBuffer.Data, sourceList->IdxBuffer.Data, sourceList->IdxBuffer.size_in_bytes());
+        memcpy(list->VtxBuffer.Data, sourceList->VtxBuffer.Data, sourceList->VtxBuffer.size_in_bytes());
+        list->Flags = sourceList->Flags;
+        copy.CmdLists[i] = list;
+    }
 
     CleanUp();
 }
 
+void UIManager::RenderDrawData(UIDrawData& drawData, ID3D12GraphicsCommandList* cmdList)
+{
+    // The back buffer is bound and in RENDER_TARGET, the render graph transitions it for present.
+    ImGui_ImplDX12_RenderDrawData(&drawData.m_DrawData, cmdList);
+}
+
 void UIManager::CleanUp()
 {
     m_ViewportDisplayTextureHandles.clear();
@@ -337,6 +382,7 @@ void UIManager::MainMenuBar()
         if (ImGui::BeginMenu("Window"))
         {
             if (ImGui::MenuItem("Add Viewport")) CreateViewport();
+            if (ImGui::MenuItem("Image Browser")) m_ActiveWindows.m_ImageBrowser = !m_ActiveWindows.m_ImageBrowser;
             if (ImGui::MenuItem("Dockspace"))
             {
                 m_UISettings.m_DockSpace.m_Value = !m_UISettings.m_DockSpace.m_Value;
@@ -391,6 +437,91 @@ void UIManager::SettingsWindow()
     }
 }
 
+void UIManager::ImageBrowserWindow()
+{
+    if (!m_ActiveWindows.m_ImageBrowser)
+    {
+        return;
+    }
+
+    if (!m_BrowserImagesLoaded)
+    {
+        LoadBrowserImages();
+    }
+
+    ImGui::SetNextWindowSize(ImVec2(560, 400), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Image Browser", &m_ActiveWindows.m_ImageBrowser))
+    {
+        // Images are drawn as soon as their copy has landed, the rest show their state until then.
+        const float thumbnailSize = 128.0f;
+        const int columns = std::max(1, (int)(ImGui::GetContentRegionAvail().x / (thumbnailSize + ImGui::GetStyle().ItemSpacing.x)));
+        if (ImGui::BeginTable("images", columns))
+        {
+            for (const BrowserImage& image : m_BrowserImages)
+            {
+                ImGui::TableNextColumn();
+                switch (m_ImagePool->GetState(image.m_Image))
+                {
+                case ImageState::Ready:
+                {
+                    const float width = (float)m_ImagePool->GetWidth(image.m_Image);
+                    const float height = (float)m_ImagePool->GetHeight(image.m_Image);
+                    const float scale = thumbnailSize / std::max(width, height);
+                    ImGui::Image(TexHandleToImTexID(m_DescriptorHeap->GetGpuHandle(image.m_Srv)), ImVec2(width * scale, height * scale));
+                    if (ImGui::IsItemHovered())
+                    {
+                        ImGui::SetTooltip("%s\n%u x %u", image.m_Name.c_str(), (u32)width, (u32)height);
+                    }
+                    break;
+                }
+                case ImageState::Pending:
+                    ImGui::TextDisabled("Loading...");
+                    break;
+                case ImageState::Failed:
+                    ImGui::TextDisabled("Failed to load");
+                    break;
+                }
+                ImGui::TextUnformatted(image.m_Name.c_str());
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+void UIManager::LoadBrowserImages()
+{
+    m_BrowserImagesLoaded = true;
+
+    // The DDS files are the renderer's, the browser shows the images WIC can read.
+    const char* extensions[] = { ".bmp", ".png", ".jpg", ".jpeg", ".gif", ".tif", ".tiff" };
+    std::vector<std::filesystem::path> paths;
+    std::error_code error;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator("Assets/Textures", error))
+    {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+        if (entry.is_regular_file(error) && std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions))
+        {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for (const std::filesystem::path& path : paths)
+    {
+        BrowserImage image;
+        image.m_Srv = m_DescriptorHeap->Allocate();
+        if (!image.m_Srv.IsValid())
+        {
+            break;
+        }
+        image.m_Name = path.filename().string();
+        image.m_Image = m_ImagePool->Load(path, m_DescriptorHeap->GetCpuHandle(image.m_Srv));
+        m_BrowserImages.push_back(image);
+    }
+}
+
 void UIManager::SceneSettingsPage()
 {
     RenderSettings& renderSettings = m_Renderer->GetRenderSettings();
@@ -409,6 +540,65 @@ void UIManager::SceneSettingsPage()
         [&]() { if (ImGui::Checkbox(m_UISettings.m_DockSpace.GetLabelessName().c_str(), &m_UISettings.m_DockSpace.m_Value)) m_Renderer->SetRenderToMainRTV(m_UISettings.m_DockSpace.m_Value); }
     };
     settingsDisplayFunctions.push_back(dockSpace);
+
+    const FramePacingReport& framePacing = m_Renderer->GetFramePacingReport();
+    VoidFuncPair framesInFlight =
+    {
+        [&]() { ImGui::Text(renderSettings.m_MaxFramesInFlight.GetName().c_str()); },
+        [&]()
+        {
+            const u32 minFrames = 1;
+            const u32 maxFrames = std::max(framePacing.m_FrameResourceCount, minFrames);
+            ImGui::SliderScalar(renderSettings.m_MaxFramesInFlight.GetLabelessName().c_str(), ImGuiDataType_U32, &renderSettings.m_MaxFramesInFlight.m_Value, &minFrames, &maxFrames);
+        }
+    };
+    settingsDisplayFunctions.push_back(framesInFlight);
+
+    VoidFuncPair lowLatency =
+    {
+        [&]() { ImGui::Text(renderSettings.m_LowLatencyMode.GetName().c_str()); },
+        [&]() { ImGui::Checkbox(renderSettings.m_LowLatencyMode.GetLabelessName().c_str(), &renderSettings.m_LowLatencyMode.m_Value); }
+    };
+    settingsDisplayFunctions.push_back(lowLatency);
+
+    VoidFuncPair streamingBudget =
+    {
+        [&]() { ImGui::Text(renderSettings.m_TextureStreamingBudgetMB.GetName().c_str()); },
+        [&]()
+        {
+            const u32 minBudget = 1;
+            const u32 maxBudget = 1024;
+            ImGui::SliderScalar(renderSettings.m_TextureStreamingBudgetMB.GetLabelessName().c_str(), ImGuiDataType_U32, &renderSettings.m_TextureStreamingBudgetMB.m_Value, &minBudget, &maxBudget);
+        }
+    };
+    settingsDisplayFunctions.push_back(streamingBudget);
+
+    VoidFuncPair gpuWait =
+    {
+        [&]() { ImGui::Text("CPU wait for GPU (ms)"); },
+        [&]()
+        {
+            const FramePacingStats& stats = framePacing.m_Stats;
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "avg %.2f max %.2f", stats.m_AverageWaitMs, stats.m_MaxWaitMs);
+            ImGui::PlotLines("###FrameWaitHistory", framePacing.m_WaitHistoryMs, FramePacer::c_WaitHistoryLength, framePacing.m_WaitHistoryOffset, overlay);
+        }
+    };
+    settingsDisplayFunctions.push_back(gpuWait);
+
+    VoidFuncPair lodTriangles =
+    {
+        [&]() { ImGui::Text("LOD triangles"); },
+        [&]()
+        {
+            const LodStats& mainStats = framePacing.m_LodStats[(u32)LodView::Main];
+            const LodStats& shadowStats = framePacing.m_LodStats[(u32)LodView::Shadow];
+            ImGui::Text("Main %u of %u (%u saved), Shadow %u of %u (%u saved)",
+                mainStats.m_SelectedTriangles, mainStats.m_FullDetailTriangles, mainStats.GetTrianglesSaved(),
+                shadowStats.m_SelectedTriangles, shadowStats.m_FullDetailTriangles, shadowStats.GetTrianglesSaved());
+        }
+    };
+    settingsDisplayFunctions.push_back(lodTriangles);
     
 
     // left
@@ -4,6 +4,8 @@
 
 #include "Settings.h"
 #include "RenderSettings.h"
+#include "BindlessDescriptorHeap.h"
+#include "ImageDecodePool.h"
 
 #include "include/imgui/imgui.h"
 #include "include/imgui/backends/imgui_impl_win32.h"
@@ -30,6 +32,21 @@ struct ViewportTexture
 	std::string m_DebugName;
 };
 
+// An image file shown in the image browser, loaded by the ImageDecodePool into its own descriptor.
+struct BrowserImage
+{
+	std::string m_Name;
+	ImageHandle m_Image;
+	DescriptorHandle m_Srv;
+};
+
+// A frame's ImGui draw data, copied so it can be rendered after ImGui has started the next frame.
+struct UIDrawData
+{
+	ImDrawData m_DrawData;
+	std::vector<std::unique_ptr<ImDrawList>> m_DrawLists;
+};
+
 class UIManager
 {
 public:
@@ -41,20 +58,26 @@ public:
 		ActiveWindows()
 			: m_ShowDemoWindow(false)
 			, m_SettingsWindow(false)
+			, m_ImageBrowser(false)
 		{
 		}
 
 		bool m_SettingsWindow;
 		bool m_ShowDemoWindow;
+		bool m_ImageBrowser;
 	};
 
 	void InitStyle();
 
-	void InitialiseForDX12(HWND window, ID3D12Device* device, ID3D12CommandQueue* commandQueue, ID3D12DescriptorHeap* descriptorHeap, int swapchainBufferCount, IRenderSettings* renderer);
+	void InitialiseForDX12(HWND window, ID3D12Device* device, ID3D12CommandQueue* commandQueue, BindlessDescriptorHeap* descriptorHeap, ImageDecodePool* imagePool, int framesInFlight, IRenderSettings* renderer);
 
+	// Builds the UI, on the thread that owns the ImGui context.
 	void BeginRender();
 	void Render();
-	void EndRender(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* backBuffer);
+	void EndRender(UIDrawData& drawData);
+
+	// Records draw data from EndRender, safe on another thread while the next UI frame is built.
+	void RenderDrawData(UIDrawData& drawData, ID3D12GraphicsCommandList* cmdList);
 
 	void SubmitViewportTexture(std::string textureName, GPUTextureHandle textureHandle, u32 textureWidth, u32 textureHeight);
 	void CreateViewport();
@@ -64,6 +87,8 @@ public:
 private:
 
 	IRenderSettings* m_Renderer;
+	BindlessDescriptorHeap* m_DescriptorHeap;
+	ImageDecodePool* m_ImagePool;
 
 	UISettings m_UISettings;
 
@@ -73,6 +98,8 @@ private:
 	void DestroyClosedViewports();
 	void MainMenuBar();
 	void SettingsWindow();
+	void ImageBrowserWindow();
+	void LoadBrowserImages();
 
 	// Settings Categories
 	void SceneSettingsPage();
@@ -92,6 +119,10 @@ private:
 	std::unordered_map<ViewportTextureHandle, ViewportTexture> m_ViewportDisplayTextureHandles;
 	ViewportHandle m_NextViewportHandle;
 
+	// Loaded the first time the browser opens and kept until shutdown.
+	std::vector<BrowserImage> m_BrowserImages;
+	bool m_BrowserImagesLoaded;
+
 	ImVec4* m_DefaultUIColours;
 	ImFont* m_DefaultFont;
 };
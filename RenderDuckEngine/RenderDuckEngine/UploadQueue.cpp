@@ -0,0 +1,265 @@
+#include "UploadQueue.h"
+
+#include <algorithm>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	ComPtr<ID3D12Fence> CreateFence(ID3D12Device* device)
+	{
+		ComPtr<ID3D12Fence> fence;
+		ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+		return fence;
+	}
+}
+
+UploadQueue::UploadQueue(ID3D12Device* device, u64 stagingSize)
+	: m_Device(device)
+	, m_Fence(CreateFence(device))
+	, m_Timeline(m_Fence.Get())
+	, m_Ring(stagingSize, &m_Timeline)
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	ThrowIfFailed(m_Device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_CopyQueue)));
+
+	ThrowIfFailed(m_Device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(stagingSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_StagingBuffer)));
+
+	ThrowIfFailed(m_StagingBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_StagingData)));
+}
+
+UploadQueue::~UploadQueue()
+{
+	// Anything still queued is dropped, but submitted copies must finish before the staging buffer goes.
+	m_Timeline.Wait(m_LastFenceValue);
+
+	if (m_StagingBuffer != nullptr)
+		m_StagingBuffer->Unmap(0, nullptr);
+
+	m_StagingData = nullptr;
+}
+
+ComPtr<ID3D12Resource> UploadQueue::CreateBuffer(const void* data, u64 byteSize)
+{
+	ComPtr<ID3D12Resource> buffer;
+	ThrowIfFailed(m_Device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(buffer.GetAddressOf())));
+
+	UploadBuffer(buffer.Get(), 0, data, byteSize);
+	return buffer;
+}
+
+void UploadQueue::UploadBuffer(ID3D12Resource* dest, u64 destOffset, const void* data, u64 byteSize)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Buffers larger than a quarter of the ring are copied in pieces so they never need all of it.
+	const u64 maxChunkSize = m_Ring.GetCapacity() / 4;
+	const u8* src = static_cast<const u8*>(data);
+
+	for (u64 copied = 0; copied < byteSize;)
+	{
+		const u64 chunkSize = std::min(byteSize - copied, maxChunkSize);
+		const u64 stagingOffset = AllocateStaging(chunkSize, 4);
+		memcpy(m_StagingData + stagingOffset, src + copied, chunkSize);
+
+		GetOpenList()->CopyBufferRegion(dest, destOffset + copied, m_StagingBuffer.Get(), stagingOffset, chunkSize);
+		copied += chunkSize;
+	}
+}
+
+void UploadQueue::UploadTexture(ID3D12Resource* dest, u32 firstSubresource, u32 numSubresources, const D3D12_SUBRESOURCE_DATA* srcData)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	const D3D12_RESOURCE_DESC desc = dest->GetDesc();
+
+	// Each subresource is staged on its own so a large texture does not need one huge allocation.
+	for (u32 i = 0; i < numSubresources; ++i)
+	{
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+		UINT numRows = 0;
+		UINT64 rowSizeInBytes = 0;
+		UINT64 totalBytes = 0;
+		m_Device->GetCopyableFootprints(&desc, firstSubresource + i, 1, 0, &layout, &numRows, &rowSizeInBytes, &totalBytes);
+
+		StageTextureRows(dest, firstSubresource + i, layout.Footprint, numRows, rowSizeInBytes,
+			static_cast<const u8*>(srcData[i].pData), srcData[i].RowPitch, srcData[i].SlicePitch, 0, 0);
+	}
+}
+
+void UploadQueue::UploadTextureRegion(ID3D12Resource* dest, u32 subresource, u32 x, u32 y, u32 width, u32 height, const void* data, u32 rowPitch)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// The footprint of a texture the size of the region gives the staging layout in its format.
+	const CD3DX12_RESOURCE_DESC regionDesc = CD3DX12_RESOURCE_DESC::Tex2D(dest->GetDesc().Format, width, height, 1, 1);
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+	UINT numRows = 0;
+	UINT64 rowSizeInBytes = 0;
+	UINT64 totalBytes = 0;
+	m_Device->GetCopyableFootprints(&regionDesc, 0, 1, 0, &layout, &numRows, &rowSizeInBytes, &totalBytes);
+
+	StageTextureRows(dest, subresource, layout.Footprint, numRows, rowSizeInBytes, static_cast<const u8*>(data), rowPitch, (u64)rowPitch * numRows, x, y);
+}
+
+void UploadQueue::StageTextureRows(ID3D12Resource* dest, u32 subresource, const D3D12_SUBRESOURCE_FOOTPRINT& footprint, u32 numRows,
+	u64 rowSizeInBytes, const u8* data, u64 rowPitch, u64 slicePitch, u32 x, u32 y)
+{
+	// Block compressed formats have a row per 4 texel rows.
+	const u32 rowHeight = numRows < footprint.Height ? 4 : 1;
+
+	// Like buffers, anything larger than a quarter of the ring is copied in pieces: whole slices
+	// when one fits, otherwise bands of rows of one slice.
+	const u64 maxChunkSize = m_Ring.GetCapacity() / 4;
+	const u64 sliceSize = (u64)footprint.RowPitch * numRows;
+	u32 bandSlices = footprint.Depth;
+	u32 bandRows = numRows;
+	if (sliceSize * footprint.Depth > maxChunkSize)
+	{
+		bandSlices = (u32)std::max<u64>(maxChunkSize / sliceSize, 1);
+		if (sliceSize > maxChunkSize)
+		{
+			bandRows = (u32)std::clamp<u64>(maxChunkSize / footprint.RowPitch, 1, numRows);
+		}
+	}
+
+	CD3DX12_TEXTURE_COPY_LOCATION dst(dest, subresource);
+	for (u32 slice = 0; slice < footprint.Depth; slice += bandSlices)
+	{
+		for (u32 row = 0; row < numRows; row += bandRows)
+		{
+			const u32 slices = std::min(bandSlices, footprint.Depth - slice);
+			const u32 rows = std::min(bandRows, numRows - row);
+
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout = { 0, footprint };
+			layout.Footprint.Height = std::min(rows * rowHeight, footprint.Height - row * rowHeight);
+			layout.Footprint.Depth = slices;
+			layout.Offset = AllocateStaging((u64)footprint.RowPitch * rows * slices, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+
+			for (u32 z = 0; z < slices; ++z)
+			{
+				for (u32 r = 0; r < rows; ++r)
+				{
+					memcpy(m_StagingData + layout.Offset + ((u64)z * rows + r) * footprint.RowPitch,
+						data + (u64)(slice + z) * slicePitch + (u64)(row + r) * rowPitch, (size_t)rowSizeInBytes);
+				}
+			}
+
+			CD3DX12_TEXTURE_COPY_LOCATION src(m_StagingBuffer.Get(), layout);
+			GetOpenList()->CopyTextureRegion(&dst, x, y + row * rowHeight, slice, &src, nullptr);
+		}
+	}
+}
+
+UploadToken UploadQueue::Submit()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return SubmitLocked();
+}
+
+UploadToken UploadQueue::SubmitLocked()
+{
+	// Nothing new, the last batch is the one to wait for.
+	if (!m_ListOpen)
+	{
+		return m_LastFenceValue;
+	}
+
+	ThrowIfFailed(m_CommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { m_CommandList.Get() };
+	m_CopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	ThrowIfFailed(m_CopyQueue->Signal(m_Fence.Get(), ++m_LastFenceValue));
+
+	m_Ring.Commit(m_LastFenceValue);
+	m_PendingAllocators.push_back({ m_LastFenceValue, m_OpenAllocator });
+	m_OpenAllocator = nullptr;
+	m_ListOpen = false;
+
+	return m_LastFenceValue;
+}
+
+void UploadQueue::Wait(UploadToken token)
+{
+	m_Timeline.Wait(token);
+}
+
+void UploadQueue::WaitOnQueue(ID3D12CommandQueue* queue, UploadToken token)
+{
+	if (token != 0)
+	{
+		ThrowIfFailed(queue->Wait(m_Fence.Get(), token));
+	}
+}
+
+ID3D12GraphicsCommandList* UploadQueue::GetOpenList()
+{
+	if (m_ListOpen)
+	{
+		return m_CommandList.Get();
+	}
+
+	// Reuse the oldest allocator once the GPU has finished with it, otherwise make another.
+	if (!m_PendingAllocators.empty() && m_PendingAllocators.front().m_FenceValue <= m_Fence->GetCompletedValue())
+	{
+		m_OpenAllocator = m_PendingAllocators.front().m_Allocator;
+		m_PendingAllocators.pop_front();
+		ThrowIfFailed(m_OpenAllocator->Reset());
+	}
+	else
+	{
+		ThrowIfFailed(m_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(m_OpenAllocator.GetAddressOf())));
+	}
+
+	if (m_CommandList == nullptr)
+	{
+		ThrowIfFailed(m_Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, m_OpenAllocator.Get(), nullptr,
+			IID_PPV_ARGS(m_CommandList.GetAddressOf())));
+	}
+	else
+	{
+		ThrowIfFailed(m_CommandList->Reset(m_OpenAllocator.Get(), nullptr));
+	}
+
+	m_ListOpen = true;
+	return m_CommandList.Get();
+}
+
+u64 UploadQueue::AllocateStaging(u64 size, u64 alignment)
+{
+	u64 offset = m_Ring.Allocate(size, alignment);
+	if (offset != c_InvalidRingOffset)
+	{
+		return offset;
+	}
+
+	// The ring is full. Send what is queued so its staging memory can be released, then wait for
+	// the oldest batches to land until there is room.
+	SubmitLocked();
+	while (offset == c_InvalidRingOffset && m_Ring.HasPendingBlocks())
+	{
+		m_Timeline.Wait(m_Ring.GetOldestPendingFence());
+		offset = m_Ring.Allocate(size, alignment);
+	}
+
+	// Only a copy larger than the whole ring gets here, release builds must not write past it.
+	if (offset == c_InvalidRingOffset)
+	{
+		throw DxException(E_OUTOFMEMORY, L"UploadQueue::AllocateStaging", AnsiToWString(__FILE__), __LINE__);
+	}
+	return offset;
+}
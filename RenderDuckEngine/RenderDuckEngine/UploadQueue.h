@@ -0,0 +1,90 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <deque>
+#include <mutex>
+
+#include "d3dUtil.h"
+#include "FenceTimeline.h"
+#include "RingAllocator.h"
+
+// Fence value the copy queue signals once a submitted batch has landed, 0 means nothing to wait for.
+typedef u64 UploadToken;
+
+// Copies CPU data into default heap resources on a dedicated copy queue. Data is staged into one
+// persistently mapped ring as soon as an upload is requested, copies are batched into a single
+// command list and Submit sends the whole batch at once. Staging memory and command allocators
+// are reused automatically once the batch's fence completes.
+// Destination resources should be in the COMMON state. Copy queue writes decay back to COMMON,
+// and buffers and textures are implicitly promoted to shader resource, vertex or index buffer
+// states on first use, so no barriers are needed on either queue.
+class UploadQueue
+{
+public:
+	UploadQueue(ID3D12Device* device, u64 stagingSize);
+	UploadQueue(const UploadQueue& rhs) = delete;
+	UploadQueue& operator=(const UploadQueue& rhs) = delete;
+	~UploadQueue();
+
+	// Creates a default heap buffer and queues a copy of data into it.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(const void* data, u64 byteSize);
+
+	// Data larger than the staging ring is copied in pieces. A single texture row larger than the
+	// whole ring cannot be, and throws a DxException with E_OUTOFMEMORY.
+	void UploadBuffer(ID3D12Resource* dest, u64 destOffset, const void* data, u64 byteSize);
+	void UploadTexture(ID3D12Resource* dest, u32 firstSubresource, u32 numSubresources, const D3D12_SUBRESOURCE_DATA* srcData);
+
+	// Writes a width x height rectangle of one 2D subresource at (x, y). Rows of data are rowPitch
+	// bytes apart, for block compressed formats a row is a row of blocks.
+	void UploadTextureRegion(ID3D12Resource* dest, u32 subresource, u32 x, u32 y, u32 width, u32 height, const void* data, u32 rowPitch);
+
+	// Sends everything queued since the last submit to the copy queue.
+	UploadToken Submit();
+
+	bool IsComplete(UploadToken token) const { return m_Fence->GetCompletedValue() >= token; }
+
+	// Blocks the CPU until the batch has landed.
+	void Wait(UploadToken token);
+
+	// Makes later work on queue wait for the batch, without blocking the CPU.
+	void WaitOnQueue(ID3D12CommandQueue* queue, UploadToken token);
+
+	u64 GetStagingSize() const { return m_Ring.GetCapacity(); }
+	u64 GetStagingUsedBytes() const { return m_Ring.GetUsedBytes(); }
+	u64 GetStagingPeakUsedBytes() const { return m_Ring.GetPeakUsedBytes(); }
+
+private:
+	struct PendingAllocator
+	{
+		u64 m_FenceValue;
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_Allocator;
+	};
+
+	ID3D12GraphicsCommandList* GetOpenList();
+	u64 AllocateStaging(u64 size, u64 alignment);
+
+	// Stages one subresource, or a region of one at (x, y), laid out as footprint with numRows rows
+	// per slice, and queues its copy.
+	void StageTextureRows(ID3D12Resource* dest, u32 subresource, const D3D12_SUBRESOURCE_FOOTPRINT& footprint, u32 numRows,
+		u64 rowSizeInBytes, const u8* data, u64 rowPitch, u64 slicePitch, u32 x, u32 y);
+	UploadToken SubmitLocked();
+
+	ID3D12Device* m_Device;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_CopyQueue;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_CommandList;
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_OpenAllocator;
+	std::deque<PendingAllocator> m_PendingAllocators;
+	bool m_ListOpen = false;
+
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_Fence;
+	u64 m_LastFenceValue = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_StagingBuffer;
+	u8* m_StagingData = nullptr;
+
+	FenceTimeline m_Timeline;
+	RingAllocator m_Ring;
+
+	std::mutex m_Mutex;
+};
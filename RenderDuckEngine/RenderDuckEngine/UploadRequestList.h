@@ -0,0 +1,211 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "d3dUtil.h"
+#include "JobSystem.h"
+#include "UploadQueue.h"
+
+enum class UploadRequestState : u32
+{
+	// A job is reading the source and staging its copies.
+	Staging = 0,
+	Staged,
+	Submitted,
+
+	// Reported by Update, the copies have landed or staging failed.
+	Landed,
+	Failed,
+	FailureReported,
+
+	Free,
+};
+
+// What every background upload keeps. Loaders derive their request from this.
+struct UploadRequest
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_Resource;
+	UploadToken m_Token = 0;
+
+	// Set when the owner releases the request while its job or copy is still in flight.
+	bool m_Released = false;
+
+	// Written by the job with release once everything it fills in is final.
+	std::atomic<UploadRequestState> m_State = UploadRequestState::Staging;
+};
+
+// The lifecycle the background loaders share. Dispatch hands a request to a job that stages its
+// copies into the upload queue, Update sends everything staged since the last call as one batch
+// and reports each request once, when its batch has landed or its staging failed, and Release frees
+// a request straight away or, while it is in flight, once Update sees it finish. Ids of freed
+// requests are reused.
+// Everything but the stage function runs on the owner's thread, one call at a time.
+template<typename Request>
+class UploadRequestList
+{
+public:
+	// Returns false when the request failed. Runs as a job and must not throw.
+	typedef std::function<bool(Request& request)> StageFunc;
+
+	UploadRequestList(JobSystem* jobSystem, UploadQueue* uploadQueue)
+		: m_JobSystem(jobSystem)
+		, m_UploadQueue(uploadQueue)
+	{
+	}
+	UploadRequestList(const UploadRequestList& rhs) = delete;
+	UploadRequestList& operator=(const UploadRequestList& rhs) = delete;
+
+	~UploadRequestList() { WaitForJobs(); }
+
+	void WaitForJobs() { m_JobSystem->Wait(m_Counter); }
+
+	u32 Dispatch(std::unique_ptr<Request> request, StageFunc stage)
+	{
+		u32 id;
+		if (!m_FreeRequests.empty())
+		{
+			// The job of a freed request has finished with it, so it can be replaced.
+			id = m_FreeRequests.back();
+			m_FreeRequests.pop_back();
+			m_Requests[id] = std::move(request);
+		}
+		else
+		{
+			id = (u32)m_Requests.size();
+			m_Requests.push_back(std::move(request));
+		}
+		++m_Outstanding;
+
+		Request* job = m_Requests[id].get();
+		m_JobSystem->Dispatch(m_Counter, [job, stage = std::move(stage)](u32)
+		{
+			const bool staged = stage(*job);
+			if (!staged)
+			{
+				job->m_Resource = nullptr;
+			}
+			job->m_State.store(staged ? UploadRequestState::Staged : UploadRequestState::Failed, std::memory_order_release);
+		});
+		return id;
+	}
+
+	// Calls onLanded(id, request) or onFailed(id, request) once for each request that finished
+	// since the last call, before it moves to Landed or FailureReported. Returns true when a batch
+	// was submitted.
+	template<typename LandedFunc, typename FailedFunc>
+	bool Update(LandedFunc onLanded, FailedFunc onFailed)
+	{
+		if (m_Outstanding == 0)
+		{
+			return false;
+		}
+
+		// States are read before submitting, so every request moved to Submitted here had its
+		// copies queued before the batch was closed. Requests staged in between wait for the next call.
+		m_Staged.clear();
+		for (u32 id = 0; id < (u32)m_Requests.size(); ++id)
+		{
+			Request* request = m_Requests[id].get();
+			switch (request->m_State.load(std::memory_order_acquire))
+			{
+			case UploadRequestState::Staged:
+				m_Staged.push_back(request);
+				break;
+
+			case UploadRequestState::Submitted:
+				if (m_UploadQueue->IsComplete(request->m_Token))
+				{
+					--m_Outstanding;
+					if (request->m_Released)
+					{
+						FreeRequest(id);
+						break;
+					}
+					onLanded(id, *request);
+					request->m_State.store(UploadRequestState::Landed, std::memory_order_relaxed);
+				}
+				break;
+
+			case UploadRequestState::Failed:
+				--m_Outstanding;
+				if (request->m_Released)
+				{
+					FreeRequest(id);
+					break;
+				}
+				onFailed(id, *request);
+				request->m_State.store(UploadRequestState::FailureReported, std::memory_order_relaxed);
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		if (m_Staged.empty())
+		{
+			return false;
+		}
+
+		const UploadToken token = m_UploadQueue->Submit();
+		for (Request* request : m_Staged)
+		{
+			request->m_Token = token;
+			request->m_State.store(UploadRequestState::Submitted, std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	// Drops the request's reference to its resource and lets the id be reused. Requests still in
+	// flight are freed by Update once their job and copy are done with them.
+	void Release(u32 id)
+	{
+		const UploadRequestState state = GetState(id);
+		ASSERTMSG(state != UploadRequestState::Free && !m_Requests[id]->m_Released, "Upload request was already released");
+		if (state == UploadRequestState::Landed || state == UploadRequestState::FailureReported)
+		{
+			FreeRequest(id);
+		}
+		else
+		{
+			m_Requests[id]->m_Released = true;
+		}
+	}
+
+	UploadRequestState GetState(u32 id) const
+	{
+		assert(id < m_Requests.size());
+		return m_Requests[id]->m_State.load(std::memory_order_acquire);
+	}
+
+	Request& operator[](u32 id) { assert(id < m_Requests.size()); return *m_Requests[id]; }
+	const Request& operator[](u32 id) const { assert(id < m_Requests.size()); return *m_Requests[id]; }
+
+	bool IsIdle() const { return m_Outstanding == 0; }
+
+private:
+	void FreeRequest(u32 id)
+	{
+		Request* request = m_Requests[id].get();
+		request->m_Resource = nullptr;
+		request->m_State.store(UploadRequestState::Free, std::memory_order_relaxed);
+		m_FreeRequests.push_back(id);
+	}
+
+	JobSystem* m_JobSystem;
+	UploadQueue* m_UploadQueue;
+
+	// Requests never move, jobs hold on to them while the vector grows.
+	std::vector<std::unique_ptr<Request>> m_Requests;
+	std::vector<u32> m_FreeRequests;
+	u32 m_Outstanding = 0;
+
+	// Scratch for Update, kept so it does not allocate every frame.
+	std::vector<Request*> m_Staged;
+
+	JobCounter m_Counter;
+};
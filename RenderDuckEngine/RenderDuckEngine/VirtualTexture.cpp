@@ -0,0 +1,56 @@
+#include "VirtualTexture.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	ComPtr<ID3D12Resource> CreateTexture(ID3D12Device* device, const D3D12_RESOURCE_DESC& desc)
+	{
+		// Created in COMMON, copy queue writes decay back to it and the first read promotes it.
+		ComPtr<ID3D12Resource> texture;
+		ThrowIfFailed(device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(texture.GetAddressOf())));
+		return texture;
+	}
+}
+
+VirtualTexture::VirtualTexture(ID3D12Device* device, UploadQueue* uploadQueue, const VirtualTexturePageTable& pageTable, DXGI_FORMAT pageFormat)
+	: m_UploadQueue(uploadQueue)
+	, m_PhysicalPageSize(pageTable.GetDesc().m_PageSize + 2 * pageTable.GetDesc().m_PageBorder)
+{
+	const VirtualTextureDesc& desc = pageTable.GetDesc();
+	m_PhysicalTexture = CreateTexture(device, CD3DX12_RESOURCE_DESC::Tex2D(pageFormat,
+		desc.m_PhysicalPagesX * m_PhysicalPageSize, desc.m_PhysicalPagesY * m_PhysicalPageSize, 1, 1));
+	m_PageTableTexture = CreateTexture(device, CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UINT,
+		pageTable.GetPagesX(0), pageTable.GetPagesY(0), 1, (UINT16)pageTable.GetMipCount()));
+}
+
+void VirtualTexture::UploadPage(const VirtualPageLoad& load, const void* pixels, u32 rowPitch)
+{
+	m_UploadQueue->UploadTextureRegion(m_PhysicalTexture.Get(), 0, load.m_SlotX * m_PhysicalPageSize, load.m_SlotY * m_PhysicalPageSize,
+		m_PhysicalPageSize, m_PhysicalPageSize, pixels, rowPitch);
+}
+
+void VirtualTexture::UploadPageTable(VirtualTexturePageTable& pageTable)
+{
+	// One copy per mip of the rectangle bounding its changes.
+	for (u32 mip = 0; mip < pageTable.GetMipCount(); ++mip)
+	{
+		const VirtualPageTableRect& dirty = pageTable.GetDirtyRect(mip);
+		if (dirty.IsEmpty())
+		{
+			continue;
+		}
+
+		const u32 rowPitch = pageTable.GetPagesX(mip) * sizeof(u32);
+		const u32* first = pageTable.GetPageTable(mip) + dirty.m_MinY * pageTable.GetPagesX(mip) + dirty.m_MinX;
+		m_UploadQueue->UploadTextureRegion(m_PageTableTexture.Get(), mip, dirty.m_MinX, dirty.m_MinY,
+			dirty.m_MaxX - dirty.m_MinX, dirty.m_MaxY - dirty.m_MinY, first, rowPitch);
+	}
+	pageTable.ClearDirtyRects();
+}
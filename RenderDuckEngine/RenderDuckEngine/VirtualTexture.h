@@ -0,0 +1,34 @@
+#pragma once
+#include "EngineCore.h"
+
+#include "d3dUtil.h"
+#include "UploadQueue.h"
+#include "VirtualTexturePageTable.h"
+
+// Device side of a virtual texture: the physical page cache, one texture holding every slot with
+// its border, and the page table texture VirtualTexturePageTable maintains, with one mip per page
+// table mip. Both are only ever written through the upload queue, so neither needs barriers.
+class VirtualTexture
+{
+public:
+	VirtualTexture(ID3D12Device* device, UploadQueue* uploadQueue, const VirtualTexturePageTable& pageTable, DXGI_FORMAT pageFormat);
+	VirtualTexture(const VirtualTexture& rhs) = delete;
+	VirtualTexture& operator=(const VirtualTexture& rhs) = delete;
+
+	// One page including its border on every side. Rows are rowPitch bytes apart, for block
+	// compressed formats a row is a row of blocks.
+	void UploadPage(const VirtualPageLoad& load, const void* pixels, u32 rowPitch);
+
+	// Writes the page table texels that changed since the last call.
+	void UploadPageTable(VirtualTexturePageTable& pageTable);
+
+	ID3D12Resource* GetPhysicalTexture() const { return m_PhysicalTexture.Get(); }
+	ID3D12Resource* GetPageTableTexture() const { return m_PageTableTexture.Get(); }
+
+private:
+	UploadQueue* m_UploadQueue;
+	u32 m_PhysicalPageSize;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_PhysicalTexture;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_PageTableTexture;
+};
@@ -0,0 +1,464 @@
+#include "VirtualTexturePageTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	u32 PackPageTableEntry(u32 slotX, u32 slotY, u32 mip)
+	{
+		return slotX | (slotY << 8) | (mip << 16);
+	}
+}
+
+VirtualTexturePageTable::VirtualTexturePageTable(const VirtualTextureDesc& desc, u32 maxPendingLoads)
+	: m_Desc(desc)
+	, m_MaxPendingLoads(std::max(1u, maxPendingLoads))
+{
+	ASSERTMSG(desc.m_PageSize > 0 && desc.m_Width % desc.m_PageSize == 0 && desc.m_Height % desc.m_PageSize == 0,
+		"Virtual texture must be a whole number of pages");
+	ASSERTMSG(desc.m_PhysicalPagesX <= 256 && desc.m_PhysicalPagesY <= 256, "Page table entries hold 8 bit slot coordinates");
+
+	// Mips down to a single page, each half the pages of the one above rounded up, so a page's
+	// parent is always at half its coordinates.
+	const u32 pagesX = desc.m_Width / desc.m_PageSize;
+	const u32 pagesY = desc.m_Height / desc.m_PageSize;
+	ASSERTMSG(pagesX <= 4096 && pagesY <= 4096, "Feedback entries hold 12 bit page coordinates");
+	u32 pageCount = 0;
+	for (u32 mip = 0; ; ++mip)
+	{
+		Mip level;
+		level.m_PagesX = (pagesX + (1u << mip) - 1) >> mip;
+		level.m_PagesY = (pagesY + (1u << mip) - 1) >> mip;
+		level.m_FirstPage = pageCount;
+		level.m_Table.resize((size_t)level.m_PagesX * level.m_PagesY, 0);
+		pageCount += level.m_PagesX * level.m_PagesY;
+		m_Mips.push_back(std::move(level));
+
+		if (m_Mips.back().m_PagesX == 1 && m_Mips.back().m_PagesY == 1)
+		{
+			break;
+		}
+	}
+
+	m_PageSlots.resize(pageCount, c_NoSlot);
+	m_FailedPages.resize(pageCount, false);
+	m_RequestFrames.resize(pageCount, 0);
+	m_RequestCounts.resize(pageCount, 0);
+	m_CandidateFrames.resize(pageCount, 0);
+	m_CandidateWeights.resize(pageCount, 0);
+
+	const u32 slotCount = desc.m_PhysicalPagesX * desc.m_PhysicalPagesY;
+	ASSERTMSG(slotCount > 1, "Virtual textures need more than the pinned page");
+	m_Slots.resize(slotCount);
+	for (u32 slot = slotCount; slot-- > 0;)
+	{
+		m_FreeSlots.push_back(slot);
+	}
+}
+
+void VirtualTexturePageTable::Update(const u32* feedback, u32 entryCount, std::vector<VirtualPageLoad>& loads)
+{
+	loads.clear();
+	++m_Frame;
+	m_Stats.m_FeedbackEntries = 0;
+	m_Stats.m_ResidentEntries = 0;
+
+	// Count requests per page. Entries naming pages that do not exist are dropped.
+	m_UniquePages.clear();
+	for (u32 i = 0; i < entryCount; ++i)
+	{
+		const u32 entry = feedback[i];
+		const u32 mip = entry >> 24;
+		const u32 x = entry & 0xfff;
+		const u32 y = (entry >> 12) & 0xfff;
+		if (entry == c_VirtualTextureNoFeedback || mip >= m_Mips.size() || x >= m_Mips[mip].m_PagesX || y >= m_Mips[mip].m_PagesY)
+		{
+			continue;
+		}
+
+		const u32 page = GetPage(mip, x, y);
+		if (m_RequestFrames[page] != m_Frame)
+		{
+			m_RequestFrames[page] = m_Frame;
+			m_RequestCounts[page] = 0;
+			m_UniquePages.push_back(page);
+		}
+		++m_RequestCounts[page];
+		++m_Stats.m_FeedbackEntries;
+	}
+	m_Stats.m_UniquePages = (u32)m_UniquePages.size();
+
+	// The pinned page goes before anything else.
+	m_Candidates.clear();
+	const u32 pinnedPage = (u32)m_PageSlots.size() - 1;
+	if (m_PageSlots[pinnedPage] == c_NoSlot && !m_FailedPages[pinnedPage])
+	{
+		m_CandidateFrames[pinnedPage] = m_Frame;
+		m_CandidateWeights[pinnedPage] = ~0u;
+		m_Candidates.push_back(pinnedPage);
+	}
+
+	// Each request goes to the coarsest page missing on the way to it, and only once the page above
+	// that is resident, so detail always arrives coarse to fine.
+	for (u32 page : m_UniquePages)
+	{
+		const u32 weight = m_RequestCounts[page];
+		if (IsResident(page))
+		{
+			m_Stats.m_ResidentEntries += weight;
+		}
+
+		u32 missing = c_NoSlot;
+		u32 covering = page;
+		bool failed = false;
+		while (m_PageSlots[covering] == c_NoSlot && covering != pinnedPage)
+		{
+			failed |= m_FailedPages[covering];
+			missing = covering;
+			covering = GetParent(covering);
+		}
+		Touch(covering);
+
+		if (missing == c_NoSlot || failed || !IsResident(covering))
+		{
+			continue;
+		}
+		if (m_CandidateFrames[missing] != m_Frame)
+		{
+			m_CandidateFrames[missing] = m_Frame;
+			m_CandidateWeights[missing] = 0;
+			m_Candidates.push_back(missing);
+		}
+		m_CandidateWeights[missing] += weight;
+	}
+	m_Stats.m_Candidates = (u32)m_Candidates.size();
+
+	// Most feedback texels served first, then the coarser page.
+	std::sort(m_Candidates.begin(), m_Candidates.end(), [this](u32 a, u32 b)
+	{
+		if (m_CandidateWeights[a] != m_CandidateWeights[b])
+		{
+			return m_CandidateWeights[a] > m_CandidateWeights[b];
+		}
+		return a > b;
+	});
+
+	for (u32 page : m_Candidates)
+	{
+		if (m_Stats.m_PendingLoads >= m_MaxPendingLoads)
+		{
+			break;
+		}
+
+		const u32 slot = AllocateSlot();
+		if (slot == c_NoSlot)
+		{
+			break;
+		}
+
+		Slot& s = m_Slots[slot];
+		s.m_Page = page;
+		s.m_Loading = true;
+		s.m_Pinned = page == pinnedPage;
+		m_PageSlots[page] = slot;
+
+		VirtualPageLoad load;
+		GetPageCoords(page, load.m_Mip, load.m_X, load.m_Y);
+		load.m_SlotX = slot % m_Desc.m_PhysicalPagesX;
+		load.m_SlotY = slot / m_Desc.m_PhysicalPagesX;
+		loads.push_back(load);
+
+		++m_Stats.m_PendingLoads;
+		++m_Stats.m_Loads;
+	}
+}
+
+void VirtualTexturePageTable::OnPageLoaded(const VirtualPageLoad& load, bool succeeded)
+{
+	const u32 page = GetPage(load.m_Mip, load.m_X, load.m_Y);
+	const u32 slot = load.m_SlotY * m_Desc.m_PhysicalPagesX + load.m_SlotX;
+	ASSERTMSG(m_PageSlots[page] == slot && m_Slots[slot].m_Loading, "Page was not loading into this slot");
+
+	Slot& s = m_Slots[slot];
+	s.m_Loading = false;
+	--m_Stats.m_PendingLoads;
+
+	if (!succeeded)
+	{
+		m_PageSlots[page] = c_NoSlot;
+		m_FailedPages[page] = true;
+		s.m_Page = c_NoSlot;
+		s.m_Pinned = false;
+		m_FreeSlots.push_back(slot);
+		++m_Stats.m_Failures;
+		return;
+	}
+
+	++m_Stats.m_ResidentPages;
+	s.m_LastUsedFrame = m_Frame;
+	if (!s.m_Pinned)
+	{
+		LinkMostRecent(slot);
+	}
+	SetSubtree(load.m_Mip, load.m_X, load.m_Y, PackPageTableEntry(load.m_SlotX, load.m_SlotY, load.m_Mip), true);
+}
+
+bool VirtualTexturePageTable::IsReady() const
+{
+	return IsResident((u32)m_PageSlots.size() - 1);
+}
+
+void VirtualTexturePageTable::ClearDirtyRects()
+{
+	for (Mip& level : m_Mips)
+	{
+		level.m_Dirty = VirtualPageTableRect();
+	}
+}
+
+void VirtualTexturePageTable::GetPageCoords(u32 page, u32& mip, u32& x, u32& y) const
+{
+	mip = 0;
+	while (mip + 1 < m_Mips.size() && page >= m_Mips[mip + 1].m_FirstPage)
+	{
+		++mip;
+	}
+	const u32 index = page - m_Mips[mip].m_FirstPage;
+	x = index % m_Mips[mip].m_PagesX;
+	y = index / m_Mips[mip].m_PagesX;
+}
+
+u32 VirtualTexturePageTable::GetParent(u32 page) const
+{
+	u32 mip = 0;
+	u32 x = 0;
+	u32 y = 0;
+	GetPageCoords(page, mip, x, y);
+	return GetPage(mip + 1, x / 2, y / 2);
+}
+
+void VirtualTexturePageTable::Touch(u32 page)
+{
+	const u32 pinnedPage = (u32)m_PageSlots.size() - 1;
+	for (;;)
+	{
+		const u32 slot = m_PageSlots[page];
+		if (slot != c_NoSlot && !m_Slots[slot].m_Loading)
+		{
+			// Ancestors were touched along with the page the first time.
+			if (m_Slots[slot].m_LastUsedFrame == m_Frame)
+			{
+				return;
+			}
+			m_Slots[slot].m_LastUsedFrame = m_Frame;
+			if (!m_Slots[slot].m_Pinned)
+			{
+				Unlink(slot);
+				LinkMostRecent(slot);
+			}
+		}
+
+		if (page == pinnedPage)
+		{
+			return;
+		}
+		page = GetParent(page);
+	}
+}
+
+u32 VirtualTexturePageTable::AllocateSlot()
+{
+	if (!m_FreeSlots.empty())
+	{
+		const u32 slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+		return slot;
+	}
+
+	// Everything resident is in use this frame, loading more would only evict what is on screen.
+	const u32 slot = m_LeastRecent;
+	if (slot == c_NoSlot || m_Slots[slot].m_LastUsedFrame == m_Frame)
+	{
+		return c_NoSlot;
+	}
+	Evict(slot);
+	return slot;
+}
+
+void VirtualTexturePageTable::Evict(u32 slot)
+{
+	Unlink(slot);
+	Slot& s = m_Slots[slot];
+	const u32 page = s.m_Page;
+	m_PageSlots[page] = c_NoSlot;
+	s.m_Page = c_NoSlot;
+	--m_Stats.m_ResidentPages;
+	++m_Stats.m_Evictions;
+
+	// The page and everything that fell back to it now fall back to whatever covers its parent.
+	u32 mip = 0;
+	u32 x = 0;
+	u32 y = 0;
+	GetPageCoords(page, mip, x, y);
+	const u32 parentValue = m_Mips[mip + 1].m_Table[(y / 2) * m_Mips[mip + 1].m_PagesX + x / 2];
+	SetSubtree(mip, x, y, parentValue, true);
+}
+
+void VirtualTexturePageTable::Unlink(u32 slot)
+{
+	Slot& s = m_Slots[slot];
+	if (s.m_Prev != c_NoSlot)
+	{
+		m_Slots[s.m_Prev].m_Next = s.m_Next;
+	}
+	else if (m_LeastRecent == slot)
+	{
+		m_LeastRecent = s.m_Next;
+	}
+	if (s.m_Next != c_NoSlot)
+	{
+		m_Slots[s.m_Next].m_Prev = s.m_Prev;
+	}
+	else if (m_MostRecent == slot)
+	{
+		m_MostRecent = s.m_Prev;
+	}
+	s.m_Prev = c_NoSlot;
+	s.m_Next = c_NoSlot;
+}
+
+void VirtualTexturePageTable::LinkMostRecent(u32 slot)
+{
+	Slot& s = m_Slots[slot];
+	s.m_Prev = m_MostRecent;
+	s.m_Next = c_NoSlot;
+	if (m_MostRecent != c_NoSlot)
+	{
+		m_Slots[m_MostRecent].m_Next = slot;
+	}
+	else
+	{
+		m_LeastRecent = slot;
+	}
+	m_MostRecent = slot;
+}
+
+void VirtualTexturePageTable::SetSubtree(u32 mip, u32 x, u32 y, u32 value, bool isRoot)
+{
+	Mip& level = m_Mips[mip];
+	u32& entry = level.m_Table[y * level.m_PagesX + x];
+	if (!isRoot && (entry == value || IsResident(GetPage(mip, x, y))))
+	{
+		// Either the subtree points here already or it is covered by a finer page.
+		return;
+	}
+
+	if (entry != value)
+	{
+		entry = value;
+		++m_Stats.m_PageTableWrites;
+
+		VirtualPageTableRect& dirty = level.m_Dirty;
+		if (dirty.IsEmpty())
+		{
+			dirty = { x, y, x + 1, y + 1 };
+		}
+		else
+		{
+			dirty.m_MinX = std::min(dirty.m_MinX, x);
+			dirty.m_MinY = std::min(dirty.m_MinY, y);
+			dirty.m_MaxX = std::max(dirty.m_MaxX, x + 1);
+			dirty.m_MaxY = std::max(dirty.m_MaxY, y + 1);
+		}
+	}
+
+	if (mip == 0)
+	{
+		return;
+	}
+	const Mip& child = m_Mips[mip - 1];
+	for (u32 childY = y * 2; childY < std::min(y * 2 + 2, child.m_PagesY); ++childY)
+	{
+		for (u32 childX = x * 2; childX < std::min(x * 2 + 2, child.m_PagesX); ++childX)
+		{
+			SetSubtree(mip - 1, childX, childY, value, false);
+		}
+	}
+}
+
+void RunVirtualTextureBenchmark(std::string& report)
+{
+	VirtualTextureDesc desc;
+	desc.m_Width = 65536;
+	desc.m_Height = 65536;
+	VirtualTexturePageTable table(desc, 64);
+
+	// An eighth of 1920x1080, which is a common feedback resolution.
+	const u32 feedbackWidth = 240;
+	const u32 feedbackHeight = 135;
+	const u32 frameCount = 600;
+	std::vector<u32> feedback(feedbackWidth * feedbackHeight);
+	std::vector<VirtualPageLoad> loads;
+
+	double totalUs = 0.0;
+	double worstUs = 0.0;
+	u64 uniquePages = 0;
+	u64 residentEntries = 0;
+	u64 feedbackEntries = 0;
+	for (u32 frame = 0; frame < frameCount; ++frame)
+	{
+		// A camera looking along v, drifting along u and turning slowly. Rows further up the
+		// screen are further away and want coarser mips.
+		const float cameraU = 0.3f + 0.0004f * frame;
+		const float cameraV = 0.5f + 0.1f * sinf(frame * 0.01f);
+		for (u32 row = 0; row < feedbackHeight; ++row)
+		{
+			const float t = (float)row / feedbackHeight;
+			const float depth = 0.004f / (1.0f - 0.99f * t);
+			const float texelsPerPixel = 2.0f * 0.8f * depth / 1920.0f * desc.m_Width;
+			const u32 mip = std::min(texelsPerPixel > 1.0f ? (u32)log2f(texelsPerPixel) : 0, table.GetMipCount() - 1);
+			for (u32 column = 0; column < feedbackWidth; ++column)
+			{
+				const float sx = 2.0f * (column + 0.5f) / feedbackWidth - 1.0f;
+				float u = cameraU + sx * 0.8f * depth;
+				float v = cameraV + depth;
+				u -= floorf(u);
+				v -= floorf(v);
+				const u32 texelX = (u32)(u * desc.m_Width) >> mip;
+				const u32 texelY = (u32)(v * desc.m_Height) >> mip;
+				feedback[row * feedbackWidth + column] = EncodeVirtualTextureFeedback(texelX / desc.m_PageSize, texelY / desc.m_PageSize, mip);
+			}
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		table.Update(feedback.data(), (u32)feedback.size(), loads);
+		const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		totalUs += us;
+		worstUs = std::max(worstUs, us);
+
+		const VirtualTextureStats& stats = table.GetStats();
+		uniquePages += stats.m_UniquePages;
+		residentEntries += stats.m_ResidentEntries;
+		feedbackEntries += stats.m_FeedbackEntries;
+
+		// Every load lands before the next frame's feedback.
+		for (const VirtualPageLoad& load : loads)
+		{
+			table.OnPageLoaded(load, true);
+		}
+		table.ClearDirtyRects();
+	}
+
+	const VirtualTextureStats& stats = table.GetStats();
+	char text[512];
+	snprintf(text, sizeof(text),
+		"Virtual texture %ux%u, %u mips, %u physical pages, %ux%u feedback, %u frames\n"
+		"Update %.1f us average, %.1f us worst, %.0f unique pages per frame\n"
+		"%u loads, %u evictions, %.1f page table texels written per frame, %.1f%% of feedback resident\n",
+		desc.m_Width, desc.m_Height, table.GetMipCount(), desc.m_PhysicalPagesX * desc.m_PhysicalPagesY, feedbackWidth, feedbackHeight, frameCount,
+		totalUs / frameCount, worstUs, (double)uniquePages / frameCount,
+		stats.m_Loads, stats.m_Evictions, (double)stats.m_PageTableWrites / frameCount, 100.0 * residentEntries / std::max<u64>(feedbackEntries, 1));
+	report += text;
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include "EngineCore.h"
+
+#include <string>
+
+struct VirtualTextureDesc
+{
+	// Texels of the top mip, a whole number of pages on each side.
+	u32 m_Width = 0;
+	u32 m_Height = 0;
+
+	// Texels on each side of a page, not counting the border every physical page carries so that
+	// filtering near its edge reads the neighbouring texels.
+	u32 m_PageSize = 128;
+	u32 m_PageBorder = 4;
+
+	// Slots of the physical page cache, at most 256 on each side.
+	u32 m_PhysicalPagesX = 32;
+	u32 m_PhysicalPagesY = 32;
+};
+
+// Feedback entries name one virtual page, buffer texels nothing was drawn to hold
+// c_VirtualTextureNoFeedback.
+const u32 c_VirtualTextureNoFeedback = ~0u;
+
+inline u32 EncodeVirtualTextureFeedback(u32 pageX, u32 pageY, u32 mip)
+{
+	return (mip << 24) | (pageY << 12) | pageX;
+}
+
+// Page to load into a physical slot, replacing whatever it held.
+struct VirtualPageLoad
+{
+	u32 m_X = 0;
+	u32 m_Y = 0;
+	u32 m_Mip = 0;
+	u32 m_SlotX = 0;
+	u32 m_SlotY = 0;
+};
+
+// Page table texels in [m_MinX, m_MaxX) x [m_MinY, m_MaxY) of one mip changed since the last upload.
+struct VirtualPageTableRect
+{
+	u32 m_MinX = 0;
+	u32 m_MinY = 0;
+	u32 m_MaxX = 0;
+	u32 m_MaxY = 0;
+
+	bool IsEmpty() const { return m_MinX >= m_MaxX || m_MinY >= m_MaxY; }
+};
+
+struct VirtualTextureStats
+{
+	// Of the last Update.
+	u32 m_FeedbackEntries = 0;
+	u32 m_UniquePages = 0;
+	u32 m_Candidates = 0;
+
+	// Feedback entries whose page was resident, the rest sampled a coarser fallback.
+	u32 m_ResidentEntries = 0;
+
+	// Since construction.
+	u32 m_Loads = 0;
+	u32 m_Evictions = 0;
+	u32 m_Failures = 0;
+	u64 m_PageTableWrites = 0;
+
+	u32 m_ResidentPages = 0;
+	u32 m_PendingLoads = 0;
+};
+
+// CPU side of a virtual texture, mapped onto a fixed cache of physical pages. Every frame the
+// caller hands Update the feedback buffer, the pages the GPU wanted to sample, and gets back pages
+// to load. Requests are deduplicated and each goes to its coarsest missing ancestor, so detail
+// arrives coarse to fine and every page always has a resident fallback. Candidates are ranked by
+// how many feedback texels they serve, slots are taken from the least recently used pages, and
+// pages used this frame are never evicted. The single page of the last mip is pinned.
+// The page table has one texel per virtual page in a mip chain of its own. Each holds the slot and
+// mip of the finest resident page covering it, packed as R8G8B8A8_UINT with the slot in red and
+// green and the mip in blue. Mapping or evicting a page rewrites its subtree, stopping at finer
+// resident pages, and grows a dirty rectangle per mip for the caller to upload.
+// Nothing here touches the device, the caller uploads pages and reports back with OnPageLoaded, so
+// it can be driven by synthetic feedback.
+class VirtualTexturePageTable
+{
+public:
+	VirtualTexturePageTable(const VirtualTextureDesc& desc, u32 maxPendingLoads);
+
+	// Loads are issued up to maxPendingLoads in flight.
+	void Update(const u32* feedback, u32 entryCount, std::vector<VirtualPageLoad>& loads);
+
+	// A page whose load failed frees its slot and is not requested again.
+	void OnPageLoaded(const VirtualPageLoad& load, bool succeeded);
+
+	// Whether the pinned page is resident, before that the page table holds nothing valid.
+	bool IsReady() const;
+
+	u32 GetMipCount() const { return (u32)m_Mips.size(); }
+	u32 GetPagesX(u32 mip) const { return m_Mips[mip].m_PagesX; }
+	u32 GetPagesY(u32 mip) const { return m_Mips[mip].m_PagesY; }
+	const VirtualTextureDesc& GetDesc() const { return m_Desc; }
+
+	// Tightly packed rows of one page table mip.
+	const u32* GetPageTable(u32 mip) const { return m_Mips[mip].m_Table.data(); }
+
+	const VirtualPageTableRect& GetDirtyRect(u32 mip) const { return m_Mips[mip].m_Dirty; }
+	void ClearDirtyRects();
+
+	const VirtualTextureStats& GetStats() const { return m_Stats; }
+
+private:
+	static constexpr u32 c_NoSlot = ~0u;
+
+	struct Mip
+	{
+		u32 m_PagesX = 0;
+		u32 m_PagesY = 0;
+
+		// Index of the mip's first page in the per page arrays.
+		u32 m_FirstPage = 0;
+
+		std::vector<u32> m_Table;
+		VirtualPageTableRect m_Dirty;
+	};
+
+	struct Slot
+	{
+		u32 m_Page = c_NoSlot;
+		u64 m_LastUsedFrame = 0;
+
+		// Least recently used list of resident, unpinned slots.
+		u32 m_Prev = c_NoSlot;
+		u32 m_Next = c_NoSlot;
+
+		bool m_Loading = false;
+		bool m_Pinned = false;
+	};
+
+	u32 GetPage(u32 mip, u32 x, u32 y) const { return m_Mips[mip].m_FirstPage + y * m_Mips[mip].m_PagesX + x; }
+	void GetPageCoords(u32 page, u32& mip, u32& x, u32& y) const;
+	u32 GetParent(u32 page) const;
+	bool IsResident(u32 page) const { return m_PageSlots[page] != c_NoSlot && !m_Slots[m_PageSlots[page]].m_Loading; }
+
+	// Marks the page and every ancestor used this frame.
+	void Touch(u32 page);
+
+	u32 AllocateSlot();
+	void Evict(u32 slot);
+	void Unlink(u32 slot);
+	void LinkMostRecent(u32 slot);
+
+	// Points the page, and every descendant not covered by a finer resident page, at value.
+	void SetSubtree(u32 mip, u32 x, u32 y, u32 value, bool isRoot);
+
+	VirtualTextureDesc m_Desc;
+	u32 m_MaxPendingLoads;
+	std::vector<Mip> m_Mips;
+
+	std::vector<u32> m_PageSlots;
+	std::vector<bool> m_FailedPages;
+
+	// Feedback counts, valid where the stamp matches the current frame.
+	std::vector<u64> m_RequestFrames;
+	std::vector<u32> m_RequestCounts;
+	std::vector<u32> m_UniquePages;
+
+	// Pages to load this frame, with the feedback texels each would serve.
+	std::vector<u64> m_CandidateFrames;
+	std::vector<u32> m_CandidateWeights;
+	std::vector<u32> m_Candidates;
+
+	std::vector<Slot> m_Slots;
+	std::vector<u32> m_FreeSlots;
+	u32 m_LeastRecent = c_NoSlot;
+	u32 m_MostRecent = c_NoSlot;
+
+	// Frame 0 means never used, so counting starts at 1.
+	u64 m_Frame = 1;
+
+	VirtualTextureStats m_Stats;
+};
+
+// Drives a 64k x 64k texture with feedback from a synthetic camera flying low over it and reports
+// the CPU cost of each Update, the loads it issues and how much of the feedback was resident.
+void RunVirtualTextureBenchmark(std::string& report);
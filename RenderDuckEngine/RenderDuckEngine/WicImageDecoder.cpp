@@ -0,0 +1,86 @@
+#include "WicImageDecoder.h"
+
+#include <windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Balances a successful CoInitializeEx, a thread already in another apartment is left alone.
+	struct ScopedComInit
+	{
+		ScopedComInit() : m_Result(CoInitializeEx(nullptr, COINIT_MULTITHREADED)) {}
+		~ScopedComInit()
+		{
+			if (SUCCEEDED(m_Result))
+			{
+				CoUninitialize();
+			}
+		}
+
+		HRESULT m_Result;
+	};
+}
+
+bool DecodeImageWic(const u8* data, u64 size, u32& width, u32& height, std::vector<u8>& pixels)
+{
+	if (size > MAXDWORD)
+	{
+		return false;
+	}
+
+	ScopedComInit comInit;
+	if (FAILED(comInit.m_Result) && comInit.m_Result != RPC_E_CHANGED_MODE)
+	{
+		return false;
+	}
+
+	ComPtr<IWICImagingFactory> factory;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))))
+	{
+		return false;
+	}
+
+	// The stream only reads, WIC just does not take a const pointer.
+	ComPtr<IWICStream> stream;
+	ComPtr<IWICBitmapDecoder> decoder;
+	ComPtr<IWICBitmapFrameDecode> frame;
+	ComPtr<IWICFormatConverter> converter;
+	if (FAILED(factory->CreateStream(stream.GetAddressOf()))
+		|| FAILED(stream->InitializeFromMemory(const_cast<u8*>(data), (DWORD)size))
+		|| FAILED(factory->CreateDecoderFromStream(stream.Get(), nullptr, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf()))
+		|| FAILED(decoder->GetFrame(0, frame.GetAddressOf()))
+		|| FAILED(factory->CreateFormatConverter(converter.GetAddressOf()))
+		|| FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)))
+	{
+		return false;
+	}
+
+	UINT frameWidth = 0;
+	UINT frameHeight = 0;
+	if (FAILED(converter->GetSize(&frameWidth, &frameHeight)) || frameWidth == 0 || frameHeight == 0)
+	{
+		return false;
+	}
+
+	const u64 rowPitch = (u64)frameWidth * 4;
+	const u64 imageSize = rowPitch * frameHeight;
+	if (imageSize > MAXUINT)
+	{
+		return false;
+	}
+
+	pixels.resize((size_t)imageSize);
+	if (FAILED(converter->CopyPixels(nullptr, (UINT)rowPitch, (UINT)imageSize, pixels.data())))
+	{
+		return false;
+	}
+
+	width = frameWidth;
+	height = frameHeight;
+	return true;
+}
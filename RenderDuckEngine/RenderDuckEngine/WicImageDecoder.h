@@ -0,0 +1,7 @@
+#pragma once
+#include "EngineCore.h"
+
+// ImageDecodeFunc for ImageDecodePool using the Windows Imaging Component, which reads BMP, PNG,
+// JPEG, GIF and TIFF without any third party library. Safe to call from any thread, COM is
+// initialised for the call if the thread has not done so already.
+bool DecodeImageWic(const u8* data, u64 size, u32& width, u32& height, std::vector<u8>& pixels);
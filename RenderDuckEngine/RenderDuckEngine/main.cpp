@@ -2,7 +2,50 @@
 #include <windows.h>
 #include <wrl.h>
 
+#include <fstream>
+
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
 #include "Renderer.h"
+#include "TextureCooker.h"
+#include "VirtualTexturePageTable.h"
+#include "ECS/EntityAdmin.h"
+
+namespace
+{
+    struct Benchmark
+    {
+        const char* m_Flag;
+        const char* m_ReportFile;
+        void (*m_Run)(std::string& report);
+    };
+
+    // Measures the texture cooker's encoders on the scene's textures.
+    void RunTextureBenchmark(std::string& report)
+    {
+        JobSystem jobSystem;
+        RunTextureCookerBenchmark("Assets/Textures", &jobSystem, report);
+    }
+
+    // Measures the BC decoders on the scene's textures.
+    void RunDecodeBenchmark(std::string& report)
+    {
+        JobSystem jobSystem;
+        RunBcDecodeBenchmark("Assets/Textures", &jobSystem, report);
+    }
+
+    // Each runs instead of the renderer when its flag is on the command line. The virtual texture
+    // benchmark runs the page table on synthetic feedback, the occlusion one culls a synthetic city
+    // and the ECS one iterates a million entities.
+    const Benchmark c_Benchmarks[] =
+    {
+        { "-texturebenchmark", "TextureCookerBenchmark.txt", RunTextureBenchmark },
+        { "-bcdecodebenchmark", "BcDecodeBenchmark.txt", RunDecodeBenchmark },
+        { "-vtbenchmark", "VirtualTextureBenchmark.txt", RunVirtualTextureBenchmark },
+        { "-occlusionbenchmark", "OcclusionBenchmark.txt", RunOcclusionBenchmark },
+        { "-ecsbenchmark", "EcsBenchmark.txt", RunEcsBenchmark },
+    };
+}
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
     PSTR cmdLine, int showCmd)
@@ -12,6 +55,20 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+    for (const Benchmark& benchmark : c_Benchmarks)
+    {
+        if (strstr(cmdLine, benchmark.m_Flag) != nullptr)
+        {
+            std::string report;
+            benchmark.m_Run(report);
+            OutputDebugStringA(report.c_str());
+
+            std::ofstream file(benchmark.m_ReportFile);
+            file << report;
+            return 0;
+        }
+    }
+
     try
     {
         Renderer theApp(hInstance);
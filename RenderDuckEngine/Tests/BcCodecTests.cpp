@@ -0,0 +1,285 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "BcCodec.h"
+#include "JobSystem.h"
+#include "TextureCooker.h"
+
+namespace
+{
+	// Indices 0, 1, 2, 3 repeating, two bits per texel.
+	const u8 c_Bc1Indices[4] = { 0xE4, 0xE4, 0xE4, 0xE4 };
+
+	// Indices 0 to 7 twice, three bits per texel.
+	const u8 c_Bc4Indices[6] = { 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA };
+
+	// Endpoints of red, 0xF800, and blue, 0x001F, in either order.
+	void MakeBc1Block(bool redFirst, u8* block)
+	{
+		const u8 red[2] = { 0x00, 0xF8 };
+		const u8 blue[2] = { 0x1F, 0x00 };
+		memcpy(block, redFirst ? red : blue, 2);
+		memcpy(block + 2, redFirst ? blue : red, 2);
+		memcpy(block + 4, c_Bc1Indices, 4);
+	}
+
+	void MakeBc4Block(u8 value0, u8 value1, u8* block)
+	{
+		block[0] = value0;
+		block[1] = value1;
+		memcpy(block + 2, c_Bc4Indices, 6);
+	}
+
+	std::vector<u8> FromHex(const char* hex)
+	{
+		std::vector<u8> bytes;
+		for (size_t i = 0; hex[i] != 0 && hex[i + 1] != 0; i += 2)
+		{
+			bytes.push_back((u8)std::stoul(std::string(hex + i, 2), nullptr, 16));
+		}
+		return bytes;
+	}
+
+	void ExpectTexel(const u8* texels, u32 texel, u8 r, u8 g, u8 b, u8 a)
+	{
+		const u8* decoded = texels + texel * 4;
+		EXPECT_EQ(decoded[0], r) << "texel " << texel;
+		EXPECT_EQ(decoded[1], g) << "texel " << texel;
+		EXPECT_EQ(decoded[2], b) << "texel " << texel;
+		EXPECT_EQ(decoded[3], a) << "texel " << texel;
+	}
+
+	double GetPsnr(const std::vector<u8>& reference, const std::vector<u8>& decoded, u32 channelCount)
+	{
+		double squaredError = 0.0;
+		for (size_t i = 0; i < reference.size(); i += 4)
+		{
+			for (u32 c = 0; c < channelCount; ++c)
+			{
+				const double delta = (double)reference[i + c] - (double)decoded[i + c];
+				squaredError += delta * delta;
+			}
+		}
+		const double meanSquaredError = squaredError / (double)(reference.size() / 4 * channelCount);
+		return meanSquaredError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+	}
+}
+
+TEST(BcCodec, Bc1FourColourMode)
+{
+	// The larger endpoint first, two thirds between them.
+	u8 block[8];
+	MakeBc1Block(true, block);
+	u8 texels[64];
+	EXPECT_TRUE(DecodeBcBlock(BcFormat::BC1, block, texels));
+
+	const u8 palette[4][3] = { { 255, 0, 0 }, { 0, 0, 255 }, { 170, 0, 85 }, { 85, 0, 170 } };
+	for (u32 i = 0; i < 16; ++i)
+	{
+		ExpectTexel(texels, i, palette[i % 4][0], palette[i % 4][1], palette[i % 4][2], 255);
+	}
+}
+
+TEST(BcCodec, Bc1ThreeColourModeHasTransparentBlack)
+{
+	// The smaller endpoint first, a midpoint and index 3 transparent.
+	u8 block[8];
+	MakeBc1Block(false, block);
+	u8 texels[64];
+	EXPECT_TRUE(DecodeBcBlock(BcFormat::BC1, block, texels));
+
+	const u8 palette[4][4] = { { 0, 0, 255, 255 }, { 255, 0, 0, 255 }, { 127, 0, 127, 255 }, { 0, 0, 0, 0 } };
+	for (u32 i = 0; i < 16; ++i)
+	{
+		ExpectTexel(texels, i, palette[i % 4][0], palette[i % 4][1], palette[i % 4][2], palette[i % 4][3]);
+	}
+}
+
+TEST(BcCodec, Bc2HasFourBitAlphaAndAlwaysFourColours)
+{
+	// Alpha nibble i is i, and the colour block is in the order that means 3 colours in BC1.
+	u8 block[16] = { 0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE };
+	MakeBc1Block(false, block + 8);
+	u8 texels[64];
+	EXPECT_TRUE(DecodeBcBlock(BcFormat::BC2, block, texels));
+
+	const u8 palette[4][3] = { { 0, 0, 255 }, { 255, 0, 0 }, { 85, 0, 170 }, { 170, 0, 85 } };
+	for (u32 i = 0; i < 16; ++i)
+	{
+		ExpectTexel(texels, i, palette[i % 4][0], palette[i % 4][1], palette[i % 4][2], (u8)(i * 17));
+	}
+}
+
+TEST(BcCodec, Bc3HasEightLevelAlpha)
+{
+	u8 block[16];
+	MakeBc4Block(200, 100, block);
+	MakeBc1Block(false, block + 8);
+	u8 texels[64];
+	EXPECT_TRUE(DecodeBcBlock(BcFormat::BC3, block, texels));
+
+	const u8 palette[4][3] = { { 0, 0, 255 }, { 255, 0, 0 }, { 85, 0, 170 }, { 170, 0, 85 } };
+	const u8 alpha[8] = { 200, 100, 185, 171, 157, 142, 128, 114 };
+	for (u32 i = 0; i < 16; ++i)
+	{
+		ExpectTexel(texels, i, palette[i % 4][0], palette[i % 4][1], palette[i % 4][2], alpha[i % 8]);
+	}
+}
+
+TEST(BcCodec, Bc4SixLevelModeAddsZeroAndFull)
+{
+	// The smaller value first gives four levels between them, then 0 and 255.
+	u8 block[8];
+	MakeBc4Block(50, 150, block);
+	u8 texels[64];
+	memset(texels, 0xCD, sizeof(texels));
+	EXPECT_TRUE(DecodeBcBlock(BcFormat::BC4, block, texels));
+
+	const u8 red[8] = { 50, 150, 70, 90, 110, 130, 0, 255 };
+	for (u32 i = 0; i < 16; ++i)
+	{
+		ExpectTexel(texels, i, red[i % 8], 0, 0, 255);
+	}
+}
+
+TEST(BcCodec, Bc5HasTwoIndependentChannels)
+{
+	// Red in the 8 level mode and green in the 6 level one.
+	u8 block[16];
+	MakeBc4Block(200, 100, block);
+	MakeBc4Block(50, 150, block + 8);
+	u8 texels[64];
+	memset(texels, 0xCD, sizeof(texels));
+	EXPECT_TRUE(DecodeBcBlock(BcFormat::BC5, block, texels));
+
+	const u8 red[8] = { 200, 100, 185, 171, 157, 142, 128, 114 };
+	const u8 green[8] = { 50, 150, 70, 90, 110, 130, 0, 255 };
+	for (u32 i = 0; i < 16; ++i)
+	{
+		ExpectTexel(texels, i, red[i % 8], green[i % 8], 0, 255);
+	}
+}
+
+TEST(BcCodec, Bc7EveryModeMatchesTheReference)
+{
+	// Random blocks of each mode and what an independent decoder makes of them. The mode 4 and 5
+	// blocks rotate, and the mode 4 one swaps its index sets.
+	struct Bc7Vector
+	{
+		const char* m_Block;
+		const char* m_Texels;
+	};
+	const Bc7Vector vectors[8] =
+	{
+		// Mode 0, partition 2.
+		{ "a54dca182530bb1d6d132cded6237b2e",
+			"c676d8ffc676d8ff732fe5ffa55addff90b3aaffa55addff833de2ff528463ff6394b5ff81a9aeff4b7468ff4b7468ff90b3aaffbfd4a0ff44636cff211084ff" },
+		// Mode 1, partition 54.
+		{ "da1e3f721fcb1971174494d6493c9d5c",
+			"8983baff89640dff89640dffab92a3ffcfa28bffab92a3ff855716ff855716ff7c3d29fff1b174ffbe9b96ff74243bff89640dff89640dfff1b174ff9a8baeff" },
+		// Mode 2, partition 6.
+		{ "3460be31201e69fedaa0eee8b9997f5c",
+			"9cc937ffce8c42ff2fe35cff1bf282ff84e731ffce8c42ff08ffa5ff42d639ff8cce73ff8cce73ff8cce73ffbda5efff9cc19cff8cce73ff9cc19cffbda5efff" },
+		// Mode 3, partition 23.
+		{ "782999fdafe593253cd654af4dfad714",
+			"96325bffe77bafffd240b6fffbb3a9ff96325bff993fd7ffbe08bcffbe08bcff993fd7ff97399affd240b6ffe77bafff97399aff97399aff942c1efffbb3a9ff" },
+		// Mode 4, alpha swapped with red, index selection 1.
+		{ "b00becb5563bfc1e6f93427ecbc8fe29",
+			"7ecb5a4d0cde5a5a0ccb5a4d7e5a5a000c5a5a000c6d5a0db6b95a41446d5a0d0cde5a5a7ecb5a4d0ca65a34445a5a007e5a5a0044a65a34b6b95a417ecb5a4d" },
+		// Mode 5, alpha swapped with red.
+		{ "60e5cd8e46dc8ed4b7c2764d2a5a4d76",
+			"6871989ab06da867b071989a2371989ab071989ab07689cb686da8676871989a6868b736f56da8672368b736686da867b06da8676871989af56da867687689cb" },
+		// Mode 6.
+		{ "4006f85d8690024ad6bda3401be9c8cb",
+			"3ada2820a8cd427fa8cd427f93cf3d6d3ada282089d13b6418de200245d92b2993cf3d6d23dd230b7cd23859b6cb468b71d335509ece407693cf3d6d9ece4076" },
+		// Mode 7, partition 9.
+		{ "80c935f6cd1f61226ae15338ae1a3400",
+			"8dba3c958dba3c95a1895567a18955678dba3c957d865de7b28a5128b28a51288e8759a88e8759a8a1895567b28a5128b28a5128b28a5128b28a5128b28a5128" },
+	};
+
+	for (u32 mode = 0; mode < 8; ++mode)
+	{
+		SCOPED_TRACE(mode);
+		const std::vector<u8> block = FromHex(vectors[mode].m_Block);
+		const std::vector<u8> expected = FromHex(vectors[mode].m_Texels);
+		ASSERT_EQ(block.size(), 16u);
+		ASSERT_EQ(expected.size(), 64u);
+
+		u8 texels[64];
+		EXPECT_TRUE(DecodeBcBlock(BcFormat::BC7, block.data(), texels));
+		for (u32 i = 0; i < 16; ++i)
+		{
+			const u8* texel = expected.data() + i * 4;
+			ExpectTexel(texels, i, texel[0], texel[1], texel[2], texel[3]);
+		}
+	}
+}
+
+TEST(BcCodec, Bc7ReservedModeDecodesToZero)
+{
+	// No mode bit in the first byte, whatever follows.
+	u8 block[16];
+	for (u32 i = 0; i < 16; ++i)
+	{
+		block[i] = (u8)(i == 0 ? 0 : 0xA5 + i);
+	}
+	u8 texels[64];
+	memset(texels, 0xCD, sizeof(texels));
+	EXPECT_FALSE(DecodeBcBlock(BcFormat::BC7, block, texels));
+	for (u32 i = 0; i < 16; ++i)
+	{
+		ExpectTexel(texels, i, 0, 0, 0, 0);
+	}
+}
+
+TEST(BcCodec, EncodedAssetsStayAboveThePsnrFloor)
+{
+	// Over the stored channels of every asset texture, about 2 dB below the worst texture today,
+	// which for every format but BC4 and BC5 is one of the normal maps.
+	struct Floor
+	{
+		BcFormat m_Format;
+		u32 m_ChannelCount;
+		double m_MinPsnr;
+	};
+	const Floor floors[] =
+	{
+		{ BcFormat::BC1, 3, 26.5 },
+		{ BcFormat::BC2, 4, 27.5 },
+		{ BcFormat::BC3, 4, 27.5 },
+		{ BcFormat::BC4, 1, 38.0 },
+		{ BcFormat::BC5, 2, 37.5 },
+		{ BcFormat::BC7, 4, 26.5 },
+	};
+
+	JobSystem jobSystem(3);
+	u32 textureCount = 0;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator("Assets/Textures"))
+	{
+		DdsFile dds;
+		std::vector<u8> pixels;
+		if (entry.path().extension() != ".dds" || dds.Open(entry.path()) != DdsError::None || !ReadDdsTextureRgba(dds, pixels))
+		{
+			continue;
+		}
+		++textureCount;
+
+		const u32 width = dds.GetDesc().m_Width;
+		const u32 height = dds.GetDesc().m_Height;
+		for (const Floor& floor : floors)
+		{
+			const u32 blockRowPitch = ((width + 3) / 4) * GetBcBlockSize(floor.m_Format);
+			std::vector<u8> blocks((size_t)blockRowPitch * ((height + 3) / 4));
+			std::vector<u8> decoded(pixels.size());
+			EncodeBcImage(floor.m_Format, pixels.data(), width, height, width * 4, blocks.data(), blockRowPitch, &jobSystem);
+			DecodeBcImage(floor.m_Format, blocks.data(), blockRowPitch, width, height, decoded.data(), width * 4, &jobSystem);
+
+			const double psnr = GetPsnr(pixels, decoded, floor.m_ChannelCount);
+			EXPECT_GE(psnr, floor.m_MinPsnr) << entry.path().filename().string() << " format " << (u32)floor.m_Format;
+		}
+	}
+	EXPECT_GT(textureCount, 0u);
+}
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "JobSystem.h"
+#include "TextureCooker.h"
+#include "VirtualTexturePageTable.h"
+
+// The benchmarks WinMain runs for its flags, for machines without the Windows build. Takes the same
+// flags, prints each report and writes it to the same file the engine does.
+
+namespace
+{
+	struct Benchmark
+	{
+		const char* m_Flag;
+		const char* m_ReportFile;
+		void (*m_Run)(std::string& report);
+	};
+
+	void RunTextureBenchmark(std::string& report)
+	{
+		JobSystem jobSystem;
+		RunTextureCookerBenchmark("Assets/Textures", &jobSystem, report);
+	}
+
+	void RunDecodeBenchmark(std::string& report)
+	{
+		JobSystem jobSystem;
+		RunBcDecodeBenchmark("Assets/Textures", &jobSystem, report);
+	}
+
+	const Benchmark c_Benchmarks[] =
+	{
+		{ "-texturebenchmark", "TextureCookerBenchmark.txt", RunTextureBenchmark },
+		{ "-bcdecodebenchmark", "BcDecodeBenchmark.txt", RunDecodeBenchmark },
+		{ "-vtbenchmark", "VirtualTextureBenchmark.txt", RunVirtualTextureBenchmark },
+	};
+}
+
+int main(int argc, char** argv)
+{
+	u32 runCount = 0;
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		for (const Benchmark& benchmark : c_Benchmarks)
+		{
+			if (strcmp(argv[arg], benchmark.m_Flag) == 0)
+			{
+				std::string report;
+				benchmark.m_Run(report);
+				fputs(report.c_str(), stdout);
+
+				std::ofstream file(benchmark.m_ReportFile);
+				file << report;
+				++runCount;
+			}
+		}
+	}
+
+	if (runCount == 0)
+	{
+		fprintf(stderr, "Usage: %s", argv[0]);
+		for (const Benchmark& benchmark : c_Benchmarks)
+		{
+			fprintf(stderr, " [%s]", benchmark.m_Flag);
+		}
+		fprintf(stderr, "\nRun from the engine project directory, assets are read relative to it.\n");
+		return 1;
+	}
+	return 0;
+}
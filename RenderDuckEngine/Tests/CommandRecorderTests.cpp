@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include <mutex>
+
+#include "CommandRecorder.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Records every task into a CPU-side list, so the order lists would be submitted in can be
+	// compared with the order the tasks were built in.
+	class MockCommandListRecorder : public ICommandListRecorder
+	{
+	public:
+		explicit MockCommandListRecorder(u32 workerCount) : m_WorkerBusy(workerCount) {}
+
+		void RecordCommandList(u32 workerIndex, u32 listIndex, const RecordTask& task) override
+		{
+			ASSERT_LT(workerIndex, m_WorkerBusy.size());
+			EXPECT_EQ(m_WorkerBusy[workerIndex].fetch_add(1), 0u) << "worker " << workerIndex << " recorded two lists at once";
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				if (m_Lists.size() <= listIndex)
+				{
+					m_Lists.resize(listIndex + 1);
+				}
+				m_Lists[listIndex].push_back(task);
+			}
+			m_WorkerBusy[workerIndex].fetch_sub(1);
+		}
+
+		void SubmitRecordedLists(u32 listCount) override
+		{
+			m_SubmittedCounts.push_back(listCount);
+		}
+
+		std::vector<std::atomic<u32>> m_WorkerBusy;
+		std::mutex m_Mutex;
+
+		// The tasks recorded into each list, one per list when the recorder works.
+		std::vector<std::vector<RecordTask>> m_Lists;
+		std::vector<u32> m_SubmittedCounts;
+	};
+
+	std::vector<RecordTask> GetPassTasks(const std::vector<RecordTask>& tasks, u32 passIndex)
+	{
+		std::vector<RecordTask> passTasks;
+		for (const RecordTask& task : tasks)
+		{
+			if (task.m_PassIndex == passIndex)
+			{
+				passTasks.push_back(task);
+			}
+		}
+		return passTasks;
+	}
+}
+
+TEST(ParallelCommandRecorder, SplitsPassesIntoEvenTasks)
+{
+	// Four threads record, so no pass is split into more than four tasks.
+	JobSystem jobSystem(3);
+	ParallelCommandRecorder recorder(&jobSystem);
+	ASSERT_EQ(recorder.GetMaxTasksPerPass(), 4u);
+
+	recorder.BeginFrame();
+	const u32 whole = recorder.AddPass("Whole", 1000);
+	const u32 split = recorder.AddPass("Split", 10, 3);
+	const u32 small = recorder.AddPass("Small", 3, 3);
+	const u32 capped = recorder.AddPass("Capped", 103, 1);
+	const std::vector<RecordTask>& tasks = recorder.BuildTasks();
+	ASSERT_EQ(tasks.size(), 1u + 4u + 1u + 4u);
+
+	const std::vector<RecordTask> wholeTasks = GetPassTasks(tasks, whole);
+	ASSERT_EQ(wholeTasks.size(), 1u);
+	EXPECT_EQ(wholeTasks[0].m_ItemCount, 1000u);
+
+	// 10 items at 3 or more per task makes four tasks, the remainder going to the first two.
+	const std::vector<RecordTask> splitTasks = GetPassTasks(tasks, split);
+	const u32 splitCounts[] = { 3, 3, 2, 2 };
+	ASSERT_EQ(splitTasks.size(), 4u);
+	u32 firstItem = 0;
+	for (u32 t = 0; t < 4; ++t)
+	{
+		EXPECT_EQ(splitTasks[t].m_FirstItem, firstItem);
+		EXPECT_EQ(splitTasks[t].m_ItemCount, splitCounts[t]);
+		firstItem += splitTasks[t].m_ItemCount;
+	}
+
+	// A pass no larger than the minimum stays whole.
+	EXPECT_EQ(GetPassTasks(tasks, small).size(), 1u);
+
+	// 103 single items would make 103 tasks, the cap leaves four of 26, 26, 26 and 25.
+	const std::vector<RecordTask> cappedTasks = GetPassTasks(tasks, capped);
+	const u32 cappedCounts[] = { 26, 26, 26, 25 };
+	ASSERT_EQ(cappedTasks.size(), 4u);
+	for (u32 t = 0; t < 4; ++t)
+	{
+		EXPECT_EQ(cappedTasks[t].m_ItemCount, cappedCounts[t]);
+	}
+}
+
+TEST(ParallelCommandRecorder, OnlyTheEndsOfAPassAreMarked)
+{
+	JobSystem jobSystem(3);
+	ParallelCommandRecorder recorder(&jobSystem);
+	recorder.BeginFrame();
+	recorder.AddPass("Single", 5);
+	recorder.AddPass("Split", 9, 3);
+	recorder.AddPass("Empty", 0, 3);
+	const std::vector<RecordTask>& tasks = recorder.BuildTasks();
+
+	const std::vector<RecordTask> single = GetPassTasks(tasks, 0);
+	ASSERT_EQ(single.size(), 1u);
+	EXPECT_TRUE(single[0].m_FirstInPass);
+	EXPECT_TRUE(single[0].m_LastInPass);
+
+	const std::vector<RecordTask> split = GetPassTasks(tasks, 1);
+	ASSERT_EQ(split.size(), 3u);
+	for (u32 t = 0; t < 3; ++t)
+	{
+		EXPECT_EQ(split[t].m_FirstInPass, t == 0);
+		EXPECT_EQ(split[t].m_LastInPass, t == 2);
+	}
+
+	// An empty pass still gets a list, for its barriers and clears.
+	const std::vector<RecordTask> empty = GetPassTasks(tasks, 2);
+	ASSERT_EQ(empty.size(), 1u);
+	EXPECT_EQ(empty[0].m_ItemCount, 0u);
+	EXPECT_TRUE(empty[0].m_FirstInPass);
+	EXPECT_TRUE(empty[0].m_LastInPass);
+}
+
+TEST(ParallelCommandRecorder, ListsFollowTaskOrder)
+{
+	JobSystem jobSystem(3);
+	ParallelCommandRecorder recorder(&jobSystem);
+	MockCommandListRecorder mock(jobSystem.GetWorkerCount());
+
+	for (u32 frame = 0; frame < 50; ++frame)
+	{
+		mock.m_Lists.clear();
+		recorder.BeginFrame();
+		recorder.AddPass("Shadow", 40 + frame, 8);
+		recorder.AddPass("Clear", 0);
+		recorder.AddPass("Main", 200 + frame * 3, 16);
+		recorder.AddPass("Empty", 0, 16);
+		recorder.AddPass("UI", 1);
+		recorder.Record(mock);
+
+		// Every task is recorded exactly once, into the list with its own index, and the
+		// lists come out in pass order whichever worker finished first.
+		const std::vector<RecordTask>& tasks = recorder.GetTasks();
+		ASSERT_EQ(mock.m_SubmittedCounts.back(), (u32)tasks.size());
+		ASSERT_EQ(mock.m_Lists.size(), tasks.size());
+		u32 previousPass = 0;
+		for (u32 i = 0; i < (u32)tasks.size(); ++i)
+		{
+			ASSERT_EQ(mock.m_Lists[i].size(), 1u) << "list " << i;
+			const RecordTask& recorded = mock.m_Lists[i][0];
+			EXPECT_EQ(recorded.m_PassIndex, tasks[i].m_PassIndex);
+			EXPECT_EQ(recorded.m_FirstItem, tasks[i].m_FirstItem);
+			EXPECT_EQ(recorded.m_ItemCount, tasks[i].m_ItemCount);
+			EXPECT_GE(recorded.m_PassIndex, previousPass);
+			previousPass = recorded.m_PassIndex;
+		}
+		EXPECT_EQ(previousPass, 4u);
+	}
+	EXPECT_EQ(mock.m_SubmittedCounts.size(), 50u);
+}
+
+TEST(ParallelCommandRecorder, FramesOfOnlyEmptyPassesStillSubmit)
+{
+	JobSystem jobSystem(1);
+	ParallelCommandRecorder recorder(&jobSystem);
+	MockCommandListRecorder mock(jobSystem.GetWorkerCount());
+
+	recorder.BeginFrame();
+	recorder.AddPass("Clear", 0);
+	recorder.AddPass("Empty", 0, 4);
+	recorder.Record(mock);
+	ASSERT_EQ(mock.m_SubmittedCounts.size(), 1u);
+	EXPECT_EQ(mock.m_SubmittedCounts[0], 2u);
+	EXPECT_EQ(mock.m_Lists.size(), 2u);
+
+	// Nothing added, nothing recorded, but the submit still happens.
+	recorder.BeginFrame();
+	recorder.Record(mock);
+	ASSERT_EQ(mock.m_SubmittedCounts.size(), 2u);
+	EXPECT_EQ(mock.m_SubmittedCounts[1], 0u);
+}
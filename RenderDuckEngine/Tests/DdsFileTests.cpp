@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "DdsFile.h"
+
+namespace
+{
+	// Relative to the engine project directory, which the tests run from.
+	const char* c_TextureDirectory = "Assets/Textures";
+
+	std::vector<std::filesystem::path> FindTextures()
+	{
+		std::vector<std::filesystem::path> paths;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(c_TextureDirectory))
+		{
+			if (entry.path().extension() == ".dds")
+			{
+				paths.push_back(entry.path());
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	}
+
+	std::vector<u8> ReadFile(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<u8>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+}
+
+TEST(DdsFile, EveryAssetTextureParses)
+{
+	const std::vector<std::filesystem::path> paths = FindTextures();
+	EXPECT_EQ(paths.size(), 22u);
+
+	for (const std::filesystem::path& path : paths)
+	{
+		SCOPED_TRACE(path.string());
+		DdsFile dds;
+		const DdsError error = dds.Open(path);
+		ASSERT_EQ(error, DdsError::None) << GetDdsErrorString(error);
+
+		const DdsTextureDesc& desc = dds.GetDesc();
+		EXPECT_NE(desc.m_Format, DdsFormat::Unknown);
+		EXPECT_GT(desc.m_Width, 0u);
+		EXPECT_GT(desc.m_Height, 0u);
+		ASSERT_EQ(dds.GetSubresourceCount(), desc.m_ArraySize * desc.m_MipCount);
+
+		// The subresources follow each other and end exactly at the end of the file.
+		u64 offset = dds.GetSubresource(0, 0).m_Offset;
+		u64 dataSize = 0;
+		for (const DdsSubresource& subresource : dds.GetSubresources())
+		{
+			EXPECT_EQ(subresource.m_Offset, offset);
+			offset += subresource.m_SlicePitch * subresource.m_Depth;
+			dataSize += subresource.m_SlicePitch * subresource.m_Depth;
+		}
+		EXPECT_EQ(offset, std::filesystem::file_size(path));
+		EXPECT_EQ(dataSize, dds.GetDataSize());
+
+		// Parsing a copy in memory gives the same table.
+		const std::vector<u8> bytes = ReadFile(path);
+		DdsFile parsed;
+		ASSERT_EQ(parsed.Parse(bytes.data(), bytes.size()), DdsError::None);
+		ASSERT_EQ(parsed.GetSubresourceCount(), dds.GetSubresourceCount());
+		for (u32 i = 0; i < parsed.GetSubresourceCount(); ++i)
+		{
+			const DdsSubresource& mapped = dds.GetSubresources()[i];
+			const DdsSubresource& copy = parsed.GetSubresources()[i];
+			EXPECT_EQ(copy.m_Offset, mapped.m_Offset);
+			EXPECT_EQ(copy.m_RowPitch, mapped.m_RowPitch);
+			EXPECT_EQ(memcmp(copy.m_Data, mapped.m_Data, mapped.m_SlicePitch), 0);
+		}
+	}
+}
+
+TEST(DdsFile, TruncatedFilesAreRejected)
+{
+	for (const std::filesystem::path& path : FindTextures())
+	{
+		SCOPED_TRACE(path.string());
+		const std::vector<u8> bytes = ReadFile(path);
+
+		// Every cut through the headers, then a stride through the texels.
+		for (u64 size = 0; size < bytes.size(); size += size < 256 ? 1 : 997)
+		{
+			DdsFile dds;
+			ASSERT_NE(dds.Parse(bytes.data(), size), DdsError::None) << "accepted " << size << " bytes";
+			EXPECT_EQ(dds.GetSubresourceCount(), 0u);
+		}
+	}
+}
+
+TEST(DdsFile, CorruptHeadersAreRejected)
+{
+	const std::vector<u8> bytes = ReadFile(std::filesystem::path(c_TextureDirectory) / "bricks.dds");
+	ASSERT_FALSE(bytes.empty());
+
+	std::vector<u8> badMagic = bytes;
+	badMagic[0] = 'X';
+	DdsFile dds;
+	EXPECT_EQ(dds.Parse(badMagic.data(), badMagic.size()), DdsError::NotDds);
+
+	// Header size, after the magic.
+	std::vector<u8> badSize = bytes;
+	badSize[4] = 100;
+	EXPECT_EQ(dds.Parse(badSize.data(), badSize.size()), DdsError::BadHeader);
+
+	// More mips than the texture has room for, and more than the file holds.
+	std::vector<u8> tooManyMips = bytes;
+	const u32 mipCount = 30;
+	memcpy(&tooManyMips[4 + 24], &mipCount, sizeof(mipCount));
+	EXPECT_NE(dds.Parse(tooManyMips.data(), tooManyMips.size()), DdsError::None);
+}
@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+#include <thread>
+
+#include "DescriptorAllocator.h"
+#include "FakeGpuTimeline.h"
+
+TEST(DescriptorAllocator, FreedRangesWaitForTheGpu)
+{
+	FakeGpuTimeline timeline;
+	DescriptorAllocator allocator(10, 1, &timeline);
+
+	const DescriptorHandle first = allocator.Allocate(3);
+	const DescriptorHandle second = allocator.Allocate(4);
+	const DescriptorHandle third = allocator.Allocate(3);
+	EXPECT_EQ(first.m_Index, 0u);
+	EXPECT_EQ(second.m_Index, 3u);
+	EXPECT_EQ(third.m_Index, 7u);
+	EXPECT_FALSE(allocator.Allocate(1).IsValid());
+
+	// Not reused before it is committed, nor before the GPU reaches the fence.
+	allocator.Free(second);
+	EXPECT_FALSE(allocator.Allocate(1).IsValid());
+	allocator.Commit(5);
+	timeline.Complete(4);
+	EXPECT_FALSE(allocator.Allocate(1).IsValid());
+	timeline.Complete(5);
+
+	const DescriptorHandle reused = allocator.Allocate(4);
+	EXPECT_EQ(reused.m_Index, 3u);
+	EXPECT_EQ(allocator.GetAllocatedCount(), 10u);
+
+	// Neighbouring frees merge back into one range.
+	allocator.Free(first);
+	allocator.Free(third);
+	allocator.Free(reused);
+	allocator.Commit(6);
+	timeline.Complete(6);
+	EXPECT_EQ(allocator.Allocate(10).m_Index, 0u);
+}
+
+TEST(DescriptorAllocator, HandlesGoStaleWhenFreed)
+{
+	FakeGpuTimeline timeline;
+	DescriptorAllocator allocator(4, 1, &timeline);
+
+	const DescriptorHandle handle = allocator.Allocate(4);
+	EXPECT_TRUE(allocator.IsLive(handle));
+	EXPECT_EQ(allocator.FindHandle(0).m_Count, 4u);
+	EXPECT_FALSE(allocator.FindHandle(1).IsValid());
+
+	allocator.Free(handle);
+	EXPECT_FALSE(allocator.IsLive(handle));
+	EXPECT_FALSE(allocator.FindHandle(0).IsValid());
+
+	allocator.Commit(1);
+	timeline.Complete(1);
+	const DescriptorHandle reused = allocator.Allocate(4);
+	EXPECT_EQ(reused.m_Index, handle.m_Index);
+	EXPECT_FALSE(allocator.IsLive(handle));
+	EXPECT_TRUE(allocator.IsLive(reused));
+}
+
+TEST(DescriptorAllocator, RangesNeverSpanShards)
+{
+	// Shards of 3, 3 and 4 indices.
+	FakeGpuTimeline timeline;
+	DescriptorAllocator allocator(10, 3, &timeline);
+
+	std::set<u32> indices;
+	for (u32 i = 0; i < 10; ++i)
+	{
+		const DescriptorHandle handle = allocator.Allocate(1);
+		ASSERT_TRUE(handle.IsValid());
+		indices.insert(handle.m_Index);
+	}
+	EXPECT_EQ(indices.size(), 10u);
+
+	for (u32 index : indices)
+	{
+		allocator.Free(allocator.FindHandle(index));
+	}
+	allocator.Commit(1);
+	timeline.Complete(1);
+	EXPECT_TRUE(allocator.Allocate(4).IsValid());
+	EXPECT_FALSE(allocator.Allocate(4).IsValid());
+	EXPECT_TRUE(allocator.Allocate(3).IsValid());
+}
+
+// Meant to be run under -DSANITIZE=thread or address as well. Threads allocate and free while the
+// frame loop commits and a GPU two frames behind retires, checking that no index is handed out twice
+// and that no range is reused before the GPU has finished the frame it was freed in.
+TEST(DescriptorAllocator, ThreadsNeverShareOrReuseTooEarly)
+{
+	const u32 c_Capacity = 4096;
+	const u32 c_ThreadCount = 8;
+	const u32 c_Iterations = 20000;
+	const u64 c_GpuLag = 2;
+
+	FakeGpuTimeline timeline;
+	DescriptorAllocator allocator(c_Capacity, 8, &timeline);
+
+	// Per index, how many live handles cover it and the fence the GPU must reach before it is reused.
+	std::vector<std::atomic<u32>> owners(c_Capacity);
+	std::vector<std::atomic<u64>> reusableAt(c_Capacity);
+	std::atomic<u64> committed = 0;
+	std::atomic<u32> sharedIndices = 0;
+	std::atomic<u32> earlyReuses = 0;
+	std::atomic<u32> staleHandles = 0;
+	std::atomic<u32> runningThreads = c_ThreadCount;
+
+	std::vector<std::thread> threads;
+	for (u32 thread = 0; thread < c_ThreadCount; ++thread)
+	{
+		threads.emplace_back([&, thread]()
+		{
+			std::mt19937 random(thread);
+			std::vector<DescriptorHandle> handles;
+			auto freeLast = [&]()
+			{
+				const DescriptorHandle handle = handles.back();
+				handles.pop_back();
+				staleHandles += !allocator.IsLive(handle);
+
+				// Free takes the fence of the commit after this one at the earliest.
+				const u64 fence = committed.load() + 1;
+				for (u32 i = handle.m_Index; i < handle.m_Index + handle.m_Count; ++i)
+				{
+					owners[i].fetch_sub(1);
+					reusableAt[i].store(fence);
+				}
+				allocator.Free(handle);
+			};
+
+			for (u32 iteration = 0; iteration < c_Iterations; ++iteration)
+			{
+				if (handles.size() < 40 && random() % 3 != 0)
+				{
+					const DescriptorHandle handle = allocator.Allocate(1 + random() % 7);
+					if (!handle.IsValid())
+					{
+						continue;
+					}
+
+					const u64 completed = timeline.GetCompletedValue();
+					for (u32 i = handle.m_Index; i < handle.m_Index + handle.m_Count; ++i)
+					{
+						sharedIndices += owners[i].fetch_add(1) != 0;
+						earlyReuses += reusableAt[i].load() > completed;
+					}
+					handles.push_back(handle);
+				}
+				else if (!handles.empty())
+				{
+					freeLast();
+				}
+			}
+			while (!handles.empty())
+			{
+				freeLast();
+			}
+			runningThreads.fetch_sub(1);
+		});
+	}
+
+	for (u64 frame = 1; runningThreads.load() > 0; ++frame)
+	{
+		allocator.Commit(frame);
+		committed.store(frame);
+		if (frame > c_GpuLag)
+		{
+			timeline.Complete(frame - c_GpuLag);
+		}
+		std::this_thread::yield();
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(sharedIndices.load(), 0u);
+	EXPECT_EQ(earlyReuses.load(), 0u);
+	EXPECT_EQ(staleHandles.load(), 0u);
+	EXPECT_EQ(allocator.GetAllocatedCount(), 0u);
+
+	// Everything comes back whole once the GPU catches up.
+	allocator.Commit(committed.load() + 1);
+	timeline.Complete(committed.load() + 1);
+	for (u32 shard = 0; shard < 8; ++shard)
+	{
+		EXPECT_TRUE(allocator.Allocate(c_Capacity / 8).IsValid());
+	}
+}
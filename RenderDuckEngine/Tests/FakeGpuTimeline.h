@@ -0,0 +1,26 @@
+#pragma once
+#include "GpuTimeline.h"
+
+#include <atomic>
+#include <thread>
+
+// A timeline the test advances by hand. Wait only returns once the test has got that far, so a
+// test that waits must advance it from another thread.
+class FakeGpuTimeline : public IGpuTimeline
+{
+public:
+	u64 GetCompletedValue() const override { return m_Completed.load(std::memory_order_acquire); }
+
+	void Wait(u64 value) override
+	{
+		while (GetCompletedValue() < value)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void Complete(u64 value) { m_Completed.store(value, std::memory_order_release); }
+
+private:
+	std::atomic<u64> m_Completed = 0;
+};
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "FakeGpuTimeline.h"
+#include "FramePacer.h"
+
+namespace
+{
+	// A GPU that only makes progress when the CPU waits on it, and then gets exactly as far as the
+	// fence waited on. Records every wait so tests can check which frame the pacer retired.
+	class RecordingGpuTimeline : public FakeGpuTimeline
+	{
+	public:
+		void Wait(u64 value) override
+		{
+			m_Waits.push_back(value);
+			if (m_WaitTime.count() > 0)
+			{
+				std::this_thread::sleep_for(m_WaitTime);
+			}
+			Complete(value);
+			FakeGpuTimeline::Wait(value);
+		}
+
+		std::vector<u64> m_Waits;
+		std::chrono::milliseconds m_WaitTime = std::chrono::milliseconds(0);
+	};
+
+	// One frame as the renderer drives it, signalling the frame's number plus one.
+	void RunFrame(FramePacer& pacer)
+	{
+		pacer.BeginFrame();
+		pacer.WaitForFrameResources();
+		pacer.EndFrame(pacer.GetFrameNumber() + 1);
+	}
+}
+
+TEST(FramePacer, MaxFramesInFlightIsClampedToTheSlots)
+{
+	FakeGpuTimeline timeline;
+	FramePacer pacer(&timeline, 3);
+	EXPECT_EQ(pacer.GetMaxFramesInFlight(), 3u);
+
+	pacer.SetMaxFramesInFlight(0);
+	EXPECT_EQ(pacer.GetMaxFramesInFlight(), 1u);
+	pacer.SetMaxFramesInFlight(2);
+	EXPECT_EQ(pacer.GetMaxFramesInFlight(), 2u);
+	pacer.SetMaxFramesInFlight(5);
+	EXPECT_EQ(pacer.GetMaxFramesInFlight(), 3u);
+}
+
+TEST(FramePacer, WaitsForTheFrameMaxFramesInFlightBack)
+{
+	for (u32 maxFrames = 1; maxFrames <= 3; ++maxFrames)
+	{
+		SCOPED_TRACE(maxFrames);
+		RecordingGpuTimeline timeline;
+		FramePacer pacer(&timeline, 3);
+		pacer.SetMaxFramesInFlight(maxFrames);
+
+		// Frame n signals n + 1 and has to wait for frame n - maxFrames, once there is one.
+		for (u64 frame = 0; frame < 10; ++frame)
+		{
+			EXPECT_EQ(pacer.GetFrameResourceIndex(), frame % 3);
+			const size_t waitsBefore = timeline.m_Waits.size();
+			RunFrame(pacer);
+			if (frame < maxFrames)
+			{
+				EXPECT_EQ(timeline.m_Waits.size(), waitsBefore) << "frame " << frame;
+			}
+			else
+			{
+				ASSERT_EQ(timeline.m_Waits.size(), waitsBefore + 1) << "frame " << frame;
+				EXPECT_EQ(timeline.m_Waits.back(), frame - maxFrames + 1) << "frame " << frame;
+			}
+		}
+	}
+
+	// Nothing to wait for when the GPU is already there.
+	RecordingGpuTimeline timeline;
+	FramePacer pacer(&timeline, 3);
+	pacer.SetMaxFramesInFlight(1);
+	for (u64 frame = 0; frame < 10; ++frame)
+	{
+		timeline.Complete(frame);
+		RunFrame(pacer);
+	}
+	EXPECT_TRUE(timeline.m_Waits.empty());
+	EXPECT_EQ(pacer.GetStats().m_FramesWaited, 0u);
+}
+
+TEST(FramePacer, LowLatencyModeWaitsBeforeInput)
+{
+	RecordingGpuTimeline timeline;
+	FramePacer pacer(&timeline, 2);
+	pacer.SetMaxFramesInFlight(1);
+	RunFrame(pacer);
+
+	// Normally the wait comes after input is sampled in BeginFrame.
+	pacer.BeginFrame();
+	EXPECT_TRUE(timeline.m_Waits.empty());
+	pacer.WaitForFrameResources();
+	EXPECT_EQ(timeline.m_Waits.size(), 1u);
+	pacer.EndFrame(2);
+
+	// In low latency mode BeginFrame waits, and WaitForFrameResources does not wait again.
+	pacer.SetLowLatencyMode(true);
+	pacer.BeginFrame();
+	EXPECT_EQ(timeline.m_Waits.size(), 2u);
+	EXPECT_EQ(timeline.m_Waits.back(), 2u);
+	pacer.WaitForFrameResources();
+	EXPECT_EQ(timeline.m_Waits.size(), 2u);
+	pacer.EndFrame(3);
+}
+
+TEST(FramePacer, WaitHistoryAveragesTheFramesSoFar)
+{
+	RecordingGpuTimeline timeline;
+	timeline.m_WaitTime = std::chrono::milliseconds(2);
+	FramePacer pacer(&timeline, 2);
+	pacer.SetMaxFramesInFlight(1);
+
+	// Frame 0 has nothing to wait for, then odd frames wait and even ones find the GPU done.
+	const u32 c_FrameCount = 10;
+	for (u64 frame = 0; frame < c_FrameCount; ++frame)
+	{
+		if (frame % 2 == 0)
+		{
+			timeline.Complete(frame);
+		}
+		RunFrame(pacer);
+	}
+	EXPECT_EQ(timeline.m_Waits.size(), 5u);
+
+	// Only ten frames are in the history so far, so the average is over those ten.
+	const FramePacingStats& stats = pacer.GetStats();
+	const float* history = pacer.GetWaitHistory();
+	float total = 0.0f;
+	float maxWait = 0.0f;
+	for (u32 i = 0; i < c_FrameCount; ++i)
+	{
+		if (i % 2 == 1)
+		{
+			EXPECT_GE(history[i], 2.0f) << "frame " << i;
+		}
+		else
+		{
+			EXPECT_EQ(history[i], 0.0f) << "frame " << i;
+		}
+		total += history[i];
+		maxWait = std::max(maxWait, history[i]);
+	}
+	EXPECT_EQ(stats.m_FramesWaited, 5u);
+	EXPECT_FLOAT_EQ(stats.m_AverageWaitMs, total / c_FrameCount);
+	EXPECT_FLOAT_EQ(stats.m_MaxWaitMs, maxWait);
+	EXPECT_FLOAT_EQ(stats.m_LastWaitMs, history[c_FrameCount - 1]);
+	EXPECT_EQ(pacer.GetWaitHistoryOffset(), c_FrameCount);
+
+	FramePacingReport report;
+	pacer.FillReport(report);
+	EXPECT_EQ(report.m_Stats.m_FramesWaited, 5u);
+	EXPECT_EQ(report.m_WaitHistoryOffset, c_FrameCount);
+	EXPECT_EQ(report.m_FrameResourceCount, 2u);
+	EXPECT_EQ(report.m_WaitHistoryMs[1], history[1]);
+
+	// Once the history is full the oldest frames drop out of the stats.
+	timeline.m_WaitTime = std::chrono::milliseconds(0);
+	for (u64 frame = c_FrameCount; frame < FramePacer::c_WaitHistoryLength + c_FrameCount; ++frame)
+	{
+		timeline.Complete(frame);
+		RunFrame(pacer);
+	}
+	EXPECT_EQ(pacer.GetStats().m_FramesWaited, 0u);
+	EXPECT_EQ(pacer.GetStats().m_MaxWaitMs, 0.0f);
+	EXPECT_EQ(pacer.GetWaitHistoryOffset(), c_FrameCount);
+}
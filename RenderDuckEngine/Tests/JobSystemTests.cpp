@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <set>
+
+#include "JobSystem.h"
+
+namespace
+{
+	// Records which worker indices run jobs at the same time, so tests can check no two share one.
+	struct WorkerIndexTracker
+	{
+		explicit WorkerIndexTracker(u32 workerCount) : m_Busy(workerCount) {}
+
+		void Enter(u32 workerIndex)
+		{
+			ASSERT_LT(workerIndex, m_Busy.size());
+			EXPECT_EQ(m_Busy[workerIndex].fetch_add(1), 0u) << "worker index " << workerIndex << " used twice at once";
+		}
+
+		void Leave(u32 workerIndex) { m_Busy[workerIndex].fetch_sub(1); }
+
+		std::vector<std::atomic<u32>> m_Busy;
+	};
+}
+
+TEST(JobSystem, RunsEveryJobOfARange)
+{
+	JobSystem jobSystem(3);
+	std::vector<std::atomic<u32>> runs(1000);
+	JobCounter counter;
+	jobSystem.DispatchRange(counter, (u32)runs.size(), [&](u32 index, u32) { runs[index].fetch_add(1); });
+	jobSystem.Wait(counter);
+
+	for (const std::atomic<u32>& run : runs)
+	{
+		EXPECT_EQ(run.load(), 1u);
+	}
+}
+
+TEST(JobSystem, ManyThreadsCanWaitAtOnce)
+{
+	// More waiting threads than scratch indices, the ones left without one sleep.
+	JobSystem jobSystem(2);
+	WorkerIndexTracker tracker(jobSystem.GetWorkerCount());
+	std::atomic<u32> runs = 0;
+
+	std::vector<std::thread> threads;
+	for (u32 i = 0; i < 8; ++i)
+	{
+		threads.emplace_back([&]()
+		{
+			for (u32 round = 0; round < 50; ++round)
+			{
+				JobCounter counter;
+				jobSystem.DispatchRange(counter, 20, [&](u32, u32 workerIndex)
+				{
+					tracker.Enter(workerIndex);
+					runs.fetch_add(1);
+					tracker.Leave(workerIndex);
+				});
+				jobSystem.Wait(counter);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(runs.load(), 8u * 50u * 20u);
+}
+
+TEST(JobSystemDeathTest, JobsMustNotWait)
+{
+	EXPECT_DEATH(
+	{
+		JobSystem jobSystem(1);
+		JobCounter outer;
+		jobSystem.Dispatch(outer, [&](u32)
+		{
+			JobCounter inner;
+			jobSystem.Dispatch(inner, [](u32) {});
+			jobSystem.Wait(inner);
+		});
+		jobSystem.Wait(outer);
+	}, "Jobs must not wait");
+}
+
+TEST(JobSystem, OtherThreadsHelpWhileWaiting)
+{
+	// One worker is held busy, so the jobs can only finish if the foreign thread runs them.
+	JobSystem jobSystem(1);
+	WorkerIndexTracker tracker(jobSystem.GetWorkerCount());
+	std::mutex blockMutex;
+	std::unique_lock<std::mutex> block(blockMutex);
+
+	JobCounter blocker;
+	std::atomic<bool> blocked = false;
+	jobSystem.Dispatch(blocker, [&](u32)
+	{
+		blocked = true;
+		std::lock_guard<std::mutex> lock(blockMutex);
+	});
+	while (!blocked)
+	{
+		std::this_thread::yield();
+	}
+
+	std::set<u32> helperIndices;
+	std::thread helper([&]()
+	{
+		JobCounter counter;
+		std::mutex indicesMutex;
+		jobSystem.DispatchRange(counter, 32, [&](u32, u32 workerIndex)
+		{
+			tracker.Enter(workerIndex);
+			{
+				std::lock_guard<std::mutex> lock(indicesMutex);
+				helperIndices.insert(workerIndex);
+			}
+			tracker.Leave(workerIndex);
+		});
+		jobSystem.Wait(counter);
+	});
+	helper.join();
+
+	block.unlock();
+	jobSystem.Wait(blocker);
+
+	// The helper ran them under a scratch index, after the worker threads' and the owner's.
+	ASSERT_FALSE(helperIndices.empty());
+	for (u32 workerIndex : helperIndices)
+	{
+		EXPECT_GE(workerIndex, jobSystem.GetThreadCount());
+		EXPECT_LT(workerIndex, jobSystem.GetWorkerCount());
+	}
+}
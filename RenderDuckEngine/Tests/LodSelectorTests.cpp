@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include "LodSelector.h"
+
+namespace
+{
+	// Four levels of 100, 40, 20 and 10 triangles. With a projection scale of 100 and a threshold
+	// of one pixel, level l is good enough from a distance of 100 times its error: 1, 4 and 10.
+	LodSet MakeLodSet(u32 levelCount = 4)
+	{
+		const u32 triangles[] = { 100, 40, 20, 10 };
+		const float errors[] = { 0.0f, 0.01f, 0.04f, 0.1f };
+
+		LodSet set;
+		for (u32 level = 0; level < levelCount; ++level)
+		{
+			LodLevel lodLevel;
+			lodLevel.m_DrawArgs.m_IndexCount = triangles[level] * 3;
+			lodLevel.m_DrawArgs.m_StartIndexLocation = level * 1000;
+			lodLevel.m_GeometricError = errors[level];
+			set.m_Levels.push_back(lodLevel);
+		}
+		return set;
+	}
+
+	LodViewParams MakeParams(float hysteresis = 0.0f)
+	{
+		LodViewParams params;
+		params.m_EyePosW = { 0.0f, 0.0f, 0.0f };
+		params.m_ProjectionScale = 100.0f;
+		params.m_ErrorThreshold = 1.0f;
+		params.m_Hysteresis = hysteresis;
+		return params;
+	}
+
+	// A point item straight ahead of the eye.
+	void PlaceItem(LodSelector& selector, u32 item, float distance)
+	{
+		selector.SetItemBounds(item, { 0.0f, 0.0f, distance }, 0.0f, 1.0f);
+	}
+}
+
+TEST(LodSelector, PicksTheCoarsestLevelUnderTheThreshold)
+{
+	const LodSet set = MakeLodSet();
+	LodSelector selector;
+
+	// Six items, so the second group of four is padded.
+	const float distances[] = { 0.5f, 2.0f, 5.0f, 20.0f, 0.0f, 3.9f };
+	const u32 expected[] = { 0, 1, 2, 3, 0, 1 };
+	for (u32 i = 0; i < 6; ++i)
+	{
+		EXPECT_EQ(selector.AddItem(&set), i);
+		PlaceItem(selector, i, distances[i]);
+	}
+
+	selector.Select(LodView::Main, MakeParams());
+	u32 selectedTriangles = 0;
+	for (u32 i = 0; i < 6; ++i)
+	{
+		EXPECT_EQ(selector.GetSelectedLevel(LodView::Main, i), expected[i]) << "item " << i;
+		EXPECT_EQ(selector.GetSelectedDrawArgs(LodView::Main, i).m_StartIndexLocation, expected[i] * 1000);
+		selectedTriangles += set.m_Levels[expected[i]].m_DrawArgs.m_IndexCount / 3;
+	}
+
+	const LodStats& stats = selector.GetStats(LodView::Main);
+	EXPECT_EQ(stats.m_FullDetailTriangles, 600u);
+	EXPECT_EQ(stats.m_SelectedTriangles, selectedTriangles);
+	EXPECT_EQ(stats.GetTrianglesSaved(), 600u - selectedTriangles);
+
+	// Items count from the nearest point of their bounds, so a large one refines early.
+	selector.SetItemBounds(3, { 0.0f, 0.0f, 20.0f }, 19.5f, 1.0f);
+	selector.Select(LodView::Main, MakeParams());
+	EXPECT_EQ(selector.GetSelectedLevel(LodView::Main, 3), 0u);
+
+	// And the world scale grows the error.
+	selector.SetItemBounds(3, { 0.0f, 0.0f, 20.0f }, 0.0f, 4.0f);
+	selector.Select(LodView::Main, MakeParams());
+	EXPECT_EQ(selector.GetSelectedLevel(LodView::Main, 3), 2u);
+}
+
+TEST(LodSelector, HysteresisStopsFlickerAtABoundary)
+{
+	// With 20% hysteresis level 1 is taken from a distance of 1.25 and kept down to 1.
+	const LodSet set = MakeLodSet();
+	LodSelector selector;
+	selector.AddItem(&set);
+	const LodViewParams params = MakeParams(0.2f);
+
+	// Wobbling inside the band from below never switches to the coarser level.
+	for (u32 frame = 0; frame < 20; ++frame)
+	{
+		PlaceItem(selector, 0, frame % 2 == 0 ? 0.95f : 1.2f);
+		selector.Select(LodView::Main, params);
+		ASSERT_EQ(selector.GetSelectedLevel(LodView::Main, 0), 0u) << "frame " << frame;
+	}
+
+	PlaceItem(selector, 0, 1.3f);
+	selector.Select(LodView::Main, params);
+	EXPECT_EQ(selector.GetSelectedLevel(LodView::Main, 0), 1u);
+
+	// Nor, once there, does wobbling inside it switch back.
+	for (u32 frame = 0; frame < 20; ++frame)
+	{
+		PlaceItem(selector, 0, frame % 2 == 0 ? 1.05f : 1.2f);
+		selector.Select(LodView::Main, params);
+		ASSERT_EQ(selector.GetSelectedLevel(LodView::Main, 0), 1u) << "frame " << frame;
+	}
+
+	PlaceItem(selector, 0, 0.9f);
+	selector.Select(LodView::Main, params);
+	EXPECT_EQ(selector.GetSelectedLevel(LodView::Main, 0), 0u);
+
+	// Without hysteresis the same wobble across the threshold flips every frame.
+	u32 flips = 0;
+	u32 previous = 0;
+	for (u32 frame = 0; frame < 20; ++frame)
+	{
+		PlaceItem(selector, 0, frame % 2 == 0 ? 0.95f : 1.05f);
+		selector.Select(LodView::Main, MakeParams());
+		flips += selector.GetSelectedLevel(LodView::Main, 0) != previous;
+		previous = selector.GetSelectedLevel(LodView::Main, 0);
+	}
+	EXPECT_EQ(flips, 19u);
+}
+
+TEST(LodSelector, ShadowBiasAddsLevelsUpToTheCoarsest)
+{
+	const LodSet set = MakeLodSet();
+	const LodSet twoLevels = MakeLodSet(2);
+	LodSelector selector;
+	selector.AddItem(&set);
+	selector.AddItem(&set);
+	selector.AddItem(&set);
+	selector.AddItem(&twoLevels);
+	PlaceItem(selector, 0, 0.5f);
+	PlaceItem(selector, 1, 5.0f);
+	PlaceItem(selector, 2, 20.0f);
+	PlaceItem(selector, 3, 0.5f);
+
+	LodViewParams shadowParams = MakeParams();
+	shadowParams.m_LodBias = 1;
+	selector.Select(LodView::Main, MakeParams());
+	selector.Select(LodView::Shadow, shadowParams);
+
+	const u32 mainLevels[] = { 0, 2, 3, 0 };
+	const u32 shadowLevels[] = { 1, 3, 3, 1 };
+	for (u32 i = 0; i < 4; ++i)
+	{
+		EXPECT_EQ(selector.GetSelectedLevel(LodView::Main, i), mainLevels[i]) << "item " << i;
+		EXPECT_EQ(selector.GetSelectedLevel(LodView::Shadow, i), shadowLevels[i]) << "item " << i;
+	}
+	EXPECT_EQ(selector.GetStats(LodView::Main).m_SelectedTriangles, 100u + 20u + 10u + 100u);
+	EXPECT_EQ(selector.GetStats(LodView::Shadow).m_SelectedTriangles, 40u + 10u + 10u + 40u);
+
+	// The bias is applied after selection, so it does not feed into the view's hysteresis.
+	shadowParams.m_LodBias = 0;
+	selector.Select(LodView::Shadow, shadowParams);
+	for (u32 i = 0; i < 4; ++i)
+	{
+		EXPECT_EQ(selector.GetSelectedLevel(LodView::Shadow, i), mainLevels[i]) << "item " << i;
+	}
+}
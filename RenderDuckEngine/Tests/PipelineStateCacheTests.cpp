@@ -0,0 +1,347 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <set>
+
+#include "PipelineStateCache.h"
+#include "TestFiles.h"
+
+namespace
+{
+	// Reference counted base for the fakes, answering QueryInterface for Interfaces.
+	template<typename Base, typename... Interfaces>
+	class FakeComObject : public Base
+	{
+	public:
+		HRESULT QueryInterface(REFIID riid, void** object) override
+		{
+			*object = nullptr;
+			if (riid == typeid(IUnknown) || ((riid == typeid(Interfaces)) || ...))
+			{
+				*object = this;
+				AddRef();
+				return S_OK;
+			}
+			return E_NOINTERFACE;
+		}
+
+		ULONG AddRef() override { return ++m_References; }
+
+		ULONG Release() override
+		{
+			const ULONG references = --m_References;
+			if (references == 0)
+			{
+				delete this;
+			}
+			return references;
+		}
+
+	private:
+		ULONG m_References = 1;
+	};
+
+	class FakePipelineState : public FakeComObject<ID3D12PipelineState, ID3D12PipelineState>
+	{
+	public:
+		explicit FakePipelineState(bool fromLibrary) : m_FromLibrary(fromLibrary) {}
+		bool m_FromLibrary;
+	};
+
+	template<typename T>
+	HRESULT ReturnObject(T* object, REFIID riid, void** result)
+	{
+		const HRESULT hr = object->QueryInterface(riid, result);
+		object->Release();
+		return hr;
+	}
+
+	// Serializes as "LIB1" followed by each pipeline's name and a ';', and only loads names it has.
+	class FakePipelineLibrary : public FakeComObject<ID3D12PipelineLibrary, ID3D12PipelineLibrary>
+	{
+	public:
+		HRESULT StorePipeline(LPCWSTR name, ID3D12PipelineState*) override
+		{
+			return m_Names.insert(name).second ? S_OK : E_INVALIDARG;
+		}
+
+		HRESULT LoadGraphicsPipeline(LPCWSTR name, const D3D12_GRAPHICS_PIPELINE_STATE_DESC*, REFIID riid, void** pipelineState) override
+		{
+			if (m_Names.count(name) == 0)
+			{
+				return E_INVALIDARG;
+			}
+			return ReturnObject(new FakePipelineState(true), riid, pipelineState);
+		}
+
+		SIZE_T GetSerializedSize() override { return ToString().size(); }
+
+		HRESULT Serialize(void* data, SIZE_T size) override
+		{
+			const std::string serialized = ToString();
+			if (size < serialized.size())
+			{
+				return E_INVALIDARG;
+			}
+			memcpy(data, serialized.data(), serialized.size());
+			return S_OK;
+		}
+
+		std::string ToString() const
+		{
+			std::string serialized = "LIB1";
+			for (const std::wstring& name : m_Names)
+			{
+				serialized += std::string(name.begin(), name.end()) + ";";
+			}
+			return serialized;
+		}
+
+		std::set<std::wstring> m_Names;
+	};
+
+	class FakeDevice : public FakeComObject<ID3D12Device1, ID3D12Device, ID3D12Device1>
+	{
+	public:
+		HRESULT CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC*, REFIID riid, void** pipelineState) override
+		{
+			++m_Creates;
+			return ReturnObject(new FakePipelineState(false), riid, pipelineState);
+		}
+
+		HRESULT CreatePipelineLibrary(const void* blob, SIZE_T size, REFIID riid, void** library) override
+		{
+			FakePipelineLibrary* created = new FakePipelineLibrary();
+			const std::string serialized((const char*)blob, size);
+			if (size > 0)
+			{
+				if (serialized.compare(0, 4, "LIB1") != 0)
+				{
+					created->Release();
+					return D3D12_ERROR_DRIVER_VERSION_MISMATCH;
+				}
+				for (size_t start = 4, end; (end = serialized.find(';', start)) != std::string::npos; start = end + 1)
+				{
+					created->m_Names.insert(std::wstring(serialized.begin() + start, serialized.begin() + end));
+				}
+			}
+			return ReturnObject(created, riid, library);
+		}
+
+		u32 m_Creates = 0;
+	};
+
+	// A device from before ID3D12Device1, without pipeline libraries.
+	class FakeOldDevice : public FakeComObject<ID3D12Device, ID3D12Device>
+	{
+	public:
+		HRESULT CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC*, REFIID riid, void** pipelineState) override
+		{
+			return ReturnObject(new FakePipelineState(false), riid, pipelineState);
+		}
+	};
+
+	const u8 c_VertexShader[] = { 0x44, 0x58, 0x42, 0x43, 1 };
+	const u8 c_PixelShader[] = { 0x44, 0x58, 0x42, 0x43, 2 };
+
+	// Opaque triangles with a position and a normal, into one render target and a depth buffer.
+	struct PipelineDesc
+	{
+		explicit PipelineDesc(u8 padding)
+		{
+			// Padding and unused fields are filled with junk, which the key must not see.
+			memset(&m_Desc, padding, sizeof(m_Desc));
+			strcpy(m_Position, "POSITION");
+			strcpy(m_Normal, "NORMAL");
+			m_Elements[0] = { m_Position, 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+			m_Elements[1] = { m_Normal, 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+
+			m_Desc.pRootSignature = (ID3D12RootSignature*)(uintptr_t)padding;
+			m_Desc.VS = { c_VertexShader, sizeof(c_VertexShader) };
+			m_Desc.PS = { c_PixelShader, sizeof(c_PixelShader) };
+			m_Desc.DS = m_Desc.HS = m_Desc.GS = { nullptr, 0 };
+			m_Desc.StreamOutput = { nullptr, 0, nullptr, 0, 0 };
+			m_Desc.BlendState.AlphaToCoverageEnable = false;
+			m_Desc.BlendState.IndependentBlendEnable = false;
+			for (D3D12_RENDER_TARGET_BLEND_DESC& target : m_Desc.BlendState.RenderTarget)
+			{
+				target = { false, false, D3D12_BLEND_ONE, D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD, D3D12_BLEND_ONE, D3D12_BLEND_ZERO,
+					D3D12_BLEND_OP_ADD, D3D12_LOGIC_OP_NOOP, 0xf };
+			}
+			m_Desc.SampleMask = ~0u;
+			m_Desc.RasterizerState = { D3D12_FILL_MODE_SOLID, D3D12_CULL_MODE_BACK, false, 0, 0.0f, 0.0f, true, false, false, 0,
+				D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF };
+			const D3D12_DEPTH_STENCILOP_DESC keep = { D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_COMPARISON_FUNC_ALWAYS };
+			m_Desc.DepthStencilState = { true, D3D12_DEPTH_WRITE_MASK_ALL, D3D12_COMPARISON_FUNC_LESS, false, 0xff, 0xff, keep, keep };
+			m_Desc.InputLayout = { m_Elements, 2 };
+			m_Desc.IBStripCutValue = D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED;
+			m_Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+			m_Desc.NumRenderTargets = 1;
+			m_Desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+			m_Desc.DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+			m_Desc.SampleDesc = { 1, 0 };
+			m_Desc.NodeMask = 0;
+			m_Desc.CachedPSO = { padding != 0 ? c_VertexShader : nullptr, padding };
+			m_Desc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		}
+
+		PipelineKey GetKey(u64 rootSignatureHash = 1) const { return HashGraphicsPipelineDesc(m_Desc, rootSignatureHash); }
+
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC m_Desc;
+		D3D12_INPUT_ELEMENT_DESC m_Elements[2];
+		char m_Position[16];
+		char m_Normal[16];
+	};
+
+	bool IsFromLibrary(ID3D12PipelineState* pipelineState)
+	{
+		return static_cast<FakePipelineState*>(pipelineState)->m_FromLibrary;
+	}
+}
+
+TEST(PipelineHash, IgnoresPaddingPointersAndUnusedFields)
+{
+	// Different junk in padding, unused render target slots and the root signature pointer, and
+	// semantic names at different addresses.
+	PipelineDesc a(0x00);
+	PipelineDesc b(0xcd);
+	EXPECT_EQ(a.GetKey(), b.GetKey());
+
+	b.m_Desc.RTVFormats[5] = DXGI_FORMAT_R16_UNORM;
+	EXPECT_EQ(a.GetKey(), b.GetKey());
+}
+
+TEST(PipelineHash, EveryStateThatChangesThePipelineChangesTheKey)
+{
+	const PipelineDesc reference(0);
+	const PipelineKey key = reference.GetKey();
+	EXPECT_NE(key, reference.GetKey(2));
+
+	auto expectNewKey = [&](const char* what, auto change)
+	{
+		PipelineDesc changed(0);
+		change(changed);
+		EXPECT_NE(changed.GetKey(), key) << what;
+	};
+
+	const u8 otherShader[] = { 0x44, 0x58, 0x42, 0x43, 3 };
+	expectNewKey("vertex shader", [&](PipelineDesc& d) { d.m_Desc.VS = { otherShader, sizeof(otherShader) }; });
+	expectNewKey("pixel shader length", [](PipelineDesc& d) { d.m_Desc.PS.BytecodeLength -= 1; });
+	expectNewKey("blend", [](PipelineDesc& d) { d.m_Desc.BlendState.RenderTarget[0].BlendEnable = true; });
+	expectNewKey("write mask", [](PipelineDesc& d) { d.m_Desc.BlendState.RenderTarget[3].RenderTargetWriteMask = 0x7; });
+	expectNewKey("cull mode", [](PipelineDesc& d) { d.m_Desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE; });
+	expectNewKey("depth bias", [](PipelineDesc& d) { d.m_Desc.RasterizerState.DepthBias = 100; });
+	expectNewKey("slope bias", [](PipelineDesc& d) { d.m_Desc.RasterizerState.SlopeScaledDepthBias = 1.0f; });
+	expectNewKey("depth func", [](PipelineDesc& d) { d.m_Desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL; });
+	expectNewKey("back face stencil", [](PipelineDesc& d) { d.m_Desc.DepthStencilState.BackFace.StencilPassOp = D3D12_STENCIL_OP_REPLACE; });
+	expectNewKey("semantic", [](PipelineDesc& d) { strcpy(d.m_Normal, "TANGENT"); });
+	expectNewKey("element offset", [](PipelineDesc& d) { d.m_Elements[1].AlignedByteOffset = 16; });
+	expectNewKey("element count", [](PipelineDesc& d) { d.m_Desc.InputLayout.NumElements = 1; });
+	expectNewKey("render target count", [](PipelineDesc& d) { d.m_Desc.NumRenderTargets = 2; d.m_Desc.RTVFormats[1] = DXGI_FORMAT_R8G8B8A8_UNORM; });
+	expectNewKey("render target format", [](PipelineDesc& d) { d.m_Desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; });
+	expectNewKey("depth format", [](PipelineDesc& d) { d.m_Desc.DSVFormat = DXGI_FORMAT_D32_FLOAT; });
+	expectNewKey("sample count", [](PipelineDesc& d) { d.m_Desc.SampleDesc.Count = 4; });
+	expectNewKey("topology", [](PipelineDesc& d) { d.m_Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE; });
+}
+
+TEST(PipelineStateCache, LaterRunsLoadPipelinesFromTheLibrary)
+{
+	ScopedTestDirectory directory;
+	const std::filesystem::path libraryPath = directory / "Cache/Pipelines.bin";
+	const PipelineDesc desc(0);
+	Microsoft::WRL::ComPtr<FakeDevice> device;
+	device.Attach(new FakeDevice());
+
+	{
+		PipelineStateCache cache(device.Get(), libraryPath);
+		ASSERT_EQ(cache.CreatePipeline(1, desc.m_Desc), S_OK);
+		ASSERT_EQ(cache.CreatePipeline(2, desc.m_Desc), S_OK);
+		EXPECT_FALSE(IsFromLibrary(cache.Get(1)));
+		EXPECT_EQ(cache.GetStats().m_Creates, 2u);
+		cache.Save();
+	}
+	EXPECT_TRUE(std::filesystem::exists(libraryPath));
+	// Nothing is left of the temporary file it was written to.
+	EXPECT_EQ(std::distance(std::filesystem::directory_iterator(directory / "Cache"), std::filesystem::directory_iterator()), 1);
+
+	// Pipeline 3 is new. The saved library only keeps what this run used, so 2 is dropped.
+	{
+		PipelineStateCache cache(device.Get(), libraryPath);
+		ASSERT_EQ(cache.CreatePipeline(1, desc.m_Desc), S_OK);
+		ASSERT_EQ(cache.CreatePipeline(3, desc.m_Desc), S_OK);
+		EXPECT_TRUE(IsFromLibrary(cache.Get(1)));
+		EXPECT_FALSE(IsFromLibrary(cache.Get(3)));
+		EXPECT_EQ(cache.GetStats().m_LibraryHits, 1u);
+		EXPECT_EQ(cache.GetStats().m_Creates, 1u);
+		cache.Save();
+	}
+
+	{
+		PipelineStateCache cache(device.Get(), libraryPath);
+		cache.CreatePipeline(1, desc.m_Desc);
+		cache.CreatePipeline(2, desc.m_Desc);
+		cache.CreatePipeline(3, desc.m_Desc);
+		EXPECT_EQ(cache.GetStats().m_LibraryHits, 2u);
+		EXPECT_FALSE(IsFromLibrary(cache.Get(2)));
+	}
+	EXPECT_EQ(device->m_Creates, 4u);
+}
+
+TEST(PipelineStateCache, SaveIsSkippedWhenNothingWasCreated)
+{
+	ScopedTestDirectory directory;
+	const std::filesystem::path libraryPath = directory / "Pipelines.bin";
+	const PipelineDesc desc(0);
+	Microsoft::WRL::ComPtr<FakeDevice> device;
+	device.Attach(new FakeDevice());
+
+	{
+		PipelineStateCache cache(device.Get(), libraryPath);
+		cache.CreatePipeline(1, desc.m_Desc);
+		cache.Save();
+	}
+	const std::filesystem::file_time_type written = std::filesystem::last_write_time(libraryPath);
+	std::filesystem::last_write_time(libraryPath, written - std::chrono::hours(1));
+
+	PipelineStateCache cache(device.Get(), libraryPath);
+	cache.CreatePipeline(1, desc.m_Desc);
+	cache.Save();
+	EXPECT_EQ(std::filesystem::last_write_time(libraryPath), written - std::chrono::hours(1));
+}
+
+TEST(PipelineStateCache, RejectedLibrariesAreRebuilt)
+{
+	ScopedTestDirectory directory;
+	const std::filesystem::path libraryPath = directory / "Pipelines.bin";
+	const PipelineDesc desc(0);
+	Microsoft::WRL::ComPtr<FakeDevice> device;
+	device.Attach(new FakeDevice());
+
+	// Written by another driver, as far as the device is concerned.
+	WriteTestFile(libraryPath, "LIB0 0000000000000001;");
+	{
+		PipelineStateCache cache(device.Get(), libraryPath);
+		ASSERT_EQ(cache.CreatePipeline(1, desc.m_Desc), S_OK);
+		EXPECT_EQ(cache.GetStats().m_Creates, 1u);
+		cache.Save();
+	}
+
+	PipelineStateCache cache(device.Get(), libraryPath);
+	ASSERT_EQ(cache.CreatePipeline(1, desc.m_Desc), S_OK);
+	EXPECT_EQ(cache.GetStats().m_LibraryHits, 1u);
+}
+
+TEST(PipelineStateCache, DevicesWithoutLibrariesCreateEveryPipeline)
+{
+	ScopedTestDirectory directory;
+	const std::filesystem::path libraryPath = directory / "Pipelines.bin";
+	const PipelineDesc desc(0);
+	Microsoft::WRL::ComPtr<FakeOldDevice> device;
+	device.Attach(new FakeOldDevice());
+
+	PipelineStateCache cache(device.Get(), libraryPath);
+	ASSERT_EQ(cache.CreatePipeline(1, desc.m_Desc), S_OK);
+	EXPECT_NE(cache.Get(1), nullptr);
+	cache.Save();
+	EXPECT_FALSE(std::filesystem::exists(libraryPath));
+}
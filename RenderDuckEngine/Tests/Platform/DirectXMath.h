@@ -0,0 +1,36 @@
+#pragma once
+
+// Stand-in for the Windows SDK's DirectXMath.h on Linux, declaring the types types.h names. The
+// modules under test keep their maths in plain floats, so no functions are needed.
+
+#include <xmmintrin.h>
+
+namespace DirectX
+{
+	typedef __m128 XMVECTOR;
+
+	struct XMMATRIX
+	{
+		XMVECTOR r[4];
+	};
+
+	struct XMFLOAT2
+	{
+		float x, y;
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+	};
+
+	struct XMFLOAT4X4
+	{
+		float m[4][4];
+	};
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Force included when the tests build with GCC or Clang. Declares the MSVC keywords and CRT
+// functions EngineCore.h and types.h use, so the CPU-side engine modules compile unchanged.
+
+#include <cstdio>
+#include <cstdlib>
+
+#define __int8 char
+#define __int16 short
+#define __int64 long long
+
+#define _CRT_WIDE_(s) L##s
+#define _CRT_WIDE(s) _CRT_WIDE_(s)
+
+// ASSERTMSG and ASSERTFAILMSG report through _wassert. Failing one fails the test run.
+inline void _wassert(const wchar_t* message, const wchar_t* file, unsigned line)
+{
+	fprintf(stderr, "%ls(%u): %ls\n", file, line, message);
+	abort();
+}
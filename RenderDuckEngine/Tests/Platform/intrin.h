@@ -0,0 +1,11 @@
+#pragma once
+// MSVC's __cpuid on top of GCC and Clang's cpuid.h, which has a macro of the same name.
+#include <cpuid.h>
+#include <immintrin.h>
+
+#undef __cpuid
+
+inline void __cpuid(int info[4], int leaf)
+{
+	__cpuid_count(leaf, 0, info[0], info[1], info[2], info[3]);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// The part of Microsoft::WRL::ComPtr the engine modules under test use, over the d3d12.h stand-in.
+
+#include <cstddef>
+#include <utility>
+
+#include <d3d12.h>
+
+namespace Microsoft
+{
+	namespace WRL
+	{
+		template<typename T>
+		class ComPtr
+		{
+		public:
+			ComPtr() = default;
+			ComPtr(std::nullptr_t) {}
+			ComPtr(T* ptr) : m_Ptr(ptr) { InternalAddRef(); }
+			ComPtr(const ComPtr& rhs) : m_Ptr(rhs.m_Ptr) { InternalAddRef(); }
+			ComPtr(ComPtr&& rhs) noexcept : m_Ptr(std::exchange(rhs.m_Ptr, nullptr)) {}
+			~ComPtr() { InternalRelease(); }
+
+			ComPtr& operator=(const ComPtr& rhs)
+			{
+				ComPtr(rhs).Swap(*this);
+				return *this;
+			}
+
+			ComPtr& operator=(ComPtr&& rhs) noexcept
+			{
+				ComPtr(std::move(rhs)).Swap(*this);
+				return *this;
+			}
+
+			ComPtr& operator=(std::nullptr_t)
+			{
+				Reset();
+				return *this;
+			}
+
+			T* Get() const { return m_Ptr; }
+			T* operator->() const { return m_Ptr; }
+			T* const* GetAddressOf() const { return &m_Ptr; }
+			T** GetAddressOf() { return &m_Ptr; }
+
+			T** ReleaseAndGetAddressOf()
+			{
+				InternalRelease();
+				return &m_Ptr;
+			}
+
+			// WRL returns a proxy that releases on conversion to T**, this releases straight away.
+			T** operator&() { return ReleaseAndGetAddressOf(); }
+
+			void Attach(T* ptr)
+			{
+				InternalRelease();
+				m_Ptr = ptr;
+			}
+
+			void Reset() { InternalRelease(); }
+			void Swap(ComPtr& rhs) { std::swap(m_Ptr, rhs.m_Ptr); }
+
+			// Called as As(&other), which has already released other.
+			template<typename U>
+			HRESULT As(U** result) const
+			{
+				return m_Ptr->QueryInterface(typeid(U), reinterpret_cast<void**>(result));
+			}
+
+			explicit operator bool() const { return m_Ptr != nullptr; }
+			bool operator==(std::nullptr_t) const { return m_Ptr == nullptr; }
+			bool operator!=(std::nullptr_t) const { return m_Ptr != nullptr; }
+
+		private:
+			void InternalAddRef()
+			{
+				if (m_Ptr != nullptr)
+				{
+					m_Ptr->AddRef();
+				}
+			}
+
+			void InternalRelease()
+			{
+				if (T* ptr = std::exchange(m_Ptr, nullptr))
+				{
+					ptr->Release();
+				}
+			}
+
+			T* m_Ptr = nullptr;
+		};
+	}
+}
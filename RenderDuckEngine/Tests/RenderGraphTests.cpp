@@ -0,0 +1,286 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "RenderGraph.h"
+
+namespace
+{
+	const RGResourceDesc c_TargetDesc = { 1 << 20, 65536 };
+
+	std::vector<RGBarrier> FindBarriers(const std::vector<RGBarrier>& barriers, RGBarrierType type, RGResourceHandle resource)
+	{
+		std::vector<RGBarrier> found;
+		for (const RGBarrier& barrier : barriers)
+		{
+			if (barrier.m_Type == type && barrier.m_Resource == resource)
+			{
+				found.push_back(barrier);
+			}
+		}
+		return found;
+	}
+}
+
+TEST(RenderGraph, CullsPassesWhoseOutputIsNeverRead)
+{
+	RenderGraph graph;
+	const RGResourceHandle backBuffer = graph.ImportResource("BackBuffer", RGResourceState::Present, RGResourceState::Present);
+	const RGResourceHandle scene = graph.CreateTransient("Scene", c_TargetDesc);
+	const RGResourceHandle debug = graph.CreateTransient("Debug", c_TargetDesc);
+	const RGResourceHandle debugBlur = graph.CreateTransient("DebugBlur", c_TargetDesc);
+	const RGResourceHandle readback = graph.CreateTransient("Readback", c_TargetDesc);
+
+	const RGPassHandle scenePass = graph.AddPass("Scene");
+	graph.Write(scenePass, scene, RGResourceState::RenderTarget);
+
+	// Only feeds a pass that is culled itself, so goes too.
+	const RGPassHandle debugPass = graph.AddPass("Debug");
+	graph.Read(debugPass, scene, RGResourceState::PixelShaderResource);
+	graph.Write(debugPass, debug, RGResourceState::RenderTarget);
+
+	const RGPassHandle debugBlurPass = graph.AddPass("DebugBlur");
+	graph.Read(debugBlurPass, debug, RGResourceState::PixelShaderResource);
+	graph.Write(debugBlurPass, debugBlur, RGResourceState::RenderTarget);
+
+	// Its output is unused, but it has side effects.
+	const RGPassHandle readbackPass = graph.AddPass("Readback", true);
+	graph.Read(readbackPass, scene, RGResourceState::CopySource);
+	graph.Write(readbackPass, readback, RGResourceState::CopyDest);
+
+	const RGPassHandle presentPass = graph.AddPass("Present");
+	graph.Read(presentPass, scene, RGResourceState::PixelShaderResource);
+	graph.Write(presentPass, backBuffer, RGResourceState::RenderTarget);
+
+	graph.Compile();
+
+	EXPECT_FALSE(graph.IsPassCulled(scenePass));
+	EXPECT_TRUE(graph.IsPassCulled(debugPass));
+	EXPECT_TRUE(graph.IsPassCulled(debugBlurPass));
+	EXPECT_FALSE(graph.IsPassCulled(readbackPass));
+	EXPECT_FALSE(graph.IsPassCulled(presentPass));
+
+	// Culled passes take no part in lifetimes, barriers or placement.
+	EXPECT_EQ(graph.GetResources()[scene].m_FirstPass, scenePass);
+	EXPECT_EQ(graph.GetResources()[scene].m_LastPass, presentPass);
+	EXPECT_EQ(graph.GetResources()[debug].m_FirstPass, c_InvalidRGHandle);
+	EXPECT_TRUE(graph.GetPassBarriers(debugPass).empty());
+	EXPECT_EQ(graph.GetTransientHeapSize(), 2 * c_TargetDesc.m_SizeInBytes);
+}
+
+TEST(RenderGraph, TransientsShareMemoryOnlyWhenLifetimesAreDisjoint)
+{
+	// A ping-pong chain: each target is written by one pass and read by the next, so a and c
+	// never live at the same time and can share memory, b overlaps both.
+	RenderGraph graph;
+	const RGResourceHandle backBuffer = graph.ImportResource("BackBuffer", RGResourceState::Present, RGResourceState::Present);
+	const RGResourceHandle a = graph.CreateTransient("A", c_TargetDesc);
+	const RGResourceHandle b = graph.CreateTransient("B", c_TargetDesc);
+	const RGResourceHandle c = graph.CreateTransient("C", { c_TargetDesc.m_SizeInBytes / 2, 65536 });
+
+	const RGPassHandle pass0 = graph.AddPass("0");
+	graph.Write(pass0, a, RGResourceState::RenderTarget);
+	const RGPassHandle pass1 = graph.AddPass("1");
+	graph.Read(pass1, a, RGResourceState::PixelShaderResource);
+	graph.Write(pass1, b, RGResourceState::RenderTarget);
+	const RGPassHandle pass2 = graph.AddPass("2");
+	graph.Read(pass2, b, RGResourceState::PixelShaderResource);
+	graph.Write(pass2, c, RGResourceState::RenderTarget);
+	const RGPassHandle pass3 = graph.AddPass("3");
+	graph.Read(pass3, c, RGResourceState::PixelShaderResource);
+	graph.Write(pass3, backBuffer, RGResourceState::RenderTarget);
+
+	graph.Compile();
+
+	const std::vector<RGResource>& resources = graph.GetResources();
+	EXPECT_EQ(resources[a].m_HeapOffset, resources[c].m_HeapOffset);
+	EXPECT_NE(resources[a].m_HeapOffset, resources[b].m_HeapOffset);
+	EXPECT_EQ(graph.GetTransientHeapSize(), 2 * c_TargetDesc.m_SizeInBytes);
+
+	// c reuses a's memory, so its first pass waits for a with an aliasing barrier.
+	const std::vector<RGBarrier> aliasing = FindBarriers(graph.GetPassBarriers(pass2), RGBarrierType::Aliasing, c);
+	ASSERT_EQ(aliasing.size(), 1u);
+	EXPECT_EQ(aliasing[0].m_AliasBefore, a);
+	EXPECT_TRUE(FindBarriers(graph.GetPassBarriers(pass0), RGBarrierType::Aliasing, a).empty());
+	EXPECT_TRUE(FindBarriers(graph.GetPassBarriers(pass1), RGBarrierType::Aliasing, b).empty());
+
+	// Transients are created in the state of their first access.
+	EXPECT_EQ(resources[c].m_CreateState, RGResourceState::RenderTarget);
+}
+
+TEST(RenderGraph, RandomGraphsPlaceLiveTransientsApart)
+{
+	std::mt19937 random(7);
+	for (u32 iteration = 0; iteration < 200; ++iteration)
+	{
+		RenderGraph graph;
+		const RGResourceHandle backBuffer = graph.ImportResource("BackBuffer", RGResourceState::Present, RGResourceState::Present);
+
+		const u32 resourceCount = 2 + random() % 12;
+		std::vector<RGResourceHandle> transients;
+		for (u32 i = 0; i < resourceCount; ++i)
+		{
+			const u64 alignment = (u64)4096 << (random() % 5);
+			transients.push_back(graph.CreateTransient("T" + std::to_string(i), { 1 + random() % (4 << 20), alignment }));
+		}
+
+		const u32 passCount = 2 + random() % 16;
+		for (u32 p = 0; p < passCount; ++p)
+		{
+			const RGPassHandle pass = graph.AddPass("P" + std::to_string(p));
+			graph.Read(pass, transients[random() % resourceCount], RGResourceState::PixelShaderResource);
+			graph.Write(pass, transients[random() % resourceCount], RGResourceState::RenderTarget);
+			if (random() % 4 == 0)
+			{
+				graph.Write(pass, backBuffer, RGResourceState::RenderTarget);
+			}
+		}
+		graph.Compile();
+
+		const std::vector<RGResource>& resources = graph.GetResources();
+		u64 heapEnd = 0;
+		for (RGResourceHandle a : transients)
+		{
+			const RGResource& resourceA = resources[a];
+			if (resourceA.m_FirstPass == c_InvalidRGHandle)
+			{
+				continue;
+			}
+
+			EXPECT_EQ(resourceA.m_HeapOffset % resourceA.m_Desc.m_Alignment, 0u);
+			heapEnd = std::max(heapEnd, resourceA.m_HeapOffset + resourceA.m_Desc.m_SizeInBytes);
+
+			for (RGResourceHandle b : transients)
+			{
+				const RGResource& resourceB = resources[b];
+				if (a == b || resourceB.m_FirstPass == c_InvalidRGHandle ||
+					resourceA.m_FirstPass > resourceB.m_LastPass || resourceB.m_FirstPass > resourceA.m_LastPass)
+				{
+					continue;
+				}
+
+				const bool memoryOverlaps = resourceA.m_HeapOffset < resourceB.m_HeapOffset + resourceB.m_Desc.m_SizeInBytes &&
+					resourceB.m_HeapOffset < resourceA.m_HeapOffset + resourceA.m_Desc.m_SizeInBytes;
+				EXPECT_FALSE(memoryOverlaps) << resourceA.m_Name << " and " << resourceB.m_Name << " are live at once";
+			}
+		}
+		EXPECT_EQ(graph.GetTransientHeapSize(), heapEnd);
+	}
+}
+
+TEST(RenderGraph, TransitionsAreBatchedPerPass)
+{
+	RenderGraph graph;
+	const RGResourceHandle backBuffer = graph.ImportResource("BackBuffer", RGResourceState::Present, RGResourceState::Present);
+	const RGResourceHandle shadowMap = graph.ImportResource("ShadowMap", RGResourceState::GenericRead, RGResourceState::GenericRead);
+	const RGResourceHandle normals = graph.ImportResource("Normals", RGResourceState::PixelShaderResource, RGResourceState::PixelShaderResource);
+
+	const RGPassHandle shadowPass = graph.AddPass("Shadow");
+	graph.Write(shadowPass, shadowMap, RGResourceState::DepthWrite);
+
+	const RGPassHandle normalsPass = graph.AddPass("Normals");
+	graph.Write(normalsPass, normals, RGResourceState::RenderTarget);
+
+	const RGPassHandle scenePass = graph.AddPass("Scene");
+	graph.Read(scenePass, shadowMap, RGResourceState::PixelShaderResource);
+	graph.Read(scenePass, normals, RGResourceState::PixelShaderResource);
+	graph.Write(scenePass, backBuffer, RGResourceState::RenderTarget);
+
+	// Already in a state that covers the read, so no barrier.
+	const RGPassHandle samplePass = graph.AddPass("Sample");
+	graph.Read(samplePass, shadowMap, RGResourceState::NonPixelShaderResource);
+	graph.Write(samplePass, backBuffer, RGResourceState::RenderTarget);
+
+	graph.Compile();
+
+	// Every transition a pass needs is in its own list, to be issued as one call.
+	const std::vector<RGBarrier>& sceneBarriers = graph.GetPassBarriers(scenePass);
+	ASSERT_EQ(sceneBarriers.size(), 3u);
+
+	// Reads of an imported resource go straight to its final state when that covers them.
+	const std::vector<RGBarrier> shadowReads = FindBarriers(sceneBarriers, RGBarrierType::Transition, shadowMap);
+	ASSERT_EQ(shadowReads.size(), 1u);
+	EXPECT_EQ(shadowReads[0].m_Before, RGResourceState::DepthWrite);
+	EXPECT_EQ(shadowReads[0].m_After, RGResourceState::GenericRead);
+
+	const std::vector<RGBarrier> normalReads = FindBarriers(sceneBarriers, RGBarrierType::Transition, normals);
+	ASSERT_EQ(normalReads.size(), 1u);
+	EXPECT_EQ(normalReads[0].m_Before, RGResourceState::RenderTarget);
+	EXPECT_EQ(normalReads[0].m_After, RGResourceState::PixelShaderResource);
+
+	EXPECT_EQ(FindBarriers(sceneBarriers, RGBarrierType::Transition, backBuffer).size(), 1u);
+	EXPECT_TRUE(graph.GetPassBarriers(samplePass).empty());
+
+	// Only the back buffer is left away from its final state.
+	const std::vector<RGBarrier>& finalBarriers = graph.GetFinalBarriers();
+	ASSERT_EQ(finalBarriers.size(), 1u);
+	EXPECT_EQ(finalBarriers[0].m_Resource, backBuffer);
+	EXPECT_EQ(finalBarriers[0].m_Before, RGResourceState::RenderTarget);
+	EXPECT_EQ(finalBarriers[0].m_After, RGResourceState::Present);
+}
+
+TEST(RenderGraph, UnorderedAccessBetweenPassesWaitsOnUavBarrier)
+{
+	RenderGraph graph;
+	const RGResourceHandle backBuffer = graph.ImportResource("BackBuffer", RGResourceState::Present, RGResourceState::Present);
+	const RGResourceHandle buffer = graph.CreateTransient("Buffer", c_TargetDesc);
+
+	const RGPassHandle clearPass = graph.AddPass("Clear");
+	graph.Write(clearPass, buffer, RGResourceState::UnorderedAccess);
+
+	const RGPassHandle accumulatePass = graph.AddPass("Accumulate");
+	graph.Write(accumulatePass, buffer, RGResourceState::UnorderedAccess);
+
+	const RGPassHandle readPass0 = graph.AddPass("Read0");
+	graph.Read(readPass0, buffer, RGResourceState::UnorderedAccess);
+	graph.Write(readPass0, backBuffer, RGResourceState::UnorderedAccess);
+
+	const RGPassHandle readPass1 = graph.AddPass("Read1");
+	graph.Read(readPass1, buffer, RGResourceState::UnorderedAccess);
+	graph.Write(readPass1, backBuffer, RGResourceState::UnorderedAccess);
+
+	const RGPassHandle resolvePass = graph.AddPass("Resolve");
+	graph.Write(resolvePass, buffer, RGResourceState::UnorderedAccess);
+	graph.Write(resolvePass, backBuffer, RGResourceState::UnorderedAccess);
+
+	const RGPassHandle presentPass = graph.AddPass("Present");
+	graph.Read(presentPass, buffer, RGResourceState::PixelShaderResource);
+	graph.Write(presentPass, backBuffer, RGResourceState::RenderTarget);
+
+	graph.Compile();
+
+	// Write after write, and read after write.
+	EXPECT_TRUE(FindBarriers(graph.GetPassBarriers(clearPass), RGBarrierType::UnorderedAccess, buffer).empty());
+	EXPECT_EQ(FindBarriers(graph.GetPassBarriers(accumulatePass), RGBarrierType::UnorderedAccess, buffer).size(), 1u);
+	EXPECT_EQ(FindBarriers(graph.GetPassBarriers(readPass0), RGBarrierType::UnorderedAccess, buffer).size(), 1u);
+
+	// Two reads need nothing between them, a write after them does.
+	EXPECT_TRUE(FindBarriers(graph.GetPassBarriers(readPass1), RGBarrierType::UnorderedAccess, buffer).empty());
+	EXPECT_EQ(FindBarriers(graph.GetPassBarriers(resolvePass), RGBarrierType::UnorderedAccess, buffer).size(), 1u);
+
+	// The back buffer is written in every UAV pass after its transition.
+	EXPECT_EQ(FindBarriers(graph.GetPassBarriers(readPass0), RGBarrierType::Transition, backBuffer).size(), 1u);
+	EXPECT_EQ(FindBarriers(graph.GetPassBarriers(readPass1), RGBarrierType::UnorderedAccess, backBuffer).size(), 1u);
+	EXPECT_EQ(FindBarriers(graph.GetPassBarriers(resolvePass), RGBarrierType::UnorderedAccess, backBuffer).size(), 1u);
+
+	// A transition orders the earlier work, so it replaces the UAV barrier.
+	const std::vector<RGBarrier>& presentBarriers = graph.GetPassBarriers(presentPass);
+	EXPECT_TRUE(FindBarriers(presentBarriers, RGBarrierType::UnorderedAccess, buffer).empty());
+	EXPECT_EQ(FindBarriers(presentBarriers, RGBarrierType::Transition, buffer).size(), 1u);
+}
+
+TEST(RenderGraph, RenderTargetWritesNeedNoBarrierBetweenPasses)
+{
+	RenderGraph graph;
+	const RGResourceHandle backBuffer = graph.ImportResource("BackBuffer", RGResourceState::Present, RGResourceState::Present);
+
+	const RGPassHandle opaquePass = graph.AddPass("Opaque");
+	graph.Write(opaquePass, backBuffer, RGResourceState::RenderTarget);
+	const RGPassHandle skyPass = graph.AddPass("Sky");
+	graph.Write(skyPass, backBuffer, RGResourceState::RenderTarget);
+
+	graph.Compile();
+
+	EXPECT_EQ(graph.GetPassBarriers(opaquePass).size(), 1u);
+	EXPECT_TRUE(graph.GetPassBarriers(skyPass).empty());
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+#include "FakeGpuTimeline.h"
+#include "RingAllocator.h"
+
+TEST(RingAllocator, CountsBytesSkippedForAlignment)
+{
+	FakeGpuTimeline timeline;
+	RingAllocator ring(1024, &timeline);
+
+	EXPECT_EQ(ring.Allocate(100, 1), 0u);
+	EXPECT_EQ(ring.Allocate(100, 256), 256u);
+	EXPECT_EQ(ring.Allocate(16, 16), 368u);
+	EXPECT_EQ(ring.GetUsedBytes(), 384u);
+	ring.Commit(1);
+
+	// The skipped bytes go back with the block that skipped them.
+	timeline.Complete(1);
+	ring.Retire();
+	EXPECT_EQ(ring.GetUsedBytes(), 0u);
+	EXPECT_EQ(ring.GetPeakUsedBytes(), 384u);
+	EXPECT_FALSE(ring.HasPendingBlocks());
+}
+
+TEST(RingAllocator, WrapsOnceTheTailHasMoved)
+{
+	FakeGpuTimeline timeline;
+	RingAllocator ring(1024, &timeline);
+
+	EXPECT_EQ(ring.Allocate(600, 1), 0u);
+	ring.Commit(1);
+	EXPECT_EQ(ring.Allocate(300, 1), 600u);
+	ring.Commit(2);
+
+	// 124 bytes are left at the end and nothing at the start until the first block retires.
+	EXPECT_EQ(ring.Allocate(200, 1), c_InvalidRingOffset);
+	EXPECT_EQ(ring.GetOldestPendingFence(), 1u);
+
+	// Allocate retires on its own when it runs out. The end of the ring is skipped and charged to
+	// the new allocation's block.
+	timeline.Complete(1);
+	EXPECT_EQ(ring.Allocate(200, 1), 0u);
+	EXPECT_EQ(ring.GetUsedBytes(), 300u + 124u + 200u);
+	ring.Commit(3);
+	EXPECT_EQ(ring.GetOldestPendingFence(), 2u);
+
+	// Free space is now only between the head and the tail.
+	EXPECT_EQ(ring.Allocate(400, 1), 200u);
+	EXPECT_EQ(ring.Allocate(1, 1), c_InvalidRingOffset);
+	ring.Commit(4);
+
+	// Once everything has retired the ring starts again from 0.
+	timeline.Complete(4);
+	EXPECT_EQ(ring.Allocate(1024, 256), 0u);
+}
+
+TEST(RingAllocator, RetiresOnlyBlocksTheGpuHasFinished)
+{
+	FakeGpuTimeline timeline;
+	RingAllocator ring(4096, &timeline);
+
+	for (u64 fence = 1; fence <= 4; ++fence)
+	{
+		ring.Allocate(256, 256);
+		ring.Commit(fence);
+	}
+
+	// An empty commit does not add a block.
+	ring.Commit(5);
+
+	timeline.Complete(2);
+	ring.Retire();
+	EXPECT_EQ(ring.GetUsedBytes(), 512u);
+	EXPECT_EQ(ring.GetOldestPendingFence(), 3u);
+
+	timeline.Complete(5);
+	ring.Retire();
+	EXPECT_EQ(ring.GetUsedBytes(), 0u);
+	EXPECT_FALSE(ring.HasPendingBlocks());
+}
+
+TEST(RingAllocator, RejectsAllocationsLargerThanTheRing)
+{
+	FakeGpuTimeline timeline;
+	RingAllocator ring(1024, &timeline);
+	EXPECT_EQ(ring.Allocate(1025, 1), c_InvalidRingOffset);
+	EXPECT_EQ(ring.GetUsedBytes(), 0u);
+}
+
+TEST(RingAllocator, LiveAllocationsNeverOverlap)
+{
+	// Frames of random allocations with the GPU two frames behind. Every live allocation is kept
+	// with the frame it belongs to and checked against the others.
+	const u64 capacity = 32 * 1024;
+	FakeGpuTimeline timeline;
+	RingAllocator ring(capacity, &timeline);
+	std::mt19937 random(11);
+
+	std::map<u64, std::pair<u64, u64>> live;
+	u32 failures = 0;
+	for (u64 frame = 1; frame <= 2000; ++frame)
+	{
+		if (frame > 2)
+		{
+			timeline.Complete(frame - 2);
+		}
+		for (auto it = live.begin(); it != live.end();)
+		{
+			it = it->second.second <= timeline.GetCompletedValue() ? live.erase(it) : std::next(it);
+		}
+
+		const u32 allocationCount = random() % 24;
+		for (u32 i = 0; i < allocationCount; ++i)
+		{
+			const u64 size = 1 + random() % 2048;
+			const u64 alignment = 1ull << (random() % 9);
+			const u64 offset = ring.Allocate(size, alignment);
+			if (offset == c_InvalidRingOffset)
+			{
+				++failures;
+				continue;
+			}
+
+			ASSERT_EQ(offset % alignment, 0u);
+			ASSERT_LE(offset + size, capacity);
+			auto next = live.lower_bound(offset);
+			if (next != live.end())
+			{
+				ASSERT_LE(offset + size, next->first) << "frame " << frame;
+			}
+			if (next != live.begin())
+			{
+				auto previous = std::prev(next);
+				ASSERT_LE(previous->first + previous->second.first, offset) << "frame " << frame;
+			}
+			live[offset] = { size, frame };
+		}
+		ring.Commit(frame);
+		ASSERT_LE(ring.GetUsedBytes(), capacity);
+	}
+
+	// A few frames run out of room, most do not.
+	EXPECT_GT(failures, 0u);
+	EXPECT_LT(failures, 2000u);
+
+	timeline.Complete(2000);
+	ring.Retire();
+	EXPECT_EQ(ring.GetUsedBytes(), 0u);
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+
+#include "RootSignatureDesc.h"
+
+namespace
+{
+	// Root constants, a CBV, an SRV in space 1, a pixel shader table and a linear sampler, with
+	// each part of the layout open to change by the test.
+	struct LayoutDesc
+	{
+		LayoutDesc()
+		{
+			m_Range = { D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 16, 3, 0, 0xffffffff };
+			m_Sampler = {};
+			m_Sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+			m_Sampler.AddressU = m_Sampler.AddressV = m_Sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+			m_Sampler.MaxLOD = 1000.0f;
+		}
+
+		RootSignatureDesc Build() const
+		{
+			RootSignatureDesc desc;
+			desc.AddConstants(m_ConstantCount, 1);
+			desc.AddConstantBufferView(0);
+			desc.AddShaderResourceView(0, 1, m_SrvVisibility);
+			desc.AddDescriptorTable(&m_Range, 1, D3D12_SHADER_VISIBILITY_PIXEL);
+			desc.AddStaticSamplers(&m_Sampler, 1);
+			desc.SetFlags(m_Flags);
+			return desc;
+		}
+
+		u32 m_ConstantCount = 4;
+		D3D12_SHADER_VISIBILITY m_SrvVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		D3D12_DESCRIPTOR_RANGE m_Range;
+		D3D12_STATIC_SAMPLER_DESC m_Sampler;
+		D3D12_ROOT_SIGNATURE_FLAGS m_Flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+	};
+}
+
+TEST(RootSignatureDesc, EqualLayoutsHashAlike)
+{
+	const RootSignatureDesc a = LayoutDesc().Build();
+	const RootSignatureDesc b = LayoutDesc().Build();
+	EXPECT_TRUE(a == b);
+	EXPECT_EQ(a.GetHash(), b.GetHash());
+
+	// The table's ranges are copied, so the caller's array can go away.
+	LayoutDesc layout;
+	const RootSignatureDesc copied = layout.Build();
+	layout.m_Range.NumDescriptors = 1;
+	EXPECT_TRUE(copied == a);
+	EXPECT_EQ(copied.GetHash(), a.GetHash());
+}
+
+TEST(RootSignatureDesc, EveryPartOfTheLayoutChangesTheKey)
+{
+	const RootSignatureDesc reference = LayoutDesc().Build();
+
+	auto expectDifferent = [&](const char* what, const std::function<void(LayoutDesc&)>& change)
+	{
+		LayoutDesc layout;
+		change(layout);
+		const RootSignatureDesc changed = layout.Build();
+		EXPECT_TRUE(changed != reference) << what;
+		EXPECT_NE(changed.GetHash(), reference.GetHash()) << what;
+	};
+
+	expectDifferent("constant count", [](LayoutDesc& l) { l.m_ConstantCount = 5; });
+	expectDifferent("visibility", [](LayoutDesc& l) { l.m_SrvVisibility = D3D12_SHADER_VISIBILITY_VERTEX; });
+	expectDifferent("table size", [](LayoutDesc& l) { l.m_Range.NumDescriptors = 17; });
+	expectDifferent("range type", [](LayoutDesc& l) { l.m_Range.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV; });
+	expectDifferent("sampler bias", [](LayoutDesc& l) { l.m_Sampler.MipLODBias = 0.5f; });
+	expectDifferent("sampler filter", [](LayoutDesc& l) { l.m_Sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT; });
+	expectDifferent("flags", [](LayoutDesc& l) { l.m_Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE; });
+
+	// The same parameters in another order are another layout.
+	RootSignatureDesc reordered;
+	reordered.AddConstantBufferView(0);
+	reordered.AddConstants(4, 1);
+	EXPECT_TRUE(reordered != reference);
+	RootSignatureDesc ordered;
+	ordered.AddConstants(4, 1);
+	ordered.AddConstantBufferView(0);
+	EXPECT_TRUE(reordered != ordered);
+	EXPECT_NE(reordered.GetHash(), ordered.GetHash());
+}
+
+TEST(RootSignatureDesc, DescMatchesTheAddedParameters)
+{
+	const RootSignatureDesc layout = LayoutDesc().Build();
+	std::vector<D3D12_ROOT_PARAMETER> parameters;
+	const D3D12_ROOT_SIGNATURE_DESC desc = layout.GetDesc(parameters);
+
+	ASSERT_EQ(desc.NumParameters, 4u);
+	EXPECT_EQ(desc.pParameters, parameters.data());
+	EXPECT_EQ(parameters[0].ParameterType, D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS);
+	EXPECT_EQ(parameters[0].Constants.Num32BitValues, 4u);
+	EXPECT_EQ(parameters[0].Constants.ShaderRegister, 1u);
+	EXPECT_EQ(parameters[1].ParameterType, D3D12_ROOT_PARAMETER_TYPE_CBV);
+	EXPECT_EQ(parameters[2].ParameterType, D3D12_ROOT_PARAMETER_TYPE_SRV);
+	EXPECT_EQ(parameters[2].Descriptor.RegisterSpace, 1u);
+	EXPECT_EQ(parameters[3].ParameterType, D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE);
+	EXPECT_EQ(parameters[3].ShaderVisibility, D3D12_SHADER_VISIBILITY_PIXEL);
+	ASSERT_EQ(parameters[3].DescriptorTable.NumDescriptorRanges, 1u);
+	EXPECT_EQ(parameters[3].DescriptorTable.pDescriptorRanges[0].NumDescriptors, 16u);
+	EXPECT_EQ(desc.NumStaticSamplers, 1u);
+	EXPECT_EQ(desc.Flags, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+}
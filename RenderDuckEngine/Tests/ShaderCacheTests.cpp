@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+
+#include "ShaderCache.h"
+#include "TestFiles.h"
+
+namespace
+{
+	// Bytecode spells out what it was compiled from, so tests can tell permutations apart.
+	class StubShaderCompiler : public IShaderCompiler
+	{
+	public:
+		std::string GetVersion() const override { return m_Version; }
+
+		bool Compile(const ShaderDesc& desc, std::vector<u8>& byteCode, std::string& errors) override
+		{
+			++m_Compiles;
+			if (desc.m_EntryPoint == "Broken")
+			{
+				errors = "error X3000: syntax error";
+				return false;
+			}
+
+			std::string text = desc.m_EntryPoint + " " + desc.m_Target;
+			for (const ShaderDefine& define : desc.m_Defines)
+			{
+				text += " " + define.m_Name + "=" + define.m_Value;
+			}
+			byteCode.assign(text.begin(), text.end());
+			return true;
+		}
+
+		std::string m_Version = "stub 1";
+		u32 m_Compiles = 0;
+	};
+
+	std::string ToString(const ShaderBytecodeRef& shader)
+	{
+		return std::string((const char*)shader->GetBufferPointer(), (size_t)shader->GetBufferSize());
+	}
+
+	// Default.hlsl includes Common.hlsl twice, which includes Lighting.hlsl.
+	struct ShaderSources
+	{
+		ShaderSources()
+		{
+			WriteTestFile(m_Directory / "Shaders/Lighting.hlsl", "float3 Light;\n");
+			WriteTestFile(m_Directory / "Shaders/Common.hlsl", "  #include \"Lighting.hlsl\"\nfloat Common;\n");
+			WriteTestFile(m_Directory / "Shaders/Default.hlsl", "#include \"Common.hlsl\"\n#include <Common.hlsl>\nfloat4 VS() : SV_Position;\n");
+			m_Desc = { m_Directory / "Shaders/Default.hlsl", {}, "VS", "vs_5_1" };
+		}
+
+		std::filesystem::path GetCacheDirectory() const { return m_Directory / "Cache"; }
+
+		ScopedTestDirectory m_Directory;
+		ShaderDesc m_Desc;
+	};
+}
+
+TEST(ShaderCache, RepeatedRequestsHitMemory)
+{
+	ShaderSources sources;
+	StubShaderCompiler compiler;
+	ShaderCache cache(&compiler, sources.GetCacheDirectory());
+
+	const ShaderBytecodeRef first = cache.GetShader(sources.m_Desc);
+	const ShaderBytecodeRef second = cache.GetShader(sources.m_Desc);
+	ASSERT_NE(first, nullptr);
+	EXPECT_EQ(first, second);
+	EXPECT_EQ(ToString(first), "VS vs_5_1");
+	EXPECT_EQ(compiler.m_Compiles, 1u);
+	EXPECT_EQ(cache.GetStats().m_Compiles, 1u);
+	EXPECT_EQ(cache.GetStats().m_MemoryHits, 1u);
+}
+
+TEST(ShaderCache, LaterRunsHitDisk)
+{
+	ShaderSources sources;
+	StubShaderCompiler compiler;
+	{
+		ShaderCache cache(&compiler, sources.GetCacheDirectory());
+		ASSERT_NE(cache.GetShader(sources.m_Desc), nullptr);
+	}
+
+	ShaderCache cache(&compiler, sources.GetCacheDirectory());
+	const ShaderBytecodeRef shader = cache.GetShader(sources.m_Desc);
+	ASSERT_NE(shader, nullptr);
+	EXPECT_EQ(ToString(shader), "VS vs_5_1");
+	EXPECT_EQ(compiler.m_Compiles, 1u);
+	EXPECT_EQ(cache.GetStats().m_DiskHits, 1u);
+
+	// So does a new compiler, as long as it reports the same version.
+	StubShaderCompiler sameVersion;
+	ShaderCache otherCache(&sameVersion, sources.GetCacheDirectory());
+	EXPECT_NE(otherCache.GetShader(sources.m_Desc), nullptr);
+	EXPECT_EQ(sameVersion.m_Compiles, 0u);
+}
+
+TEST(ShaderCache, EditingAnIncludeRecompiles)
+{
+	ShaderSources sources;
+	StubShaderCompiler compiler;
+	ShaderCache cache(&compiler, sources.GetCacheDirectory());
+
+	u64 before = 0;
+	ASSERT_TRUE(cache.ComputeKey(sources.m_Desc, before));
+	ASSERT_NE(cache.GetShader(sources.m_Desc), nullptr);
+
+	// Two levels down, only reached through Common.hlsl.
+	WriteTestFile(sources.m_Directory / "Shaders/Lighting.hlsl", "float3 Light;\nfloat3 Ambient;\n");
+	u64 after = 0;
+	ASSERT_TRUE(cache.ComputeKey(sources.m_Desc, after));
+	EXPECT_NE(before, after);
+	ASSERT_NE(cache.GetShader(sources.m_Desc), nullptr);
+	EXPECT_EQ(compiler.m_Compiles, 2u);
+
+	// Putting the old text back finds the first compile again.
+	WriteTestFile(sources.m_Directory / "Shaders/Lighting.hlsl", "float3 Light;\n");
+	ASSERT_TRUE(cache.ComputeKey(sources.m_Desc, after));
+	EXPECT_EQ(before, after);
+	ASSERT_NE(cache.GetShader(sources.m_Desc), nullptr);
+	EXPECT_EQ(compiler.m_Compiles, 2u);
+}
+
+TEST(ShaderCache, DefinesEntryPointsTargetsAndCompilerPickNewKeys)
+{
+	ShaderSources sources;
+	StubShaderCompiler compiler;
+	ShaderCache cache(&compiler, sources.GetCacheDirectory());
+	ASSERT_NE(cache.GetShader(sources.m_Desc), nullptr);
+
+	ShaderDesc alphaTested = sources.m_Desc;
+	alphaTested.m_Defines.push_back({ "ALPHA_TEST", "1" });
+	const ShaderBytecodeRef alphaShader = cache.GetShader(alphaTested);
+	ASSERT_NE(alphaShader, nullptr);
+	EXPECT_EQ(ToString(alphaShader), "VS vs_5_1 ALPHA_TEST=1");
+
+	ShaderDesc otherValue = alphaTested;
+	otherValue.m_Defines[0].m_Value = "2";
+	ASSERT_NE(cache.GetShader(otherValue), nullptr);
+
+	ShaderDesc pixelShader = sources.m_Desc;
+	pixelShader.m_EntryPoint = "PS";
+	pixelShader.m_Target = "ps_5_1";
+	ASSERT_NE(cache.GetShader(pixelShader), nullptr);
+	EXPECT_EQ(compiler.m_Compiles, 4u);
+
+	// A new compiler version invalidates everything, memory included.
+	compiler.m_Version = "stub 2";
+	ASSERT_NE(cache.GetShader(sources.m_Desc), nullptr);
+	EXPECT_EQ(compiler.m_Compiles, 5u);
+	EXPECT_EQ(cache.GetStats().m_MemoryHits, 0u);
+}
+
+TEST(ShaderCache, FailuresAreReportedAndNotCached)
+{
+	ShaderSources sources;
+	StubShaderCompiler compiler;
+	ShaderCache cache(&compiler, sources.GetCacheDirectory());
+
+	ShaderDesc broken = sources.m_Desc;
+	broken.m_EntryPoint = "Broken";
+	std::string errors;
+	EXPECT_EQ(cache.GetShader(broken, &errors), nullptr);
+	EXPECT_EQ(errors, "error X3000: syntax error");
+	EXPECT_EQ(cache.GetShader(broken), nullptr);
+	EXPECT_EQ(compiler.m_Compiles, 2u);
+	EXPECT_EQ(cache.GetStats().m_Failures, 2u);
+
+	// A missing source compiles uncached, every time.
+	ShaderDesc missing = sources.m_Desc;
+	missing.m_Path = sources.m_Directory / "Shaders/Missing.hlsl";
+	u64 key = 0;
+	EXPECT_FALSE(cache.ComputeKey(missing, key));
+	cache.GetShader(missing);
+	cache.GetShader(missing);
+	EXPECT_EQ(compiler.m_Compiles, 4u);
+}
+
+TEST(ShaderCache, TruncatedCacheFilesAreRecompiled)
+{
+	ShaderSources sources;
+	StubShaderCompiler compiler;
+	{
+		ShaderCache cache(&compiler, sources.GetCacheDirectory());
+		ASSERT_NE(cache.GetShader(sources.m_Desc), nullptr);
+	}
+
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(sources.GetCacheDirectory()))
+	{
+		std::filesystem::resize_file(entry.path(), 10);
+	}
+
+	ShaderCache cache(&compiler, sources.GetCacheDirectory());
+	const ShaderBytecodeRef shader = cache.GetShader(sources.m_Desc);
+	ASSERT_NE(shader, nullptr);
+	EXPECT_EQ(ToString(shader), "VS vs_5_1");
+	EXPECT_EQ(compiler.m_Compiles, 2u);
+	EXPECT_EQ(cache.GetStats().m_DiskHits, 0u);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// A directory under the system temp directory, named after the running test and emptied when
+// the test starts and ends.
+class ScopedTestDirectory
+{
+public:
+	ScopedTestDirectory()
+	{
+		const ::testing::TestInfo* test = ::testing::UnitTest::GetInstance()->current_test_info();
+		m_Path = std::filesystem::temp_directory_path() / "RenderDuckEngineTests" / (std::string(test->test_suite_name()) + "." + test->name());
+		std::filesystem::remove_all(m_Path);
+		std::filesystem::create_directories(m_Path);
+	}
+
+	~ScopedTestDirectory()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_Path, error);
+	}
+
+	const std::filesystem::path& GetPath() const { return m_Path; }
+	std::filesystem::path operator/(const std::filesystem::path& name) const { return m_Path / name; }
+
+private:
+	std::filesystem::path m_Path;
+};
+
+inline void WriteTestFile(const std::filesystem::path& path, const std::string& contents)
+{
+	std::filesystem::create_directories(path.parent_path());
+	std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+}
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "DdsFile.h"
+#include "TextureAtlas.h"
+
+namespace
+{
+	const u32 c_Normal = 0xffff8080;
+
+	// A gradient that differs in every texel and between entries.
+	std::vector<u8> MakeImage(u32 width, u32 height, u32 seed)
+	{
+		std::vector<u8> pixels(width * height * 4);
+		for (u32 y = 0; y < height; ++y)
+		{
+			for (u32 x = 0; x < width; ++x)
+			{
+				u8* texel = &pixels[(y * width + x) * 4];
+				texel[0] = (u8)(x * 255 / width);
+				texel[1] = (u8)(y * 255 / height);
+				texel[2] = (u8)(seed * 37);
+				texel[3] = 255;
+			}
+		}
+		return pixels;
+	}
+
+	u32 ReadTexel(const DdsSubresource& subresource, u32 x, u32 y)
+	{
+		u32 texel;
+		memcpy(&texel, subresource.m_Data + (u64)y * subresource.m_RowPitch + x * 4, 4);
+		return texel;
+	}
+
+	// Colour layer of various sizes, normal layer always a 1x1 default map.
+	struct AtlasFixture
+	{
+		explicit AtlasFixture(u32 pageSize)
+			: m_Packer(2, MakeSettings(pageSize))
+		{
+			const u32 sizes[][2] = { { 64, 64 }, { 32, 96 }, { 128, 32 }, { 160, 160 }, { 64, 64 }, { 48, 16 }, { 16, 16 }, { 96, 48 } };
+			for (u32 i = 0; i < std::size(sizes); ++i)
+			{
+				m_Images.push_back(MakeImage(sizes[i][0], sizes[i][1], i));
+				const TextureAtlasImage layers[2] = { { m_Images.back().data(), sizes[i][0], sizes[i][1] }, { (const u8*)&c_Normal, 1, 1 } };
+				EXPECT_TRUE(m_Packer.CanAdd(layers));
+				m_Packer.Add(layers);
+			}
+			m_Packer.Pack();
+		}
+
+		static TextureAtlasSettings MakeSettings(u32 pageSize)
+		{
+			TextureAtlasSettings settings;
+			settings.m_PageSize = pageSize;
+			settings.m_MipCount = 3;
+			return settings;
+		}
+
+		TextureAtlasPacker m_Packer;
+		std::vector<std::vector<u8>> m_Images;
+	};
+}
+
+TEST(TextureAtlas, RejectsLayersThatCannotBePacked)
+{
+	TextureAtlasPacker packer(2, AtlasFixture::MakeSettings(256));
+	ASSERT_EQ(packer.GetAlignment(), 16u);
+
+	const std::vector<u8> square = MakeImage(64, 64, 0);
+	const std::vector<u8> wide = MakeImage(128, 64, 0);
+	const std::vector<u8> unaligned = MakeImage(40, 40, 0);
+	const std::vector<u8> huge = MakeImage(240, 240, 0);
+
+	const TextureAtlasImage sameSize[2] = { { square.data(), 64, 64 }, { square.data(), 64, 64 } };
+	const TextureAtlasImage withDefault[2] = { { square.data(), 64, 64 }, { (const u8*)&c_Normal, 1, 1 } };
+	const TextureAtlasImage mismatched[2] = { { square.data(), 64, 64 }, { wide.data(), 128, 64 } };
+	const TextureAtlasImage notAligned[2] = { { unaligned.data(), 40, 40 }, { (const u8*)&c_Normal, 1, 1 } };
+	const TextureAtlasImage noRoomForGutter[2] = { { huge.data(), 240, 240 }, { (const u8*)&c_Normal, 1, 1 } };
+	const TextureAtlasImage missing[2] = { { square.data(), 64, 64 }, { nullptr, 64, 64 } };
+
+	EXPECT_TRUE(packer.CanAdd(sameSize));
+	EXPECT_TRUE(packer.CanAdd(withDefault));
+	EXPECT_FALSE(packer.CanAdd(mismatched));
+	EXPECT_FALSE(packer.CanAdd(notAligned));
+	EXPECT_FALSE(packer.CanAdd(noRoomForGutter));
+	EXPECT_FALSE(packer.CanAdd(missing));
+}
+
+TEST(TextureAtlas, RegionsAreAlignedAndKeepTheirGuttersApart)
+{
+	AtlasFixture atlas(256);
+	const TextureAtlasPacker& packer = atlas.m_Packer;
+	const u32 gutter = packer.GetAlignment();
+	ASSERT_GT(packer.GetPageCount(), 1u);
+
+	std::vector<std::pair<u32, u32>> pageSizes(packer.GetPageCount());
+	for (u32 page = 0; page < packer.GetPageCount(); ++page)
+	{
+		std::vector<u8> file;
+		packer.BuildPage(page, 0, false, file);
+		DdsFile dds;
+		ASSERT_EQ(dds.Parse(file.data(), file.size()), DdsError::None);
+		EXPECT_EQ(dds.GetDesc().m_MipCount, 3u);
+		EXPECT_LE(dds.GetDesc().m_Width, 256u);
+		EXPECT_LE(dds.GetDesc().m_Height, 256u);
+		pageSizes[page] = { dds.GetDesc().m_Width, dds.GetDesc().m_Height };
+	}
+
+	for (u32 entry = 0; entry < packer.GetEntryCount(); ++entry)
+	{
+		const TextureAtlasRegion& region = packer.GetRegion(entry);
+		ASSERT_LT(region.m_Page, packer.GetPageCount());
+		EXPECT_EQ(region.m_X % gutter, 0u);
+		EXPECT_EQ(region.m_Y % gutter, 0u);
+		EXPECT_EQ(region.m_Width, atlas.m_Images[entry].size() / 4 / region.m_Height);
+
+		// The gutter stays on the page.
+		const auto [pageWidth, pageHeight] = pageSizes[region.m_Page];
+		EXPECT_GE(region.m_X, gutter);
+		EXPECT_GE(region.m_Y, gutter);
+		EXPECT_LE(region.m_X + region.m_Width + gutter, pageWidth);
+		EXPECT_LE(region.m_Y + region.m_Height + gutter, pageHeight);
+
+		// UV 0 and 1 land on the region's edges.
+		EXPECT_FLOAT_EQ(region.m_OffsetU * pageWidth, (float)region.m_X);
+		EXPECT_FLOAT_EQ(region.m_OffsetV * pageHeight, (float)region.m_Y);
+		EXPECT_FLOAT_EQ((region.m_OffsetU + region.m_ScaleU) * pageWidth, (float)(region.m_X + region.m_Width));
+		EXPECT_FLOAT_EQ((region.m_OffsetV + region.m_ScaleV) * pageHeight, (float)(region.m_Y + region.m_Height));
+
+		// No two regions on a page overlap once each is grown by its gutter.
+		for (u32 other = 0; other < entry; ++other)
+		{
+			const TextureAtlasRegion& otherRegion = packer.GetRegion(other);
+			if (otherRegion.m_Page != region.m_Page)
+			{
+				continue;
+			}
+			const bool apart = region.m_X + region.m_Width + gutter <= otherRegion.m_X - gutter ||
+				otherRegion.m_X + otherRegion.m_Width + gutter <= region.m_X - gutter ||
+				region.m_Y + region.m_Height + gutter <= otherRegion.m_Y - gutter ||
+				otherRegion.m_Y + otherRegion.m_Height + gutter <= region.m_Y - gutter;
+			EXPECT_TRUE(apart) << "entries " << other << " and " << entry;
+		}
+	}
+}
+
+TEST(TextureAtlas, GuttersRepeatEdgeTexelsAtEveryMip)
+{
+	AtlasFixture atlas(256);
+	const TextureAtlasPacker& packer = atlas.m_Packer;
+
+	for (u32 layer = 0; layer < 2; ++layer)
+	{
+		for (u32 page = 0; page < packer.GetPageCount(); ++page)
+		{
+			std::vector<u8> file;
+			packer.BuildPage(page, layer, false, file);
+			DdsFile dds;
+			ASSERT_EQ(dds.Parse(file.data(), file.size()), DdsError::None);
+
+			for (u32 entry = 0; entry < packer.GetEntryCount(); ++entry)
+			{
+				const TextureAtlasRegion& region = packer.GetRegion(entry);
+				if (region.m_Page != page)
+				{
+					continue;
+				}
+
+				for (u32 mip = 0; mip < dds.GetDesc().m_MipCount; ++mip)
+				{
+					const DdsSubresource& subresource = dds.GetSubresource(mip, 0);
+					const s32 gutter = (s32)(packer.GetAlignment() >> mip);
+					const s32 width = (s32)(region.m_Width >> mip);
+					const s32 height = (s32)(region.m_Height >> mip);
+					const u32 x0 = region.m_X >> mip;
+					const u32 y0 = region.m_Y >> mip;
+
+					u32 mismatches = 0;
+					for (s32 y = -gutter; y < height + gutter; ++y)
+					{
+						for (s32 x = -gutter; x < width + gutter; ++x)
+						{
+							const s32 edgeX = std::clamp(x, 0, width - 1);
+							const s32 edgeY = std::clamp(y, 0, height - 1);
+							const u32 texel = ReadTexel(subresource, x0 + x, y0 + y);
+							mismatches += texel != ReadTexel(subresource, x0 + edgeX, y0 + edgeY);
+
+							// The top mip holds the source untouched, the default normal map is stretched.
+							if (layer == 1)
+							{
+								mismatches += texel != c_Normal;
+							}
+							else if (mip == 0 && x == edgeX && y == edgeY)
+							{
+								mismatches += memcmp(&texel, &atlas.m_Images[entry][(y * width + x) * 4], 4) != 0;
+							}
+						}
+					}
+					EXPECT_EQ(mismatches, 0u) << "layer " << layer << " entry " << entry << " mip " << mip;
+				}
+			}
+		}
+	}
+}
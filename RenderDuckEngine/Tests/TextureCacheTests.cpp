@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include "TestFiles.h"
+#include "TextureCache.h"
+
+namespace
+{
+	// An 8x8 RGBA8 texture with one mip, every texel a different colour.
+	std::string MakeDds(u8 seed)
+	{
+		DdsTextureDesc desc;
+		desc.m_Format = DdsFormat::R8G8B8A8_UNorm;
+		desc.m_Width = 8;
+		desc.m_Height = 8;
+
+		std::vector<u8> file;
+		WriteDdsHeaders(desc, file);
+		for (u32 i = 0; i < 8 * 8; ++i)
+		{
+			const u8 texel[4] = { (u8)i, (u8)(i * 3), seed, 255 };
+			file.insert(file.end(), texel, texel + 4);
+		}
+		return std::string(file.begin(), file.end());
+	}
+
+	// Rewrites the file and moves its write time on, so the change is seen even when the clock is coarse.
+	void RewriteTestFile(const std::filesystem::path& path, const std::string& contents)
+	{
+		const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path);
+		WriteTestFile(path, contents);
+		std::filesystem::last_write_time(path, writeTime + std::chrono::seconds(1));
+	}
+
+	// Offset of the DDS header's reserved fields, which nothing reads.
+	const size_t c_ReservedOffset = 4 + 7 * 4;
+}
+
+TEST(TextureCache, SamePathHitsWithoutReading)
+{
+	ScopedTestDirectory directory;
+	const std::filesystem::path path = directory / "a.dds";
+	WriteTestFile(path, MakeDds(0));
+
+	TextureCache cache;
+	bool isNew = false;
+	const TextureCacheId id = cache.Acquire(path, isNew);
+	ASSERT_NE(id, c_InvalidTextureCacheId);
+	EXPECT_TRUE(isNew);
+	EXPECT_EQ(cache.GetDesc(id).m_Width, 8u);
+
+	// The same file under a path spelled another way.
+	std::filesystem::create_directories(directory / "sub");
+	EXPECT_EQ(cache.Acquire(directory / "sub/../a.dds", isNew), id);
+	EXPECT_FALSE(isNew);
+	EXPECT_EQ(cache.GetRefCount(id), 2u);
+
+	const TextureCacheStats stats = cache.GetStats();
+	EXPECT_EQ(stats.m_Acquires, 2u);
+	EXPECT_EQ(stats.m_PathHits, 1u);
+	EXPECT_EQ(stats.m_Misses, 1u);
+	EXPECT_EQ(stats.m_Textures, 1u);
+	EXPECT_EQ(stats.m_TextureBytes, 8u * 8u * 4u);
+	EXPECT_EQ(stats.m_SavedBytes, 8u * 8u * 4u);
+}
+
+TEST(TextureCache, SameTexelsUnderAnotherNameShareATexture)
+{
+	ScopedTestDirectory directory;
+	WriteTestFile(directory / "a.dds", MakeDds(0));
+	WriteTestFile(directory / "copy.dds", MakeDds(0));
+	WriteTestFile(directory / "other.dds", MakeDds(1));
+
+	TextureCache cache;
+	bool isNew = false;
+	const TextureCacheId id = cache.Acquire(directory / "a.dds", isNew);
+	EXPECT_EQ(cache.Acquire(directory / "copy.dds", isNew), id);
+	EXPECT_FALSE(isNew);
+
+	const std::string inMemory = MakeDds(0);
+	EXPECT_EQ(cache.Acquire((const u8*)inMemory.data(), inMemory.size(), isNew), id);
+	EXPECT_FALSE(isNew);
+
+	const TextureCacheId other = cache.Acquire(directory / "other.dds", isNew);
+	EXPECT_NE(other, id);
+	EXPECT_TRUE(isNew);
+
+	const TextureCacheStats stats = cache.GetStats();
+	EXPECT_EQ(stats.m_ContentHits, 2u);
+	EXPECT_EQ(stats.m_PathHits, 0u);
+	EXPECT_EQ(stats.m_Misses, 2u);
+	EXPECT_EQ(stats.m_Textures, 2u);
+	EXPECT_EQ(cache.GetRefCount(id), 3u);
+}
+
+TEST(TextureCache, HeaderOnlyEditsKeepTheTexture)
+{
+	ScopedTestDirectory directory;
+	const std::filesystem::path path = directory / "a.dds";
+	std::string contents = MakeDds(0);
+	WriteTestFile(path, contents);
+
+	TextureCache cache;
+	bool isNew = false;
+	const TextureCacheId id = cache.Acquire(path, isNew);
+	const u64 hash = cache.GetContentHash(id);
+
+	// The file changed, so it is read again, but the texels and how they are read did not.
+	contents[c_ReservedOffset] = 'X';
+	RewriteTestFile(path, contents);
+	EXPECT_EQ(cache.Acquire(path, isNew), id);
+	EXPECT_FALSE(isNew);
+	EXPECT_EQ(cache.GetContentHash(id), hash);
+
+	TextureCacheStats stats = cache.GetStats();
+	EXPECT_EQ(stats.m_PathHits, 0u);
+	EXPECT_EQ(stats.m_ContentHits, 1u);
+
+	// Read again now, the path hits once more.
+	EXPECT_EQ(cache.Acquire(path, isNew), id);
+	stats = cache.GetStats();
+	EXPECT_EQ(stats.m_PathHits, 1u);
+	EXPECT_EQ(cache.GetRefCount(id), 3u);
+}
+
+TEST(TextureCache, TexelEditsMakeANewTexture)
+{
+	ScopedTestDirectory directory;
+	const std::filesystem::path path = directory / "a.dds";
+	std::string contents = MakeDds(0);
+	WriteTestFile(path, contents);
+
+	TextureCache cache;
+	bool isNew = false;
+	const TextureCacheId id = cache.Acquire(path, isNew);
+
+	// Same size, one texel differs.
+	contents.back() = 0;
+	RewriteTestFile(path, contents);
+	const TextureCacheId edited = cache.Acquire(path, isNew);
+	ASSERT_NE(edited, c_InvalidTextureCacheId);
+	EXPECT_NE(edited, id);
+	EXPECT_TRUE(isNew);
+	EXPECT_NE(cache.GetContentHash(edited), cache.GetContentHash(id));
+
+	// The old texture lives on for whoever still holds it.
+	EXPECT_EQ(cache.GetRefCount(id), 1u);
+	EXPECT_EQ(cache.GetStats().m_Misses, 2u);
+	EXPECT_EQ(cache.GetStats().m_Textures, 2u);
+}
+
+TEST(TextureCache, ReleasedTexturesAreLoadedAgain)
+{
+	ScopedTestDirectory directory;
+	const std::filesystem::path path = directory / "a.dds";
+	WriteTestFile(path, MakeDds(0));
+	WriteTestFile(directory / "b.dds", MakeDds(1));
+
+	TextureCache cache;
+	bool isNew = false;
+	const TextureCacheId id = cache.Acquire(path, isNew);
+	cache.AddRef(id);
+	EXPECT_FALSE(cache.Release(id));
+	EXPECT_TRUE(cache.Release(id));
+	EXPECT_EQ(cache.GetStats().m_Textures, 0u);
+	EXPECT_EQ(cache.GetStats().m_TextureBytes, 0u);
+
+	// The freed id goes to another texture, the old path record must not hand it out.
+	const TextureCacheId reused = cache.Acquire(directory / "b.dds", isNew);
+	EXPECT_EQ(reused, id);
+	EXPECT_TRUE(isNew);
+
+	const TextureCacheId reloaded = cache.Acquire(path, isNew);
+	EXPECT_NE(reloaded, reused);
+	EXPECT_TRUE(isNew);
+	EXPECT_EQ(cache.GetStats().m_PathHits, 0u);
+	EXPECT_EQ(cache.GetStats().m_Misses, 3u);
+}
+
+TEST(TextureCache, UnreadableFilesFail)
+{
+	ScopedTestDirectory directory;
+	WriteTestFile(directory / "junk.dds", "not a texture");
+
+	TextureCache cache;
+	bool isNew = true;
+	EXPECT_EQ(cache.Acquire(directory / "missing.dds", isNew), c_InvalidTextureCacheId);
+	EXPECT_FALSE(isNew);
+	EXPECT_EQ(cache.Acquire(directory / "junk.dds", isNew), c_InvalidTextureCacheId);
+
+	const std::string truncated = MakeDds(0).substr(0, 200);
+	EXPECT_EQ(cache.Acquire((const u8*)truncated.data(), truncated.size(), isNew), c_InvalidTextureCacheId);
+	EXPECT_EQ(cache.GetStats().m_Failures, 3u);
+	EXPECT_EQ(cache.GetStats().m_Textures, 0u);
+}
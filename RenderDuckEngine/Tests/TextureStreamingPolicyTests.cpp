@@ -0,0 +1,257 @@
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "TextureStreamingPolicy.h"
+
+namespace
+{
+	// Mip sizes of a square RGBA8 texture, most detailed first.
+	std::vector<u64> MakeMipSizes(u32 size)
+	{
+		std::vector<u64> mipSizes;
+		for (; size > 0; size >>= 1)
+		{
+			mipSizes.push_back((u64)size * size * 4);
+		}
+		return mipSizes;
+	}
+
+	u64 GetBytesFrom(const std::vector<u64>& mipSizes, u32 mip)
+	{
+		u64 bytes = 0;
+		for (; mip < mipSizes.size(); ++mip)
+		{
+			bytes += mipSizes[mip];
+		}
+		return bytes;
+	}
+
+	// Runs frames in which the textures in seen are drawn at full detail, completing every request
+	// straight away, until no more requests come. Returns the requests in the order they came.
+	std::vector<TextureStreamingRequest> RunUntilSettled(TextureStreamingPolicy& policy, const std::vector<StreamedTextureId>& seen, u32 size)
+	{
+		std::vector<TextureStreamingRequest> issued;
+		std::vector<TextureStreamingRequest> requests;
+		for (u32 frame = 0; frame < 100; ++frame)
+		{
+			policy.BeginFrame();
+			for (StreamedTextureId id : seen)
+			{
+				policy.RequestDensity(id, (float)size);
+			}
+			policy.Update(requests);
+			if (requests.empty())
+			{
+				break;
+			}
+			for (const TextureStreamingRequest& request : requests)
+			{
+				policy.OnRequestComplete(request.m_Texture, true);
+				issued.push_back(request);
+			}
+		}
+		EXPECT_TRUE(requests.empty()) << "requests never settled";
+		return issued;
+	}
+}
+
+TEST(TextureStreamingPolicy, LoadsTheMipsThatAreSeen)
+{
+	const std::vector<u64> mipSizes = MakeMipSizes(1024);
+	TextureStreamingPolicy policy(64ull << 20, 4);
+	const StreamedTextureId id = policy.AddTexture(1024, 1024, mipSizes, 4);
+
+	std::vector<TextureStreamingRequest> requests;
+	policy.BeginFrame();
+	policy.Update(requests);
+	EXPECT_TRUE(requests.empty());
+	EXPECT_EQ(policy.GetStats().m_ResidentBytes, GetBytesFrom(mipSizes, 4));
+
+	// 64 pixels per UV draws the 1024 texture at 64x64, which is resident already.
+	policy.BeginFrame();
+	policy.RequestDensity(id, 64.0f);
+	policy.Update(requests);
+	EXPECT_TRUE(requests.empty());
+
+	policy.BeginFrame();
+	policy.RequestDensity(id, 100.0f);
+	policy.Update(requests);
+	ASSERT_EQ(requests.size(), 1u);
+	EXPECT_EQ(requests[0].m_FirstMip, 3u);
+
+	// One request per texture while it is in flight.
+	policy.BeginFrame();
+	policy.RequestDensity(id, 1024.0f);
+	policy.Update(requests);
+	EXPECT_TRUE(requests.empty());
+	EXPECT_TRUE(policy.IsPending(id));
+
+	policy.OnRequestComplete(id, true);
+	EXPECT_EQ(policy.GetResidentMip(id), 3u);
+	policy.BeginFrame();
+	policy.RequestDensity(id, 1024.0f);
+	policy.Update(requests);
+	ASSERT_EQ(requests.size(), 1u);
+	EXPECT_EQ(requests[0].m_FirstMip, 0u);
+	policy.OnRequestComplete(id, true);
+	EXPECT_EQ(policy.GetStats().m_ResidentBytes, GetBytesFrom(mipSizes, 0));
+	EXPECT_EQ(policy.GetStats().m_Loads, 2u);
+}
+
+TEST(TextureStreamingPolicy, FailedTexturesAreNotStreamedAgain)
+{
+	TextureStreamingPolicy policy(64ull << 20, 4);
+	const StreamedTextureId id = policy.AddTexture(1024, 1024, MakeMipSizes(1024), 4);
+
+	std::vector<TextureStreamingRequest> requests;
+	policy.BeginFrame();
+	policy.RequestDensity(id, 1024.0f);
+	policy.Update(requests);
+	ASSERT_EQ(requests.size(), 1u);
+	policy.OnRequestComplete(id, false);
+	EXPECT_EQ(policy.GetResidentMip(id), 4u);
+
+	policy.BeginFrame();
+	policy.RequestDensity(id, 1024.0f);
+	policy.Update(requests);
+	EXPECT_TRUE(requests.empty());
+}
+
+TEST(TextureStreamingPolicy, EvictsTheLeastRecentlyUsedFirst)
+{
+	// Room for three textures in full, and the small mips of the fourth.
+	const u32 c_Size = 512;
+	const u32 c_TailMip = 3;
+	const std::vector<u64> mipSizes = MakeMipSizes(c_Size);
+	const u64 budget = 3 * GetBytesFrom(mipSizes, 0) + GetBytesFrom(mipSizes, c_TailMip);
+	TextureStreamingPolicy policy(budget, 4);
+
+	std::vector<StreamedTextureId> ids;
+	for (u32 i = 0; i < 4; ++i)
+	{
+		ids.push_back(policy.AddTexture(c_Size, c_Size, mipSizes, c_TailMip));
+	}
+
+	// 0, 1 and 2 are loaded in that order and then left alone.
+	for (u32 i = 0; i < 3; ++i)
+	{
+		RunUntilSettled(policy, { ids[i] }, c_Size);
+		EXPECT_EQ(policy.GetResidentMip(ids[i]), 0u);
+	}
+	EXPECT_EQ(policy.GetStats().m_Evictions, 0u);
+
+	// 3 only gets in by dropping detail from 0, the one used longest ago.
+	std::vector<TextureStreamingRequest> issued = RunUntilSettled(policy, { ids[3] }, c_Size);
+	EXPECT_EQ(policy.GetResidentMip(ids[3]), 0u);
+	EXPECT_GT(policy.GetResidentMip(ids[0]), 0u);
+	EXPECT_EQ(policy.GetResidentMip(ids[1]), 0u);
+	EXPECT_EQ(policy.GetResidentMip(ids[2]), 0u);
+	ASSERT_FALSE(issued.empty());
+	EXPECT_EQ(issued[0].m_Texture, ids[0]);
+	EXPECT_LE(policy.GetStats().m_ResidentBytes, budget);
+
+	// Drawing 0 again now makes 1 the oldest, while 3 is still in use and keeps its detail.
+	issued = RunUntilSettled(policy, { ids[0], ids[3] }, c_Size);
+	EXPECT_EQ(policy.GetResidentMip(ids[0]), 0u);
+	EXPECT_GT(policy.GetResidentMip(ids[1]), 0u);
+	EXPECT_EQ(policy.GetResidentMip(ids[2]), 0u);
+	EXPECT_EQ(policy.GetResidentMip(ids[3]), 0u);
+	ASSERT_FALSE(issued.empty());
+	EXPECT_EQ(issued[0].m_Texture, ids[1]);
+	EXPECT_LE(policy.GetStats().m_ResidentBytes, budget);
+}
+
+TEST(TextureStreamingPolicy, TexturesInUseAreNotEvicted)
+{
+	const std::vector<u64> mipSizes = MakeMipSizes(1024);
+	TextureStreamingPolicy policy(8ull << 20, 4);
+	const StreamedTextureId a = policy.AddTexture(1024, 1024, mipSizes, 4);
+	const StreamedTextureId b = policy.AddTexture(1024, 1024, mipSizes, 4);
+
+	// Both in full would not fit, b settles for what is left beside a.
+	RunUntilSettled(policy, { a }, 1024);
+	RunUntilSettled(policy, { a, b }, 1024);
+	EXPECT_EQ(policy.GetResidentMip(a), 0u);
+	EXPECT_EQ(policy.GetResidentMip(b), 1u);
+	EXPECT_EQ(policy.GetStats().m_Evictions, 0u);
+	EXPECT_LE(policy.GetStats().m_ResidentBytes, 8ull << 20);
+}
+
+TEST(TextureStreamingPolicy, ShrinkingTheBudgetEvictsDownToTheSmallMips)
+{
+	const std::vector<u64> mipSizes = MakeMipSizes(1024);
+	TextureStreamingPolicy policy(64ull << 20, 4);
+	const StreamedTextureId a = policy.AddTexture(1024, 1024, mipSizes, 4);
+	const StreamedTextureId b = policy.AddTexture(1024, 1024, mipSizes, 4);
+	RunUntilSettled(policy, { a, b }, 1024);
+	EXPECT_EQ(policy.GetResidentMip(a), 0u);
+	EXPECT_EQ(policy.GetResidentMip(b), 0u);
+
+	// The small mips stay however far over the budget they are.
+	policy.SetBudget(1);
+	const std::vector<TextureStreamingRequest> issued = RunUntilSettled(policy, {}, 1024);
+	EXPECT_EQ(issued.size(), 2u);
+	EXPECT_EQ(policy.GetResidentMip(a), 4u);
+	EXPECT_EQ(policy.GetResidentMip(b), 4u);
+	EXPECT_EQ(policy.GetStats().m_ResidentBytes, 2 * GetBytesFrom(mipSizes, 4));
+}
+
+TEST(TextureStreamingPolicy, RandomViewsStayWithinBudget)
+{
+	// Twelve textures seen at random densities, with requests completing a random number of frames
+	// later and a few failing.
+	const u64 budget = 6ull << 20;
+	const u32 c_MaxPending = 3;
+	TextureStreamingPolicy policy(budget, c_MaxPending);
+	std::vector<StreamedTextureId> ids;
+	for (u32 i = 0; i < 12; ++i)
+	{
+		ids.push_back(policy.AddTexture(512, 512, MakeMipSizes(512), 3));
+	}
+
+	std::mt19937 random(1);
+	std::vector<TextureStreamingRequest> requests;
+	std::vector<TextureStreamingRequest> inFlight;
+	for (u32 frame = 0; frame < 20000; ++frame)
+	{
+		policy.BeginFrame();
+		for (StreamedTextureId id : ids)
+		{
+			if (random() % 3 == 0)
+			{
+				policy.RequestDensity(id, (float)(random() % 1024));
+			}
+		}
+		policy.Update(requests);
+		for (const TextureStreamingRequest& request : requests)
+		{
+			EXPECT_LE(request.m_FirstMip, 3u);
+			EXPECT_TRUE(policy.IsPending(request.m_Texture));
+		}
+		inFlight.insert(inFlight.end(), requests.begin(), requests.end());
+		ASSERT_EQ(policy.GetStats().m_PendingRequests, inFlight.size());
+		ASSERT_LE(inFlight.size(), c_MaxPending);
+
+		for (size_t i = 0; i < inFlight.size();)
+		{
+			if (random() % 2 == 0)
+			{
+				const TextureStreamingRequest request = inFlight[i];
+				const bool succeeded = random() % 100 != 0;
+				const u32 previousMip = policy.GetResidentMip(request.m_Texture);
+				policy.OnRequestComplete(request.m_Texture, succeeded);
+				EXPECT_EQ(policy.GetResidentMip(request.m_Texture), succeeded ? request.m_FirstMip : previousMip);
+				inFlight.erase(inFlight.begin() + i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+		ASSERT_LE(policy.GetStats().m_ResidentBytes, budget);
+	}
+
+	EXPECT_GT(policy.GetStats().m_Loads, 100u);
+	EXPECT_GT(policy.GetStats().m_Evictions, 100u);
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+
+#include "DescriptorAllocator.h"
+#include "FakeGpuTimeline.h"
+#include "TransientDescriptorRing.h"
+
+TEST(TransientDescriptorRing, EachFrameHasItsOwnPartition)
+{
+	// Three partitions of 8 after 100 persistent descriptors.
+	FakeGpuTimeline timeline;
+	TransientDescriptorRing ring(100, 8, 3, &timeline);
+
+	for (u32 frame = 0; frame < 6; ++frame)
+	{
+		const u32 partition = frame % 3;
+		ring.BeginFrame(partition);
+		EXPECT_EQ(ring.GetUsedCount(), 0u);
+		EXPECT_EQ(ring.Allocate(3), 100 + partition * 8);
+		EXPECT_EQ(ring.Allocate(5), 100 + partition * 8 + 3);
+		ring.EndFrame(frame + 1);
+		timeline.Complete(frame + 1);
+	}
+	EXPECT_EQ(ring.GetPeakUsedCount(), 8u);
+
+	EXPECT_FALSE(ring.Contains(99));
+	EXPECT_TRUE(ring.Contains(100));
+	EXPECT_TRUE(ring.Contains(123));
+	EXPECT_FALSE(ring.Contains(124));
+}
+
+TEST(TransientDescriptorRing, FullPartitionsFailWithoutWrapping)
+{
+	FakeGpuTimeline timeline;
+	TransientDescriptorRing ring(0, 8, 2, &timeline);
+
+	ring.BeginFrame(1);
+	EXPECT_EQ(ring.Allocate(6), 8u);
+	EXPECT_EQ(ring.Allocate(3), c_InvalidDescriptorIndex);
+
+	// Failed allocations still count, so nothing smaller squeezes in after them and nothing spills
+	// into the next partition.
+	EXPECT_EQ(ring.Allocate(2), c_InvalidDescriptorIndex);
+	EXPECT_EQ(ring.Allocate(1), c_InvalidDescriptorIndex);
+	EXPECT_EQ(ring.GetUsedCount(), 8u);
+	ring.EndFrame(1);
+	EXPECT_EQ(ring.GetPeakUsedCount(), 8u);
+
+	// The next frame starts empty.
+	timeline.Complete(1);
+	ring.BeginFrame(0);
+	EXPECT_EQ(ring.Allocate(8), 0u);
+	EXPECT_EQ(ring.Allocate(1), c_InvalidDescriptorIndex);
+}
+
+TEST(TransientDescriptorRing, BeginFrameWaitsForThePartitionsLastFrame)
+{
+	FakeGpuTimeline timeline;
+	TransientDescriptorRing ring(0, 4, 2, &timeline);
+
+	ring.BeginFrame(0);
+	ring.Allocate(4);
+	ring.EndFrame(5);
+	ring.BeginFrame(1);
+	ring.EndFrame(6);
+
+	// Partition 0 was last used by the frame signalling 5.
+	std::atomic<bool> begun = false;
+	std::thread frame([&]()
+	{
+		ring.BeginFrame(0);
+		begun.store(true);
+	});
+
+	timeline.Complete(4);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_FALSE(begun.load()) << "partition reused before the GPU finished with it";
+
+	timeline.Complete(5);
+	frame.join();
+	EXPECT_TRUE(begun.load());
+	EXPECT_EQ(ring.Allocate(4), 0u);
+}
+
+// Meant to be run under -DSANITIZE=thread as well. Recording workers allocate at the same time,
+// every descriptor handed out in a frame must be unique and inside the frame's partition.
+TEST(TransientDescriptorRing, ConcurrentAllocationsNeverOverlap)
+{
+	const u32 c_DescriptorsPerFrame = 4096;
+	const u32 c_ThreadCount = 8;
+
+	FakeGpuTimeline timeline;
+	TransientDescriptorRing ring(16, c_DescriptorsPerFrame, 2, &timeline);
+
+	for (u32 frame = 0; frame < 20; ++frame)
+	{
+		const u32 partition = frame % 2;
+		ring.BeginFrame(partition);
+
+		// Together the threads ask for more than fits, so the partition fills up.
+		std::vector<std::vector<std::pair<u32, u32>>> ranges(c_ThreadCount);
+		std::vector<std::thread> threads;
+		for (u32 thread = 0; thread < c_ThreadCount; ++thread)
+		{
+			threads.emplace_back([&, thread]()
+			{
+				for (u32 i = 0; i < 400; ++i)
+				{
+					const u32 count = 1 + (i + thread) % 4;
+					const u32 index = ring.Allocate(count);
+					if (index != c_InvalidDescriptorIndex)
+					{
+						ranges[thread].push_back({ index, count });
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		std::set<u32> indices;
+		u32 allocated = 0;
+		for (const auto& threadRanges : ranges)
+		{
+			for (const std::pair<u32, u32>& range : threadRanges)
+			{
+				for (u32 index = range.first; index < range.first + range.second; ++index)
+				{
+					ASSERT_GE(index, 16 + partition * c_DescriptorsPerFrame);
+					ASSERT_LT(index, 16 + (partition + 1) * c_DescriptorsPerFrame);
+					ASSERT_TRUE(indices.insert(index).second) << "index " << index << " handed out twice";
+				}
+				allocated += range.second;
+			}
+		}
+		EXPECT_GT(allocated, c_DescriptorsPerFrame - 4);
+		EXPECT_EQ(ring.GetUsedCount(), c_DescriptorsPerFrame);
+
+		ring.EndFrame(frame + 1);
+		timeline.Complete(frame + 1);
+	}
+}
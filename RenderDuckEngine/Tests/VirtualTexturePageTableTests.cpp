@@ -0,0 +1,264 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <tuple>
+
+#include "VirtualTexturePageTable.h"
+
+namespace
+{
+	typedef std::tuple<u32, u32, u32> PageKey;
+
+	PageKey GetParent(const PageKey& page)
+	{
+		return { std::get<0>(page) + 1, std::get<1>(page) / 2, std::get<2>(page) / 2 };
+	}
+
+	// The page table as the loads say it should be, with every slot's contents.
+	struct ShadowPageTable
+	{
+		explicit ShadowPageTable(const VirtualTexturePageTable& table) : m_Table(table) {}
+
+		bool HasSlot(const PageKey& page) const { return m_Resident.count(page) != 0 || m_Loading.count(page) != 0; }
+		bool IsTop(const PageKey& page) const { return std::get<0>(page) + 1 == m_Table.GetMipCount(); }
+
+		// What a feedback entry for page marks used: the first page with a slot on the way up and
+		// every resident page above it.
+		void AddUsed(PageKey page, std::set<PageKey>& used) const
+		{
+			while (!HasSlot(page) && !IsTop(page))
+			{
+				page = GetParent(page);
+			}
+			for (;;)
+			{
+				if (m_Resident.count(page) != 0)
+				{
+					used.insert(page);
+				}
+				if (IsTop(page))
+				{
+					return;
+				}
+				page = GetParent(page);
+			}
+		}
+
+		// Packed entry of the finest resident page covering page.
+		u32 GetExpectedEntry(PageKey page) const
+		{
+			for (;;)
+			{
+				const auto it = m_Resident.find(page);
+				if (it != m_Resident.end())
+				{
+					const u32 slotX = it->second % m_Table.GetDesc().m_PhysicalPagesX;
+					const u32 slotY = it->second / m_Table.GetDesc().m_PhysicalPagesX;
+					return slotX | (slotY << 8) | (std::get<0>(page) << 16);
+				}
+				if (IsTop(page))
+				{
+					return ~0u;
+				}
+				page = GetParent(page);
+			}
+		}
+
+		const VirtualTexturePageTable& m_Table;
+		std::map<PageKey, u32> m_Resident;
+		std::map<PageKey, u32> m_Loading;
+		std::set<PageKey> m_Failed;
+	};
+}
+
+TEST(VirtualTexturePageTable, MipsRoundUpToASinglePage)
+{
+	VirtualTextureDesc desc;
+	desc.m_PageSize = 32;
+	desc.m_Width = 40 * 32;
+	desc.m_Height = 24 * 32;
+	VirtualTexturePageTable table(desc, 4);
+
+	const u32 pagesX[] = { 40, 20, 10, 5, 3, 2, 1 };
+	const u32 pagesY[] = { 24, 12, 6, 3, 2, 1, 1 };
+	ASSERT_EQ(table.GetMipCount(), 7u);
+	for (u32 mip = 0; mip < table.GetMipCount(); ++mip)
+	{
+		EXPECT_EQ(table.GetPagesX(mip), pagesX[mip]);
+		EXPECT_EQ(table.GetPagesY(mip), pagesY[mip]);
+	}
+
+	// The pinned page comes first, nothing else is loaded before it is resident.
+	std::vector<VirtualPageLoad> loads;
+	const u32 feedback = EncodeVirtualTextureFeedback(3, 4, 0);
+	table.Update(&feedback, 1, loads);
+	ASSERT_EQ(loads.size(), 1u);
+	EXPECT_EQ(loads[0].m_Mip, 6u);
+	EXPECT_FALSE(table.IsReady());
+	table.OnPageLoaded(loads[0], true);
+	EXPECT_TRUE(table.IsReady());
+
+	// Then one mip at a time towards the page asked for.
+	for (u32 mip = 6; mip-- > 0;)
+	{
+		table.Update(&feedback, 1, loads);
+		ASSERT_EQ(loads.size(), 1u);
+		EXPECT_EQ(loads[0].m_Mip, mip);
+		EXPECT_EQ(loads[0].m_X, 3u >> mip);
+		EXPECT_EQ(loads[0].m_Y, 4u >> mip);
+		table.OnPageLoaded(loads[0], true);
+	}
+	table.Update(&feedback, 1, loads);
+	EXPECT_TRUE(loads.empty());
+	EXPECT_EQ(table.GetStats().m_ResidentEntries, 1u);
+}
+
+// Synthetic feedback from a view wandering over the texture, with loads completing late and some
+// failing, checked against a model of the slots after every frame: the page table holds the
+// finest resident page everywhere, no slot holds two pages, pages used this frame are never
+// evicted, failed pages are not asked for again, and every texel that changed is inside its mip's
+// dirty rectangle.
+TEST(VirtualTexturePageTable, RandomFeedbackKeepsTheTableConsistent)
+{
+	VirtualTextureDesc desc;
+	desc.m_PageSize = 32;
+	desc.m_Width = 40 * 32;
+	desc.m_Height = 24 * 32;
+	desc.m_PhysicalPagesX = 6;
+	desc.m_PhysicalPagesY = 6;
+	const u32 c_MaxPendingLoads = 4;
+	VirtualTexturePageTable table(desc, c_MaxPendingLoads);
+	ShadowPageTable shadow(table);
+
+	std::mt19937 random(7);
+	std::vector<std::vector<u32>> previousTables(table.GetMipCount());
+	std::vector<u32> feedback;
+	std::vector<VirtualPageLoad> loads;
+	std::vector<VirtualPageLoad> inFlight;
+	u32 failures = 0;
+
+	for (u32 frame = 0; frame < 1000; ++frame)
+	{
+		for (u32 mip = 0; mip < table.GetMipCount(); ++mip)
+		{
+			const u32* pageTable = table.GetPageTable(mip);
+			previousTables[mip].assign(pageTable, pageTable + table.GetPagesX(mip) * table.GetPagesY(mip));
+		}
+
+		// A window of pages around a centre that drifts, at a detail that changes now and then,
+		// plus texels nothing was drawn to and entries naming pages that do not exist.
+		const u32 mip = (frame / 50) % 4;
+		const s32 centreX = (s32)((frame * 3 / 7) % table.GetPagesX(0));
+		const s32 centreY = (s32)((frame / 5) % table.GetPagesY(0));
+		feedback.clear();
+		std::set<PageKey> used;
+		for (u32 i = 0; i < 256; ++i)
+		{
+			const u32 x = (u32)std::clamp(centreX + (s32)(random() % 9) - 4, 0, (s32)table.GetPagesX(0) - 1) >> mip;
+			const u32 y = (u32)std::clamp(centreY + (s32)(random() % 7) - 3, 0, (s32)table.GetPagesY(0) - 1) >> mip;
+			feedback.push_back(EncodeVirtualTextureFeedback(x, y, mip));
+			shadow.AddUsed({ mip, x, y }, used);
+		}
+		feedback.push_back(c_VirtualTextureNoFeedback);
+		feedback.push_back(EncodeVirtualTextureFeedback(table.GetPagesX(1), 0, 1));
+		feedback.push_back(EncodeVirtualTextureFeedback(0, 0, table.GetMipCount()));
+
+		table.Update(feedback.data(), (u32)feedback.size(), loads);
+		ASSERT_LE(inFlight.size() + loads.size(), c_MaxPendingLoads);
+
+		for (const VirtualPageLoad& load : loads)
+		{
+			const PageKey page = { load.m_Mip, load.m_X, load.m_Y };
+			const u32 slot = load.m_SlotY * desc.m_PhysicalPagesX + load.m_SlotX;
+			ASSERT_LT(load.m_SlotX, desc.m_PhysicalPagesX);
+			ASSERT_LT(load.m_SlotY, desc.m_PhysicalPagesY);
+			EXPECT_FALSE(shadow.HasSlot(page));
+			EXPECT_EQ(shadow.m_Failed.count(page), 0u) << "failed page requested again";
+
+			// The parent has to be there already, detail arrives coarse to fine.
+			if (!shadow.IsTop(page))
+			{
+				EXPECT_EQ(shadow.m_Resident.count(GetParent(page)), 1u);
+			}
+
+			for (const auto& loading : shadow.m_Loading)
+			{
+				ASSERT_NE(loading.second, slot) << "slot of a page still loading was handed out";
+			}
+			for (auto it = shadow.m_Resident.begin(); it != shadow.m_Resident.end(); ++it)
+			{
+				if (it->second == slot)
+				{
+					EXPECT_FALSE(shadow.IsTop(it->first)) << "pinned page evicted";
+					EXPECT_EQ(used.count(it->first), 0u) << "page used this frame evicted";
+					shadow.m_Resident.erase(it);
+					break;
+				}
+			}
+			shadow.m_Loading[page] = slot;
+			inFlight.push_back(load);
+		}
+
+		// Some loads land this frame, one in thirty fails.
+		for (size_t i = 0; i < inFlight.size();)
+		{
+			if (random() % 3 != 0)
+			{
+				++i;
+				continue;
+			}
+			const VirtualPageLoad load = inFlight[i];
+			const PageKey page = { load.m_Mip, load.m_X, load.m_Y };
+			const bool succeeded = shadow.IsTop(page) || random() % 30 != 0;
+			table.OnPageLoaded(load, succeeded);
+			if (succeeded)
+			{
+				shadow.m_Resident[page] = shadow.m_Loading[page];
+			}
+			else
+			{
+				shadow.m_Failed.insert(page);
+				++failures;
+			}
+			shadow.m_Loading.erase(page);
+			inFlight.erase(inFlight.begin() + i);
+		}
+
+		const VirtualTextureStats& stats = table.GetStats();
+		ASSERT_EQ(stats.m_ResidentPages, shadow.m_Resident.size());
+		ASSERT_EQ(stats.m_PendingLoads, shadow.m_Loading.size());
+		ASSERT_EQ(table.IsReady(), shadow.m_Resident.count({ table.GetMipCount() - 1, 0, 0 }) != 0);
+		if (!table.IsReady())
+		{
+			continue;
+		}
+
+		u32 wrongEntries = 0;
+		u32 missedChanges = 0;
+		for (u32 m = 0; m < table.GetMipCount(); ++m)
+		{
+			const VirtualPageTableRect& dirty = table.GetDirtyRect(m);
+			for (u32 y = 0; y < table.GetPagesY(m); ++y)
+			{
+				for (u32 x = 0; x < table.GetPagesX(m); ++x)
+				{
+					const u32 entry = table.GetPageTable(m)[y * table.GetPagesX(m) + x];
+					wrongEntries += entry != shadow.GetExpectedEntry({ m, x, y });
+					const bool inDirtyRect = x >= dirty.m_MinX && x < dirty.m_MaxX && y >= dirty.m_MinY && y < dirty.m_MaxY;
+					missedChanges += entry != previousTables[m][y * table.GetPagesX(m) + x] && !inDirtyRect;
+				}
+			}
+		}
+		ASSERT_EQ(wrongEntries, 0u) << "frame " << frame;
+		ASSERT_EQ(missedChanges, 0u) << "frame " << frame;
+		table.ClearDirtyRects();
+	}
+
+	// Enough happened for the checks to mean something.
+	EXPECT_GT(table.GetStats().m_Evictions, 100u);
+	EXPECT_GT(failures, 0u);
+	EXPECT_EQ(table.GetStats().m_Failures, failures);
+}